@@ -82,11 +82,23 @@ LOCAL_SRC_FILES:=\
 	CameraUSBAdapter.cpp\
 	CameraIspAdapter.cpp\
 	CameraIspSOCAdapter.cpp\
+	MutliFrameDenoiseCpu.cpp\
 	FakeCameraAdapter.cpp\
+	ReplayCameraAdapter.cpp\
 	CameraHal.cpp\
 	CameraHal_board_xml_parse.cpp\
 	CameraHal_Tracer.c\
 	CameraIspTunning.cpp \
+	CameraIspTuneWriter.cpp\
+	CameraFrameStats.cpp\
+	CameraFrameFanout.cpp\
+	CameraBufferLease.cpp\
+	CameraJpegThumb.cpp\
+	CameraMjpegDecoder.cpp\
+	CameraParamDiff.cpp\
+	CameraThreadConfig.cpp\
+	CameraFaceTracker.cpp\
+	CameraContrastAf.cpp\
 	SensorListener.cpp\
 
 ifeq ($(strip $(BOARD_USE_DRM)), true)
@@ -15,14 +15,13 @@ namespace android {
 
 static char ExifMaker[32];
 static char ExifModel[32];
-static char ExifSelfDefine[640];
 #define FACEDETECT_INIT_BIAS (-20)
 #define FACEDETECT_BIAS_INERVAL (5)
-#define FACEDETECT_FRAME_INTERVAL (1)
 /* ddl@rock-chips.com: v1.0xb.0 */
 AppMsgNotifier::AppMsgNotifier(CameraAdapter *camAdp)
                :mCamAdp(camAdp),
                encProcessThreadCommandQ("pictureEncThreadQ"),
+               jpegEncThreadCommandQ("jpegEncThreadQ"),
                 eventThreadCommandQ("eventThreadQ")
 {
     LOG_FUNCTION_NAME
@@ -37,6 +36,16 @@ AppMsgNotifier::AppMsgNotifier(CameraAdapter *camAdp)
 //    mReceivePictureFrame = false;
 	mRunningState = 0;
     mEncPictureNum = 0;
+    mPicSlotCnt = 0;
+    mPicSlotBusy = 0;
+    mPicSlotSize = 0;
+    mPicSeqCnt = 0;
+    mPicSeqStart = 0;
+    mJpegOutSize = 0;
+    mJpegOutRetry = 0;
+    memset(mMirrorLine, 0, sizeof(mMirrorLine));
+    memset(mMirrorLineSize, 0, sizeof(mMirrorLineSize));
+    mExifTemplateValid = false;
 //    mRecordingRunning = 0;
     mRecordW = 0;
     mRecordH = 0;
@@ -53,6 +62,9 @@ AppMsgNotifier::AppMsgNotifier(CameraAdapter *camAdp)
 
     mPreviewDataW = 0;
     mPreviewDataH = 0;
+    memset(mPreviewDataFmt,0,sizeof(mPreviewDataFmt));
+    mDataCbFrontMirror = false;
+    mDataCbFrontFlip = false;
     mPicSize =0;
     mPicture = NULL;
     mCurOrintation = 0;
@@ -68,6 +80,8 @@ AppMsgNotifier::AppMsgNotifier(CameraAdapter *camAdp)
     mRecMetaDataEn = true;
 	mIsStoreMD = false;
     memset(&mFaceDetectorFun,0,sizeof(struct face_detector_func_s));
+    memset(mVideoFrameTime,0,sizeof(mVideoFrameTime));
+    mVideoLastTime = 0;
     int i ;
     //request mVideoBufs
 	for (i=0; i<CONFIG_CAMERA_VIDEOENC_BUF_CNT; i++) {
@@ -78,13 +92,16 @@ AppMsgNotifier::AppMsgNotifier(CameraAdapter *camAdp)
 	mGrallocModule = NULL;
     //create thread 
     mCameraAppMsgThread = new CameraAppMsgThread(this);
-    mCameraAppMsgThread->run("CamHalAppEventThread",ANDROID_PRIORITY_DISPLAY);
+    mCameraAppMsgThread->run("CamHalAppEventThread",CameraThreadConfig::priority("CamHalAppEventThread"));
     mEncProcessThread = new EncProcessThread(this);
-    mEncProcessThread->run("CamHalAppEncThread",ANDROID_PRIORITY_NORMAL);
+    mEncProcessThread->run("CamHalAppEncThread",CameraThreadConfig::priority("CamHalAppEncThread"));
+    mJpegEncodeThread = new JpegEncodeThread(this);
+    mJpegEncodeThread->run("CamHalJpegEncThread",CameraThreadConfig::priority("CamHalJpegEncThread"));
+    mJpegThumb.init();
     mFaceDetThread = new CameraAppFaceDetThread(this);
-    mFaceDetThread->run("CamHalAppFaceThread",ANDROID_PRIORITY_NORMAL);
+    mFaceDetThread->run("CamHalAppFaceThread",CameraThreadConfig::priority("CamHalAppFaceThread"));
     mCallbackThread = new CameraAppCallbackThread(this);
-    mCallbackThread->run("CamHalCallbckThread",ANDROID_PRIORITY_NORMAL);    
+    mCallbackThread->run("CamHalCallbckThread",CameraThreadConfig::priority("CamHalCallbckThread"));    
     LOG_FUNCTION_NAME_EXIT
 }
 AppMsgNotifier::~AppMsgNotifier()
@@ -116,6 +133,22 @@ AppMsgNotifier::~AppMsgNotifier()
         mEncProcessThread->requestExitAndWait();
         mEncProcessThread.clear();
     }
+    if(mJpegEncodeThread != NULL){
+        msg.command = JpegEncodeThread::CMD_JPEGENC_EXIT;
+        sem1.Create();
+        msg.arg1 = (void*)(&sem1);
+        jpegEncThreadCommandQ.put(&msg);
+        if(msg.arg1){
+            sem1.Wait();
+        }
+        mJpegEncodeThread->requestExitAndWait();
+        mJpegEncodeThread.clear();
+    }
+    mJpegThumb.destroy();
+    {
+        Mutex::Autolock lock(mPicSlotLock);
+        pictureSlotFreeLocked();
+    }
     if(mFaceDetThread != NULL){
         msg.command = CameraAppFaceDetThread::CMD_FACEDET_EXIT;
         sem1.Create();
@@ -209,19 +242,24 @@ void AppMsgNotifier::stopFaceDection()
     LOG_FUNCTION_NAME_EXIT
 }
 int AppMsgNotifier::initializeFaceDetec(int width,int height){
+    //the detector works on the face level of the preview
+    if(!mFaceTracker.setup(width, height))
+        return -1;
     if(!mFaceDetecInit){
         //load face detection lib 
+        char face_lib[PROPERTY_VALUE_MAX];
+        property_get(CAMERAHAL_FACEDETECT_LIB_PROPERTY_KEY, face_lib, CAMERAHAL_FACEDETECT_LIB_DEFAULT);
         dlerror();
-        mFaceDetectorFun.mLibFaceDetectLibHandle = dlopen("libcam_facedetection.so", RTLD_NOW);    
+        mFaceDetectorFun.mLibFaceDetectLibHandle = dlopen(face_lib, RTLD_NOW);    
         if (mFaceDetectorFun.mLibFaceDetectLibHandle == NULL) {
-            LOGE("%s(%d): open libcam_facedetection.so fail",__FUNCTION__,__LINE__);
+            LOGE("%s(%d): open %s fail",__FUNCTION__,__LINE__,face_lib);
             const char *errmsg;
             if ((errmsg = dlerror()) != NULL) {
             	LOGE("dlopen fail errmsg: %s", errmsg);
             }
             return -1;
         } else {
-            LOGE("%s(%d): open libcam_facedetection.so success",__FUNCTION__,__LINE__);
+            LOGD("%s(%d): open %s success",__FUNCTION__,__LINE__,face_lib);
             mFaceDetectorFun.mFaceDectStartFunc = (FaceDetector_start_func)dlsym(mFaceDetectorFun.mLibFaceDetectLibHandle, "FaceDetector_start"); 
 
             if (mFaceDetectorFun.mFaceDectStartFunc == NULL) {
@@ -262,7 +300,7 @@ int AppMsgNotifier::initializeFaceDetec(int width,int height){
             mFaceDetectorFun.mFaceDetector_destory_func = (FaceDetector_destory_func)dlsym(mFaceDetectorFun.mLibFaceDetectLibHandle, "FaceDetector_destory");
             mFaceContext = (*mFaceDetectorFun.mFaceDetector_initizlize_func)(DETECTOR_OPENCL, 15.0f , 1);
             if(mFaceContext){
-                (*mFaceDetectorFun.mFaceDectStartFunc)(mFaceContext,width, height, IMAGE_YUV420SP);
+                (*mFaceDetectorFun.mFaceDectStartFunc)(mFaceContext,mFaceTracker.levelWidth(), mFaceTracker.levelHeight(), IMAGE_YUV420SP);
                 mFaceDetecInit = true;
             }else{
                 dlclose(mFaceDetectorFun.mLibFaceDetectLibHandle); 
@@ -272,7 +310,7 @@ int AppMsgNotifier::initializeFaceDetec(int width,int height){
         }
     }else if((mFaceDetecW != width) || (mFaceDetectH != height)){
         (*mFaceDetectorFun.mFaceDectStopFunc)(mFaceContext);
-        (*mFaceDetectorFun.mFaceDectStartFunc)(mFaceContext,width, height, IMAGE_YUV420SP);
+        (*mFaceDetectorFun.mFaceDectStartFunc)(mFaceContext,mFaceTracker.levelWidth(), mFaceTracker.levelHeight(), IMAGE_YUV420SP);
     }
     mFaceDetecW = width;
     mFaceDetectH = height;
@@ -357,10 +395,8 @@ void AppMsgNotifier::setPictureRawBufProvider(BufferProvider* bufprovider)
  }
 void AppMsgNotifier::setPictureJpegBufProvider(BufferProvider* bufprovider)
 {
+    //jpeg output is allocated by the encode stage, see jpegOutBufGet
     mJpegBufferProvider = bufprovider;
-	#if (JPEG_BUFFER_DYNAMIC == 0)
-    mJpegBufferProvider->createBuffer(1, 0x1600000,JPEGBUFFER,mJpegBufferProvider->is_cif_driver);
-	#endif
 }
 void AppMsgNotifier::setFrameProvider(FrameProvider * framepro)
 {
@@ -722,6 +758,7 @@ int AppMsgNotifier::startRecording(int w,int h)
    
     mRecordW = w;
     mRecordH = h;
+    publishSharedSpec(FANOUT_CONSUMER_VIDEO, w, h, V4L2_PIX_FMT_NV12, false);
 //    mRecordingRunning = true;
 	mRunningState |= STA_RECORD_RUNNING;
 
@@ -825,6 +862,7 @@ int AppMsgNotifier::setPreviewDataCbRes(int w,int h, const char *fmt)
     strcpy(mPreviewDataFmt,fmt);
     mPreviewDataW = w;
     mPreviewDataH = h;
+    publishDataCbSpec();
     LOG_FUNCTION_NAME_EXIT
     return 0;
     
@@ -983,13 +1021,21 @@ void AppMsgNotifier::callback_preview_metadata(camera_memory_t* datacbFrameMem,
     callbackThreadCommandQ.put(&msg);
 }
 
-void AppMsgNotifier::callback_video_frame(camera_memory_t* video_frame)
+void AppMsgNotifier::callback_video_frame(camera_memory_t* video_frame, int index, nsecs_t timestamp)
 {
 	//send to callbackthread
     Message_cam msg;
+
+    //capture time of the frame, the encoder needs it increasing
+    if (timestamp == 0)
+        timestamp = systemTime(CLOCK_MONOTONIC);
+    if (timestamp <= mVideoLastTime)
+        timestamp = mVideoLastTime + 1;
+    mVideoLastTime = timestamp;
+    mVideoFrameTime[index] = timestamp;
     msg.command = CameraAppCallbackThread::CMD_MSG_VIDEO_FRAME;
     msg.arg2 = (void *)video_frame;
-    msg.arg3 = NULL;
+    msg.arg3 = (void *)&mVideoFrameTime[index];
     callbackThreadCommandQ.put(&msg);
 }
 
@@ -1045,9 +1091,10 @@ extern "C" int jpegEncFlushBufferCb(int buf_type, int offset, int len)
      */
 
     if (buf_type == 0) {
-        g_rawbufProvider->flushBuffer(0);
+        ret = g_rawbufProvider->syncBuffer(0, offset, len, CACHE_SYNC_CPU_TO_DEVICE);
     } else if (buf_type == 1) {
-        g_jpegbufProvider->flushBuffer(0);
+        //encoder may call it before or after writing the stream
+        ret = g_jpegbufProvider->syncBuffer(0, offset, len, CACHE_SYNC_BIDIRECTIONAL);
     }
 
     return ret;
@@ -1099,15 +1146,34 @@ int AppMsgNotifier::copyAndSendCompressedImage(void *compressed_image, int size)
     return 0;
 }
 
-int AppMsgNotifier::Jpegfillexifinfo(RkExifInfo *exifInfo,picture_info_s &params)
+//true: the client got the jpeg output itself, mapped through fd, so it can't be reused
+bool AppMsgNotifier::sendCompressedImage(int fd, int size)
+{
+    camera_memory_t* picture;
+
+    if (!(mMsgTypeEnabled & CAMERA_MSG_COMPRESSED_IMAGE) || (fd <= 0))
+        return false;
+    picture = mRequestMemory(fd, size, 1, NULL);
+    if (picture == NULL)
+        return false;
+    if (picture->data == NULL) {
+        picture->release(picture);
+        return false;
+    }
+    callback_compressed_image(picture);
+    return true;
+}
+
+/*
+ * Maker, model and the fixed tags are filled once; each picture copies the
+ * template and only patches the tags that change from shot to shot.
+ */
+void AppMsgNotifier::buildExifTemplate()
 {
 	char property[PROPERTY_VALUE_MAX];
-	
-	if(exifInfo==NULL){
-		LOGE( "..%s..%d..argument error ! ",__FUNCTION__,__LINE__);
-		return 0;
-	}
-	
+	RkExifInfo *exifInfo = &mExifTemplate;
+
+	memset(exifInfo,0x00,sizeof(RkExifInfo));
 	/*fill in jpeg exif tag*/ 
 	property_get("ro.product.brand", property, EXIF_DEF_MAKER);
 	strncpy((char *)ExifMaker, property,sizeof(ExifMaker) - 1);
@@ -1121,6 +1187,44 @@ int AppMsgNotifier::Jpegfillexifinfo(RkExifInfo *exifInfo,picture_info_s &params
 	exifInfo->modelstr = ExifModel;
 	exifInfo->modelchars = strlen(ExifModel)+1;  
 
+	exifInfo->ExposureTime.denom = 10000;
+	exifInfo->ApertureFNumber.num = 0x118;
+	exifInfo->ApertureFNumber.denom = 0x64;
+	exifInfo->CompressedBitsPerPixel.num = 0x4;
+	exifInfo->CompressedBitsPerPixel.denom = 0x1;
+	exifInfo->ShutterSpeedValue.num = 0x452;
+	exifInfo->ShutterSpeedValue.denom = 0x100;
+	exifInfo->ApertureValue.num = 0x2f8;
+	exifInfo->ApertureValue.denom = 0x100;
+	exifInfo->ExposureBiasValue.num = 0;
+	exifInfo->ExposureBiasValue.denom = 0x100;
+	exifInfo->MaxApertureValue.num = 0x02f8;
+	exifInfo->MaxApertureValue.denom = 0x100;
+	exifInfo->MeteringMode = 02;
+	exifInfo->FocalLength.denom = 0x1;
+	
+	exifInfo->FocalPlaneXResolution.num = 0x8383;
+	exifInfo->FocalPlaneXResolution.denom = 0x67;
+	exifInfo->FocalPlaneYResolution.num = 0x7878;
+	exifInfo->FocalPlaneYResolution.denom = 0x76;
+	exifInfo->SensingMethod = 2;
+	exifInfo->FileSource = 3;
+	exifInfo->CustomRendered = 1;
+	exifInfo->ExposureMode = 0;
+	exifInfo->SceneCaptureType = 0x01;	 
+	mExifTemplateValid = true;
+}
+
+int AppMsgNotifier::Jpegfillexifinfo(RkExifInfo *exifInfo,picture_info_s &params,char *makernote,int makernoteSize)
+{
+	if((exifInfo==NULL) || (makernote==NULL)){
+		LOGE( "..%s..%d..argument error ! ",__FUNCTION__,__LINE__);
+		return 0;
+	}
+	if (!mExifTemplateValid)
+		buildExifTemplate();
+	*exifInfo = mExifTemplate;
+
     //degree 0:1
     //degree 90(clockwise):6
     //degree 180:3
@@ -1151,41 +1255,14 @@ int AppMsgNotifier::Jpegfillexifinfo(RkExifInfo *exifInfo,picture_info_s &params
 	strftime((char *)exifInfo->DateTime, 20, "%Y:%m:%d %H:%M:%S", timeinfo);
 	
 	exifInfo->ExposureTime.num = (int)(params.cameraparam.ExposureTime*10000);
-	exifInfo->ExposureTime.denom = 10000;
-	exifInfo->ApertureFNumber.num = 0x118;
-	exifInfo->ApertureFNumber.denom = 0x64;
 	exifInfo->ISOSpeedRatings = ((int)(params.cameraparam.ISOSpeedRatings))*100;
-	exifInfo->CompressedBitsPerPixel.num = 0x4;
-	exifInfo->CompressedBitsPerPixel.denom = 0x1;
-	exifInfo->ShutterSpeedValue.num = 0x452;
-	exifInfo->ShutterSpeedValue.denom = 0x100;
-	exifInfo->ApertureValue.num = 0x2f8;
-	exifInfo->ApertureValue.denom = 0x100;
-	exifInfo->ExposureBiasValue.num = 0;
-	exifInfo->ExposureBiasValue.denom = 0x100;
-	exifInfo->MaxApertureValue.num = 0x02f8;
-	exifInfo->MaxApertureValue.denom = 0x100;
-	exifInfo->MeteringMode = 02;
-
 	exifInfo->Flash = params.flash;	
 	exifInfo->FocalLength.num = (uint32_t)params.focalen;
-	exifInfo->FocalLength.denom = 0x1;
-	
-	exifInfo->FocalPlaneXResolution.num = 0x8383;
-	exifInfo->FocalPlaneXResolution.denom = 0x67;
-	exifInfo->FocalPlaneYResolution.num = 0x7878;
-	exifInfo->FocalPlaneYResolution.denom = 0x76;
-	exifInfo->SensingMethod = 2;
-	exifInfo->FileSource = 3;
-	exifInfo->CustomRendered = 1;
-	exifInfo->ExposureMode = 0;
-
 	exifInfo->WhiteBalance = params.whiteBalance;
 	exifInfo->DigitalZoomRatio.num = params.w;
 	exifInfo->DigitalZoomRatio.denom = params.w;
-	exifInfo->SceneCaptureType = 0x01;	 
 	
-	snprintf(ExifSelfDefine,sizeof(ExifSelfDefine)-1,"XMLVersion=%s   Rg_Proj=%0.5f   s=%0.5f   s_max1=%0.5f  s_max2=%0.5f   Bg1=%0.5f   Rg1=%0.5f   Bg2=%0.5f   Rg2=%0.5f   "
+	snprintf(makernote,makernoteSize-1,"XMLVersion=%s   Rg_Proj=%0.5f   s=%0.5f   s_max1=%0.5f  s_max2=%0.5f   Bg1=%0.5f   Rg1=%0.5f   Bg2=%0.5f   Rg2=%0.5f   "
     "colortemperature=%s   ExpPriorIn=%0.2f   ExpPriorOut=%0.2f    region=%d   ",params.cameraparam.XMLVersion,params.cameraparam.f_RgProj,\
     params.cameraparam.f_s,params.cameraparam.f_s_Max1,params.cameraparam.f_s_Max2,params.cameraparam.f_Bg1,params.cameraparam.f_Rg1,params.cameraparam.f_Bg2,\
     params.cameraparam.f_Rg2,params.cameraparam.illuName[params.cameraparam.illuIdx],params.cameraparam.expPriorIn,params.cameraparam.expPriorOut,\
@@ -1196,14 +1273,14 @@ int AppMsgNotifier::Jpegfillexifinfo(RkExifInfo *exifInfo,picture_info_s &params
 	for(i=0; i<params.cameraparam.count; i++)
 	{
 		snprintf(str,sizeof(str)-1, "illuName[%d]=%s   ",i,params.cameraparam.illuName[i]);
-		strncat(ExifSelfDefine, str, sizeof(ExifSelfDefine)-strlen(ExifSelfDefine)-1);
+		strncat(makernote, str, makernoteSize-strlen(makernote)-1);
 		snprintf(str,sizeof(str)-1, "likehood[%d]=%0.2f   ",i,params.cameraparam.likehood[i]);
-		strncat(ExifSelfDefine, str, sizeof(ExifSelfDefine)-strlen(ExifSelfDefine)-1);	
+		strncat(makernote, str, makernoteSize-strlen(makernote)-1);	
 		snprintf(str,sizeof(str)-1, "wight[%d]=%0.2f   ",i,params.cameraparam.wight[i]);
-		strncat(ExifSelfDefine, str, sizeof(ExifSelfDefine)-strlen(ExifSelfDefine)-1);	
+		strncat(makernote, str, makernoteSize-strlen(makernote)-1);	
 	}
-	exifInfo->makernote = ExifSelfDefine;
-	exifInfo->makernotechars = strlen(ExifSelfDefine)+1;
+	exifInfo->makernote = makernote;
+	exifInfo->makernotechars = strlen(makernote)+1;
 	
 	return 0;
 }
@@ -1316,64 +1393,180 @@ int AppMsgNotifier::Jpegfillgpsinfo(RkGPSInfo *gpsInfo,picture_info_s &params)
 	return 0;
 }
 
-int AppMsgNotifier::captureEncProcessPicture(FramInfo_s* frame){
+/*
+ * Burst capture runs as two stages: encProcessThread scales each frame into a
+ * raw slot buffer (and returns the isp frame as soon as it isn't the encoder
+ * input anymore), jpegEncodeThread encodes and sends it. Up to
+ * CONFIG_CAMERA_PIC_SLOT_CNT pictures are in flight, a full pipeline stalls
+ * the prepare stage until a slot is free.
+ */
+picture_slot_t* AppMsgNotifier::pictureSlotGet(unsigned int pictureSize, int pending)
+{
+    picture_slot_t* slot;
+    long rawbuf_phy,rawbuf_vir;
+    int index,count,ret;
+
+    Mutex::Autolock lock(mPicSlotLock);
+#if (JPEG_BUFFER_DYNAMIC == 1)
+    if (mPicSlotCnt && (mPicSlotSize != pictureSize)) {
+        //picture size changed, let the pictures in flight go first
+        while (mPicSlotBusy)
+            mPicSlotCond.wait(mPicSlotLock);
+        pictureSlotFreeLocked();
+    }
+    if (mPicSlotCnt == 0) {
+        count = (pending > CONFIG_CAMERA_PIC_SLOT_CNT) ? CONFIG_CAMERA_PIC_SLOT_CNT : pending;
+        if (count < 1)
+            count = 1;
+        ret = mRawBufferProvider->createBuffer(count, pictureSize, RAWBUFFER,mRawBufferProvider->is_cif_driver);
+        if ((ret < 0) && (count > 1)) {
+            LOGD("%s(%d): %d picture slots failed, retry with one",__FUNCTION__,__LINE__,count);
+            count = 1;
+            ret = mRawBufferProvider->createBuffer(count, pictureSize, RAWBUFFER,mRawBufferProvider->is_cif_driver);
+        }
+        if (ret < 0) {
+            LOGE("%s(%d): create raw buffer FAILED",__FUNCTION__,__LINE__);
+            return NULL;
+        }
+        mPicSlotCnt = count;
+        mPicSlotSize = pictureSize;
+        mPicSeqCnt = 0;
+        mPicSeqStart = systemTime(CLOCK_MONOTONIC);
+    }
+#endif
+    g_rawbufProvider = mRawBufferProvider;
+    g_jpegbufProvider = mJpegBufferProvider;
+
+    while ((index = mRawBufferProvider->getOneAvailableBuffer(&rawbuf_phy, &rawbuf_vir)) < 0) {
+        if (mPicSlotBusy == 0) {
+            LOGE("%s(%d): mRawBufferProvider->getOneAvailableBuffer FAILED",__FUNCTION__,__LINE__);
+            return NULL;
+        }
+        mPicSlotCond.wait(mPicSlotLock);
+    }
+    if (index >= CONFIG_CAMERA_PIC_SLOT_CNT) {
+        LOGE("%s(%d): raw buffer %d has no slot",__FUNCTION__,__LINE__,index);
+        return NULL;
+    }
+    mRawBufferProvider->setBufferStatus(index, 1);
+    mPicSlotBusy++;
+
+    slot = &mPicSlot[index];
+    memset(slot, 0, sizeof(picture_slot_t));
+    slot->index = index;
+    slot->input_phy = rawbuf_phy;
+    slot->input_vir = rawbuf_vir;
+	#if	defined(RK_DRM_GRALLOC) // should use fd
+    slot->input_phy = mRawBufferProvider->getBufShareFd(index);
+	#endif
+    slot->pictureSize = pictureSize;
+    return slot;
+}
+
+void AppMsgNotifier::pictureSlotPut(picture_slot_t* slot)
+{
+    Mutex::Autolock lock(mPicSlotLock);
+    mRawBufferProvider->setBufferStatus(slot->index, 0);
+    mPicSlotBusy--;
+    mPicSeqCnt++;
+    //last picture of the sequence, give the buffers back
+    if ((mPicSlotBusy == 0) && !(mRunningState & STA_RECEIVE_PIC_FRAME))
+        pictureSlotFreeLocked();
+    mPicSlotCond.broadcast();
+}
+
+void AppMsgNotifier::pictureSlotFreeLocked()
+{
+#if (JPEG_BUFFER_DYNAMIC == 1)
+    if (mPicSlotCnt) {
+        mRawBufferProvider->freeBuffer();
+        LOG1("%s(%d): %d pictures in %lld ms on %d slots",__FUNCTION__,__LINE__,
+            mPicSeqCnt,(long long)((systemTime(CLOCK_MONOTONIC) - mPicSeqStart)/1000000),mPicSlotCnt);
+        mPicSlotCnt = 0;
+        mPicSlotSize = 0;
+    }
+#endif
+    //no slot busy, so the encode stage isn't using the jpeg output
+    if (mJpegOutSize) {
+        mJpegBufferProvider->freeBuffer();
+        LOG1("%s(%d): jpeg output %d KB freed, %d overflow retries",__FUNCTION__,__LINE__,mJpegOutSize >> 10,mJpegOutRetry);
+        mJpegOutSize = 0;
+        mJpegOutRetry = 0;
+    }
+    for (int i = 0; i < CONFIG_CAMERA_PIC_SLOT_CNT; i++) {
+        if (mMirrorLine[i]) {
+            free(mMirrorLine[i]);
+            mMirrorLine[i] = NULL;
+            mMirrorLineSize[i] = 0;
+        }
+    }
+}
+
+/* hw encoder output in 1/16 byte per pixel for qLvl 5..10, a little above typical scenes */
+static const int jpegOutSixteenthPerPixel[6] = {4, 5, 6, 8, 12, 24};
+#define JPEG_OUT_RESERVE        0x20000     /* markers, exif and gps */
+
+static int jpegOutEstimate(int w, int h, int qLvl, int thumbw, int thumbh)
+{
+    long size;
+
+    if (qLvl < 5)
+        qLvl = 5;
+    else if (qLvl > 10)
+        qLvl = 10;
+    size = (long)w*h*jpegOutSixteenthPerPixel[qLvl - 5]/16 + thumbw*thumbh*3/2 + JPEG_OUT_RESERVE;
+    return (size + 0xfff) & ~0xfff;
+}
+
+//bound for the overflow retry: uncompressed 420 plus headers
+static int jpegOutMax(int w, int h, int thumbw, int thumbh)
+{
+    long size = (long)w*h*3/2 + thumbw*thumbh*3/2 + JPEG_OUT_RESERVE;
+    return (size + 0xfff) & ~0xfff;
+}
+
+//encode stage only: keeps the jpeg output at least size bytes, grows it if needed;
+//an output handed to the client by fd is dropped, so the next picture allocates again
+int AppMsgNotifier::jpegOutBufGet(int size, long* phy, long* vir)
+{
+    if (mJpegOutSize < size) {
+        if (mJpegOutSize) {
+            mJpegBufferProvider->freeBuffer();
+            mJpegOutSize = 0;
+        }
+        if (mJpegBufferProvider->createBuffer(1, size,JPEGBUFFER,mJpegBufferProvider->is_cif_driver) < 0) {
+            LOGE("%s(%d): create %d bytes jpeg buffer FAILED",__FUNCTION__,__LINE__,size);
+            return -1;
+        }
+        mJpegOutSize = size;
+    }
+    *phy = mJpegBufferProvider->getBufPhyAddr(0);
+    *vir = mJpegBufferProvider->getBufVirAddr(0);
+	#if defined(RK_DRM_GRALLOC) // should use fd
+    *phy = mJpegBufferProvider->getBufShareFd(0);
+	#endif
+    return 0;
+}
+
+int AppMsgNotifier::capturePreparePicture(FramInfo_s* frame, long frame_used_flag, int pending){
     int ret = 0;
-	int jpeg_w,jpeg_h,i,jpeg_buf_w,jpeg_buf_h;
+	int jpeg_w,jpeg_h,jpeg_buf_w,jpeg_buf_h;
 	unsigned int pictureSize;
-	int jpegSize;
-	int quality;
-	int thumbquality = 0;
-	int thumbwidth	= 0;
-	int thumbheight = 0;
 	int err = 0;
 	int rotation = 0;
-	JpegEncInInfo JpegInInfo;
-	JpegEncOutInfo JpegOutInfo;  
-	RkExifInfo exifInfo;
-	RkGPSInfo gpsInfo;
-	char ExifAsciiPrefix[8] = {'A', 'S', 'C', 'I', 'I', '\0', '\0', '\0'};
-	char gpsprocessmethod[45];
-	char *getMethod = NULL;
-	double latitude,longtitude,altitude;
-	long timestamp;
-	JpegEncType encodetype;
     int picfmt;
+    int encodetype;
     long rawbuf_phy;
     long rawbuf_vir;
-    long jpegbuf_phy;
-    long jpegbuf_vir;
-    long input_phy_addr,input_vir_addr;
-    long output_phy_addr,output_vir_addr;
-    int jpegbuf_size;
-	int bufindex;
     bool mIs_Verifier = false;
+    picture_slot_t* slot = NULL;
+    Message_cam msg;
+	char ExifAsciiPrefix[8] = {'A', 'S', 'C', 'I', 'I', '\0', '\0', '\0'};
 	char prop_value[PROPERTY_VALUE_MAX];
-	memset(&JpegInInfo,0x00,sizeof(JpegEncInInfo));
-	memset(&JpegOutInfo,0x00,sizeof(JpegEncOutInfo));
-	memset(&exifInfo,0x00,sizeof(exifInfo));
-	quality = mPictureInfo.quality;	
-	/*only for passing cts yzm*/
-	property_get("sys.cts_camera.status",prop_value, "false");
-	if(!strcmp(prop_value,"true")){
-		thumbquality = mPictureInfo.thumbquality;
-		thumbwidth	= mPictureInfo.thumbwidth;
-		thumbheight = mPictureInfo.thumbheight;
-	}else{
-		thumbquality = 70;
-		thumbwidth	= 160;
-		thumbheight = 128;		
-	}
+
 	rotation = mPictureInfo.rotation;
-    
 	jpeg_w = mPictureInfo.w;
     jpeg_h = mPictureInfo.h;
-	/*get gps information*/
-	altitude = mPictureInfo.altitude;
-	latitude = mPictureInfo.latitude;
-	longtitude = mPictureInfo.longtitude;
-	timestamp = mPictureInfo.timestamp;    
-	getMethod = mPictureInfo.getMethod;//getMethod : len <= 32
-	
 	picfmt = mPictureInfo.fmt;
 
     if(frame->res)
@@ -1397,68 +1590,38 @@ int AppMsgNotifier::captureEncProcessPicture(FramInfo_s* frame){
 		pictureSize = (pictureSize & 0xfffff000) + 0x1000;
 	}
 
-    jpegbuf_size = 0x1400000; //pictureSize;
-    #if (JPEG_BUFFER_DYNAMIC == 1)
-    //create raw & jpeg buffer
-    ret = mRawBufferProvider->createBuffer(1, pictureSize, RAWBUFFER,mRawBufferProvider->is_cif_driver);
-    if(ret < 0){
-        LOGE("mRawBufferProvider->createBuffer FAILED");
-        goto 	captureEncProcessPicture_exit;
-    }
-    ret = mJpegBufferProvider->createBuffer(1, jpegbuf_size,JPEGBUFFER,mJpegBufferProvider->is_cif_driver);
-    if(ret < 0){
-        LOGE("mJpegBufferProvider->createBuffer FAILED");
-        goto 	captureEncProcessPicture_exit;
+    //blocks while all slots are in flight
+    slot = pictureSlotGet(pictureSize, pending);
+    if (slot == NULL) {
+        err = -1;
+        goto capturePreparePicture_exit;
     }
-    #endif
-
-    bufindex=mRawBufferProvider->getOneAvailableBuffer(&rawbuf_phy, &rawbuf_vir);
-    if(bufindex < 0){
-        LOGE("mRawBufferProvider->getOneAvailableBuffer FAILED");
-        goto 	captureEncProcessPicture_exit;
-    }
-
-	#if	defined(RK_DRM_GRALLOC) // should use fd
-	rawbuf_phy = mRawBufferProvider->getBufShareFd(bufindex);
-	#endif
-	
-	//mRawBufferProvider->setBufferStatus(bufindex, 1);		
-    bufindex=mJpegBufferProvider->getOneAvailableBuffer(&jpegbuf_phy, &jpegbuf_vir);
-    if(bufindex < 0){
-        LOGE("mJpegBufferProvider->getOneAvailableBuffer FAILED");
-        goto 	captureEncProcessPicture_exit;
-    }
-
-	#if defined(RK_DRM_GRALLOC) // should use fd
-	jpegbuf_phy = mJpegBufferProvider->getBufShareFd(bufindex);
-	#endif
-    
-    g_rawbufProvider = mRawBufferProvider;
-    g_jpegbufProvider = mJpegBufferProvider;
-
-
-    input_phy_addr = frame->phy_addr;
-    input_vir_addr = frame->vir_addr;
-    output_phy_addr = jpegbuf_phy;
-    output_vir_addr = jpegbuf_vir;
-	LOG1("input_phy_addr:%x,rawbuf_phy:%x,rawbuf_vir:%x;jpegbuf_phy = %x,jpegbuf_vir = %x",input_phy_addr,rawbuf_phy,rawbuf_vir,jpegbuf_phy,jpegbuf_vir);
+    slot->frame = frame;
+    slot->frame_used_flag = frame_used_flag;
+    slot->encodetype = encodetype;
+    slot->info = mPictureInfo;
+    rawbuf_phy = slot->input_phy;
+    rawbuf_vir = slot->input_vir;
+    slot->input_phy = frame->phy_addr;
+    slot->input_vir = frame->vir_addr;
+	LOG1("input_phy_addr:%x,rawbuf_phy:%x,rawbuf_vir:%x",slot->input_phy,rawbuf_phy,rawbuf_vir);
 
 	if (mMsgTypeEnabled & CAMERA_MSG_SHUTTER)
 		callback_notify_shutter();
 
-	LOGD("captureEncProcessPicture,rotation = %d,jpeg_w = %d,jpeg_h = %d",rotation,jpeg_w,jpeg_h);
+	LOGD("%s,rotation = %d,jpeg_w = %d,jpeg_h = %d,slot %d",__FUNCTION__,rotation,jpeg_w,jpeg_h,slot->index);
 
     //2. copy to output buffer for mirro and flip
 	/*ddl@rock-chips.com: v0.4.7*/
     // bool rotat_180 = false; //used by ipp
     //frame->phy_addr = -1 ,just for isp soc camera used iommu,so ugly...
-    if((frame->frame_fmt == V4L2_PIX_FMT_NV12) && ((frame->frame_width != mPictureInfo.w) || (frame->frame_height != mPictureInfo.h) || (frame->zoom_value != 100) || (long)frame->phy_addr == -1)){
-        output_phy_addr = rawbuf_phy;
-        output_vir_addr = rawbuf_vir;
+    //the encoder takes uv right after y, a padded or split frame is copied to the raw buffer
+    if((frame->frame_fmt == V4L2_PIX_FMT_NV12) && ((frame->frame_width != mPictureInfo.w) || (frame->frame_height != mPictureInfo.h) || (frame->zoom_value != 100) || (long)frame->phy_addr == -1
+        || !FRAME_IS_PACKED(frame))){
         #if 0
         arm_camera_yuv420_scale_arm(V4L2_PIX_FMT_NV12, V4L2_PIX_FMT_NV12, (char*)(frame->vir_addr),
             (char*)rawbuf_vir,frame->frame_width, frame->frame_height,
-             jpeg_w, jpeg_h,false,frame->zoom_value);
+             jpeg_w, jpeg_h,false,frame->zoom_value,FRAME_Y_STRIDE(frame),FRAME_UV_OFFSET(frame));
         #else
 			#if defined(TARGET_RK3188)
 				rk_camera_zoom_ipp(V4L2_PIX_FMT_NV12, (int)(frame->phy_addr), frame->frame_width, frame->frame_height,(int)rawbuf_phy,frame->zoom_value);
@@ -1475,86 +1638,152 @@ int AppMsgNotifier::captureEncProcessPicture(FramInfo_s* frame){
 				if (frame->vir_addr_valid) {
 					err = rga_nv12_scale_crop(frame->frame_width, frame->frame_height, 
 			                            (char*)(frame->vir_addr), (short int *)rawbuf_vir, 
-			                            jpeg_w,jpeg_h,frame->zoom_value,false,!mIs_Verifier,false,0,frame->vir_addr_valid);
+			                            jpeg_w,jpeg_h,frame->zoom_value,false,!mIs_Verifier,false,0,frame->vir_addr_valid,FRAME_Y_STRIDE(frame),FRAME_UV_OFFSET(frame));
 		        } else {
 					err = rga_nv12_scale_crop(frame->frame_width, frame->frame_height, 
 			                            (char*)(frame->phy_addr), (short int *)rawbuf_phy, 
-			                            jpeg_w,jpeg_h,frame->zoom_value,false,!mIs_Verifier,false,0,frame->vir_addr_valid);
+			                            jpeg_w,jpeg_h,frame->zoom_value,false,!mIs_Verifier,false,0,frame->vir_addr_valid,FRAME_Y_STRIDE(frame),FRAME_UV_OFFSET(frame));
 			    }
 				if (err < 0)
 					arm_camera_yuv420_scale_arm(V4L2_PIX_FMT_NV12, V4L2_PIX_FMT_NV12, (char*)(frame->vir_addr),
 						(char*)rawbuf_vir,frame->frame_width, frame->frame_height,
-						 jpeg_w, jpeg_h,false,frame->zoom_value);
+						 jpeg_w, jpeg_h,false,frame->zoom_value,FRAME_Y_STRIDE(frame),FRAME_UV_OFFSET(frame));
+				err = 0;
 				#else
 				rga_nv12_scale_crop(frame->frame_width, frame->frame_height, 
 		                            (char*)(frame->vir_addr), (short int *)rawbuf_vir, 
-		                            jpeg_w,jpeg_h,frame->zoom_value,false,!mIs_Verifier,false);
+		                            jpeg_w,jpeg_h,frame->zoom_value,false,!mIs_Verifier,false,true,FRAME_Y_STRIDE(frame),FRAME_UV_OFFSET(frame));
 				#endif
 			#endif
         #endif
-        input_phy_addr = output_phy_addr;
-        input_vir_addr = output_vir_addr;
-        mRawBufferProvider->flushBuffer(0);
+        slot->input_phy = rawbuf_phy;
+        slot->input_vir = rawbuf_vir;
+        mRawBufferProvider->flushBuffer(slot->index);
+
+        //the encoder reads the raw buffer, isp frame can go back now
+        mFrameProvider->returnFrame(frame->frame_index,frame_used_flag);
+        slot->frame = NULL;
     }
-	/*if ((frame->frame_fmt != picfmt) || (frame->frame_width!= jpeg_w) || (frame->frame_height != jpeg_h) 
-    	|| (frame->zoom_value != 100)) {
-
-        output_phy_addr = rawbuf_phy;
-        output_vir_addr = rawbuf_vir;
-        //do rotation,scale,zoom,fmt convert.   
-		if(cameraFormatConvert(frame->frame_fmt, picfmt, NULL,
-        (char*)input_vir_addr,(char*)output_vir_addr,0,0,jpeg_w*jpeg_h*2,
-        jpeg_w, jpeg_h,jpeg_w,jpeg_w, jpeg_h,jpeg_w,false)==0)
-      // arm_yuyv_to_nv12(frame->frame_width, frame->frame_height,(char*)input_vir_addr, (char*)output_vir_addr);
-        {
-            //change input addr
-			input_phy_addr = output_phy_addr;
-			input_vir_addr = output_vir_addr;
-			mRawBufferProvider->flushBuffer(0);
-		}
-	}*/
 	
 	if((mMsgTypeEnabled & (CAMERA_MSG_RAW_IMAGE))|| (mMsgTypeEnabled & CAMERA_MSG_RAW_IMAGE_NOTIFY)) {
-		copyAndSendRawImage((void*)input_vir_addr, pictureSize);
+		copyAndSendRawImage((void*)slot->input_vir, pictureSize);
     }
-    
-    output_phy_addr = jpegbuf_phy;
-    output_vir_addr = jpegbuf_vir;
-
-#if 1
 
     //3. src data will be changed by mirror and flip algorithm
-    //use jpeg buffer as line buffer
-
-	if(rotation == 0)
+	if((rotation == 180) || (rotation == 90))
 	{
-		JpegInInfo.rotateDegree = DEGREE_0; 
+		//slots are prepared one at a time on this thread, the enc thread never touches the line
+		if (mMirrorLineSize[slot->index] < jpeg_w) {
+			free(mMirrorLine[slot->index]);
+			mMirrorLine[slot->index] = (char*)malloc(jpeg_w);
+			mMirrorLineSize[slot->index] = mMirrorLine[slot->index] ? jpeg_w : 0;
+		}
+		if (mMirrorLine[slot->index]) {
+			YuvData_Mirror_Flip(V4L2_PIX_FMT_NV12, (char*)slot->input_vir,
+			mMirrorLine[slot->index], jpeg_w, jpeg_h);
+			mRawBufferProvider->flushBuffer(slot->index);
+		} else {
+			LOGE("%s(%d): no %d byte mirror line, picture %d is not rotated %d",__FUNCTION__,__LINE__,
+				jpeg_w,slot->index,rotation);
+		}
 	}
-	else if(rotation == 180)
-	{
-		YuvData_Mirror_Flip(V4L2_PIX_FMT_NV12, (char*)input_vir_addr,
-		(char*) jpegbuf_vir, jpeg_w, jpeg_h);
-		mRawBufferProvider->flushBuffer(0);
-		JpegInInfo.rotateDegree = DEGREE_0; 
+
+    //4. exif, gps and the thumbnail are ready before the slot reaches the encoder
+	/*only for passing cts yzm*/
+	property_get("sys.cts_camera.status",prop_value, "false");
+	if(!strcmp(prop_value,"true")){
+		slot->thumbquality = mPictureInfo.thumbquality;
+		slot->thumbwidth = mPictureInfo.thumbwidth;
+		slot->thumbheight = mPictureInfo.thumbheight;
+	}else{
+		slot->thumbquality = 70;
+		slot->thumbwidth = 160;
+		slot->thumbheight = 128;
 	}
-	else if(rotation == 90)
-	{
-		YuvData_Mirror_Flip(V4L2_PIX_FMT_NV12, (char*)input_vir_addr,
-		(char*) jpegbuf_vir, jpeg_w, jpeg_h);
-		mRawBufferProvider->flushBuffer(0);	
-		JpegInInfo.rotateDegree = DEGREE_270;
+	Jpegfillexifinfo(&slot->exif,slot->info,slot->makernote,sizeof(slot->makernote));
+	if((slot->info.longtitude!=-1)&& (slot->info.latitude!=-1)&&(slot->info.timestamp!=-1)) {
+		Jpegfillgpsinfo(&slot->gps,slot->info);
+		memset(slot->gpsmethod,0,sizeof(slot->gpsmethod));
+		memcpy(slot->gpsmethod,ExifAsciiPrefix,8);
+		strncpy(slot->gpsmethod+8,slot->info.getMethod,sizeof(slot->gpsmethod)-9);
+		slot->gps.GpsProcessingMethodchars = strlen(slot->gpsmethod+8)+1+8;
+		slot->gps.GPSProcessingMethod = slot->gpsmethod;
+		slot->hasGps = true;
+	}
+#if !defined(TARGET_RK3188) && !defined(TARGET_RK322x)
+	//rotated pictures keep the encoder's own thumbnail, it knows the rotation
+	if (slot->thumbwidth && slot->thumbheight && slot->input_vir && (encodetype == JPEGENC_YUV420_SP)
+		&& ((rotation == 0) || (rotation == 180))) {
+		slot->thumbJob.src = (const unsigned char*)slot->input_vir;
+		slot->thumbJob.srcW = jpeg_w;
+		slot->thumbJob.srcH = jpeg_h;
+		slot->thumbJob.dstW = slot->thumbwidth;
+		slot->thumbJob.dstH = slot->thumbheight;
+		slot->thumbJob.quality = (slot->thumbquality < 1) ? 1 : ((slot->thumbquality > 100) ? 100 : slot->thumbquality);
+		mJpegThumb.queue(&slot->thumbJob);
+	}
+#endif
+
+    msg.command = JpegEncodeThread::CMD_JPEGENC_SLOT;
+    msg.arg2 = (void*)slot;
+    jpegEncThreadCommandQ.put(&msg);
+    return ret;
+
+capturePreparePicture_exit:
+    if (frame)
+        mFrameProvider->returnFrame(frame->frame_index,frame_used_flag);
+	LOGE("%s(%d) take picture erro!!!,",__FUNCTION__,__LINE__);
+	if (mNotifyCb && (mMsgTypeEnabled & CAMERA_MSG_ERROR)) {						
+		callback_notify_error();
 	}
-	else if(rotation == 270)
+    return err;
+}
+
+int AppMsgNotifier::captureEncodePicture(picture_slot_t* slot){
+    int ret = 0;
+	int jpeg_w,jpeg_h;
+	int quality;
+	int thumbquality = 0;
+	int thumbwidth	= 0;
+	int thumbheight = 0;
+	int err = 0;
+	int rotation = 0;
+	JpegEncInInfo JpegInInfo;
+	JpegEncOutInfo JpegOutInfo;  
+    long input_phy_addr,input_vir_addr;
+    long output_phy_addr,output_vir_addr;
+    int jpegbuf_size;
+    picture_info_s& info = slot->info;
+	memset(&JpegInInfo,0x00,sizeof(JpegEncInInfo));
+	memset(&JpegOutInfo,0x00,sizeof(JpegEncOutInfo));
+	quality = info.quality;	
+	thumbquality = slot->thumbquality;
+	thumbwidth = slot->thumbwidth;
+	thumbheight = slot->thumbheight;
+	rotation = info.rotation;
+    
+	jpeg_w = info.w;
+    jpeg_h = info.h;
+
+    input_phy_addr = slot->input_phy;
+    input_vir_addr = slot->input_vir;
+
+#if 1
+	if((rotation == 90) || (rotation == 270))
 	{
 		JpegInInfo.rotateDegree = DEGREE_270; 		
 	}
+	else
+	{
+		JpegInInfo.rotateDegree = DEGREE_0; 
+	}
 #else
     //set rotation in exif file
 	JpegInInfo.rotateDegree = DEGREE_0; 
 #endif
 	JpegInInfo.frameHeader = 1;
 	JpegInInfo.yuvaddrfor180 = (int)NULL;
-	JpegInInfo.type = encodetype;
+	JpegInInfo.type = (JpegEncType)slot->encodetype;
 	JpegInInfo.y_rgb_addr = input_phy_addr;
 	JpegInInfo.uv_addr = input_phy_addr + jpeg_w*jpeg_h;	 
 	//JpegInInfo.y_vir_addr = input_vir_addr;
@@ -1582,6 +1811,11 @@ int AppMsgNotifier::captureEncProcessPicture(FramInfo_s* frame){
 		JpegInInfo.doThumbNail = 1; 		 //insert thumbnail at APP0 extension
 		JpegInInfo.thumbData = NULL;		 //if thumbData is NULL, do scale, the type above can not be 420_P or 422_UYVY
 		JpegInInfo.thumbDataLen = -1;
+		//made by mJpegThumb while the previous picture was encoded
+		if ((slot->thumbJob.state != CAM_THUMB_IDLE) && (mJpegThumb.wait(&slot->thumbJob) > 0)) {
+			JpegInInfo.thumbData = slot->thumbJob.out;
+			JpegInInfo.thumbDataLen = slot->thumbJob.outLen;
+		}
 		JpegInInfo.thumbW = thumbwidth;
 		JpegInInfo.thumbH = thumbheight;
 		JpegInInfo.y_vir_addr = (unsigned char*)input_vir_addr;
@@ -1596,22 +1830,21 @@ int AppMsgNotifier::captureEncProcessPicture(FramInfo_s* frame){
 		JpegInInfo.uv_vir_addr = 0;		
 	}
 
-	Jpegfillexifinfo(&exifInfo,mPictureInfo);
-	JpegInInfo.exifInfo =&exifInfo;
-
-	if((longtitude!=-1)&& (latitude!=-1)&&(timestamp!=-1)&&(getMethod!=NULL)) {    
-		Jpegfillgpsinfo(&gpsInfo,mPictureInfo);  
-		memset(gpsprocessmethod,0,45);	 
-		memcpy(gpsprocessmethod,ExifAsciiPrefix,8);   
-		memcpy(gpsprocessmethod+8,getMethod,strlen(getMethod)+1);		   
-		gpsInfo.GpsProcessingMethodchars = strlen(getMethod)+1+8;
-		gpsInfo.GPSProcessingMethod  = gpsprocessmethod;
-		LOG1("\nGpsProcessingMethodchars =%d",gpsInfo.GpsProcessingMethodchars);
-		JpegInInfo.gpsInfo = &gpsInfo;
-	} else {
-		JpegInInfo.gpsInfo = NULL;
-	}
+	JpegInInfo.exifInfo = &slot->exif;
+	JpegInInfo.gpsInfo = slot->hasGps ? &slot->gps : NULL;
 
+#if defined(TARGET_RK322x)
+    //soft encoder runs at quality 100 and can't report an overflow
+    jpegbuf_size = jpegOutMax(jpeg_w, jpeg_h, 0, 0);
+#else
+    jpegbuf_size = jpegOutEstimate(jpeg_w, jpeg_h, JpegInInfo.qLvl, JpegInInfo.doThumbNail ? thumbwidth : 0,
+                                   JpegInInfo.doThumbNail ? thumbheight : 0);
+#endif
+jpeg_encode_retry:
+    if (jpegOutBufGet(jpegbuf_size, &output_phy_addr, &output_vir_addr) < 0) {
+        err = -1;
+        goto captureEncodePicture_exit;
+    }
 	JpegOutInfo.outBufPhyAddr = output_phy_addr;
 	JpegOutInfo.outBufVirAddr = (unsigned char*)output_vir_addr;
 	JpegOutInfo.outBuflen = jpegbuf_size;
@@ -1645,22 +1878,35 @@ LOG2("\nJpegInInfo.y_rgb_addr=0x%x\n"
 	  JpegOutInfo.outBuflen);
 
 	err = hw_jpeg_encode(&JpegInInfo, &JpegOutInfo);
-	
-	if ((err < 0) || (JpegOutInfo.jpegFileLen <=0x00)) {
+
+	//the estimate was too small: encode once more into a worst case buffer
+	if (((err < 0) || (JpegOutInfo.jpegFileLen <= 0x00) || (JpegOutInfo.jpegFileLen >= jpegbuf_size))
+		&& (jpegbuf_size < jpegOutMax(jpeg_w, jpeg_h, thumbwidth, thumbheight))) {
+		LOGD("%s(%d): jpeg output(%d bytes) overflow, err %d len %d, retry",__FUNCTION__,__LINE__,
+			jpegbuf_size, err, JpegOutInfo.jpegFileLen);
+		mJpegOutRetry++;
+		jpegbuf_size = jpegOutMax(jpeg_w, jpeg_h, thumbwidth, thumbheight);
+		goto jpeg_encode_retry;
+	}
+	if ((err < 0) || (JpegOutInfo.jpegFileLen <=0x00) || (JpegOutInfo.jpegFileLen > jpegbuf_size)) {
 		LOGE("%s(%d): hw_jpeg_encode Failed, err: %d  JpegOutInfo.jpegFileLen:0x%x\n",__FUNCTION__,__LINE__,
 			err, JpegOutInfo.jpegFileLen);
-		goto captureEncProcessPicture_exit;
+		goto captureEncodePicture_exit;
+	} else if (sendCompressedImage(mJpegBufferProvider->getBufShareFd(0), JpegOutInfo.jpegFileLen)) {
+		//the client maps the jpeg output until it's done, the next picture gets a new one
+		mJpegBufferProvider->freeBuffer();
+		mJpegOutSize = 0;
 	} else {
 		copyAndSendCompressedImage((void*)JpegOutInfo.outBufVirAddr,JpegOutInfo.jpegFileLen);
 	}
 #endif
 
-captureEncProcessPicture_exit: 
- //destroy raw and jpeg buffer
- #if (JPEG_BUFFER_DYNAMIC == 1)
-    mRawBufferProvider->freeBuffer();
-    mJpegBufferProvider->freeBuffer();
- #endif
+captureEncodePicture_exit: 
+    if (slot->thumbJob.state != CAM_THUMB_IDLE)
+        mJpegThumb.release(&slot->thumbJob);
+    if (slot->frame)
+        mFrameProvider->returnFrame(slot->frame->frame_index,slot->frame_used_flag);
+    pictureSlotPut(slot);
 	if(err < 0) {
 		LOGE("%s(%d) take picture erro!!!,",__FUNCTION__,__LINE__);
 		if (mNotifyCb && (mMsgTypeEnabled & CAMERA_MSG_ERROR)) {						
@@ -1686,6 +1932,8 @@ int AppMsgNotifier::processPreviewDataCb(FramInfo_s* frame){
         camera_memory_t* tmpPreviewMemory = NULL;
         camera_memory_t* tmpNV12To420pMemory = NULL;
         bool isYUV420p = false;
+        bool isYUV420sp = false;
+        const unsigned char* shared = NULL;
 
         if (strcmp(mPreviewDataFmt,android::CameraParameters::PIXEL_FORMAT_RGB565) == 0) {
             tempMemSize = mPreviewDataW*mPreviewDataH*2;        
@@ -1694,6 +1942,7 @@ int AppMsgNotifier::processPreviewDataCb(FramInfo_s* frame){
             pixFmt =V4L2_PIX_FMT_NV21;
             tempMemSize = mPreviewDataW*mPreviewDataH*3/2;        
             tempMemSize_crop = mPreviewDataW*mPreviewDataH*3/2;        
+            isYUV420sp = true;
         } else if (strcmp(mPreviewDataFmt,android::CameraParameters::PIXEL_FORMAT_YUV422SP) == 0) {
             tempMemSize = mPreviewDataW*mPreviewDataH*2;        
             tempMemSize_crop = mPreviewDataW*mPreviewDataH*2;        
@@ -1718,35 +1967,42 @@ int AppMsgNotifier::processPreviewDataCb(FramInfo_s* frame){
 #if 0
 			//QQ voip need NV21
 			arm_camera_yuv420_scale_arm(V4L2_PIX_FMT_NV12, V4L2_PIX_FMT_NV21, (char*)(frame->vir_addr),
-					(char*)tmpPreviewMemory->data,frame->frame_width, frame->frame_height,mPreviewDataW, mPreviewDataH,mDataCbFrontMirror,frame->zoom_value);
+					(char*)tmpPreviewMemory->data,frame->frame_width, frame->frame_height,mPreviewDataW, mPreviewDataH,mDataCbFrontMirror,frame->zoom_value,FRAME_Y_STRIDE(frame),FRAME_UV_OFFSET(frame));
 #else
         if(g_ctsV_flag &&((mPreviewDataW==176&&mPreviewDataH==144)||(mPreviewDataW==352&&mPreviewDataH==288))) {
             arm_camera_yuv420_scale_arm(V4L2_PIX_FMT_NV12, pixFmt, (char*)(frame->vir_addr),
                                         (char*)tmpPreviewMemory->data,frame->frame_width, frame->frame_height,
-                                        mPreviewDataW, mPreviewDataH,false,frame->zoom_value);
+                                        mPreviewDataW, mPreviewDataH,false,frame->zoom_value,FRAME_Y_STRIDE(frame),FRAME_UV_OFFSET(frame));
         }else{
+            if (isYUV420p || isYUV420sp)
+                shared = acquireSharedFrame(frame, FANOUT_CONSUMER_DATACB, mPreviewDataW, mPreviewDataH,
+                                            isYUV420p ? V4L2_PIX_FMT_NV12 : V4L2_PIX_FMT_NV21, mDataCbFrontMirror);
+            if (shared) {
+                memcpy(tmpPreviewMemory->data, shared, mPreviewDataW*mPreviewDataH*3/2);
+            }else{
 			#if defined(RK_DRM_GRALLOC)
             if (!strcmp("com.tencent.mobileqq:MSF",mCallingProcess)
                 || !strcmp("com.tencent.mobileqq:peak",mCallingProcess)){
                 //workround fix qq self capture little video problem.
                 arm_camera_yuv420_scale_arm(V4L2_PIX_FMT_NV12, V4L2_PIX_FMT_NV21, (char*)(frame->vir_addr),
 					(char*)tmpPreviewMemory->data,frame->frame_width, frame->frame_height,mPreviewDataW, mPreviewDataH,
-                    mDataCbFrontMirror,frame->zoom_value);
+                    mDataCbFrontMirror,frame->zoom_value,FRAME_Y_STRIDE(frame),FRAME_UV_OFFSET(frame));
             }else{
 			    err = rga_nv12_scale_crop(frame->frame_width, frame->frame_height,
 					(char*)(frame->vir_addr), (short int *)(tmpPreviewMemory->data), 
-					mPreviewDataW,mPreviewDataH,frame->zoom_value,mDataCbFrontMirror,true,!isYUV420p,0,true);
+					mPreviewDataW,mPreviewDataH,frame->zoom_value,mDataCbFrontMirror,true,!isYUV420p,0,true,FRAME_Y_STRIDE(frame),FRAME_UV_OFFSET(frame));
                 if (err){
                     arm_camera_yuv420_scale_arm(V4L2_PIX_FMT_NV12, V4L2_PIX_FMT_NV12, (char*)(frame->vir_addr),
                         (char*)(tmpPreviewMemory->data),frame->frame_width, frame->frame_height,
-                        mPreviewDataW,mPreviewDataH,mDataCbFrontMirror,frame->zoom_value);
+                        mPreviewDataW,mPreviewDataH,mDataCbFrontMirror,frame->zoom_value,FRAME_Y_STRIDE(frame),FRAME_UV_OFFSET(frame));
                  }
             }
 			#else
             rga_nv12_scale_crop(frame->frame_width, frame->frame_height, 
 					(char*)(frame->vir_addr), (short int *)(tmpPreviewMemory->data), 
-					mPreviewDataW,mPreviewDataH,frame->zoom_value,mDataCbFrontMirror,true,!isYUV420p);
+					mPreviewDataW,mPreviewDataH,frame->zoom_value,mDataCbFrontMirror,true,!isYUV420p,true,FRAME_Y_STRIDE(frame),FRAME_UV_OFFSET(frame));
 			#endif
+            }
         }
 #endif
 			//arm_yuyv_to_nv12(frame->frame_width, frame->frame_height,(char*)(frame->vir_addr), (char*)buf_vir);
@@ -1782,10 +2038,50 @@ int AppMsgNotifier::processPreviewDataCb(FramInfo_s* frame){
 	return ret;
 }
 
+//rendition shared with the other preview consumers, NULL: render it here
+const unsigned char* AppMsgNotifier::acquireSharedFrame(FramInfo_s* frame, int consumer, int width, int height, int fmt, bool mirror)
+{
+    CameraFrameFanout* fanout = mFrameProvider ? mFrameProvider->getFrameFanout() : NULL;
+    fanout_spec_t spec;
+
+    if ((fanout == NULL) || (frame->frame_fmt != V4L2_PIX_FMT_NV12))
+        return NULL;
+    spec.width = width;
+    spec.height = height;
+    spec.fmt = fmt;
+    spec.mirror = mirror;
+    return fanout->acquire(frame->vir_addr, consumer, &spec);
+}
+
+//the output a consumer renders from the next frame on, so that frame can already be shared
+void AppMsgNotifier::publishSharedSpec(int consumer, int width, int height, int fmt, bool mirror)
+{
+    CameraFrameFanout* fanout = mFrameProvider ? mFrameProvider->getFrameFanout() : NULL;
+    fanout_spec_t spec;
+
+    if ((fanout == NULL) || (width <= 0) || (height <= 0))
+        return;
+    spec.width = width;
+    spec.height = height;
+    spec.fmt = fmt;
+    spec.mirror = mirror;
+    fanout->publish(consumer, &spec);
+}
+
+//yuv420p callbacks are rendered as nv12 and converted, yuv420sp ones as nv21
+void AppMsgNotifier::publishDataCbSpec()
+{
+    if (strcmp(mPreviewDataFmt,android::CameraParameters::PIXEL_FORMAT_YUV420P) == 0)
+        publishSharedSpec(FANOUT_CONSUMER_DATACB, mPreviewDataW, mPreviewDataH, V4L2_PIX_FMT_NV12, mDataCbFrontMirror);
+    else if (strcmp(mPreviewDataFmt,android::CameraParameters::PIXEL_FORMAT_YUV420SP) == 0)
+        publishSharedSpec(FANOUT_CONSUMER_DATACB, mPreviewDataW, mPreviewDataH, V4L2_PIX_FMT_NV21, mDataCbFrontMirror);
+}
+
 int AppMsgNotifier::processVideoCb(FramInfo_s* frame){
     int ret = 0,buf_index = -1;
 	long buf_phy = 0,buf_vir = 0;
     int err;
+    const unsigned char* shared = NULL;
 	if(mIsStoreMD == false){	
 	    //get one available buffer
 	    if((buf_index = mVideoBufferProvider->getOneAvailableBuffer(&buf_phy,&buf_vir)) == -1){
@@ -1800,39 +2096,41 @@ int AppMsgNotifier::processVideoCb(FramInfo_s* frame){
 		buf_vir = mGrallocVideoBuf[buf_index]->vir_addr;
 	        arm_camera_yuv420_scale_arm(V4L2_PIX_FMT_NV12, V4L2_PIX_FMT_NV12, (char*)(frame->vir_addr),
 	            (char*)buf_vir,frame->frame_width, frame->frame_height,
-	            mRecordW, mRecordH,false,frame->zoom_value);
+	            mRecordW, mRecordH,false,frame->zoom_value,FRAME_Y_STRIDE(frame),FRAME_UV_OFFSET(frame));
 	        #else
 	        if(g_ctsV_flag &&((mRecordW==176&&mRecordH==144)||(mRecordW==352&&mRecordH==288))) {
 	            arm_camera_yuv420_scale_arm(V4L2_PIX_FMT_NV12, V4L2_PIX_FMT_NV12, (char*)(frame->vir_addr),
 	                                        (char*)buf_vir,frame->frame_width, frame->frame_height,
-	                                        mRecordW, mRecordH,false,frame->zoom_value);
+	                                        mRecordW, mRecordH,false,frame->zoom_value,FRAME_Y_STRIDE(frame),FRAME_UV_OFFSET(frame));
+	        }else if ((shared = acquireSharedFrame(frame, FANOUT_CONSUMER_VIDEO, mRecordW, mRecordH, V4L2_PIX_FMT_NV12, false)) != NULL){
+	            memcpy((void*)buf_vir, shared, mRecordW*mRecordH*3/2);
 	        }else{
 				#if defined(RK_DRM_GRALLOC)
 				if (frame->vir_addr_valid){
 		            err = rga_nv12_scale_crop(frame->frame_width, frame->frame_height,
 		                                (char*)(frame->vir_addr), (short int *)buf_vir,
-		                                mRecordW,mRecordH,frame->zoom_value,false,true,false,0,frame->vir_addr_valid);
+		                                mRecordW,mRecordH,frame->zoom_value,false,true,false,0,frame->vir_addr_valid,FRAME_Y_STRIDE(frame),FRAME_UV_OFFSET(frame));
 	            } else{
 					long fd = mVideoBufferProvider->getBufShareFd(buf_index);
 					err = rga_nv12_scale_crop(frame->frame_width, frame->frame_height,
 										(char*)(frame->phy_addr), (short int *)fd,
-										mRecordW,mRecordH,frame->zoom_value,false,true,false,0,frame->vir_addr_valid);
+										mRecordW,mRecordH,frame->zoom_value,false,true,false,0,frame->vir_addr_valid,FRAME_Y_STRIDE(frame),FRAME_UV_OFFSET(frame));
 	            }
                 if (err){
                     arm_camera_yuv420_scale_arm(V4L2_PIX_FMT_NV12, V4L2_PIX_FMT_NV12, (char*)(frame->vir_addr),
                             (char*)(buf_vir),frame->frame_width, frame->frame_height,
-                            mRecordW,mRecordH,false,frame->zoom_value);
+                            mRecordW,mRecordH,false,frame->zoom_value,FRAME_Y_STRIDE(frame),FRAME_UV_OFFSET(frame));
                 }
 				#else
 	            rga_nv12_scale_crop(frame->frame_width, frame->frame_height,
 	                                (char*)(frame->vir_addr), (short int *)buf_vir,
-	                                mRecordW,mRecordH,frame->zoom_value,false,true,false);
+	                                mRecordW,mRecordH,frame->zoom_value,false,true,false,true,FRAME_Y_STRIDE(frame),FRAME_UV_OFFSET(frame));
 				#endif
 	        }
 	        #endif
 
 	        mVideoBufferProvider->flushBuffer(buf_index);
-	        callback_video_frame(mVideoBufs[buf_index]);
+	        callback_video_frame(mVideoBufs[buf_index], buf_index, frame->meta.timestamp);
 	        LOG1("EncPicture:V4L2_PIX_FMT_NV12,arm_camera_yuv420_scale_arm");
 	    }
 	}else{
@@ -1850,38 +2148,43 @@ int AppMsgNotifier::processVideoCb(FramInfo_s* frame){
         buf_vir = mGrallocVideoBuf[buf_index]->vir_addr;
         arm_camera_yuv420_scale_arm(V4L2_PIX_FMT_NV12, V4L2_PIX_FMT_NV12, (char*)(frame->vir_addr),
             (char*)buf_vir,frame->frame_width, frame->frame_height,
-            mRecordW, mRecordH,false,frame->zoom_value);
+            mRecordW, mRecordH,false,frame->zoom_value,FRAME_Y_STRIDE(frame),FRAME_UV_OFFSET(frame));
         #else
 		
+        shared = acquireSharedFrame(frame, FANOUT_CONSUMER_VIDEO, mRecordW, mRecordH, V4L2_PIX_FMT_NV12, false);
+        if (shared) {
+            memcpy((void*)mGrallocVideoBuf[buf_index]->vir_addr, shared, mRecordW*mRecordH*3/2);
+        } else {
 		#if defined(RK_DRM_GRALLOC)
 		if (frame->vir_addr_valid){
 		    err = rga_nv12_scale_crop(frame->frame_width, frame->frame_height,
 		                (char*)(frame->vir_addr), (short int*)(mGrallocVideoBuf[buf_index]->vir_addr),
-		                mRecordW,mRecordH,frame->zoom_value,false,true,false,0,frame->vir_addr_valid);
+		                mRecordW,mRecordH,frame->zoom_value,false,true,false,0,frame->vir_addr_valid,FRAME_Y_STRIDE(frame),FRAME_UV_OFFSET(frame));
 	    } else{
             err = rga_nv12_scale_crop(frame->frame_width, frame->frame_height,
                         (char*)(frame->phy_addr), (short int*)(mGrallocVideoBuf[buf_index]->phy_addr),
-                        mRecordW,mRecordH,frame->zoom_value,false,true,false,0,frame->vir_addr_valid);
+                        mRecordW,mRecordH,frame->zoom_value,false,true,false,0,frame->vir_addr_valid,FRAME_Y_STRIDE(frame),FRAME_UV_OFFSET(frame));
 	    }
         if (err){
             arm_camera_yuv420_scale_arm(V4L2_PIX_FMT_NV12, V4L2_PIX_FMT_NV12, (char*)(frame->vir_addr),
                     (char*)(mGrallocVideoBuf[buf_index]->vir_addr),frame->frame_width, frame->frame_height,
-                    mRecordW,mRecordH,false,frame->zoom_value);
+                    mRecordW,mRecordH,false,frame->zoom_value,FRAME_Y_STRIDE(frame),FRAME_UV_OFFSET(frame));
         }
 		#else
         	#if (defined(TARGET_RK312x) || defined(TARGET_RK3328)) && defined(ANDROID_7_X)
 			    rga_nv12_scale_crop(frame->frame_width, frame->frame_height,
 			                (char*)(frame->phy_addr), (short int*)(mGrallocVideoBuf[buf_index]->phy_addr),
-			                mRecordW,mRecordH,frame->zoom_value,false,true,false,false);
+			                mRecordW,mRecordH,frame->zoom_value,false,true,false,false,FRAME_Y_STRIDE(frame),FRAME_UV_OFFSET(frame));
             #else
 			    rga_nv12_scale_crop(frame->frame_width, frame->frame_height,
 			                (char*)(frame->vir_addr), (short int*)(mGrallocVideoBuf[buf_index]->vir_addr),
-			                mRecordW,mRecordH,frame->zoom_value,false,true,false,true);
+			                mRecordW,mRecordH,frame->zoom_value,false,true,false,true,FRAME_Y_STRIDE(frame),FRAME_UV_OFFSET(frame));
             #endif
 		#endif
+        }
         #endif
 
-        callback_video_frame(mVideoBufs[buf_index]);
+        callback_video_frame(mVideoBufs[buf_index], buf_index, frame->meta.timestamp);
 		}
 
 	}
@@ -1889,97 +2192,56 @@ int AppMsgNotifier::processVideoCb(FramInfo_s* frame){
     return ret;
 }
 
+//>= 0: faces the detector found, -1: the faces were tracked or the frame skipped
 int AppMsgNotifier::processFaceDetect(FramInfo_s* frame, long frame_used_flag)
 {
-    int num = 0;
-    //Mutex::Autolock lock(mFaceDecLock);
-    if(mMsgTypeEnabled & CAMERA_MSG_PREVIEW_METADATA){
-        if((frame->frame_fmt == V4L2_PIX_FMT_NV12)){
-            struct RectFace *faces = NULL;
-            int i = 0,hasSmileFace = 0;
-            int zoom_value, frame_width, frame_height;
-            nsecs_t last = systemTime(SYSTEM_TIME_MONOTONIC);
-            if(!mFaceDetecInit)
-                return -1;
-
-            (*mFaceDetectorFun.mFaceDectprepareFunc)(mFaceContext, (void*)frame->vir_addr);
-            zoom_value = frame->zoom_value;
-            frame_width = frame->frame_width;
-            frame_height = frame->frame_height;
-            mFrameProvider->returnFrame(frame->frame_index,frame_used_flag);
-
-            (*mFaceDetectorFun.mFaceDectFindFaceFun)(mFaceContext, mCurOrintation,mCurBiasAngle,0, &hasSmileFace, &faces, &num);
-            nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
-
-            nsecs_t diff = now - last;
-            LOG2("FaceDetection mCurBiasAngle %0.0f,facenum: %d, use time: %lldms\n", mCurBiasAngle,num, ns2ms(diff));
-			camera_frame_metadata_t *pMetadata = (camera_frame_metadata_t *)malloc(sizeof(camera_frame_metadata_t));
-
-            if(num > 0){
-                num = MIN(num, mFaceNum);
-                pMetadata->number_of_faces = num;
-                camera_face_t* pFace = (camera_face_t*)malloc(sizeof(camera_face_t)*num);
-                pMetadata->faces = pFace;
-                int tmpX,tmpY,tmpW,tempH;
-                for(i = 0;i < num;i++){
-                    tmpX = faces[i].x;
-                    tmpY = faces[i].y;
-                    tmpW = faces[i].width;
-                    tempH = faces[i].height;
-
-                    switch(mCurOrintation){
-                        case 1://90 degree
-                            tmpY += tempH;
-                            faces[i].x = frame_width - tmpY;
-                            faces[i].y = tmpX;
-                            faces[i].width = tempH;
-                            faces[i].height = tmpW;
-                            break;
-                        case 2://180 degree
-                            tmpX += tmpW;
-                            tmpY += tempH;
-                            faces[i].x = frame_width - tmpX;
-                            faces[i].y = frame_height - tmpY;
-                            break;
-                        case 3://270 degree
-                            tmpX += tmpW;
-                            faces[i].x = tmpY ;
-                            faces[i].y = frame_height - tmpX;
-                            faces[i].width = tempH;
-                            faces[i].height = tmpW;
-                            break;
-                        default:
-                            break;
-                    }
-                    LOG2("facerect[%d]: (%d, %d, %d, %d)\n", i, faces[i].x, faces[i].y, faces[i].width, faces[i].height);
-                    //map to face rect
-                    int virWidtHig = 2000 * zoom_value / 100;
-
-                    pFace[i].rect[0] = faces[i].x * virWidtHig/frame_width - (virWidtHig/2);
-                    pFace[i].rect[1] = faces[i].y * virWidtHig/frame_height - (virWidtHig/2);
-                    pFace[i].rect[2] = pFace[i].rect[0] + (faces[i].width)*virWidtHig/frame_width;
-                    pFace[i].rect[3] = pFace[i].rect[1] + (faces[i].height)*virWidtHig/frame_height;
+    struct RectFace *faces = NULL;
+    cam_face_meta_t* report;
+    int num = -1,hasSmileFace = 0,zoom_value;
+    nsecs_t wall,wait;
+    bool built;
+
+    if(!(mMsgTypeEnabled & CAMERA_MSG_PREVIEW_METADATA) || !mFaceDetecInit){
+        mFrameProvider->returnFrame(frame->frame_index,frame_used_flag);
+        return -1;
+    }
+    if((frame->frame_width != mFaceDetecW) || (frame->frame_height != mFaceDetectH)){
+        Mutex::Autolock lock(mFaceDecLock);
+        initializeFaceDetec(frame->frame_width, frame->frame_height);
+    }
+    zoom_value = frame->zoom_value;
+    built = (frame->frame_fmt == V4L2_PIX_FMT_NV12)
+        && mFaceTracker.buildLevel((const unsigned char*)frame->vir_addr, frame->frame_width, frame->frame_height,
+                                   FRAME_Y_STRIDE(frame));
+    //the detector and the tracker only read the level
+    mFrameProvider->returnFrame(frame->frame_index,frame_used_flag);
+    if(!built)
+        return -1;
 
-                    pFace[i].score = (hasSmileFace > 0)? 100:60;
-                    pFace[i].id =   0;
+    if(mFaceTracker.needDetect()){
+        //the detector may sleep on the gpu, only the run queue wait tells cpu contention
+        wait = CameraThreadConfig::runQueueWait();
+        wall = systemTime(SYSTEM_TIME_MONOTONIC);
+        (*mFaceDetectorFun.mFaceDectprepareFunc)(mFaceContext, (void*)mFaceTracker.level());
+        (*mFaceDetectorFun.mFaceDectFindFaceFun)(mFaceContext, mCurOrintation,mCurBiasAngle,0, &hasSmileFace, &faces, &num);
+        wall = systemTime(SYSTEM_TIME_MONOTONIC) - wall;
+        if (wait >= 0)
+            wait = CameraThreadConfig::runQueueWait() - wait;
+        LOG2("FaceDetection mCurBiasAngle %0.0f,facenum: %d, use time: %lldms, run queue wait %lldms\n",
+            mCurBiasAngle,num, ns2ms(wall), ns2ms(wait));
+        if((num < 0) || (faces == NULL))
+            num = 0;
+        mFaceTracker.detected(faces, num, mCurOrintation, (hasSmileFace > 0), wall, wait);
+    }else{
+        mFaceTracker.track();
+    }
 
-                    LOG2("pFace RECT (%d,%d,%d,%d)",pFace[i].rect[0],pFace[i].rect[1],pFace[i].rect[2],pFace[i].rect[3]);
-                }
-                {
-                    Mutex::Autolock lock(mFaceDecLock);
-                    if(mMsgTypeEnabled & CAMERA_MSG_PREVIEW_METADATA){
-                        camera_memory_t* tmpPreviewMemory = NULL;
-                        callback_preview_metadata(tmpPreviewMemory, pMetadata, faces);
-                    }
-                }
-            }else{
-				pMetadata->number_of_faces = 0;
-				pMetadata->faces = NULL;
-				Mutex::Autolock lock(mFaceDecLock);
-                if(mMsgTypeEnabled & CAMERA_MSG_PREVIEW_METADATA){
-                 callback_preview_metadata(NULL, pMetadata, faces);
-                }
-            }
+    {
+        Mutex::Autolock lock(mFaceDecLock);
+        if(mMsgTypeEnabled & CAMERA_MSG_PREVIEW_METADATA){
+            report = mFaceTracker.report(zoom_value, mFaceNum);
+            if(report)
+                callback_preview_metadata(NULL, &report->meta, report->rect);
         }
     }
     return num;
@@ -2003,13 +2265,14 @@ void AppMsgNotifier::startReceiveFrame()
 }
 void AppMsgNotifier::dump()
 {
-
+    mFaceTracker.dump();
 }
 
 void AppMsgNotifier::setDatacbFrontMirrorFlipState(bool mirror,bool Flip)
 {
 	mDataCbFrontMirror = mirror;
 	mDataCbFrontFlip = Flip;
+	publishDataCbSpec();
 }
 
 picture_info_s&  AppMsgNotifier::getPictureInfoRef()
@@ -2023,6 +2286,7 @@ void AppMsgNotifier::encProcessThread()
 		Message_cam msg;
 		int err = 0;
         long frame_used_flag = -1;
+        int pending;
 	
 		LOG_FUNCTION_NAME
 		while (loop) {
@@ -2041,6 +2305,7 @@ void AppMsgNotifier::encProcessThread()
 					{
 						Mutex::Autolock lock(mPictureLock); 
 
+                        pending = mEncPictureNum;
                         if((mEncPictureNum > 0) && (mRunningState & STA_RECEIVE_PIC_FRAME)){
                             mEncPictureNum--;
                             if(!mEncPictureNum)
@@ -2051,11 +2316,9 @@ void AppMsgNotifier::encProcessThread()
                         }
                     }
                     /* zyc@rock-chips.com: v0.0x22.0 */ 
-					captureEncProcessPicture(frame);
-
-                    //return frame
+                    //frame is returned by the prepare or encode stage
                     frame_used_flag = (long)msg.arg3;
-                    mFrameProvider->returnFrame(frame->frame_index,frame_used_flag);
+					capturePreparePicture(frame,frame_used_flag,pending);
 					
 					break;
 				}
@@ -2066,10 +2329,17 @@ void AppMsgNotifier::encProcessThread()
                     while(!encProcessThreadCommandQ.isEmpty()){
                         encProcessThreadCommandQ.get(&filter_msg);
                         if(filter_msg.command == EncProcessThread::CMD_ENCPROCESS_SNAPSHOT){
-        					FramInfo_s *frame = (FramInfo_s*)msg.arg2;
-                            mFrameProvider->returnFrame(frame->frame_index,frame->used_flag);
+        					FramInfo_s *frame = (FramInfo_s*)filter_msg.arg2;
+                            mFrameProvider->returnFrame(frame->frame_index,(long)filter_msg.arg3);
                         }
                     }
+                    //let the encode stage finish the pictures in flight
+                    {
+                        Mutex::Autolock lock(mPicSlotLock);
+                        while (mPicSlotBusy)
+                            mPicSlotCond.wait(mPicSlotLock);
+                        pictureSlotFreeLocked();
+                    }
                     if(msg.arg1)
                         ((Semaphore*)(msg.arg1))->Signal();
                    //wake up waiter
@@ -2096,13 +2366,47 @@ void AppMsgNotifier::encProcessThread()
 		return;
 }
 
+void AppMsgNotifier::jpegEncodeThread()
+{
+		bool loop = true;
+		Message_cam msg;
+	
+		LOG_FUNCTION_NAME
+		while (loop) {
+            memset(&msg,0,sizeof(msg));
+			jpegEncThreadCommandQ.get(&msg);
+			
+			switch (msg.command)
+			{
+				case JpegEncodeThread::CMD_JPEGENC_SLOT:
+					captureEncodePicture((picture_slot_t*)msg.arg2);
+					break;
+				case JpegEncodeThread::CMD_JPEGENC_EXIT:
+				{
+					LOGD("%s(%d): receive CMD_JPEGENC_EXIT",__FUNCTION__,__LINE__);
+					loop = false;
+                    if(msg.arg1)
+                        ((Semaphore*)(msg.arg1))->Signal();
+
+					break;
+				}
+				default:
+				{
+					LOGE("%s(%d): receive unknow command(0x%x)",__FUNCTION__,__LINE__,msg.command);
+					break;
+				}
+			}
+		}
+		LOG_FUNCTION_NAME_EXIT
+		return;
+}
+
 void AppMsgNotifier::faceDetectThread()
 {
 	bool loop = true;
 	Message_cam msg;
     FramInfo_s *frame = NULL;
     long frame_used_flag = -1;
-    bool face_detected = 0;
 	LOG_FUNCTION_NAME
 	while (loop) {
         memset(&msg,0,sizeof(msg));
@@ -2114,28 +2418,21 @@ void AppMsgNotifier::faceDetectThread()
                 frame_used_flag = (long)msg.arg3;
                 frame = (FramInfo_s*)msg.arg2;
                 LOG2("%s(%d):get new frame , index(%ld),useflag(%d)",__FUNCTION__,__LINE__,frame->frame_index,frame_used_flag);
-        		mFaceDecLock.lock();
-                if(mFaceFrameNum++ % FACEDETECT_FRAME_INTERVAL == 0){
-            		mFaceDecLock.unlock();
-                    if((processFaceDetect(frame, frame_used_flag) > 0)){
-                        face_detected = true;
-                    }else
-                        face_detected = false;
-            		mFaceDecLock.lock();
-                    if(!face_detected){
-                        mCurBiasAngle = (mCurBiasAngle + FACEDETECT_BIAS_INERVAL);
-                        if(mCurBiasAngle - (-FACEDETECT_INIT_BIAS) > 0.0001){
-                            mCurBiasAngle = FACEDETECT_INIT_BIAS;
-                        }
+                mFaceDecLock.lock();
+                //started or orientation changed, the tracked faces are stale
+                if(mFaceFrameNum++ == 0)
+                    mFaceTracker.reset();
+                mFaceDecLock.unlock();
+                //the detector ran and found nothing, try the next bias
+                if(processFaceDetect(frame, frame_used_flag) == 0){
+                    mFaceDecLock.lock();
+                    mCurBiasAngle = (mCurBiasAngle + FACEDETECT_BIAS_INERVAL);
+                    if(mCurBiasAngle - (-FACEDETECT_INIT_BIAS) > 0.0001){
+                        mCurBiasAngle = FACEDETECT_INIT_BIAS;
                     }
-            		mFaceDecLock.unlock();
-                    mFaceDetectionDone = true;
-                    break;
-                }else
-            		mFaceDecLock.unlock();
-                //return frame
+                    mFaceDecLock.unlock();
+                }
                 mFaceDetectionDone = true;
-                mFrameProvider->returnFrame(frame->frame_index,frame_used_flag);
                 break;
           case CameraAppFaceDetThread::CMD_FACEDET_PAUSE:
 				{
@@ -2320,15 +2617,13 @@ void AppMsgNotifier::callbackThread()
 						mDataCb(CAMERA_MSG_PREVIEW_METADATA, frame ,0,tempMetaData,mCallbackCookie);
 					}
 				 	mCamAdp->faceNotify(faces, &tempMetaData->number_of_faces);
-              		free(tempMetaData->faces);
-					free(tempMetaData);
 				}else{
 					if(mMsgTypeEnabled & CAMERA_MSG_PREVIEW_METADATA){
 						mDataCb(CAMERA_MSG_PREVIEW_METADATA, NULL,0,tempMetaData,mCallbackCookie);
 					}
              		mCamAdp->faceNotify(NULL, &tempMetaData->number_of_faces);
-					free(tempMetaData);
 				}
+				mFaceTracker.releaseMeta(tempMetaData);
 		  	}
 		  		break;
 				
@@ -2336,7 +2631,7 @@ void AppMsgNotifier::callbackThread()
 		  	{
 				LOG1("send video frame.");
 				frame = (camera_memory_t*)msg.arg2;
-				mDataCbTimestamp(systemTime(CLOCK_MONOTONIC), CAMERA_MSG_VIDEO_FRAME, frame, 0, mCallbackCookie);
+				mDataCbTimestamp(*(nsecs_t*)msg.arg3, CAMERA_MSG_VIDEO_FRAME, frame, 0, mCallbackCookie);
 		  	}
 		  		break;
 				
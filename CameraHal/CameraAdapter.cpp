@@ -14,6 +14,7 @@ CameraAdapter::CameraAdapter(int cameraId):mPreviewRunning(0),
     mPreviewBufProvider = NULL;
     mCamDrvWidth = 0;
     mCamDrvHeight = 0;
+    mCamDrvStride = 0;
     mVideoWidth = 0;
     mVideoHeight = 0;
     mCamDriverStream = false;
@@ -24,6 +25,8 @@ CameraAdapter::CameraAdapter(int cameraId):mPreviewRunning(0),
     mCamDriverPreviewFmt = 0;
     mZoomVal = 100;
 	mLibstageLibHandle = NULL;
+    memset(&mMjpegDecoder, 0x00, sizeof(mjpeg_interface_t));
+    mMjpegDecoder.state = -1;
 
     CameraHal_SupportFmt[0] = V4L2_PIX_FMT_NV12;
     CameraHal_SupportFmt[1] = V4L2_PIX_FMT_NV16;
@@ -55,6 +58,7 @@ CameraAdapter::~CameraAdapter()
 		
 	
 	if(mAutoFocusThread != NULL){
+        mContrastAf.cancel();
     	mAutoFocusLock.lock();
     	mExitAutoFocusThread = true;
     	mAutoFocusLock.unlock();
@@ -155,7 +159,7 @@ bool CameraAdapter::isNeedToRestartPreview()
 void CameraAdapter::dump(int cameraId)
 {
 	LOG2("%s CameraAdapter dump cameraId(%d)\n", __FUNCTION__,cameraId);
-	
+	mContrastAf.dump();
 }
 
 void CameraAdapter::getCameraParamInfo(cameraparam_info_s &paraminfo)
@@ -211,6 +215,9 @@ status_t CameraAdapter::startPreview(int preview_w,int preview_h,int w, int h, i
     mCamPreviewW = preview_w;
 
     memset(mPreviewFrameInfos,0,sizeof(mPreviewFrameInfos));
+    //vpu or sw mjpeg decoder is picked per frame from here on
+    mMjpegSwDecoder.reset((mMjpegDecoder.state == 0) && (mMjpegDecoder.decode != NULL),
+                          mParameters.getPreviewFrameRate());
     //camera start
     if(cameraStart() < 0){
         ret = -1;
@@ -218,7 +225,7 @@ status_t CameraAdapter::startPreview(int preview_w,int preview_h,int w, int h, i
     }
     //new preview thread
     mCameraPreviewThread = new CameraPreviewThread(this);
-	mCameraPreviewThread->run("CameraPreviewThread",ANDROID_PRIORITY_DISPLAY);
+	mCameraPreviewThread->run("CameraPreviewThread",CameraThreadConfig::priority("CameraPreviewThread"));
     
     mPreviewRunning = 1;
     LOGD("%s(%d):OUT",__FUNCTION__,__LINE__);
@@ -226,6 +233,7 @@ status_t CameraAdapter::startPreview(int preview_w,int preview_h,int w, int h, i
 start_preview_end:
     mCamDrvWidth = 0;
     mCamDrvHeight = 0;
+    mCamDrvStride = 0;
     mCamPreviewH = 0;
     mCamPreviewW = 0;
     return ret;
@@ -235,6 +243,8 @@ status_t CameraAdapter::stopPreview()
 {
     LOGD("%s(%d):IN",__FUNCTION__,__LINE__);
     if(mPreviewRunning == 1){
+        //a search waiting for frames fails now rather than on its frame timeout
+        mContrastAf.cancel();
         //camera stop
         cameraStream(false);
         
@@ -246,6 +256,7 @@ status_t CameraAdapter::stopPreview()
     	}
 		
     	cameraStop();
+        mMjpegSwDecoder.dump();
         //destroy preview buffer
         if(mPreviewBufProvider)
             mPreviewBufProvider->freeBuffer();
@@ -253,6 +264,7 @@ status_t CameraAdapter::stopPreview()
     }
     mCamDrvWidth = 0;
     mCamDrvHeight = 0;
+    mCamDrvStride = 0;
     LOGD("%s(%d):OUT",__FUNCTION__,__LINE__);
     return 0;
 }
@@ -268,11 +280,13 @@ void CameraAdapter::initDefaultParameters(int camFd)
 status_t CameraAdapter::autoFocus()
 {
 	
+	mContrastAf.arm();
 	mAutoFocusCond.signal();
     return 0;
 }
 status_t CameraAdapter::cancelAutoFocus()
 {
+    mContrastAf.cancel();
     return 0;
 }
 int CameraAdapter::getCameraFd()
@@ -390,11 +404,9 @@ int CameraAdapter::cameraCreate(int cameraId)
         LOG1("CameraHal_SupportFmt:fmt = %d,index = %d",CameraHal_SupportFmt[i],i);
         j = 0;
         while (mCamDriverSupportFmt[j]) {
-            if (mCamDriverSupportFmt[j] == CameraHal_SupportFmt[i]) {
-                if ((mCamDriverSupportFmt[j] == V4L2_PIX_FMT_MJPEG) && (mMjpegDecoder.state == -1))
-                    continue;
+            //mjpeg is decoded in sw when the vpu decoder is missing
+            if (mCamDriverSupportFmt[j] == CameraHal_SupportFmt[i])
                 break;
-            }
             j++;
         }
         if (mCamDriverSupportFmt[j] == CameraHal_SupportFmt[i]) {
@@ -420,6 +432,8 @@ int CameraAdapter::cameraCreate(int cameraId)
 			(mCamDriverPreviewFmt >> 16) & 0xFF, (mCamDriverPreviewFmt >> 24) & 0xFF);
 
         LOGD("mCamDriverPreviewFmt  = %d",mCamDriverPreviewFmt);
+        if (mCamDriverPreviewFmt == V4L2_PIX_FMT_MJPEG)
+            mMjpegSwDecoder.init(0);
         
     }
 
@@ -430,7 +444,7 @@ int CameraAdapter::cameraCreate(int cameraId)
 
     //create focus thread for soc or usb camera.
     mAutoFocusThread = new AutoFocusThread(this);
-	mAutoFocusThread->run("AutoFocusThread", ANDROID_PRIORITY_URGENT_DISPLAY);	
+	mAutoFocusThread->run("AutoFocusThread",CameraThreadConfig::priority("AutoFocusThread"));	
     mExitAutoFocusThread = false;
 
 
@@ -452,6 +466,7 @@ int CameraAdapter::cameraDestroy()
     int err,i;
 
     LOG_FUNCTION_NAME
+    mMjpegSwDecoder.destroy();
     if (mLibstageLibHandle && (mMjpegDecoder.state == 0)) {
         mMjpegDecoder.deInit(mMjpegDecoder.decoder);
         mMjpegDecoder.destroy(mMjpegDecoder.decoder);
@@ -485,6 +500,7 @@ int CameraAdapter::cameraSetSize(int w, int h, int fmt, bool is_capture)
 	if ( err < 0 ){
 		LOGE("%s(%d): VIDIOC_S_FMT failed ,err: %s",__FUNCTION__,__LINE__,strerror(errno));
 	} else {
+	    mCamDrvStride = format.fmt.pix.bytesperline;
 	    LOG1("%s(%d): VIDIOC_S_FMT %dx%d '%c%c%c%c'",__FUNCTION__,__LINE__,format.fmt.pix.width, format.fmt.pix.height,
 				fmt & 0xFF, (fmt >> 8) & 0xFF,(fmt >> 16) & 0xFF, (fmt >> 24) & 0xFF);
 	}
@@ -606,6 +622,101 @@ int CameraAdapter::cameraAutoFocus(bool auto_trig_only)
     return 0;
 }
 
+//mapping TAE/TAF area coordinate
+// zone arrange: (-1000, 1000) with width 2001
+// bPre2Drv: true - input is base on preview image size
+//			 false - input is base on driver image size
+// zone : order lx ty rx dy
+int CameraAdapter::AndroidZoneMapping(
+			const char* tag,
+			__s32 pre_w,
+			__s32 pre_h,
+			__s32 drv_w,
+			__s32 drv_h,
+			bool bPre2Drv,
+			__s32 *zone)
+{
+	bool bHeight = false;
+	long long ll_pre_w, ll_pre_h, ll_drv_w, ll_drv_h;
+
+	if (pre_w <= 0 ||
+		pre_h <= 0 ||
+		drv_w <= 0 ||
+		drv_h <= 0) {
+		LOGE("%s(%s)", __FUNCTION__, tag?tag:"NA");
+		LOGE("%s invalid parameters", __FUNCTION__);
+		return -EINVAL;
+	}
+
+	ll_pre_w = pre_w;
+	ll_pre_h = pre_h;
+	ll_drv_w = drv_w;
+	ll_drv_h = drv_h;
+
+	if (ll_pre_w * ll_drv_h == ll_pre_h * ll_drv_w) {
+		return 0;
+	}
+
+	LOGE("%s(%s)", __FUNCTION__, tag?tag:"NA");
+	LOGE("%s pre %dx%d drv %dx%d",
+			__FUNCTION__,
+			pre_w,
+			pre_h,
+			drv_w,
+			drv_h);
+	LOGE("%s from (%d, %d) (%d, %d)",
+			__FUNCTION__,
+			zone[0],
+			zone[1],
+			zone[2],
+			zone[3]);
+
+	if ( ((float) pre_h)/((float)pre_w) <
+		 ((float) drv_h)/((float)drv_w)) {
+		bHeight = true;
+	}
+
+
+	// y' * h' = y * h
+
+	if (bPre2Drv) {
+		// h = drv_h * pre_w / drv_w
+		//
+		// y = y'*h'/h
+		//   = y' * h' * drv_w / (drv_h * pre_w)
+
+		if (bHeight) {
+			zone[1] = (__s32) ( zone[1] * ll_pre_h * ll_drv_w / (ll_drv_h * ll_pre_w) );
+			zone[3] = (__s32) ( zone[3] * ll_pre_h * ll_drv_w / (ll_drv_h * ll_pre_w) );
+		} else {
+			zone[0] = (__s32) ( zone[0] * ll_pre_w * ll_drv_h / (ll_drv_w * ll_pre_h) );
+			zone[2] = (__s32) ( zone[2] * ll_pre_w * ll_drv_h / (ll_drv_w * ll_pre_h) );
+		}
+	} else {
+		// h = drv_h * pre_w /drv_w
+		//
+		// y' = y * h / h'
+		//    = y * drv_h * pre_w / (h' * drv_w)
+
+		if (bHeight) {
+			zone[1] = (__s32) ( zone[1] * ll_drv_h * ll_pre_w / (ll_pre_h * ll_drv_w) );
+			zone[3] = (__s32) ( zone[3] * ll_drv_h * ll_pre_w / (ll_pre_h * ll_drv_w) );
+		} else {
+			zone[0] = (__s32) ( zone[0] * ll_drv_w * ll_pre_h / (ll_pre_w * ll_drv_h) );
+			zone[2] = (__s32) ( zone[2] * ll_drv_w * ll_pre_h / (ll_pre_w * ll_drv_h) );
+		}
+	}
+
+	LOGE("%s to (%d, %d) (%d, %d)",
+				__FUNCTION__,
+				zone[0],
+				zone[1],
+				zone[2],
+				zone[3]);
+
+	return 0;
+}
+
 void CameraAdapter::debugShowFPS()
 {
     static int mFrameCount = 0;
@@ -624,6 +735,16 @@ void CameraAdapter::debugShowFPS()
     // XXX: mFPS has the value we want
 }
 
+//start of frame from the driver stamp, drivers stamping with another clock get the dequeue time
+static nsecs_t v4l2FrameTime(const struct v4l2_buffer* buf)
+{
+#if defined(V4L2_BUF_FLAG_TIMESTAMP_MASK) && defined(V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC)
+    if ((buf->flags & V4L2_BUF_FLAG_TIMESTAMP_MASK) == V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC)
+        return s2ns((nsecs_t)buf->timestamp.tv_sec) + us2ns((nsecs_t)buf->timestamp.tv_usec);
+#endif
+    return systemTime(CLOCK_MONOTONIC);
+}
+
 //dqbuf
 int CameraAdapter::getFrame(FramInfo_s** tmpFrame){
 
@@ -685,6 +806,15 @@ int CameraAdapter::getFrame(FramInfo_s** tmpFrame){
     mPreviewFrameInfos[cfilledbuffer1.index].frame_height = mCamDrvHeight;
     mPreviewFrameInfos[cfilledbuffer1.index].frame_width = mCamDrvWidth;
     mPreviewFrameInfos[cfilledbuffer1.index].frame_index = cfilledbuffer1.index;
+    //a driver padding nv12 lines puts the uv plane after the padded y plane
+    if(((mCamDriverPreviewFmt == V4L2_PIX_FMT_NV12) || (mCamDriverPreviewFmt == V4L2_PIX_FMT_NV21))
+        && (mCamDrvStride > mCamDrvWidth)) {
+        mPreviewFrameInfos[cfilledbuffer1.index].y_stride = mCamDrvStride;
+        mPreviewFrameInfos[cfilledbuffer1.index].uv_offset = (ulong_t)mCamDrvStride*mCamDrvHeight;
+    } else {
+        mPreviewFrameInfos[cfilledbuffer1.index].y_stride = 0;
+        mPreviewFrameInfos[cfilledbuffer1.index].uv_offset = 0;
+    }
     if(mCamDriverV4l2MemType == V4L2_MEMORY_OVERLAY){
 		if(cif_driver_iommu){
 			mPreviewFrameInfos[cfilledbuffer1.index].phy_addr = mPreviewBufProvider->getBufShareFd(cfilledbuffer1.index);
@@ -698,6 +828,11 @@ int CameraAdapter::getFrame(FramInfo_s** tmpFrame){
     mPreviewFrameInfos[cfilledbuffer1.index].used_flag = 0;
     mPreviewFrameInfos[cfilledbuffer1.index].frame_size = cfilledbuffer1.bytesused;
     mPreviewFrameInfos[cfilledbuffer1.index].res        = NULL;
+    //no exposure state from a v4l2 sensor, the buffer brings the time
+    memset(&mPreviewFrameInfos[cfilledbuffer1.index].meta, 0, sizeof(cam_frame_meta_t));
+    mPreviewFrameInfos[cfilledbuffer1.index].meta.timestamp = v4l2FrameTime(&cfilledbuffer1);
+    mPreviewFrameInfos[cfilledbuffer1.index].meta.sequence = cfilledbuffer1.sequence;
+    mPreviewFrameInfos[cfilledbuffer1.index].meta.lens_pos = -1;
         
     *tmpFrame = &(mPreviewFrameInfos[cfilledbuffer1.index]);
     LOG2("%s(%d): fill  frame info success",__FUNCTION__,__LINE__);
@@ -746,6 +881,28 @@ int CameraAdapter::returnFrame(long index,int cmd)
     return adapterReturnFrame(index,cmd);
 }
 
+int CameraAdapter::mjpegDecodeFrame(unsigned char* src, unsigned int size, char* dst, long dst_addr, int stride, int sliceHeight)
+{
+    VPU_FRAME outbuf;
+    unsigned int output_len = 0;
+    unsigned int input_len = size;
+    nsecs_t start;
+    int ret;
+
+    if ((dst_addr >= 0) && mMjpegSwDecoder.useHw()) {
+        start = systemTime(CLOCK_MONOTONIC);
+        ret = mMjpegDecoder.decode(mMjpegDecoder.decoder,
+                                    (unsigned char*)&outbuf, &output_len,
+                                    src, &input_len, dst_addr);
+        mMjpegSwDecoder.hwDone(ret >= 0, systemTime(CLOCK_MONOTONIC) - start);
+        if (ret >= 0)
+            return 0;
+        LOGE("%s(%d): vpu mjpeg decode failed(%d), decode it in sw",__FUNCTION__,__LINE__,ret);
+    }
+    ret = mMjpegSwDecoder.decode(src, size, (unsigned char*)dst, stride, sliceHeight);
+    return (ret < 0) ? -1 : 1;
+}
+
 //define  the frame info ,such as w, h ,fmt 
 int CameraAdapter::reprocessFrame(FramInfo_s* frame)
 {
@@ -782,6 +939,11 @@ void CameraAdapter::previewThread(){
                     returnFrame(tmpFrame->frame_index,buffer_log);
                     continue;
                 }
+                //an af search copies its window out, the frame isn't held for the measure
+                if(mContrastAf.wantFrame() && tmpFrame->vir_addr
+                    && ((tmpFrame->frame_fmt == V4L2_PIX_FMT_NV12) || (tmpFrame->frame_fmt == V4L2_PIX_FMT_NV21)))
+                    mContrastAf.onFrame((unsigned char*)tmpFrame->vir_addr,tmpFrame->frame_width,tmpFrame->frame_height,
+                        FRAME_Y_STRIDE(tmpFrame),tmpFrame->meta.timestamp);
 
                 buffer_log = 0;
                 //display ?
@@ -190,11 +190,16 @@ int BufferProvider::getOneAvailableBuffer(long *buf_phy,long *buf_vir)
 
 int BufferProvider::flushBuffer(int bufindex)
 {
-   	if(mBufInfo != NULL){ 
-        return mCamBuffer->flushCacheMem(mBufType,0,0);        
-    }else{
+    return syncBuffer(bufindex,0,0,CACHE_SYNC_CPU_TO_DEVICE);
+}
+
+int BufferProvider::syncBuffer(int bufindex,unsigned int offset,unsigned int len,cache_sync_dir_t dir)
+{
+    if((mBufInfo == NULL) || (bufindex < 0) || (bufindex >= mBufCount)){
+        LOGE("%s(%d): buffer(type %d) index %d is invalid, count %d",__FUNCTION__,__LINE__,mBufType,bufindex,mBufCount);
         return -1;
     }
+    return mCamBuffer->syncCacheMem(mBufType,bufindex,offset,len,dir);
 }
 
 //preview buffer
@@ -0,0 +1,215 @@
+#include "CameraBufferLease.h"
+#include "CameraHal.h"
+
+namespace android {
+
+static const char* lease_name[LEASE_TYPE_MAX] = {
+    "display", "video", "picture", "datacb", "facedetect", "tuning"
+};
+
+/* ms a consumer may hold a frame before it counts as late, 0: never late */
+static const int lease_deadline_ms[LEASE_TYPE_MAX] = {
+    100,        /* display: a couple of vsyncs */
+    200,        /* video */
+    0,          /* picture: the shot is never dropped */
+    200,        /* datacb */
+    300,        /* facedetect */
+    0,          /* tuning */
+};
+
+CameraBufferLease::CameraBufferLease()
+{
+    char prop[PROPERTY_VALUE_MAX];
+
+    memset(mLease, 0, sizeof(mLease));
+    memset(mBuf, 0, sizeof(mBuf));
+    memset(mCount, 0, sizeof(mCount));
+    memset(mDropped, 0, sizeof(mDropped));
+    mBufCnt = 0;
+    mNext = 0;
+    mPoolNum = 0;
+    mGrow = 0;
+    mStarved = 0;
+    property_get(CAMERAHAL_LEASE_GROW_PROPERTY_KEY, prop, "2");
+    mGrowMax = atoi(prop);
+    if (mGrowMax < 0)
+        mGrowMax = 0;
+}
+
+CameraBufferLease::~CameraBufferLease()
+{
+    int i;
+
+    for (i = 0; i < LEASE_TYPE_MAX; i++) {
+        if (mCount[i])
+            LOGE("%s(%d): may have %s frame leak, count is %d",__FUNCTION__,__LINE__,lease_name[i],mCount[i]);
+    }
+}
+
+void CameraBufferLease::setPool(int bufNum)
+{
+    Mutex::Autolock lock(mLock);
+    mPoolNum = bufNum;
+}
+
+int CameraBufferLease::growBy()
+{
+    Mutex::Autolock lock(mLock);
+    return mGrow;
+}
+
+//buffers missing to leave the main path its reserve, <= 0: not starving
+int CameraBufferLease::shortfall(int held)
+{
+    if (mPoolNum <= LEASE_ISP_RESERVE)
+        return 0;
+    return mBufCnt + held + LEASE_ISP_RESERVE + 1 - mPoolNum;
+}
+
+bool CameraBufferLease::starving(int held)
+{
+    Mutex::Autolock lock(mLock);
+    int need = shortfall(held);
+
+    if (need <= 0)
+        return false;
+    mStarved++;
+    if ((need > mGrow) && (mGrow < mGrowMax)) {
+        mGrow = (need < mGrowMax) ? need : mGrowMax;
+        LOGD("%s(%d): %d of %d engine buffers held, pool grows by %d at the next setup",__FUNCTION__,__LINE__,
+            mBufCnt + held,mPoolNum,mGrow);
+    }
+    return true;
+}
+
+bool CameraBufferLease::admit(int type, int held, nsecs_t now)
+{
+    Mutex::Autolock lock(mLock);
+    int i;
+
+    if ((type < 0) || (type >= LEASE_TYPE_MAX) || (lease_deadline_ms[type] == 0) || (shortfall(held) <= 0))
+        return true;
+    for (i = 0; i < LEASE_MAX; i++) {
+        if (mLease[i].busy && (mLease[i].type == type)
+            && (now - mLease[i].start > ms2ns(lease_deadline_ms[type]))) {
+            if ((mDropped[type]++ % 30) == 0)
+                LOG1("%s(%d): %s holds a frame for %lld ms, skip it (%d skipped)",__FUNCTION__,__LINE__,
+                    lease_name[type],(long long)ns2ms(now - mLease[i].start),mDropped[type]);
+            return false;
+        }
+    }
+    return true;
+}
+
+int CameraBufferLease::bufRef(MediaBuffer_t* buf)
+{
+    int i, free_idx = -1;
+
+    for (i = 0; i < LEASE_BUF_MAX; i++) {
+        if (mBuf[i].buf == buf) {
+            mBuf[i].refs++;
+            return 0;
+        }
+        if ((mBuf[i].buf == NULL) && (free_idx < 0))
+            free_idx = i;
+    }
+    if (free_idx < 0)
+        return -1;
+    mBuf[free_idx].buf = buf;
+    mBuf[free_idx].refs = 1;
+    mBufCnt++;
+    return 0;
+}
+
+void CameraBufferLease::bufUnref(MediaBuffer_t* buf)
+{
+    int i;
+
+    for (i = 0; i < LEASE_BUF_MAX; i++) {
+        if (mBuf[i].buf == buf) {
+            if (--mBuf[i].refs == 0) {
+                mBuf[i].buf = NULL;
+                mBufCnt--;
+            }
+            return;
+        }
+    }
+}
+
+FramInfo_s* CameraBufferLease::acquire(MediaBuffer_t* buf, int type, nsecs_t now)
+{
+    Mutex::Autolock lock(mLock);
+    lease_t* lease = NULL;
+    int i, idx;
+
+    //round robin, a frame returned late after clear() must not hit a new lease
+    for (i = 0; i < LEASE_MAX; i++) {
+        idx = (mNext + i) % LEASE_MAX;
+        if (!mLease[idx].busy) {
+            lease = &mLease[idx];
+            mNext = (idx + 1) % LEASE_MAX;
+            break;
+        }
+    }
+    if ((lease == NULL) || bufRef(buf)) {
+        LOGE("%s(%d): no free lease for %s frame",__FUNCTION__,__LINE__,lease_name[type]);
+        return NULL;
+    }
+    MediaBufLockBuffer(buf);
+    memset(&lease->frame, 0, sizeof(lease->frame));
+    lease->frame.frame_index = (ulong_t)&lease->frame;
+    lease->frame.used_flag = type;
+    lease->buf = buf;
+    lease->type = type;
+    lease->start = now;
+    lease->busy = true;
+    mCount[type]++;
+    return &lease->frame;
+}
+
+int CameraBufferLease::release(FramInfo_s* frame)
+{
+    Mutex::Autolock lock(mLock);
+    int i;
+
+    for (i = 0; i < LEASE_MAX; i++) {
+        if (mLease[i].busy && (&mLease[i].frame == frame)) {
+            mLease[i].busy = false;
+            mCount[mLease[i].type]--;
+            bufUnref(mLease[i].buf);
+            MediaBufUnlockBuffer(mLease[i].buf);
+            return mLease[i].type;
+        }
+    }
+    return -1;
+}
+
+void CameraBufferLease::clear()
+{
+    Mutex::Autolock lock(mLock);
+    int i;
+
+    for (i = 0; i < LEASE_MAX; i++) {
+        if (mLease[i].busy) {
+            mLease[i].busy = false;
+            mCount[mLease[i].type]--;
+            bufUnref(mLease[i].buf);
+            MediaBufUnlockBuffer(mLease[i].buf);
+        }
+    }
+}
+
+void CameraBufferLease::dump()
+{
+    Mutex::Autolock lock(mLock);
+    int i;
+
+    LOG1("%s(%d): pool %d, %d buffers leased, %u frames starved, grow %d",__FUNCTION__,__LINE__,
+        mPoolNum,mBufCnt,mStarved,mGrow);
+    for (i = 0; i < LEASE_TYPE_MAX; i++) {
+        if (mDropped[i])
+            LOG1("%s(%d): %s skipped %u frames",__FUNCTION__,__LINE__,lease_name[i],mDropped[i]);
+    }
+}
+
+}
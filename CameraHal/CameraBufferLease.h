@@ -0,0 +1,91 @@
+#ifndef ANDROID_HARDWARE_CAMERA_BUFFER_LEASE_H
+#define ANDROID_HARDWARE_CAMERA_BUFFER_LEASE_H
+
+//isp engine buffers handed to the hal consumers
+#include <utils/threads.h>
+#include <utils/Timers.h>
+#include <bufferpool/media_buffer.h>
+#include "common_type.h"
+
+#define CAMERAHAL_LEASE_GROW_PROPERTY_KEY   "sys_graphic.cam_hal.lease_grow"    /* buffers the engine pool may grow by, 0: never */
+
+namespace android {
+
+//FramInfo_s::used_flag of a leased frame
+enum LeaseType {
+    LEASE_DISPLAY = 0,
+    LEASE_VIDEO = 1,
+    LEASE_PICTURE = 2,
+    LEASE_DATACB = 3,
+    LEASE_FACEDETECT = 4,
+    LEASE_TUNING = 5,
+    LEASE_TYPE_MAX
+};
+
+#define LEASE_MAX               32      /* frames leased at once */
+#define LEASE_BUF_MAX           24      /* distinct engine buffers leased at once */
+#define LEASE_ISP_RESERVE       3       /* buffers the main path needs free to keep running */
+
+/*
+ * Every frame handed to a consumer is a lease on the engine buffer behind it,
+ * the FramInfo_s lives in the lease. The engine fills a fixed pool, once the
+ * hal holds all but LEASE_ISP_RESERVE buffers of it the main path is about to
+ * stall. The adapter is then starving: it drops the oldest frame nobody
+ * leases (the zsl ring) and admit() refuses new frames to a consumer holding
+ * a frame past its deadline, until it returns it. The largest shortfall seen
+ * is added to the pool the next time it is set up.
+ */
+class CameraBufferLease {
+public:
+    CameraBufferLease();
+    ~CameraBufferLease();
+    //bufNum: engine pool size, including what growBy() returned
+    void setPool(int bufNum);
+    //buffers to add to the pool at its next setup
+    int growBy();
+    //held: engine buffers the hal keeps outside leases
+    bool starving(int held);
+    //false: the consumer is late and the engine is short, skip it for this frame
+    bool admit(int type, int held, nsecs_t now);
+    //locks buf; the frame is zeroed but frame_index and used_flag. NULL: no free lease
+    FramInfo_s* acquire(MediaBuffer_t* buf, int type, nsecs_t now);
+    //unlocks the buffer, returns the lease type or -1 if frame isn't leased
+    int release(FramInfo_s* frame);
+    //returns every lease to the engine
+    void clear();
+    void dump();
+
+private:
+    typedef struct lease {
+        FramInfo_s frame;
+        MediaBuffer_t* buf;
+        int type;
+        nsecs_t start;
+        bool busy;
+    } lease_t;
+
+    typedef struct lease_buf {
+        MediaBuffer_t* buf;
+        int refs;
+    } lease_buf_t;
+
+    int bufRef(MediaBuffer_t* buf);
+    void bufUnref(MediaBuffer_t* buf);
+    int shortfall(int held);
+
+    lease_t mLease[LEASE_MAX];
+    int mNext;
+    lease_buf_t mBuf[LEASE_BUF_MAX];
+    int mBufCnt;                        /* distinct buffers leased */
+    int mCount[LEASE_TYPE_MAX];
+    int mPoolNum;
+    int mGrow;
+    int mGrowMax;
+    Mutex mLock;
+
+    unsigned int mStarved;              /* frames seen while starving */
+    unsigned int mDropped[LEASE_TYPE_MAX];
+};
+
+}
+#endif
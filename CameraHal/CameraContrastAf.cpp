@@ -0,0 +1,366 @@
+#include "CameraContrastAf.h"
+#include "CameraHal.h"
+#if defined(HAVE_ARM_NEON) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define CAM_AF_NEON     1
+#endif
+
+namespace android {
+
+#define CAM_AF_PAST_PEAK        0.9f    /* a sweep position below this part of the peak is past it */
+
+/* squared sobel gradients of the inner pixels of r1, and their luma */
+static void af_tenengrad_row(const unsigned char* r0, const unsigned char* r1, const unsigned char* r2,
+                             int w, uint64_t* grad, uint64_t* luma)
+{
+    unsigned int g = 0, l = 0;
+    int x = 1;
+#ifdef CAM_AF_NEON
+    //rows are <= CAM_AF_WIN_MAX_W: 32bit gradient lanes and 16bit luma lanes can't wrap
+    uint32x4_t vg = vdupq_n_u32(0);
+    uint16x8_t vl = vdupq_n_u16(0);
+    for (; x + 9 <= w; x += 8) {
+        uint8x8_t a0 = vld1_u8(r0 + x - 1), b0 = vld1_u8(r0 + x), c0 = vld1_u8(r0 + x + 1);
+        uint8x8_t a1 = vld1_u8(r1 + x - 1), b1 = vld1_u8(r1 + x), c1 = vld1_u8(r1 + x + 1);
+        uint8x8_t a2 = vld1_u8(r2 + x - 1), b2 = vld1_u8(r2 + x), c2 = vld1_u8(r2 + x + 1);
+        uint16x8_t left = vaddq_u16(vaddl_u8(a0, a2), vshll_n_u8(a1, 1));
+        uint16x8_t right = vaddq_u16(vaddl_u8(c0, c2), vshll_n_u8(c1, 1));
+        uint16x8_t top = vaddq_u16(vaddl_u8(a0, c0), vshll_n_u8(b0, 1));
+        uint16x8_t bottom = vaddq_u16(vaddl_u8(a2, c2), vshll_n_u8(b2, 1));
+        int16x8_t gx = vreinterpretq_s16_u16(vsubq_u16(right, left));
+        int16x8_t gy = vreinterpretq_s16_u16(vsubq_u16(bottom, top));
+        int32x4_t lo = vmlal_s16(vmull_s16(vget_low_s16(gx), vget_low_s16(gx)), vget_low_s16(gy), vget_low_s16(gy));
+        int32x4_t hi = vmlal_s16(vmull_s16(vget_high_s16(gx), vget_high_s16(gx)), vget_high_s16(gy), vget_high_s16(gy));
+        vg = vaddq_u32(vg, vreinterpretq_u32_s32(lo));
+        vg = vaddq_u32(vg, vreinterpretq_u32_s32(hi));
+        vl = vaddw_u8(vl, b1);
+    }
+    {
+        uint64x2_t r = vpaddlq_u32(vg);
+        *grad += vgetq_lane_u64(r, 0) + vgetq_lane_u64(r, 1);
+        r = vpaddlq_u32(vpaddlq_u16(vl));
+        *luma += vgetq_lane_u64(r, 0) + vgetq_lane_u64(r, 1);
+    }
+#endif
+    for (; x + 1 < w; x++) {
+        int gx = (r0[x + 1] + 2*r1[x + 1] + r2[x + 1]) - (r0[x - 1] + 2*r1[x - 1] + r2[x - 1]);
+        int gy = (r2[x - 1] + 2*r2[x] + r2[x + 1]) - (r0[x - 1] + 2*r0[x] + r0[x + 1]);
+        g += gx*gx + gy*gy;
+        l += r1[x];
+    }
+    *grad += g;
+    *luma += l;
+}
+
+/* tenengrad of a w x h window over its squared mean */
+static float af_tenengrad(const unsigned char* p, int w, int h)
+{
+    uint64_t grad = 0, luma = 0;
+    float n, mean;
+    int y;
+
+    for (y = 1; y + 1 < h; y++)
+        af_tenengrad_row(p + (y - 1)*w, p + y*w, p + (y + 1)*w, w, &grad, &luma);
+    n = (float)(w - 2)*(h - 2);
+    mean = luma / n;
+    return grad / n / (mean*mean + 1.0f);
+}
+
+CameraContrastAf::CameraContrastAf()
+{
+    char prop[PROPERTY_VALUE_MAX];
+
+    mFd = -1;
+    mActive = false;
+    mMin = 0;
+    mMax = 0;
+    mStep = 1;
+    mPos = -1;
+    mMoved = 0;
+    memset(mZone, 0, sizeof(mZone));
+    mWant = false;
+    mHave = false;
+    mCancel = false;
+    mAfter = 0;
+    mWin = NULL;
+    mWinW = 0;
+    mWinH = 0;
+    mSearches = 0;
+    mFocused = 0;
+    mFrames = 0;
+    mBusy = 0;
+    mLastTime = 0;
+    mLastPos = -1;
+    property_get(CAMERAHAL_AF_SETTLE_PROPERTY_KEY, prop, "60");
+    mSettle = ms2ns(atoi(prop) > 0 ? atoi(prop) : CAM_AF_SETTLE_MS);
+}
+
+CameraContrastAf::~CameraContrastAf()
+{
+    if (mWin)
+        free(mWin);
+}
+
+bool CameraContrastAf::init(int fd, bool driverAf)
+{
+    struct v4l2_queryctrl focus;
+    char prop[PROPERTY_VALUE_MAX];
+    int mode;
+
+    mFd = fd;
+    mActive = false;
+    property_get(CAMERAHAL_CONTRAST_AF_PROPERTY_KEY, prop, "1");
+    mode = atoi(prop);
+    if ((mode <= 0) || (driverAf && (mode < 2)))
+        return false;
+
+    memset(&focus, 0, sizeof(focus));
+    focus.id = V4L2_CID_FOCUS_ABSOLUTE;
+    if (ioctl(fd, VIDIOC_QUERYCTRL, &focus) || (focus.flags & V4L2_CTRL_FLAG_DISABLED)
+        || (focus.maximum <= focus.minimum))
+        return false;
+
+    if ((mWin == NULL) && (posix_memalign((void**)&mWin, 64, CAM_AF_WIN_MAX_W*CAM_AF_WIN_MAX_H) != 0)) {
+        mWin = NULL;
+        LOGE("%s(%d): alloc af window failed, no contrast af",__FUNCTION__,__LINE__);
+        return false;
+    }
+    mMin = focus.minimum;
+    mMax = focus.maximum;
+    mStep = (focus.step > 0) ? focus.step : 1;
+    mPos = mMin - 1;
+    mActive = true;
+    LOGD("%s(%d): contrast af on lens %d..%d step %d, settle %lld ms",__FUNCTION__,__LINE__,
+        mMin,mMax,mStep,(long long)ns2ms(mSettle));
+    return true;
+}
+
+void CameraContrastAf::setWindow(const int* zone)
+{
+    Mutex::Autolock lock(mLock);
+    memcpy(mZone, zone, sizeof(mZone));
+}
+
+void CameraContrastAf::onFrame(const unsigned char* y, int width, int height, int stride, nsecs_t timestamp)
+{
+    const unsigned char* src;
+    unsigned char* dst;
+    int lx, ty, w, h, sx, sy, i, j;
+
+    if (mLock.tryLock() != NO_ERROR) {
+        mBusy++;
+        return;
+    }
+    if (!mWant || (y == NULL) || (timestamp < mAfter)) {
+        mLock.unlock();
+        return;
+    }
+
+    if ((mZone[0] == 0) && (mZone[1] == 0) && (mZone[2] == 0) && (mZone[3] == 0)) {
+        lx = width/3;
+        ty = height/3;
+        w = width/3;
+        h = height/3;
+    } else {
+        lx = (int)((long long)(mZone[0] + 1000)*width/2000);
+        ty = (int)((long long)(mZone[1] + 1000)*height/2000);
+        w = (int)((long long)(mZone[2] + 1000)*width/2000) - lx;
+        h = (int)((long long)(mZone[3] + 1000)*height/2000) - ty;
+    }
+    lx = (lx < 0) ? 0 : lx;
+    ty = (ty < 0) ? 0 : ty;
+    w = (lx + w > width) ? (width - lx) : w;
+    h = (ty + h > height) ? (height - ty) : h;
+    sx = (w + CAM_AF_WIN_MAX_W - 1)/CAM_AF_WIN_MAX_W;
+    sy = (h + CAM_AF_WIN_MAX_H - 1)/CAM_AF_WIN_MAX_H;
+    if ((sx <= 0) || (sy <= 0) || (w/sx < 3) || (h/sy < 3)) {
+        mLock.unlock();
+        return;
+    }
+    mWinW = w/sx;
+    mWinH = h/sy;
+    for (j = 0; j < mWinH; j++) {
+        src = y + (long)(ty + j*sy)*stride + lx;
+        dst = mWin + j*mWinW;
+        if (sx == 1) {
+            memcpy(dst, src, mWinW);
+        } else {
+            for (i = 0; i < mWinW; i++)
+                dst[i] = src[i*sx];
+        }
+    }
+    mFrames++;
+    mHave = true;
+    mWant = false;
+    mCond.signal();
+    mLock.unlock();
+}
+
+int CameraContrastAf::moveLens(int pos)
+{
+    struct v4l2_ext_control extCtrInfo;
+    struct v4l2_ext_controls extCtrInfos;
+
+    if (pos == mPos)
+        return 0;
+    memset(&extCtrInfo, 0, sizeof(extCtrInfo));
+    memset(&extCtrInfos, 0, sizeof(extCtrInfos));
+    extCtrInfo.id = V4L2_CID_FOCUS_ABSOLUTE;
+    extCtrInfo.value = pos;
+    extCtrInfos.ctrl_class = V4L2_CTRL_CLASS_CAMERA;
+    extCtrInfos.count = 1;
+    extCtrInfos.controls = &extCtrInfo;
+    if (ioctl(mFd, VIDIOC_S_EXT_CTRLS, &extCtrInfos) < 0) {
+        LOGE("%s(%d): move lens to %d failed(%s)",__FUNCTION__,__LINE__,pos,strerror(errno));
+        return -1;
+    }
+    mPos = pos;
+    mMoved = systemTime(SYSTEM_TIME_MONOTONIC);
+    return 0;
+}
+
+int CameraContrastAf::measure(int pos, float* score)
+{
+    {
+        Mutex::Autolock lock(mLock);
+        if (mCancel)
+            return -1;
+    }
+    if (moveLens(pos) < 0)
+        return -1;
+
+    {
+        Mutex::Autolock lock(mLock);
+        mAfter = mMoved + mSettle;
+        mHave = false;
+        mWant = true;
+        while (!mHave && !mCancel) {
+            if (mCond.waitRelative(mLock, ms2ns(CAM_AF_FRAME_WAIT_MS)) != NO_ERROR)
+                break;
+        }
+        mWant = false;
+        if (!mHave) {
+            if (!mCancel)
+                LOGE("%s(%d): no frame in %d ms, af stops",__FUNCTION__,__LINE__,CAM_AF_FRAME_WAIT_MS);
+            return -1;
+        }
+    }
+    //the preview thread doesn't touch the window until mWant is set again
+    *score = af_tenengrad(mWin, mWinW, mWinH);
+    LOG2("%s(%d): lens %d: %f",__FUNCTION__,__LINE__,pos,*score);
+    return 0;
+}
+
+bool CameraContrastAf::search()
+{
+    nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
+    int step, fineStep, pos, dir, best, below, frames, i, d;
+    float f, fbest, flow;
+    bool climbed, focused = false;
+
+    if (!mActive)
+        return false;
+    mSearches++;
+
+    step = (mMax - mMin)/CAM_AF_COARSE_STEPS;
+    step = (step + mStep - 1)/mStep*mStep;
+    step = (step < mStep) ? mStep : step;
+
+    //coarse: from the range end nearest the lens, until two positions past a peak
+    if ((mPos >= mMin) && (mPos - mMin > mMax - mPos)) {
+        pos = mMax;
+        dir = -1;
+    } else {
+        pos = mMin;
+        dir = 1;
+    }
+    best = pos;
+    fbest = -1.0f;
+    flow = 0.0f;
+    below = 0;
+    frames = 0;
+    for (;;) {
+        if (measure(pos, &f) < 0)
+            goto search_end;
+        frames++;
+        if ((fbest < 0) || (f < flow))
+            flow = f;
+        if (f > fbest) {
+            fbest = f;
+            best = pos;
+            below = 0;
+        } else if ((f < fbest*CAM_AF_PAST_PEAK) && (++below >= 2)) {
+            break;
+        }
+        if ((dir > 0) ? (pos >= mMax) : (pos <= mMin))
+            break;
+        pos += dir*step;
+        pos = (pos > mMax) ? mMax : ((pos < mMin) ? mMin : pos);
+    }
+
+    //fine: climb from the best position, the step halves when neither side is better
+    fineStep = step/2/mStep*mStep;
+    d = dir;
+    for (i = 0; (i < CAM_AF_FINE_MAX) && (fineStep >= mStep); ) {
+        climbed = false;
+        for (dir = d; ; dir = -d) {
+            pos = best + dir*fineStep;
+            if ((pos >= mMin) && (pos <= mMax)) {
+                if (measure(pos, &f) < 0)
+                    goto search_end;
+                frames++;
+                i++;
+                flow = (f < flow) ? f : flow;
+                if (f > fbest) {
+                    fbest = f;
+                    best = pos;
+                    d = dir;
+                    climbed = true;
+                    break;
+                }
+            }
+            if (dir != d)
+                break;
+        }
+        if (!climbed)
+            fineStep = fineStep/2/mStep*mStep;
+    }
+
+    if (moveLens(best) < 0)
+        goto search_end;
+    focused = (fbest > 0) && (fbest >= flow*CAM_AF_PEAK_RATIO);
+    if (focused)
+        mFocused++;
+
+search_end:
+    mLastTime = systemTime(SYSTEM_TIME_MONOTONIC) - start;
+    mLastPos = mPos;
+    LOGD("%s(%d): %s at lens %d, peak %f low %f, %d frames in %lld ms",__FUNCTION__,__LINE__,
+        focused ? "focused" : "failed",mPos,fbest,flow,frames,(long long)ns2ms(mLastTime));
+    return focused;
+}
+
+void CameraContrastAf::arm()
+{
+    Mutex::Autolock lock(mLock);
+    mCancel = false;
+}
+
+void CameraContrastAf::cancel()
+{
+    Mutex::Autolock lock(mLock);
+    mCancel = true;
+    mWant = false;
+    mCond.broadcast();
+}
+
+void CameraContrastAf::dump()
+{
+    if (!mActive)
+        return;
+    LOG1("%s(%d): lens %d..%d at %d, %u searches %u focused, %u frames measured %u skipped busy",__FUNCTION__,__LINE__,
+        mMin,mMax,mPos,mSearches,mFocused,mFrames,mBusy);
+    LOG1("%s(%d): last search %lld ms ended at %d",__FUNCTION__,__LINE__,(long long)ns2ms(mLastTime),mLastPos);
+}
+
+}
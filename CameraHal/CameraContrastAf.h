@@ -0,0 +1,92 @@
+#ifndef ANDROID_HARDWARE_CAMERA_CONTRAST_AF_H
+#define ANDROID_HARDWARE_CAMERA_CONTRAST_AF_H
+
+//focus search on the contrast of the preview frames, for lenses the driver only positions
+#include <utils/threads.h>
+#include <utils/Timers.h>
+
+#define CAMERAHAL_CONTRAST_AF_PROPERTY_KEY  "sys_graphic.cam_hal.contrast_af"   /* 0: off, 1: sensors without driver af, 2: every absolute focus lens */
+#define CAMERAHAL_AF_SETTLE_PROPERTY_KEY    "sys_graphic.cam_hal.af_settle"     /* ms from a lens move to the first frame measured */
+
+namespace android {
+
+#define CAM_AF_WIN_MAX_W        320     /* af window samples per line, wider windows are subsampled */
+#define CAM_AF_WIN_MAX_H        240
+#define CAM_AF_COARSE_STEPS     10      /* coarse sweep positions over the lens range */
+#define CAM_AF_FINE_MAX         8       /* frames of the fine climb */
+#define CAM_AF_SETTLE_MS        60
+#define CAM_AF_FRAME_WAIT_MS    500     /* no frame within this: the preview stopped, the search fails */
+#define CAM_AF_PEAK_RATIO       1.15f   /* best over lowest measure of a search that focused */
+
+/*
+ * The lens is moved through V4L2_CID_FOCUS_ABSOLUTE from the autofocus thread.
+ * After each move the search asks for a frame stamped at least the settle time
+ * after the move; the preview thread copies the af window of that frame's luma
+ * plane, at most CAM_AF_WIN_MAX_W x CAM_AF_WIN_MAX_H samples, and goes on. It
+ * only tries the lock, a frame that finds the search busy is not measured.
+ *
+ * The focus measure is the Tenengrad (sum of squared Sobel gradients) of the
+ * window divided by its squared mean, so an exposure change during the sweep
+ * doesn't look like a contrast change.
+ *
+ * The coarse sweep starts from the range end nearest the lens and stops two
+ * positions past a peak; the fine climb then halves its step around the best
+ * position down to the control step. Focus fails when the best measure isn't
+ * CAM_AF_PEAK_RATIO over the lowest one: a flat window has no focus to find.
+ */
+class CameraContrastAf {
+public:
+    CameraContrastAf();
+    ~CameraContrastAf();
+    //driverAf: the driver focuses on V4L2_CID_FOCUS_AUTO itself. true: the hal runs the af of fd
+    bool init(int fd, bool driverAf);
+    bool active() { return mActive; }
+    //zone: lx ty rx dy in -1000..1000 of the frame, all zero: centre of the frame
+    void setWindow(const int* zone);
+    //preview thread, cheap test before onFrame
+    bool wantFrame() { return mWant; }
+    //preview thread, never waits: samples the af window of the luma plane
+    void onFrame(const unsigned char* y, int width, int height, int stride, nsecs_t timestamp);
+    //autoFocus, before the search is signalled: a cancel from here on ends it
+    void arm();
+    //autofocus thread, true: the lens is left at a contrast peak
+    bool search();
+    //ends a running or requested search, it reports a failure
+    void cancel();
+    void dump();
+
+private:
+    int moveLens(int pos);
+    //-1: no frame
+    int measure(int pos, float* score);
+
+    int mFd;
+    bool mActive;
+    int mMin;                           /* lens range, driver units */
+    int mMax;
+    int mStep;
+    int mPos;                           /* last position written, mMin - 1: unknown */
+    nsecs_t mMoved;
+    nsecs_t mSettle;
+    int mZone[4];
+
+    Mutex mLock;
+    Condition mCond;
+    volatile bool mWant;
+    bool mHave;
+    bool mCancel;
+    nsecs_t mAfter;                     /* first frame time the search takes */
+    unsigned char* mWin;
+    int mWinW;
+    int mWinH;
+
+    unsigned int mSearches;
+    unsigned int mFocused;
+    unsigned int mFrames;
+    unsigned int mBusy;                 /* frames skipped on the lock */
+    nsecs_t mLastTime;
+    int mLastPos;
+};
+
+}
+#endif
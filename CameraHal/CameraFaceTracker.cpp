@@ -0,0 +1,413 @@
+#include "CameraFaceTracker.h"
+#include "CameraHal.h"
+
+namespace android {
+
+#define CAM_FACE_DETECT_DUTY        25      /* % of the face thread the detector may take */
+#define CAM_FACE_GAP_IDLE_MS        500     /* static scene, the tracker carries the faces */
+#define CAM_FACE_GAP_MOVING_MS      150
+#define CAM_FACE_MOTION_LOW         2       /* mean luma difference between levels */
+#define CAM_FACE_MOTION_HIGH        8       /* scene change, detect as soon as the load allows */
+#define CAM_FACE_TRACK_RANGE        8       /* level pixels a face may move between frames */
+#define CAM_FACE_TRACK_LOST         24      /* mean template difference of a lost face */
+
+CameraFaceTracker::CameraFaceTracker()
+{
+    char prop[PROPERTY_VALUE_MAX];
+
+    mFrameW = 0;
+    mFrameH = 0;
+    mShift = 0;
+    mLevelW = 0;
+    mLevelH = 0;
+    mLevel[0] = NULL;
+    mLevel[1] = NULL;
+    mCur = 0;
+    mHavePrev = false;
+    mMotion = 0;
+    mTrackNum = 0;
+    mNextId = 1;
+    mXformZoom = 0;
+    mCost = 0;
+    mLoadGap = 0;
+    mLastDetect = 0;
+    mForce = false;
+    memset(mMeta, 0, sizeof(mMeta));
+    mDetects = 0;
+    mTracks = 0;
+    mLost = 0;
+    mMetaMiss = 0;
+    property_get(CAMERAHAL_FACE_GAP_PROPERTY_KEY, prop, "-1");
+    mFixedGap = atoi(prop);
+}
+
+CameraFaceTracker::~CameraFaceTracker()
+{
+    freeLevels();
+}
+
+void CameraFaceTracker::freeLevels()
+{
+    int i;
+
+    for (i = 0; i < 2; i++) {
+        if (mLevel[i])
+            free(mLevel[i]);
+        mLevel[i] = NULL;
+    }
+    mLevelW = 0;
+    mLevelH = 0;
+}
+
+bool CameraFaceTracker::setup(int frameW, int frameH)
+{
+    int i, w, h;
+
+    if ((frameW == mFrameW) && (frameH == mFrameH) && mLevel[0])
+        return true;
+    freeLevels();
+    mShift = 0;
+    while ((frameW >> mShift) > CAM_FACE_LEVEL_MAX_W)
+        mShift++;
+    w = (frameW >> mShift) & ~0x01;
+    h = (frameH >> mShift) & ~0x01;
+    for (i = 0; i < 2; i++) {
+        if (posix_memalign((void**)&mLevel[i], 64, w*h*3/2) != 0) {
+            mLevel[i] = NULL;
+            freeLevels();
+            mFrameW = 0;
+            mFrameH = 0;
+            LOGE("%s(%d): alloc %dx%d face level failed",__FUNCTION__,__LINE__,w,h);
+            return false;
+        }
+        memset(mLevel[i], 0, w*h);
+        memset(mLevel[i] + w*h, 128, w*h/2);
+    }
+    mFrameW = frameW;
+    mFrameH = frameH;
+    mLevelW = w;
+    mLevelH = h;
+    mXformZoom = 0;
+    reset();
+    LOG1("%s(%d): %dx%d preview, %dx%d face level",__FUNCTION__,__LINE__,frameW,frameH,w,h);
+    return true;
+}
+
+bool CameraFaceTracker::buildLevel(const unsigned char* src, int width, int height, int stride)
+{
+    const int f = 1 << mShift;
+    unsigned int acc[CAM_FACE_LEVEL_MAX_W];
+    unsigned char *dst, *prev;
+    unsigned long diff = 0;
+    int x, y, r, c, v;
+
+    if ((src == NULL) || (mLevel[0] == NULL) || (width != mFrameW) || (height != mFrameH))
+        return false;
+
+    dst = mLevel[mCur ^ 1];
+    prev = mLevel[mCur];
+    //f x f box average, the rows of a block are summed before the columns are split
+    for (y = 0; y < mLevelH; y++) {
+        memset(acc, 0, mLevelW*sizeof(acc[0]));
+        for (r = 0; r < f; r++) {
+            const unsigned char* row = src + (y*f + r)*stride;
+            for (x = 0; x < mLevelW; x++) {
+                for (c = 0; c < f; c++)
+                    acc[x] += row[x*f + c];
+            }
+        }
+        for (x = 0; x < mLevelW; x++) {
+            v = acc[x] >> (2*mShift);
+            diff += abs(v - prev[x]);
+            dst[x] = v;
+        }
+        dst += mLevelW;
+        prev += mLevelW;
+    }
+    mMotion = mHavePrev ? (unsigned int)(diff*16/(mLevelW*mLevelH)) : 0;
+    mHavePrev = true;
+    mCur ^= 1;
+    return true;
+}
+
+bool CameraFaceTracker::needDetect()
+{
+    nsecs_t gap;
+
+    if (mLastDetect == 0)
+        return true;
+    if (mFixedGap >= 0) {
+        gap = ms2ns(mFixedGap);
+    } else if (mForce || (mMotion >= CAM_FACE_MOTION_HIGH*16)) {
+        gap = mLoadGap;
+    } else {
+        gap = ms2ns((mMotion >= CAM_FACE_MOTION_LOW*16) ? CAM_FACE_GAP_MOVING_MS : CAM_FACE_GAP_IDLE_MS);
+        if (gap < mLoadGap)
+            gap = mLoadGap;
+    }
+    return (systemTime(SYSTEM_TIME_MONOTONIC) - mLastDetect >= gap);
+}
+
+void CameraFaceTracker::xformSet(face_xform_t* t, float m0, float m1, float m2, float m3, float m4, float m5)
+{
+    t->m[0] = m0;
+    t->m[1] = m1;
+    t->m[2] = m2;
+    t->m[3] = m3;
+    t->m[4] = m4;
+    t->m[5] = m5;
+}
+
+//rect: left, top, right, bottom of the mapped rectangle
+void CameraFaceTracker::xformRect(const face_xform_t* t, int x, int y, int w, int h, int* rect)
+{
+    const float* m = t->m;
+    int x0 = (int)(m[0]*x + m[1]*y + m[2]);
+    int y0 = (int)(m[3]*x + m[4]*y + m[5]);
+    int x1 = (int)(m[0]*(x + w) + m[1]*(y + h) + m[2]);
+    int y1 = (int)(m[3]*(x + w) + m[4]*(y + h) + m[5]);
+
+    rect[0] = (x0 < x1) ? x0 : x1;
+    rect[1] = (y0 < y1) ? y0 : y1;
+    rect[2] = (x0 < x1) ? x1 : x0;
+    rect[3] = (y0 < y1) ? y1 : y0;
+}
+
+void CameraFaceTracker::updateXform(int zoom)
+{
+    //the level spans the whole frame, the android window is the zoomed part of it
+    float k = 2000.0f*zoom/100;
+
+    xformSet(&mToAndroid, k/mLevelW, 0, -k/2, 0, k/mLevelH, -k/2);
+    xformSet(&mToFrame, (float)mFrameW/mLevelW, 0, 0, 0, (float)mFrameH/mLevelH, 0);
+    mXformZoom = zoom;
+}
+
+void CameraFaceTracker::sampleTmpl(const unsigned char* lv, int x, int y, int w, int h, unsigned char* tmpl)
+{
+    int i, j;
+
+    for (j = 0; j < CAM_FACE_TMPL; j++) {
+        const unsigned char* row = lv + (y + (2*j + 1)*h/(2*CAM_FACE_TMPL))*mLevelW + x;
+        for (i = 0; i < CAM_FACE_TMPL; i++)
+            *tmpl++ = row[(2*i + 1)*w/(2*CAM_FACE_TMPL)];
+    }
+}
+
+unsigned int CameraFaceTracker::matchCost(const unsigned char* lv, const face_track_t* t, int x, int y)
+{
+    const unsigned char* tmpl = t->tmpl;
+    unsigned int cost = 0;
+    int i, j;
+
+    for (j = 0; j < CAM_FACE_TMPL; j++) {
+        const unsigned char* row = lv + (y + (2*j + 1)*t->h/(2*CAM_FACE_TMPL))*mLevelW + x;
+        for (i = 0; i < CAM_FACE_TMPL; i++)
+            cost += abs(row[(2*i + 1)*t->w/(2*CAM_FACE_TMPL)] - *tmpl++);
+    }
+    return cost;
+}
+
+void CameraFaceTracker::detected(const struct RectFace* faces, int num, int orientation, bool smile,
+                                 nsecs_t wall, nsecs_t wait)
+{
+    face_track_t tracks[CAM_FACE_MAX];
+    face_xform_t rot;
+    int i, j, n = 0, rect[4], id;
+
+    mDetects++;
+    mLastDetect = systemTime(SYSTEM_TIME_MONOTONIC);
+    mForce = false;
+    mCost = mCost ? (mCost*3 + wall)/4 : wall;
+    mLoadGap = mCost*(100 - CAM_FACE_DETECT_DUTY)/CAM_FACE_DETECT_DUTY;
+    //the thread spent a good part of the detection waiting for a cpu, < 0: no schedstat
+    if (wait*10 > wall*4)
+        mLoadGap *= 2;
+
+    //the detector sees the level turned counter clockwise by orientation*90
+    switch (orientation) {
+        case 1:
+            xformSet(&rot, 0, -1, mLevelW, 1, 0, 0);
+            break;
+        case 2:
+            xformSet(&rot, -1, 0, mLevelW, 0, -1, mLevelH);
+            break;
+        case 3:
+            xformSet(&rot, 0, 1, 0, -1, 0, mLevelH);
+            break;
+        default:
+            xformSet(&rot, 1, 0, 0, 0, 1, 0);
+            break;
+    }
+
+    for (i = 0; (i < num) && (n < CAM_FACE_MAX); i++) {
+        face_track_t* t = &tracks[n];
+        int best = 0;
+
+        xformRect(&rot, faces[i].x, faces[i].y, faces[i].width, faces[i].height, rect);
+        rect[0] = (rect[0] < 0) ? 0 : rect[0];
+        rect[1] = (rect[1] < 0) ? 0 : rect[1];
+        rect[2] = (rect[2] > mLevelW) ? mLevelW : rect[2];
+        rect[3] = (rect[3] > mLevelH) ? mLevelH : rect[3];
+        if ((rect[2] - rect[0] < 4) || (rect[3] - rect[1] < 4))
+            continue;
+        t->x = rect[0];
+        t->y = rect[1];
+        t->w = rect[2] - rect[0];
+        t->h = rect[3] - rect[1];
+        t->score = smile ? 100 : 60;
+        //a face overlapping a tracked one by half keeps its id
+        id = 0;
+        for (j = 0; j < mTrackNum; j++) {
+            face_track_t* o = &mTrack[j];
+            int ix = ((t->x + t->w < o->x + o->w) ? (t->x + t->w) : (o->x + o->w)) - ((t->x > o->x) ? t->x : o->x);
+            int iy = ((t->y + t->h < o->y + o->h) ? (t->y + t->h) : (o->y + o->h)) - ((t->y > o->y) ? t->y : o->y);
+            if ((ix > 0) && (iy > 0) && (ix*iy*2 > t->w*t->h) && (ix*iy > best)) {
+                best = ix*iy;
+                id = o->id;
+            }
+        }
+        t->id = id ? id : mNextId++;
+        sampleTmpl(mLevel[mCur], t->x, t->y, t->w, t->h, t->tmpl);
+        n++;
+    }
+    memcpy(mTrack, tracks, n*sizeof(tracks[0]));
+    mTrackNum = n;
+}
+
+void CameraFaceTracker::track()
+{
+    const unsigned char* lv = mLevel[mCur];
+    unsigned int cost, best;
+    int i, n = 0, dx, dy, r, step, bx, by, cx, cy;
+
+    mTracks++;
+    for (i = 0; i < mTrackNum; i++) {
+        face_track_t* t = &mTrack[i];
+
+        r = t->w/4;
+        r = (r < 2) ? 2 : ((r > CAM_FACE_TRACK_RANGE) ? CAM_FACE_TRACK_RANGE : r);
+        best = ~0u;
+        bx = t->x;
+        by = t->y;
+        //coarse search on even offsets, then the neighbours of the best one
+        for (step = 2; step > 0; step--) {
+            cx = bx;
+            cy = by;
+            for (dy = -r; dy <= r; dy += step) {
+                for (dx = -r; dx <= r; dx += step) {
+                    int x = cx + dx, y = cy + dy;
+                    if ((x < 0) || (y < 0) || (x + t->w > mLevelW) || (y + t->h > mLevelH))
+                        continue;
+                    cost = matchCost(lv, t, x, y);
+                    if (cost < best) {
+                        best = cost;
+                        bx = x;
+                        by = y;
+                    }
+                }
+            }
+            r = 1;
+        }
+        if ((best == ~0u) || (best > CAM_FACE_TRACK_LOST*CAM_FACE_TMPL*CAM_FACE_TMPL)) {
+            mLost++;
+            mForce = true;
+            continue;
+        }
+        t->x = bx;
+        t->y = by;
+        if (n != i)
+            mTrack[n] = *t;
+        n++;
+    }
+    mTrackNum = n;
+}
+
+cam_face_meta_t* CameraFaceTracker::report(int zoom, int maxFaces)
+{
+    cam_face_meta_t* slot = NULL;
+    int i, n = 0, num, a[4], r[4];
+
+    {
+        Mutex::Autolock lock(mMetaLock);
+        for (i = 0; i < CAM_FACE_META_SLOTS; i++) {
+            if (!mMeta[i].busy) {
+                slot = &mMeta[i];
+                slot->busy = true;
+                break;
+            }
+        }
+    }
+    if (slot == NULL) {
+        mMetaMiss++;
+        return NULL;
+    }
+    if (zoom != mXformZoom)
+        updateXform(zoom);
+
+    num = (maxFaces < CAM_FACE_MAX) ? maxFaces : CAM_FACE_MAX;
+    num = (mTrackNum < num) ? mTrackNum : num;
+    for (i = 0; i < num; i++) {
+        const face_track_t* t = &mTrack[i];
+        camera_face_t* face = &slot->face[n];
+
+        xformRect(&mToAndroid, t->x, t->y, t->w, t->h, a);
+        a[0] = (a[0] < -1000) ? -1000 : a[0];
+        a[1] = (a[1] < -1000) ? -1000 : a[1];
+        a[2] = (a[2] > 1000) ? 1000 : a[2];
+        a[3] = (a[3] > 1000) ? 1000 : a[3];
+        //out of the zoomed window
+        if ((a[2] <= a[0]) || (a[3] <= a[1]))
+            continue;
+        memcpy(face->rect, a, sizeof(face->rect));
+        face->score = t->score;
+        face->id = t->id;
+        face->left_eye[0] = face->left_eye[1] = -2000;
+        face->right_eye[0] = face->right_eye[1] = -2000;
+        face->mouth[0] = face->mouth[1] = -2000;
+
+        xformRect(&mToFrame, t->x, t->y, t->w, t->h, r);
+        slot->rect[n].x = r[0];
+        slot->rect[n].y = r[1];
+        slot->rect[n].width = r[2] - r[0];
+        slot->rect[n].height = r[3] - r[1];
+        LOG2("%s(%d): face %d (%d,%d,%d,%d), preview (%d,%d,%d,%d)",__FUNCTION__,__LINE__,face->id,
+            a[0],a[1],a[2],a[3],r[0],r[1],r[2] - r[0],r[3] - r[1]);
+        n++;
+    }
+    slot->meta.number_of_faces = n;
+    slot->meta.faces = n ? slot->face : NULL;
+    return slot;
+}
+
+void CameraFaceTracker::releaseMeta(camera_frame_metadata_t* meta)
+{
+    Mutex::Autolock lock(mMetaLock);
+    int i;
+
+    for (i = 0; i < CAM_FACE_META_SLOTS; i++) {
+        if (&mMeta[i].meta == meta) {
+            mMeta[i].busy = false;
+            return;
+        }
+    }
+}
+
+void CameraFaceTracker::reset()
+{
+    mTrackNum = 0;
+    mLastDetect = 0;
+    mForce = false;
+    mHavePrev = false;
+    mMotion = 0;
+}
+
+void CameraFaceTracker::dump()
+{
+    LOG1("%s(%d): %dx%d level, %u detections, %u tracked frames, %u faces lost, %u reports dropped",__FUNCTION__,__LINE__,
+        mLevelW,mLevelH,mDetects,mTracks,mLost,mMetaMiss);
+    LOG1("%s(%d): detector %lld ms, load gap %lld ms, motion %u/16",__FUNCTION__,__LINE__,
+        (long long)ns2ms(mCost),(long long)ns2ms(mLoadGap),mMotion);
+}
+
+}
@@ -0,0 +1,129 @@
+#ifndef ANDROID_HARDWARE_CAMERA_FACE_TRACKER_H
+#define ANDROID_HARDWARE_CAMERA_FACE_TRACKER_H
+
+//luma level, detection cadence and tracking of the faces between detections
+#include <utils/threads.h>
+#include <utils/Timers.h>
+#include <hardware/camera.h>
+#include "FaceDetector.h"
+
+#define CAMERAHAL_FACE_GAP_PROPERTY_KEY "sys_graphic.cam_hal.facegap"   /* ms between detections, -1: adaptive */
+
+namespace android {
+
+#define CAM_FACE_MAX            10      /* faces reported, the app may ask for fewer */
+#define CAM_FACE_LEVEL_MAX_W    320     /* widest level handed to the detector */
+#define CAM_FACE_META_SLOTS     3       /* reports the callback thread may hold */
+#define CAM_FACE_TMPL           16      /* template samples per side */
+
+//one face report, owned by the tracker and handed to the callback thread
+typedef struct cam_face_meta_s {
+    camera_frame_metadata_t meta;
+    camera_face_t face[CAM_FACE_MAX];
+    struct RectFace rect[CAM_FACE_MAX];     /* preview pixels, for the af window */
+    bool busy;
+} cam_face_meta_t;
+
+/*
+ * The detector runs on a luma level of the preview frame, the frame downscaled
+ * by a power of two to at most CAM_FACE_LEVEL_MAX_W wide. The level is built as
+ * soon as the frame arrives so the frame is returned before the detector runs;
+ * its chroma plane is neutral and written once, as the detector takes nv12.
+ *
+ * Detections are spaced in time: the detector may take CAM_FACE_DETECT_DUTY
+ * percent of the thread, twice less when the thread waited for a cpu during
+ * the detection (run queue wait from schedstat, the detector may as well sleep
+ * on the gpu, so thread cpu time tells nothing), and a
+ * static scene stretches the gap up to CAM_FACE_GAP_IDLE_MS. In between, every
+ * face is moved by block matching its template on the new level; a lost face
+ * or a large scene change brings the next detection forward.
+ *
+ * Faces are kept in level coordinates. The detector output is rotated into the
+ * level once, reports are mapped with one affine per target (android and
+ * preview pixels), recomputed only when the zoom or the level changes.
+ */
+class CameraFaceTracker {
+public:
+    CameraFaceTracker();
+    ~CameraFaceTracker();
+    //preview size the frames come at, false: out of memory
+    bool setup(int frameW, int frameH);
+    int levelWidth() { return mLevelW; }
+    int levelHeight() { return mLevelH; }
+    //builds the level from the luma plane of a frame, the frame can be returned after it
+    bool buildLevel(const unsigned char* y, int width, int height, int stride);
+    //nv12 level of the last frame
+    const unsigned char* level() { return mLevel[mCur]; }
+    //true: run the detector on the current level
+    bool needDetect();
+    //detector output on the level rotated by orientation (0..3, counter clockwise)
+    //wall: detector time, wait: run queue wait of the thread meanwhile, -1: unknown
+    void detected(const struct RectFace* faces, int num, int orientation, bool smile,
+                  nsecs_t wall, nsecs_t wait);
+    //moves the faces onto the current level
+    void track();
+    //faces in a free report slot, NULL: every slot is held by the callback thread
+    cam_face_meta_t* report(int zoom, int maxFaces);
+    //the callback thread is done with meta
+    void releaseMeta(camera_frame_metadata_t* meta);
+    //drops the faces, the next frame is detected
+    void reset();
+    void dump();
+
+private:
+    typedef struct face_xform {
+        float m[6];                     /* x' = m0*x + m1*y + m2, y' = m3*x + m4*y + m5 */
+    } face_xform_t;
+
+    typedef struct face_track {
+        int x;                          /* level pixels */
+        int y;
+        int w;
+        int h;
+        int id;
+        int score;
+        unsigned char tmpl[CAM_FACE_TMPL*CAM_FACE_TMPL];
+    } face_track_t;
+
+    static void xformSet(face_xform_t* t, float m0, float m1, float m2, float m3, float m4, float m5);
+    static void xformRect(const face_xform_t* t, int x, int y, int w, int h, int* rect);
+    void updateXform(int zoom);
+    void sampleTmpl(const unsigned char* lv, int x, int y, int w, int h, unsigned char* tmpl);
+    unsigned int matchCost(const unsigned char* lv, const face_track_t* t, int x, int y);
+    void freeLevels();
+
+    int mFrameW;
+    int mFrameH;
+    int mShift;                         /* level = frame >> mShift */
+    int mLevelW;
+    int mLevelH;
+    unsigned char* mLevel[2];           /* current and previous level */
+    int mCur;
+    bool mHavePrev;
+    unsigned int mMotion;               /* mean luma difference to the previous level, x16 */
+
+    face_track_t mTrack[CAM_FACE_MAX];
+    int mTrackNum;
+    int mNextId;
+
+    int mXformZoom;                     /* zoom the android transform was built for, 0: stale */
+    face_xform_t mToAndroid;
+    face_xform_t mToFrame;
+
+    int mFixedGap;                      /* ms, < 0: adaptive */
+    nsecs_t mCost;                      /* detector wall time, running mean */
+    nsecs_t mLoadGap;
+    nsecs_t mLastDetect;
+    bool mForce;
+
+    cam_face_meta_t mMeta[CAM_FACE_META_SLOTS];
+    Mutex mMetaLock;
+
+    unsigned int mDetects;
+    unsigned int mTracks;
+    unsigned int mLost;
+    unsigned int mMetaMiss;
+};
+
+}
+#endif
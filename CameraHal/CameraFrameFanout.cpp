@@ -0,0 +1,527 @@
+#include "CameraFrameFanout.h"
+#include "CameraHal.h"
+
+namespace android {
+
+typedef struct fanout_scale_out {
+    unsigned char* dst;
+    int dw;
+    int dh;
+    bool nv21;
+    bool mirror;
+    const unsigned char* psY;
+    const unsigned char* psUV;
+    int stride;                         /* source bytes per line, both planes */
+    long xInv;
+    long yInv;
+    int y;
+} fanout_scale_out_t;
+
+/* same crop, zoom and bilinear weights as arm_camera_yuv420_scale_arm */
+static void fanout_scale_setup(fanout_scale_out_t* o, const unsigned char* src, int sw, int sh,
+                               int stride, long uvOffset, int zoom)
+{
+    int cropW,cropH,ratio;
+    int top = 0,left = 0;
+
+    if ((sw*100/sh) != (o->dw*100/o->dh)) {
+        ratio = ((sw*100/o->dw) >= (sh*100/o->dh)) ? (sh*100/o->dh) : (sw*100/o->dw);
+        cropW = ratio*o->dw/100;
+        cropH = ratio*o->dh/100;
+        left = ((sw - cropW) >> 1) & (~0x01);
+        top = ((sh - cropH) >> 1) & (~0x01);
+    } else {
+        cropW = sw;
+        cropH = sh;
+    }
+    if (zoom > 100) {
+        cropW = cropW*100/zoom;
+        cropH = cropH*100/zoom;
+        left = ((sw - cropW) >> 1) & (~0x01);
+        top = ((sh - cropH) >> 1) & (~0x01);
+    }
+    o->psY = src + top*stride + left;
+    o->psUV = src + uvOffset + (top >> 1)*stride + left;
+    o->stride = stride;
+    o->xInv = ((unsigned long)cropW << 16)/o->dw + 1;
+    o->yInv = ((unsigned long)cropH << 16)/o->dh + 1;
+}
+
+static void fanout_scale_row_y(const fanout_scale_out_t* o, int sw, int sY)
+{
+    const unsigned char* r0p = o->psY + sY*o->stride;
+    const unsigned char* r1p = r0p + o->stride;
+    const long xInv = o->xInv, dw = o->dw;
+    const long yc0 = (o->y*o->yInv) & 0xffff, yc1 = 0xffff - yc0;
+    unsigned char* d = o->dst + o->y*dw;
+    long x,sX,xc0,xc1,r0,r1;
+
+    if (o->mirror) {
+        d += dw - 1;
+        for (x = 0; x < dw; x++) {
+            xc0 = (x*xInv) & 0xffff;
+            xc1 = 0xffff - xc0;
+            sX = (x*xInv) >> 16;
+            sX = (sX >= sw - 1) ? (sw - 2) : sX;
+            r0 = (r0p[sX]*xc1 + r0p[sX + 1]*xc0) >> 16;
+            r1 = (r1p[sX]*xc1 + r1p[sX + 1]*xc0) >> 16;
+            *d-- = (r0*yc1 + r1*yc0) >> 16;
+        }
+    } else {
+        for (x = 0; x < dw; x++) {
+            xc0 = (x*xInv) & 0xffff;
+            xc1 = 0xffff - xc0;
+            sX = (x*xInv) >> 16;
+            sX = (sX >= sw - 1) ? (sw - 2) : sX;
+            r0 = (r0p[sX]*xc1 + r0p[sX + 1]*xc0) >> 16;
+            r1 = (r1p[sX]*xc1 + r1p[sX + 1]*xc0) >> 16;
+            d[x] = (r0*yc1 + r1*yc0) >> 16;
+        }
+    }
+}
+
+static void fanout_scale_row_uv(const fanout_scale_out_t* o, int sw2, int sY)
+{
+    const unsigned char* r0p = o->psUV + sY*o->stride;
+    const unsigned char* r1p = r0p + o->stride;
+    const long xInv = o->xInv, dw2 = o->dw/2;
+    const long yc0 = (o->y*o->yInv) & 0xffff, yc1 = 0xffff - yc0;
+    const int ui = o->nv21 ? 1 : 0, vi = 1 - ui;
+    unsigned char* d = o->dst + o->dw*o->dh + o->y*dw2*2;
+    long x,sX,xc0,xc1,r0,r1,step = 2;
+
+    if (o->mirror) {
+        d += (dw2 - 1)*2;
+        step = -2;
+    }
+    for (x = 0; x < dw2; x++, d += step) {
+        xc0 = (x*xInv) & 0xffff;
+        xc1 = 0xffff - xc0;
+        sX = (x*xInv) >> 16;
+        sX = (sX >= sw2 - 1) ? (sw2 - 2) : sX;
+        r0 = (r0p[sX*2]*xc1 + r0p[sX*2 + 2]*xc0) >> 16;
+        r1 = (r1p[sX*2]*xc1 + r1p[sX*2 + 2]*xc0) >> 16;
+        d[ui] = (r0*yc1 + r1*yc0) >> 16;
+        r0 = (r0p[sX*2 + 1]*xc1 + r0p[sX*2 + 3]*xc0) >> 16;
+        r1 = (r1p[sX*2 + 1]*xc1 + r1p[sX*2 + 3]*xc0) >> 16;
+        d[vi] = (r0*yc1 + r1*yc0) >> 16;
+    }
+}
+
+/*
+ * Scale one nv12 source into several outputs, walking the source rows once:
+ * every output emits the rows that depend on the current source row pair, so
+ * the source is streamed from memory a single time whatever the output count.
+ */
+static void fanout_scale_multi(const unsigned char* src, int sw, int sh, int stride, long uvOffset,
+                               int zoom, fanout_scale_out_t* outs, int n)
+{
+    int i,s,sY;
+
+    for (i = 0; i < n; i++) {
+        fanout_scale_setup(&outs[i], src, sw, sh, stride, uvOffset, zoom);
+        outs[i].y = 0;
+    }
+    for (s = 0; s < sh; s++) {
+        for (i = 0; i < n; i++) {
+            fanout_scale_out_t* o = &outs[i];
+            while (o->y < o->dh) {
+                sY = (o->y*o->yInv) >> 16;
+                sY = (sY >= sh - 1) ? (sh - 2) : sY;
+                if (sY > s)
+                    break;
+                fanout_scale_row_y(o, sw, sY);
+                o->y++;
+            }
+        }
+    }
+
+    for (i = 0; i < n; i++)
+        outs[i].y = 0;
+    for (s = 0; s < sh/2; s++) {
+        for (i = 0; i < n; i++) {
+            fanout_scale_out_t* o = &outs[i];
+            while (o->y < o->dh/2) {
+                sY = (o->y*o->yInv) >> 16;
+                sY = (sY >= sh/2 - 1) ? (sh/2 - 2) : sY;
+                if (sY > s)
+                    break;
+                fanout_scale_row_uv(o, sw/2, sY);
+                o->y++;
+            }
+        }
+    }
+}
+
+CameraFrameFanout::CameraFrameFanout()
+    :mEnable(true),
+     mFrames(0),
+     mShared(0),
+     mSaved(0)
+{
+    char prop[PROPERTY_VALUE_MAX];
+
+    property_get(CAMERAHAL_FANOUT_PROPERTY_KEY, prop, "1");
+    mEnable = (atoi(prop) != 0);
+    memset(mSpec, 0, sizeof(mSpec));
+    memset(mSpecValid, 0, sizeof(mSpecValid));
+    memset(mFrame, 0, sizeof(mFrame));
+    memset(mPool, 0, sizeof(mPool));
+    memset(mHold, 0, sizeof(mHold));
+}
+
+CameraFrameFanout::~CameraFrameFanout()
+{
+    int i;
+
+    for (i = 0; i < FANOUT_POOL_MAX; i++) {
+        if (mPool[i].buf)
+            free(mPool[i].buf);
+    }
+}
+
+bool CameraFrameFanout::sameSpec(const fanout_spec_t* a, const fanout_spec_t* b)
+{
+    return (a->width == b->width) && (a->height == b->height)
+        && (a->fmt == b->fmt) && (a->mirror == b->mirror);
+}
+
+//true: the consumers scale this output on the cpu, same checks as rga_nv12_scale_crop
+bool CameraFrameFanout::cpuScaled(const fanout_spec_t* spec, int width, int stride, long uvOffset)
+{
+#if defined(TARGET_RK3188)
+    return true;
+#else
+#if defined(TARGET_RK312x)
+    if (spec->mirror)
+        return true;
+#endif
+    if ((spec->width > RGA_VIRTUAL_W) || (spec->height > RGA_VIRTUAL_H))
+        return true;
+    //rga needs the uv plane a whole number of lines after the y plane
+    if (uvOffset && (uvOffset % (stride ? stride : width)))
+        return true;
+    return false;
+#endif
+}
+
+CameraFrameFanout::fanout_frame_t* CameraFrameFanout::findFrame(unsigned long src)
+{
+    int i;
+
+    for (i = 0; i < FANOUT_FRAME_MAX; i++) {
+        if (mFrame[i].pending && (mFrame[i].src == src))
+            return &mFrame[i];
+    }
+    return NULL;
+}
+
+void CameraFrameFanout::beginFrame(unsigned long src, int width, int height, int stride, long uvOffset,
+                                   int zoom, unsigned int mask)
+{
+    Mutex::Autolock lock(mLock);
+    fanout_frame_t* frame = NULL;
+    unsigned int left;
+    int i,j;
+
+    if (!mEnable || (mask & (mask - 1)) == 0)
+        return;
+    //the isp buffer is locked until every consumer returned it, so src can't be in flight twice
+    for (i = 0; i < FANOUT_FRAME_MAX; i++) {
+        if (mFrame[i].pending == 0) {
+            frame = &mFrame[i];
+            break;
+        }
+    }
+    if (frame == NULL)
+        return;
+
+    frame->count = 0;
+    left = mask;
+    for (i = 0; (i < FANOUT_CONSUMER_MAX) && (frame->count < FANOUT_RENDITION_MAX); i++) {
+        unsigned int users = 0;
+        if (!(left & (1 << i)) || !mSpecValid[i])
+            continue;
+        if (!cpuScaled(&mSpec[i], width, stride, uvOffset)) {
+            left &= ~(1 << i);
+            continue;
+        }
+        for (j = i; j < FANOUT_CONSUMER_MAX; j++) {
+            if ((left & (1 << j)) && mSpecValid[j] && sameSpec(&mSpec[i], &mSpec[j]))
+                users |= (1 << j);
+        }
+        left &= ~users;
+        if ((users & (users - 1)) == 0)
+            continue;
+        frame->rendition[frame->count].spec = mSpec[i];
+        frame->rendition[frame->count].users = users;
+        frame->rendition[frame->count].buf = NULL;
+        frame->rendition[frame->count].ready = false;
+        frame->rendition[frame->count].failed = false;
+        frame->count++;
+    }
+    if (frame->count == 0)
+        return;
+
+    frame->src = src;
+    frame->width = width;
+    frame->height = height;
+    frame->stride = stride ? stride : width;
+    frame->uvOffset = uvOffset ? uvOffset : (long)frame->stride*height;
+    frame->zoom = zoom;
+    frame->producing = false;
+    frame->pending = mask;
+    mFrames++;
+}
+
+void CameraFrameFanout::publish(int consumer, const fanout_spec_t* spec)
+{
+    Mutex::Autolock lock(mLock);
+
+    mSpec[consumer] = *spec;
+    mSpecValid[consumer] = true;
+}
+
+const unsigned char* CameraFrameFanout::acquire(unsigned long src, int consumer, const fanout_spec_t* spec)
+{
+    Mutex::Autolock lock(mLock);
+    fanout_frame_t* frame;
+    fanout_rendition_t* r = NULL;
+    fanout_hold_t* hold = NULL;
+    int i;
+
+    //published for the next frames
+    mSpec[consumer] = *spec;
+    mSpecValid[consumer] = true;
+
+    frame = findFrame(src);
+    if (frame == NULL)
+        return NULL;
+    for (i = 0; i < frame->count; i++) {
+        if (frame->rendition[i].users & (1 << consumer)) {
+            r = &frame->rendition[i];
+            break;
+        }
+    }
+    //not shared, or the consumer changed its output since the frame was planned
+    if ((r == NULL) || !sameSpec(&r->spec, spec))
+        return NULL;
+
+    if (!r->ready && !r->failed) {
+        if (frame->producing) {
+            while (frame->producing)
+                mReadyCond.wait(mLock);
+        } else {
+            frame->producing = true;
+            mLock.unlock();
+            produce(frame);
+            mLock.lock();
+            frame->producing = false;
+            mReadyCond.broadcast();
+        }
+    }
+    if (!r->ready)
+        return NULL;
+    //the consumer keeps the buffer alive until its release(), whatever happens to the frame
+    for (i = 0; i < FANOUT_HOLD_MAX; i++) {
+        if ((mHold[consumer][i].buf != NULL) && (mHold[consumer][i].src == src))
+            return r->buf;
+        if ((hold == NULL) && (mHold[consumer][i].buf == NULL))
+            hold = &mHold[consumer][i];
+    }
+    if (hold == NULL)
+        return NULL;
+    hold->src = src;
+    hold->buf = r->buf;
+    refBuf(r->buf);
+    mSaved++;
+    return r->buf;
+}
+
+void CameraFrameFanout::produce(fanout_frame_t* frame)
+{
+    fanout_scale_out_t outs[FANOUT_RENDITION_MAX];
+    fanout_rendition_t* cpu[FANOUT_RENDITION_MAX];
+    const unsigned char* src = (const unsigned char*)frame->src;
+    int i,n = 0;
+
+    for (i = 0; i < frame->count; i++) {
+        fanout_rendition_t* r = &frame->rendition[i];
+        fanout_spec_t* s = &r->spec;
+
+        mLock.lock();
+        r->buf = getBuf(s->width*s->height*3/2);
+        mLock.unlock();
+        if (r->buf == NULL) {
+            r->failed = true;
+            continue;
+        }
+        if ((s->width == frame->width) && (s->height == frame->height) && (frame->zoom == 100) && !s->mirror
+            && (frame->stride == frame->width) && (frame->uvOffset == (long)frame->width*frame->height)) {
+            if (s->fmt == V4L2_PIX_FMT_NV21)
+                cameraFormatConvert(V4L2_PIX_FMT_NV12, V4L2_PIX_FMT_NV21, NULL,
+                    (char*)src, (char*)r->buf, 0, 0, s->width*s->height*3/2,
+                    s->width, s->height, s->width, s->width, s->height, s->width, false);
+            else
+                memcpy(r->buf, src, s->width*s->height*3/2);
+            r->ready = true;
+            continue;
+        }
+        outs[n].dst = r->buf;
+        outs[n].dw = s->width;
+        outs[n].dh = s->height;
+        outs[n].nv21 = (s->fmt == V4L2_PIX_FMT_NV21);
+        outs[n].mirror = s->mirror;
+        cpu[n++] = r;
+    }
+
+    if (n) {
+        fanout_scale_multi(src, frame->width, frame->height, frame->stride, frame->uvOffset, frame->zoom, outs, n);
+        for (i = 0; i < n; i++)
+            cpu[i]->ready = true;
+    }
+
+    mLock.lock();
+    for (i = 0; i < frame->count; i++) {
+        if (frame->rendition[i].ready)
+            mShared++;
+    }
+    mLock.unlock();
+}
+
+void CameraFrameFanout::release(unsigned long src, int consumer)
+{
+    Mutex::Autolock lock(mLock);
+    fanout_frame_t* frame = findFrame(src);
+    int i;
+
+    for (i = 0; i < FANOUT_HOLD_MAX; i++) {
+        if ((mHold[consumer][i].buf != NULL) && (mHold[consumer][i].src == src)) {
+            putBuf(mHold[consumer][i].buf);
+            mHold[consumer][i].buf = NULL;
+            break;
+        }
+    }
+    if (frame == NULL)
+        return;
+    frame->pending &= ~(1 << consumer);
+    if (frame->pending == 0)
+        freeFrame(frame);
+}
+
+void CameraFrameFanout::freeFrame(fanout_frame_t* frame)
+{
+    int i;
+
+    for (i = 0; i < frame->count; i++) {
+        if (frame->rendition[i].buf)
+            putBuf(frame->rendition[i].buf);
+        frame->rendition[i].buf = NULL;
+    }
+    frame->count = 0;
+    frame->pending = 0;
+}
+
+void CameraFrameFanout::flush()
+{
+    Mutex::Autolock lock(mLock);
+    int i;
+
+    //frames dropped without being returned; a rendition a consumer acquired lives on until its release()
+    for (i = 0; i < FANOUT_FRAME_MAX; i++) {
+        if (mFrame[i].pending && !mFrame[i].producing)
+            freeFrame(&mFrame[i]);
+    }
+}
+
+unsigned char* CameraFrameFanout::getBuf(size_t size)
+{
+    int i,empty = -1,bigger = -1;
+
+    for (i = 0; i < FANOUT_POOL_MAX; i++) {
+        if (mPool[i].refs)
+            continue;
+        if (mPool[i].buf == NULL) {
+            if (empty < 0)
+                empty = i;
+        } else if (mPool[i].size >= size) {
+            if ((bigger < 0) || (mPool[i].size < mPool[bigger].size))
+                bigger = i;
+        }
+    }
+    if (bigger >= 0) {
+        mPool[bigger].refs = 1;
+        return mPool[bigger].buf;
+    }
+    if (empty < 0) {
+        //reuse the smallest idle buffer slot
+        for (i = 0; i < FANOUT_POOL_MAX; i++) {
+            if (!mPool[i].refs && ((empty < 0) || (mPool[i].size < mPool[empty].size)))
+                empty = i;
+        }
+        if (empty < 0)
+            return NULL;
+        free(mPool[empty].buf);
+        mPool[empty].buf = NULL;
+    }
+    if (posix_memalign((void**)&mPool[empty].buf, 64, size) != 0) {
+        mPool[empty].buf = NULL;
+        mPool[empty].size = 0;
+        LOGE("%s(%d): alloc %d bytes failed",__FUNCTION__,__LINE__,(int)size);
+        return NULL;
+    }
+    mPool[empty].size = size;
+    mPool[empty].refs = 1;
+    return mPool[empty].buf;
+}
+
+void CameraFrameFanout::refBuf(unsigned char* buf)
+{
+    int i;
+
+    for (i = 0; i < FANOUT_POOL_MAX; i++) {
+        if (mPool[i].buf == buf) {
+            mPool[i].refs++;
+            return;
+        }
+    }
+}
+
+void CameraFrameFanout::putBuf(unsigned char* buf)
+{
+    int i;
+
+    for (i = 0; i < FANOUT_POOL_MAX; i++) {
+        if ((mPool[i].buf == buf) && (mPool[i].refs > 0)) {
+            mPool[i].refs--;
+            return;
+        }
+    }
+}
+
+void CameraFrameFanout::copyOut(const unsigned char* rendition, int width, int height, unsigned char* dst, int dstStride)
+{
+    int y;
+
+    if ((dstStride == 0) || (dstStride == width)) {
+        memcpy(dst, rendition, width*height*3/2);
+        return;
+    }
+    //y rows then the interleaved uv rows, the uv plane starts after stride*height
+    for (y = 0; y < height; y++)
+        memcpy(dst + y*dstStride, rendition + y*width, width);
+    rendition += width*height;
+    dst += dstStride*height;
+    for (y = 0; y < height/2; y++)
+        memcpy(dst + y*dstStride, rendition + y*width, width);
+}
+
+void CameraFrameFanout::dump()
+{
+    Mutex::Autolock lock(mLock);
+
+    LOGD("%s(%d): %s, %d frames shared, %d renditions produced, %d renders saved",__FUNCTION__,__LINE__,
+        mEnable ? "on" : "off",mFrames,mShared,mSaved - mShared);
+}
+
+}
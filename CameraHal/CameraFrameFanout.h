@@ -0,0 +1,123 @@
+#ifndef ANDROID_HARDWARE_CAMERA_FRAME_FANOUT_H
+#define ANDROID_HARDWARE_CAMERA_FRAME_FANOUT_H
+
+//one rendition of a source frame shared by every consumer asking for the same output
+#include <utils/threads.h>
+
+#define CAMERAHAL_FANOUT_PROPERTY_KEY   "sys_graphic.cam_hal.fanout"    /* 0: each consumer scales for itself */
+
+namespace android {
+
+#define FANOUT_FRAME_MAX        8       /* source frames in flight */
+#define FANOUT_RENDITION_MAX    3       /* distinct renditions of one frame */
+#define FANOUT_POOL_MAX         6       /* rendition buffers */
+#define FANOUT_HOLD_MAX         FANOUT_FRAME_MAX    /* renditions a consumer may hold */
+
+enum FanoutConsumer {
+    FANOUT_CONSUMER_DISPLAY,
+    FANOUT_CONSUMER_VIDEO,
+    FANOUT_CONSUMER_DATACB,
+    FANOUT_CONSUMER_MAX
+};
+
+typedef struct fanout_spec_s {
+    int width;
+    int height;
+    int fmt;                            /* V4L2_PIX_FMT_NV12 or V4L2_PIX_FMT_NV21 */
+    bool mirror;
+} fanout_spec_t;
+
+/*
+ * Consumers publish the output they render when they are configured, through
+ * publish(), and again with every acquire(). For every frame the adapter tells
+ * beginFrame() which consumers will get it; outputs wanted by two or more of
+ * them are rendered once, by the first consumer to call acquire(), and the
+ * others copy the result. All shared outputs of a frame are produced in one
+ * pass over the source rows.
+ *
+ * Only outputs the consumers would scale on the cpu are shared. Rga scales
+ * straight into each consumer buffer, so there a copy out of a shared
+ * rendition costs more cpu than it saves; acquire() returns NULL and the
+ * consumer renders into its own buffer as before. The same goes for outputs
+ * wanted by a single consumer.
+ *
+ * Rendition buffers are counted: one reference for the frame, one for each
+ * consumer that acquired it, dropped by its release() even after a flush().
+ */
+class CameraFrameFanout {
+public:
+    CameraFrameFanout();
+    ~CameraFrameFanout();
+    //mask: 1 << FanoutConsumer for each consumer the frame is sent to
+    //stride, uvOffset: nv12 plane layout of src, 0: packed
+    void beginFrame(unsigned long src, int width, int height, int stride, long uvOffset,
+                    int zoom, unsigned int mask);
+    //the output the consumer renders from the next frame on
+    void publish(int consumer, const fanout_spec_t* spec);
+    //NULL: render as usual. Otherwise width*height*3/2 bytes, valid until release()
+    const unsigned char* acquire(unsigned long src, int consumer, const fanout_spec_t* spec);
+    //the consumer has returned the frame
+    void release(unsigned long src, int consumer);
+    //drops the frames in flight, the published outputs are kept
+    void flush();
+    void dump();
+    static void copyOut(const unsigned char* rendition, int width, int height, unsigned char* dst, int dstStride);
+
+private:
+    typedef struct fanout_rendition {
+        fanout_spec_t spec;
+        unsigned int users;             /* consumer mask */
+        unsigned char* buf;
+        bool ready;
+        bool failed;
+    } fanout_rendition_t;
+
+    typedef struct fanout_frame {
+        unsigned long src;
+        int width;
+        int height;
+        int stride;
+        long uvOffset;
+        int zoom;
+        unsigned int pending;           /* consumers that haven't returned the frame */
+        bool producing;
+        int count;
+        fanout_rendition_t rendition[FANOUT_RENDITION_MAX];
+    } fanout_frame_t;
+
+    typedef struct fanout_buf {
+        unsigned char* buf;
+        size_t size;
+        int refs;                       /* 0: free */
+    } fanout_buf_t;
+
+    typedef struct fanout_hold {
+        unsigned long src;
+        unsigned char* buf;             /* NULL: unused */
+    } fanout_hold_t;
+
+    static bool sameSpec(const fanout_spec_t* a, const fanout_spec_t* b);
+    static bool cpuScaled(const fanout_spec_t* spec, int width, int stride, long uvOffset);
+    fanout_frame_t* findFrame(unsigned long src);
+    void produce(fanout_frame_t* frame);
+    unsigned char* getBuf(size_t size);
+    void refBuf(unsigned char* buf);
+    void putBuf(unsigned char* buf);
+    void freeFrame(fanout_frame_t* frame);
+
+    bool mEnable;
+    fanout_spec_t mSpec[FANOUT_CONSUMER_MAX];
+    bool mSpecValid[FANOUT_CONSUMER_MAX];
+    fanout_frame_t mFrame[FANOUT_FRAME_MAX];
+    fanout_buf_t mPool[FANOUT_POOL_MAX];
+    fanout_hold_t mHold[FANOUT_CONSUMER_MAX][FANOUT_HOLD_MAX];
+    Mutex mLock;
+    Condition mReadyCond;
+
+    unsigned int mFrames;
+    unsigned int mShared;               /* renditions produced for more than one consumer */
+    unsigned int mSaved;                /* renders avoided */
+};
+
+}
+#endif
@@ -0,0 +1,313 @@
+#include "CameraFrameStats.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#if defined(HAVE_ARM_NEON) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define CAM_STATS_NEON  1
+#endif
+
+namespace android {
+
+/* clip counts and sum of one raw16 row, the histogram is done by the caller */
+static void stats_raw16_row(const unsigned short* p, int n, unsigned short low, unsigned short high,
+                            unsigned int* lowCnt, unsigned int* highCnt, uint64_t* sum)
+{
+    unsigned int lo = 0, hi = 0;
+    uint64_t s = 0;
+    int i = 0;
+#ifdef CAM_STATS_NEON
+    uint16x8_t vlow = vdupq_n_u16(low);
+    uint16x8_t vhigh = vdupq_n_u16(high);
+    uint16x8_t clo = vdupq_n_u16(0);
+    uint16x8_t chi = vdupq_n_u16(0);
+    uint32x4_t vs = vdupq_n_u32(0);
+    //lane counters are u16: flush before they can wrap
+    while (i + 8 <= n) {
+        int end = i + 8*8192;
+        if (end > n)
+            end = n;
+        for (; i + 8 <= end; i += 8) {
+            uint16x8_t v = vld1q_u16(p + i);
+            clo = vsubq_u16(clo, vcltq_u16(v, vlow));
+            chi = vsubq_u16(chi, vcgtq_u16(v, vhigh));
+            vs = vpadalq_u16(vs, v);
+        }
+        uint64x2_t r = vpaddlq_u32(vpaddlq_u16(clo));
+        lo += (unsigned int)(vgetq_lane_u64(r, 0) + vgetq_lane_u64(r, 1));
+        r = vpaddlq_u32(vpaddlq_u16(chi));
+        hi += (unsigned int)(vgetq_lane_u64(r, 0) + vgetq_lane_u64(r, 1));
+        r = vpaddlq_u32(vs);
+        s += vgetq_lane_u64(r, 0) + vgetq_lane_u64(r, 1);
+        clo = vdupq_n_u16(0);
+        chi = vdupq_n_u16(0);
+        vs = vdupq_n_u32(0);
+    }
+#endif
+    {
+        //rows are < 64K samples, a 32bit row sum keeps this loop vectorizable
+        unsigned int rs = 0;
+        for (; i < n; i++) {
+            unsigned short v = p[i];
+            lo += (v < low);
+            hi += (v > high);
+            rs += v;
+        }
+        s += rs;
+    }
+    *lowCnt += lo;
+    *highCnt += hi;
+    *sum += s;
+}
+
+/* 4 interleaved sub histograms so back to back equal samples don't serialize */
+static void stats_raw16_hist(const unsigned short* p, int n, unsigned int (*hist)[CAM_STATS_BINS])
+{
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        hist[0][p[i] >> 8]++;
+        hist[1][p[i + 1] >> 8]++;
+        hist[2][p[i + 2] >> 8]++;
+        hist[3][p[i + 3] >> 8]++;
+    }
+    for (; i < n; i++)
+        hist[0][p[i] >> 8]++;
+}
+
+CameraFrameStats::CameraFrameStats()
+    :mWorkers(1),
+     mPending(0)
+{
+}
+
+CameraFrameStats::~CameraFrameStats()
+{
+    destroy();
+}
+
+int CameraFrameStats::init(int workers)
+{
+    int i;
+
+    if (mWorkers > 1)
+        return 0;
+    if (workers <= 0)
+        workers = sysconf(_SC_NPROCESSORS_ONLN);
+    if (workers < 1)
+        workers = 1;
+    else if (workers > CAM_STATS_WORKER_MAX)
+        workers = CAM_STATS_WORKER_MAX;
+
+    //stripe 0 runs on the caller
+    for (i = 1; i < workers; i++) {
+        mWorker[i] = new FrameStatsThread(this, i);
+        mWorker[i]->run("CamFrameStats", CameraThreadConfig::priority("CamFrameStats"));
+    }
+    mWorkers = workers;
+    return 0;
+}
+
+void CameraFrameStats::destroy()
+{
+    Message_cam msg;
+    int i;
+
+    Mutex::Autolock lock(mRunLock);
+    for (i = 1; i < mWorkers; i++) {
+        msg.command = CMD_FRAMESTATS_EXIT;
+        mWorkerQ[i].put(&msg);
+        mWorker[i]->requestExitAndWait();
+        mWorker[i].clear();
+    }
+    mWorkers = 1;
+}
+
+void CameraFrameStats::workerThread(int id)
+{
+    Message_cam msg;
+    bool loop = true;
+
+    while (loop) {
+        memset(&msg, 0, sizeof(msg));
+        mWorkerQ[id].get(&msg);
+        switch (msg.command)
+        {
+            case CMD_FRAMESTATS_RUN:
+            {
+                runStripe((frame_stats_job_t*)msg.arg2, id);
+                Mutex::Autolock lock(mJobLock);
+                if (--mPending == 0)
+                    mJobCond.signal();
+                break;
+            }
+            case CMD_FRAMESTATS_EXIT:
+                loop = false;
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+void CameraFrameStats::runStripe(const frame_stats_job_t* job, int id)
+{
+    cam_frame_stats_t* part = &mPartial[id];
+    int y,i;
+
+    if (job->raw16) {
+        unsigned int (*hist)[CAM_STATS_BINS] = NULL;
+        unsigned short low = (job->low > 0xffff) ? 0xffff : job->low;
+        unsigned short high = (job->high > 0xffff) ? 0xffff : job->high;
+        int width = job->width;
+
+        if (job->flags & CAM_STATS_FLAG_HIST) {
+            hist = (unsigned int (*)[CAM_STATS_BINS])calloc(4, sizeof(*hist));
+            if (hist == NULL)
+                return;
+        }
+        for (y = job->rowStart[id]; y < job->rowStart[id + 1]; y++) {
+            const unsigned short* row;
+            //keep row pairs so all bayer phases are sampled
+            if (((y >> 1) % job->step) != 0)
+                continue;
+            row = (const unsigned short*)(job->src + (long)y*job->stride);
+            stats_raw16_row(row, width, low, high, &part->clip_low, &part->clip_high, &part->sum);
+            if (hist)
+                stats_raw16_hist(row, width, hist);
+            part->count += width;
+        }
+        if (hist) {
+            for (i = 0; i < CAM_STATS_BINS; i++)
+                part->hist[i] = hist[0][i] + hist[1][i] + hist[2][i] + hist[3][i];
+            free(hist);
+        }
+    } else {
+        int x, colStep = job->colStep;
+        bool hist = (job->flags & CAM_STATS_FLAG_HIST) != 0;
+        for (y = job->rowStart[id]; y < job->rowStart[id + 1]; y += job->step) {
+            const unsigned char* row = job->src + (long)y*job->stride;
+            for (x = 0; x < job->width; x += colStep) {
+                unsigned int v = row[x];
+                part->clip_low += (v < job->low);
+                part->clip_high += (v > job->high);
+                part->sum += v;
+                if (hist)
+                    part->hist[v]++;
+            }
+            part->count += (job->width + colStep - 1)/colStep;
+        }
+    }
+}
+
+int CameraFrameStats::run(frame_stats_job_t* job, int height, int rowAlign, cam_frame_stats_t* stats)
+{
+    Message_cam msg;
+    int i,j,stripes,units;
+
+    Mutex::Autolock lock(mRunLock);
+    units = (height + rowAlign - 1)/rowAlign;
+    stripes = (mWorkers > units) ? units : mWorkers;
+    if (stripes < 1)
+        stripes = 1;
+    for (i = 0; i <= stripes; i++) {
+        job->rowStart[i] = (units*i/stripes)*rowAlign;
+        if (job->rowStart[i] > height)
+            job->rowStart[i] = height;
+    }
+    memset(mPartial, 0, sizeof(cam_frame_stats_t)*stripes);
+
+    if (stripes > 1) {
+        mJobLock.lock();
+        mPending = stripes - 1;
+        mJobLock.unlock();
+        for (i = 1; i < stripes; i++) {
+            msg.command = CMD_FRAMESTATS_RUN;
+            msg.arg2 = (void*)job;
+            mWorkerQ[i].put(&msg);
+        }
+    }
+    runStripe(job, 0);
+    if (stripes > 1) {
+        Mutex::Autolock jobLock(mJobLock);
+        while (mPending > 0)
+            mJobCond.wait(mJobLock);
+    }
+
+    memset(stats, 0, sizeof(*stats));
+    for (i = 0; i < stripes; i++) {
+        stats->count += mPartial[i].count;
+        stats->clip_low += mPartial[i].clip_low;
+        stats->clip_high += mPartial[i].clip_high;
+        stats->sum += mPartial[i].sum;
+        if (job->flags & CAM_STATS_FLAG_HIST) {
+            for (j = 0; j < CAM_STATS_BINS; j++)
+                stats->hist[j] += mPartial[i].hist[j];
+        }
+    }
+    return 0;
+}
+
+int CameraFrameStats::computeRaw16(const unsigned short* src, int width, int height, int strideBytes, int rowStep,
+                                   unsigned int low, unsigned int high, int flags, cam_frame_stats_t* stats)
+{
+    frame_stats_job_t job;
+
+    if ((src == NULL) || (stats == NULL) || (width <= 0) || (height <= 0))
+        return -1;
+    job.raw16 = true;
+    job.src = (const unsigned char*)src;
+    job.width = width;
+    job.stride = strideBytes;
+    job.step = (rowStep < 1) ? 1 : rowStep;
+    job.colStep = 1;
+    job.low = low;
+    job.high = high;
+    job.flags = flags;
+    return run(&job, height, 2*job.step, stats);
+}
+
+int CameraFrameStats::computeLuma8(const unsigned char* src, int width, int height, int stride, int colStep, int rowStep,
+                                   unsigned int low, unsigned int high, int flags, cam_frame_stats_t* stats)
+{
+    frame_stats_job_t job;
+
+    if ((src == NULL) || (stats == NULL) || (width <= 0) || (height <= 0))
+        return -1;
+    job.raw16 = false;
+    job.src = src;
+    job.width = width;
+    job.stride = stride;
+    job.step = (rowStep < 1) ? 1 : rowStep;
+    job.colStep = (colStep < 1) ? 1 : colStep;
+    job.low = low;
+    job.high = high;
+    job.flags = flags;
+    return run(&job, height, job.step, stats);
+}
+
+unsigned int CameraFrameStats::mean(const cam_frame_stats_t* stats)
+{
+    return stats->count ? (unsigned int)(stats->sum/stats->count) : 0;
+}
+
+int CameraFrameStats::percentile(const cam_frame_stats_t* stats, int percent)
+{
+    uint64_t total = 0, target, acc = 0;
+    int i;
+
+    for (i = 0; i < CAM_STATS_BINS; i++)
+        total += stats->hist[i];
+    if (total == 0)
+        return -1;
+    target = (total*percent + 99)/100;
+    if (target == 0)
+        target = 1;
+    for (i = 0; i < CAM_STATS_BINS; i++) {
+        acc += stats->hist[i];
+        if (acc >= target)
+            return i;
+    }
+    return CAM_STATS_BINS - 1;
+}
+
+}
@@ -0,0 +1,98 @@
+#ifndef ANDROID_HARDWARE_CAMERA_FRAME_STATS_H
+#define ANDROID_HARDWARE_CAMERA_FRAME_STATS_H
+
+//histogram / clip / mean statistics on raw16 and 8bit luma planes
+#include <stdint.h>
+#include <utils/threads.h>
+#include "MessageQueue.h"
+#include "CameraThreadConfig.h"
+
+namespace android {
+
+#define CAM_STATS_BINS          256
+#define CAM_STATS_WORKER_MAX    4
+#define CAM_STATS_FLAG_HIST     0x1     /* clip counts and mean are always computed */
+
+typedef struct cam_frame_stats_s {
+    unsigned int hist[CAM_STATS_BINS];  /* raw16: sample >> 8, luma: sample */
+    unsigned int count;                 /* samples visited */
+    unsigned int clip_low;              /* samples < low */
+    unsigned int clip_high;             /* samples > high */
+    uint64_t sum;
+} cam_frame_stats_t;
+
+/*
+ * Raw16 planes are msb aligned (as the isp writes them) and subsampled by
+ * row pairs so every bayer phase stays in the statistics; luma planes are
+ * subsampled in both directions. Rows are striped across the workers, the
+ * caller's thread takes the first stripe. Without init() everything runs
+ * on the caller's thread.
+ */
+class CameraFrameStats {
+public:
+    enum FrameStatsCommands {
+        CMD_FRAMESTATS_RUN,
+        CMD_FRAMESTATS_EXIT
+    };
+
+    CameraFrameStats();
+    ~CameraFrameStats();
+    int init(int workers);
+    void destroy();
+    //rowStep: use one row pair out of rowStep
+    int computeRaw16(const unsigned short* src, int width, int height, int strideBytes, int rowStep,
+                     unsigned int low, unsigned int high, int flags, cam_frame_stats_t* stats);
+    //colStep/rowStep: use one byte out of colStep in a row, one row out of rowStep;
+    //width in bytes, so yuyv luma takes an even colStep
+    int computeLuma8(const unsigned char* src, int width, int height, int stride, int colStep, int rowStep,
+                     unsigned int low, unsigned int high, int flags, cam_frame_stats_t* stats);
+
+    static unsigned int mean(const cam_frame_stats_t* stats);
+    //smallest bin holding at least percent of the samples
+    static int percentile(const cam_frame_stats_t* stats, int percent);
+
+private:
+    typedef struct frame_stats_job {
+        bool raw16;
+        const unsigned char* src;
+        int width;
+        int stride;
+        int step;                       /* rows */
+        int colStep;                    /* luma bytes */
+        unsigned int low;
+        unsigned int high;
+        int flags;
+        int rowStart[CAM_STATS_WORKER_MAX + 1];
+    } frame_stats_job_t;
+
+    class FrameStatsThread : public Thread {
+        CameraFrameStats* mStats;
+        int mId;
+    public:
+        FrameStatsThread(CameraFrameStats* stats, int id)
+            : Thread(false), mStats(stats), mId(id) {}
+
+        virtual bool threadLoop() {
+            CameraThreadConfig::enter("CamFrameStats");
+            mStats->workerThread(mId);
+            return false;
+        }
+    };
+
+    void workerThread(int id);
+    int run(frame_stats_job_t* job, int height, int rowAlign, cam_frame_stats_t* stats);
+    void runStripe(const frame_stats_job_t* job, int id);
+
+    int mWorkers;
+    cam_frame_stats_t mPartial[CAM_STATS_WORKER_MAX];
+    Mutex mRunLock;                     /* one computation at a time */
+    Mutex mJobLock;
+    Condition mJobCond;
+    int mPending;
+
+    sp<FrameStatsThread> mWorker[CAM_STATS_WORKER_MAX];
+    MessageQueue mWorkerQ[CAM_STATS_WORKER_MAX];
+};
+
+}
+#endif
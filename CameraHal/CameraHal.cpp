@@ -21,6 +21,7 @@
 
 #include "CameraIspAdapter.h"
 #include "FakeCameraAdapter.h"
+#include "ReplayCameraAdapter.h"
 
 #ifdef TARGET_RK29
 #include "../libyuvtorgb/yuvtorgb.h"
@@ -83,6 +84,10 @@ CameraHal::CameraHal(int cameraId)
     mCamFd = -1;
     mCommandRunning = -1;
 	mCameraStatus = 0;
+    mShutterTime = 0;
+    mParamsFlatValid = false;
+    mParamsPending = false;
+    mParamsCoalesced = 0;
 
     #if (CONFIG_CAMERA_MEM == CAMERA_MEM_ION)
         mCamMemManager = new IonMemManager();
@@ -119,6 +124,9 @@ CameraHal::CameraHal(int cameraId)
     if (!strcmp(value, "fakecamera")) {
         LOGD("it is a fake camera!");
         mCameraAdapter = new CameraFakeAdapter(cameraId);
+    } else if (!strcmp(value, "replaycamera")) {
+        LOGD("it is a replay camera!");
+        mCameraAdapter = new CameraReplayAdapter(cameraId);
     } else {
 	    if((strcmp(gCamInfos[cameraId].driver,"uvcvideo") == 0)) {
 	        LOGD("it is a uvc camera!");
@@ -194,7 +202,7 @@ CameraHal::CameraHal(int cameraId)
     mEventNotifier->setFrameProvider(mCameraAdapter);
     //command thread
     mCommandThread = new CommandThread(this);
-	mCommandThread->run("CameraCmdThread", ANDROID_PRIORITY_URGENT_DISPLAY);
+	mCommandThread->run("CameraCmdThread",CameraThreadConfig::priority("CameraCmdThread"));
 
 	bool dataCbFrontMirror;
 	bool dataCbFrontFlip;
@@ -278,6 +286,7 @@ void CameraHal::updateParameters(CameraParameters & tmpPara)
 	LOG_FUNCTION_NAME
 
     tmpPara = mCameraAdapter->getParameters();
+    invalidateParameters();
 
 	LOG_FUNCTION_NAME_EXIT
 }
@@ -593,6 +602,7 @@ int CameraHal::takePicture()
     Message_cam msg;    
     Semaphore sem;
     Mutex::Autolock lock(mLock);
+    mShutterTime = systemTime(CLOCK_MONOTONIC);
     if ((mCommandThread != NULL)) {
         msg.command = CMD_CONTINUOS_PICTURE;
         sem.Create();
@@ -634,12 +644,98 @@ int CameraHal::cancelPicture()
     return NO_ERROR;
 }
 
+const char* CameraHal::flatParametersLocked()
+{
+    if (!mParamsFlatValid) {
+        mParamsFlat = mParamsPending ? mPendingParams.flatten() : mParameters.flatten();
+        mParamsFlatValid = true;
+    }
+    return mParamsFlat.string();
+}
+
+void CameraHal::invalidateParameters()
+{
+    Mutex::Autolock lock(mParamsLock);
+    mParamsFlatValid = false;
+}
+
+int CameraHal::coalesceParameters(const CameraParameters& params, unsigned int changed, const String8& flat)
+{
+    cam_param_area_t area;
+    Message_cam msg;
+    int zoom;
+
+    //checked here as the adapter would, the caller doesn't wait for it
+    if (changed & CAM_PARAM_ZOOM) {
+        zoom = params.getInt(CameraParameters::KEY_ZOOM);
+        if ((zoom < 0) || (zoom > params.getInt(CameraParameters::KEY_MAX_ZOOM)))
+            return -1;
+    }
+    if ((changed & CAM_PARAM_METERING_AREAS)
+        && !CameraParamDiff::parseArea(params.get(CameraParameters::KEY_METERING_AREAS), &area))
+        return -1;
+    if ((changed & CAM_PARAM_FOCUS_AREAS)
+        && !CameraParamDiff::parseArea(params.get(CameraParameters::KEY_FOCUS_AREAS), &area))
+        return -1;
+
+    Mutex::Autolock lock(mLock);
+    if ((mCommandThread == NULL) || !(mCameraStatus & STA_PREVIEW_CMD_RECEIVED))
+        return -1;
+    Mutex::Autolock paramsLock(mParamsLock);
+    mPendingParams = params;
+    mParamsFlat = flat;
+    mParamsFlatValid = true;
+    if (mParamsPending) {
+        //the queued update takes this one
+        mParamsCoalesced++;
+        LOG2("%s(%d): %d parameter updates coalesced",__FUNCTION__,__LINE__,mParamsCoalesced);
+        return 0;
+    }
+    mParamsPending = true;
+    msg.command = CMD_SET_PARAMETERS;
+    msg.arg1 = NULL;
+    msg.arg2 = NULL;
+    commandThreadCommandQ.put(&msg);
+    return 0;
+}
+
+int CameraHal::takePendingParameters(CameraParameters& params)
+{
+    Mutex::Autolock lock(mParamsLock);
+    if (!mParamsPending)
+        return -1;
+    //only the coalesced keys, anything else may have been changed by the hal meanwhile
+    params = mParameters;
+    CameraParamDiff::merge(params, mPendingParams, CAM_PARAM_COALESCE);
+    mParamsPending = false;
+    return 0;
+}
+
 int CameraHal::setParameters(const char* parameters)
 {
     CameraParameters params;
     String8 str_params(parameters);
+    unsigned int changed;
+
+    {
+        Mutex::Autolock lock(mParamsLock);
+        changed = CameraParamDiff::diff(flatParametersLocked(), parameters);
+    }
+    if (changed == 0) {
+        LOG2("%s(%d): parameters not changed",__FUNCTION__,__LINE__);
+        return 0;
+    }
 
     params.unflatten(str_params);
+    if (((changed & ~CAM_PARAM_COALESCE) == 0) && (coalesceParameters(params, changed, str_params) == 0))
+        return 0;
+
+    {
+        //this full set supersedes a queued coalesced one
+        Mutex::Autolock lock(mParamsLock);
+        mParamsPending = false;
+        mParamsFlatValid = false;
+    }
     return setParameters(params);
 }
 
@@ -708,16 +804,14 @@ int CameraHal::setParametersUnlock(const CameraParameters &params_set)
 
 char* CameraHal::getParameters()
 {
-    String8 params_str8;
     char* params_string;
-    const char * valstr = NULL;
-    CameraParameters mParams = mParameters;
-    
-    params_str8 = mParams.flatten();
+    const char* flat;
+    Mutex::Autolock lock(mParamsLock);
 
+    flat = flatParametersLocked();
     // camera service frees this string...
-    params_string = (char*) malloc(sizeof(char) * (params_str8.length()+1));
-    strcpy(params_string, params_str8.string());
+    params_string = (char*) malloc(sizeof(char) * (strlen(flat)+1));
+    strcpy(params_string, flat);
 
     ///Return the current set of parameters
 
@@ -783,6 +877,9 @@ int CameraHal::dump(int fd)
         mDisplayAdapter->dump();
     if(mEventNotifier)
         mEventNotifier->dump();
+    if(mCamMemManager)
+        mCamMemManager->dump();
+    CameraThreadConfig::dump();
 
     
     return 0;
@@ -887,6 +984,7 @@ void CameraHal::commandThread()
 	memset(&picinfo,0x0,sizeof(picture_info_s));
     int prevStatus = -1,drv_w,drv_h,picture_w,picture_h;
     int app_previw_w = 0,app_preview_h = 0;
+    int out_w = 0,out_h = 0;
     bool isRestartPreview = false;
     char prop_value[PROPERTY_VALUE_MAX];
     LOG_FUNCTION_NAME
@@ -910,6 +1008,16 @@ get_command:
                 prevStatus = mCameraAdapter->getCurPreviewState(&drv_w,&drv_h);
                 int prefered_w = app_previw_w, prefered_h = app_preview_h;
                 selectPreferedDrvSize(&prefered_w,&prefered_h,false);
+                out_w = app_previw_w;
+                out_h = app_preview_h;
+                //zsl: isp outputs picture size, display and callbacks scale it down; an unset hint isn't recording
+                const char* recording_hint = mParameters.get(CameraParameters::KEY_RECORDING_HINT);
+                if (mCameraAdapter->isZslEnabled() && (!recording_hint || strcmp(recording_hint,"true"))) {
+                    mParameters.getPictureSize(&out_w, &out_h);
+                    prefered_w = out_w;
+                    prefered_h = out_h;
+                    selectPreferedDrvSize(&prefered_w,&prefered_h,true);
+                }
                 
                 if(prevStatus){                    
                     //get preview size
@@ -930,7 +1038,7 @@ get_command:
                         //set new drv size;
                         drv_w = prefered_w;
                         drv_h = prefered_h;
-                        err=mCameraAdapter->startPreview(app_previw_w,app_preview_h,drv_w, drv_h, 0, false);
+                        err=mCameraAdapter->startPreview(out_w,out_h,drv_w, drv_h, 0, false);
                         if(mEventNotifier->msgEnabled(CAMERA_MSG_PREVIEW_FRAME))
                             mEventNotifier->startReceiveFrame();
                         if(mEventNotifier->msgEnabled(CAMERA_MSG_PREVIEW_METADATA))
@@ -952,7 +1060,7 @@ get_command:
                     //stop eventnotify
                     mEventNotifier->stopReceiveFrame();
                     //selet a proper preview size.
-                    err=mCameraAdapter->startPreview(app_previw_w,app_preview_h,drv_w, drv_h, 0, false);
+                    err=mCameraAdapter->startPreview(out_w,out_h,drv_w, drv_h, 0, false);
 					if(err != 0)
 						goto PREVIEW_START_OUT;
                     if(mEventNotifier->msgEnabled(CAMERA_MSG_PREVIEW_FRAME))
@@ -1030,6 +1138,13 @@ get_command:
                 LOG1("%s(%d): receive CMD_SET_PARAMETERS", __FUNCTION__,__LINE__);
                 //set parameters
                 CameraParameters* para = (CameraParameters*)msg.arg2;
+                CameraParameters coalesced;
+                if(para == NULL){
+                    //coalesced update, the latest one is applied; nothing if a full set replaced it
+                    if(takePendingParameters(coalesced) < 0)
+                        break;
+                    para = &coalesced;
+                }
                 if(mCameraAdapter->setParameters(*para,isRestartPreview) == 0){
                     //update parameters
                     updateParameters(mParameters);
@@ -1058,6 +1173,7 @@ get_command:
                 //reset pic num to 1
                 mParameters.set(KEY_CONTINUOUS_PIC_NUM,"1");
                 mCameraAdapter->setParameters(mParameters,isRestartPreview);
+                invalidateParameters();
                 if(msg.arg1)
                     ((Semaphore*)(msg.arg1))->Signal();
                 LOGD("%s(%d): CMD_PREVIEW_CAPTURE_CANCEL out",__FUNCTION__,__LINE__);
@@ -1117,6 +1233,9 @@ get_command:
 					else if((prefered_w == drv_w) && (prefered_h == drv_h)){
 						/*for soc caemra flash control when preview size == picture size*/
 						err = mCameraAdapter->flashcontrol();
+						//zsl: pick the kept frame closest to the shutter
+						if ((pic_num == 1) && mCameraAdapter->setZslShutter(mShutterTime))
+							LOG1("%s(%d): zsl picture",__FUNCTION__,__LINE__);
 					}
                         
                 }else{
@@ -99,11 +99,25 @@
 
 
 #include "CameraHal_Mem.h"
+#include "CameraFrameFanout.h"
+#include "CameraJpegThumb.h"
+#include "CameraMjpegDecoder.h"
+#include "CameraParamDiff.h"
+#include "CameraThreadConfig.h"
+#include "CameraFaceTracker.h"
+#include "CameraContrastAf.h"
 #include "CameraHal_Tracer.h"
 
 extern "C" int getCallingPid();
 extern "C" void callStack();
 extern "C" int cameraPixFmt2HalPixFmt(const char *fmt);
+//frame descriptors: stride 0 is the natural line of fmt, planes packed after each other
+extern "C" int camFrameDescInit(cam_frame_desc_t* desc, int fmt, void* vir, long fd,
+                                int width, int height, int stride);
+extern "C" void camFrameDescSetUv(cam_frame_desc_t* desc, long uv_offset);
+extern "C" int camFrameDescFromFrame(cam_frame_desc_t* desc, const FramInfo_s* frame);
+extern "C" bool camFrameDescPacked(const cam_frame_desc_t* desc);
+extern "C" void arm_nv12torgb565_desc(const cam_frame_desc_t* src, const cam_frame_desc_t* dst);
 extern "C" void arm_nv12torgb565(int width, int height, char *src, short int *dst,int dstbuf_w);
 extern "C" int rga_nv12torgb565(int src_width, int src_height, char *src, short int *dst, 
                                 int dstbuf_width,int dst_width,int dst_height);
@@ -111,14 +125,20 @@ extern "C" int rk_camera_yuv_scale_crop_ipp(int v4l2_fmt_src, int v4l2_fmt_dst,
 	            long srcbuf, long dstbuf,int src_w, int src_h,int dst_w, int dst_h,bool rotation_180);
 extern "C"  int YData_Mirror_Line(int v4l2_fmt_src, int *psrc, int *pdst, int w);
 extern "C"  int UVData_Mirror_Line(int v4l2_fmt_src, int *psrc, int *pdst, int w);
+extern "C"  int YuvData_Mirror_Flip_desc(const cam_frame_desc_t* frame, char *pline_tmp);
 extern "C"  int YuvData_Mirror_Flip(int v4l2_fmt_src, char *pdata, char *pline_tmp, int w, int h);
 extern "C" int YUV420_rotate(const unsigned char* srcy, int src_stride,  unsigned char* srcuv,
                    unsigned char* dsty, int dst_stride, unsigned char* dstuv,
                    int width, int height,int rotate_angle);
+extern "C"  int arm_yuv420_scale_desc(const cam_frame_desc_t* src_desc, const cam_frame_desc_t* dst_desc,
+									bool mirror,int zoom_val);
+//src_stride: bytes per source Y line, src_uv_offset: bytes from src to its UV plane; 0: packed nv12
 extern "C"  int arm_camera_yuv420_scale_arm(int v4l2_fmt_src, int v4l2_fmt_dst, 
-									char *srcbuf, char *dstbuf,int src_w, int src_h,int dst_w, int dst_h,bool mirror,int zoom_value);
+									char *srcbuf, char *dstbuf,int src_w, int src_h,int dst_w, int dst_h,bool mirror,int zoom_value,
+									int src_stride = 0,long src_uv_offset = 0);
 extern "C" char* getCallingProcess();
 
+extern "C" void arm_yuyv_to_nv12_desc(const cam_frame_desc_t* src, const cam_frame_desc_t* dst);
 extern "C" void arm_yuyv_to_nv12(int src_w, int src_h,char *srcbuf, char *dstbuf);
 
 extern "C" int cameraFormatConvert(int v4l2_fmt_src, int v4l2_fmt_dst, const char *android_fmt_dst, 
@@ -133,14 +153,18 @@ extern "C" int rga_nv12_scale_crop(
 		int dst_width,int dst_height,int zoom_val,
 		bool mirror,bool isNeedCrop,bool isDstNV21,
 		int dst_stride = 0,
-		bool is_viraddr_valid = false
+		bool is_viraddr_valid = false,
+		int src_stride = 0,
+		long src_uv_offset = 0
 		);
 #else
 extern "C" int rga_nv12_scale_crop(
 		int src_width, int src_height, char *src, short int *dst,
 		int dst_width,int dst_height,int zoom_val,
 		bool mirror,bool isNeedCrop,bool isDstNV21,
-		bool is_viraddr_valid = true
+		bool is_viraddr_valid = true,
+		int src_stride = 0,
+		long src_uv_offset = 0
 		);
 #endif
 
@@ -739,10 +763,97 @@ v1.0x4f.0:
      1) fix rk3366 android7.1 compile error.
   v1.0x50.2
      1) use arm to scale again after rga2 scale fail.
+  v1.0x50.3
+     1) add replay camera adapter(sys.cam_hal.type=replaycamera), stream recorded nv12/yuyv/mjpeg/raw files
+        through the normal preview path at recorded pace or as fast as possible.
+  v1.0x50.4
+     1) add benchmark/camerahal_bench, end to end preview/callback/video/jpeg/face pipeline benchmark
+        over the replay camera with stub sinks
+     2) replay camera registers itself as a virtual back camera when sys.cam_hal.type=replaycamera
+     3) face detection library can be overridden by sys_graphic.cam_hal.facelib
+  v1.0x50.5
+     1) add cpu multi-frame denoise engine(MutliFrameDenoiseCpu), block matching alignment + weighted
+        temporal merge on nv12 over a worker pool; isp frames are queued by reference instead of
+        blocking bufferCb. used when the gpu engine can't init, sys_graphic.cam_hal.mfd=auto|gpu|cpu
+     2) unlock and free burst frames consumed by multi-frame denoise
+  v1.0x50.6
+     1) isp tuning captures are streamed to one container per task by an async writer thread,
+        frames are packed out of the locked isp buffer and written in large aligned records,
+        exposure/gain/awb gains in each frame header. sys_graphic.cam_hal.tunestore=file keeps
+        the old pgm/ppm files, sys_graphic.cam_hal.tunedirect=1 uses O_DIRECT.
+  v1.0x50.7
+     1) CameraFrameStats: raw16/luma histogram, clip counts, mean and percentiles, neon clip/sum
+        kernels with rows striped across worker threads. ispTuneDesiredExp uses it instead of
+        the scalar per pixel loop; isLowIllumin logs subsampled preview luma statistics and
+        falls back to them when aec is stopped.
+  v1.0x50.8
+     1) sync caches per buffer and direction (BufferProvider::syncBuffer), flushBuffer
+        no longer flushes every buffer of its type; cache sync counters in dump
+  v1.0x50.9
+     1) keep released gralloc buffers in a process wide cache bounded by
+        sys_graphic.cam_hal.memcache (MB), reused on the next create
+  v1.0x50.0xa
+     1) remember HalMapMemory/HalGetMemoryMapFd results per isp buffer in bufferCb,
+        reset on connect/disconnect and stop
+  v1.0x50.0xb
+     1) display, video and preview datacb share cpu scaled renditions wanted by more than one
+        of them, rendered once per frame by a single pass scaler (sys_graphic.cam_hal.fanout).
+  v1.0x50.0xc
+     1) zsl (sys_graphic.cam_hal.zsl = frames kept, 0 off): isp preview runs at picture size and
+        takePicture encodes the kept frame closest to the shutter without restarting preview.
+  v1.0x50.0xd
+     1) burst capture pipelines scale and jpeg encode over CONFIG_CAMERA_PIC_SLOT_CNT slots,
+        isp frame is returned once scaled, PAUSE returns the queued frames it drains.
+  v1.0x50.0xe
+     1) jpeg output is allocated by the encode stage from a size estimate (resolution, quality), grown
+        and re-encoded on overflow, freed with the burst; no 22MB preallocation.
+  v1.0x50.0xf
+     1) exif/gps are filled in the prepare stage from a template built once; the thumbnail is area
+        downscaled and sw encoded by CameraJpegThumb and passed to the hw encoder as thumbData.
+  v1.0x50.0x10
+     1) uvc mjpeg falls back to a sw decoder (striped on restart intervals) when the
+        vpu decoder is missing, fails or can't keep up; sys_graphic.cam_hal.mjpeg_sw
+  v1.0x50.0x11
+     1) setParameters: skip unchanged parameter sets, coalesce zoom/area updates during preview,
+        cache the flattened parameters, only reapply the aec window when it changes.
+  v1.0x50.0x12
+     1) soc adapter: write the changed controls of a setParameters with one VIDIOC_S_EXT_CTRLS
+        per control class, look menu entries up through a hash built at init.
+  v1.0x50.0x13
+     1) isp engine buffers are leased to the consumers (CameraBufferLease), no FramInfo_s malloc per frame.
+     2) when the engine runs short, drop the oldest zsl frame and skip consumers holding a frame past
+        their deadline; the pool grows by the shortfall at the next setup (sys_graphic.cam_hal.lease_grow).
+  v1.0x50.0x14
+     1) isp nv12 frames keep their plane layout (FramInfo_s y_stride/uv_offset), the uv plane is no longer
+        copied after y in bufferCb; rga and arm helpers read the planes in place, only tuning and denoise get it packed.
+  v1.0x50.0x15
+     1) frames are described by cam_frame_desc_t (per plane pointer, offset and stride, fd, format, crop),
+        the arm scale, rgb565, mirror/flip and yuyv to nv12 helpers take it, the positional helpers wrap it.
+        v4l2 nv12/nv21 frames carry the line stride the driver reports.
+     2) display arm fallbacks, yuyv and rgb565 paths write display buffers at their gralloc stride.
+  v1.0x50.0x16
+     1) FramInfo_s carries cam_frame_meta_t: start of frame time, sequence, exposure, gain, lens position,
+        filled from the v4l2 buffer stamp in getFrame and from the engine buffer meta data in the isp bufferCb.
+     2) zsl picks the frame by its start of frame time; exposure, gain and lens position stay unknown (0, -1)
+        for isp frames, the engine buffer meta data doesn't carry them, the exif keeps the engine state.
+     3) video frames are sent with their capture time instead of the callback time.
+  v1.0x50.0x17
+     1) hal threads take class, nice, SCHED_FIFO priority and cpu mask from one table,
+        overridable by HalThread elements of cam_board.xml.
+     2) run queue wait per thread in the hal dump.
+  v1.0x50.0x18
+     1) face detection runs on a luma level of at most 320 pixels wide, the frame is returned once the level is built.
+     2) detections are spaced by the detector cost, the cpu contention and the scene motion,
+        faces are tracked by block matching in between and keep their id.
+     3) face reports come from preallocated slots, mapped to android coordinates by one affine per zoom.
+  v1.0x50.0x19
+     1) CameraContrastAf: contrast af for soc sensors without driver af and uvc cameras with absolute focus,
+        tenengrad measure with neon, coarse sweep and fine climb on the autofocus thread
+     2) AndroidZoneMapping moves to CameraAdapter
 */
 
 
-#define CONFIG_CAMERAHAL_VERSION KERNEL_VERSION(1, 0x50, 0x2)
+#define CONFIG_CAMERAHAL_VERSION KERNEL_VERSION(1, 0x50, 0x19)
 
 
 /*  */
@@ -778,6 +889,7 @@ v1.0x4f.0:
 #define CONFIG_CAMERA_VIDEO_BUF_CNT 4
 #define CONFIG_CAMERA_VIDEOENC_BUF_CNT		3
 #define CONFIG_CAMERA_ISP_BUF_REQ_CNT		8
+#define CONFIG_CAMERA_PIC_SLOT_CNT		3	/* pictures in flight between scale and jpeg encode */
 
 #define CONFIG_CAMERA_UVC_MJPEG_SUPPORT 1
 #define CONFIG_CAMERA_UVC_MANEXP 1
@@ -801,6 +913,9 @@ v1.0x4f.0:
 #define CAMERAHAL_CAMBOARDXML_PARSER_PROPERTY_KEY       "sys_graphic.cam_camboard.ver"
 #define CAMERAHAL_TRACE_LEVEL_PROPERTY_KEY              "sys_graphic.cam_trace"
 #define CAMERAHAL_CAM_OTP_PROPERTY_KEY					"sys_graphic.cam_otp"
+#define CAMERAHAL_FACEDETECT_LIB_PROPERTY_KEY           "sys_graphic.cam_hal.facelib"
+#define CAMERAHAL_FACEDETECT_LIB_DEFAULT                "libcam_facedetection.so"
+#define CAMERAHAL_MFD_ENGINE_PROPERTY_KEY               "sys_graphic.cam_hal.mfd"        /* auto | gpu | cpu */
 
 
 #define CAMERA_PMEM_NAME                     "/dev/pmem_cam"
@@ -894,6 +1009,8 @@ class FrameProvider
 {
 public:
    virtual int returnFrame(long index,int cmd)=0;
+   //shared renditions of the frames, NULL if the provider doesn't plan them
+   virtual CameraFrameFanout* getFrameFanout(){return NULL;}
    virtual ~FrameProvider(){};
    FrameProvider(){};
    FramInfo_s mPreviewFrameInfos[CONFIG_CAMERA_PREVIEW_BUF_CNT];
@@ -919,6 +1036,8 @@ public:
     long getBufVirAddr(int bufindex);
     int getBufShareFd(int bufindex);
 	int flushBuffer(int bufindex);
+    //offset/len are relative to the buffer, len 0: whole buffer
+    int syncBuffer(int bufindex,unsigned int offset,unsigned int len,cache_sync_dir_t dir);
     BufferProvider(MemManagerBase* memManager):mBufInfo(NULL),mCamBuffer(memManager){}
     virtual ~BufferProvider(){mCamBuffer = NULL;mBufInfo = NULL;}
 
@@ -1017,6 +1136,10 @@ public:
 	virtual void getCameraParamInfo(cameraparam_info_s &paraminfo);
 	virtual bool getFlashStatus();
     virtual int selectPreferedDrvSize(int *width,int * height,bool is_capture){ return 0;}
+    //zsl: preview runs at capture size and recent frames are kept for takePicture
+    virtual bool isZslEnabled(){ return false;}
+    //false: no kept frame, take the next one as usual
+    virtual bool setZslShutter(nsecs_t shutter){ return false;}
     virtual int faceNotify(struct RectFace* faces, int* num);
     virtual void debugShowFPS();
     virtual int flashcontrol();
@@ -1043,6 +1166,17 @@ protected:
     //define  the frame info ,such as w, h ,fmt ,dealflag(preview callback ? display ? video enc ? picture?)
     virtual int reprocessFrame(FramInfo_s* frame);
     virtual int adapterReturnFrame(long index,int cmd);
+    //dst_addr < 0: the vpu can't reach dst. Returns 1 if the cpu wrote dst
+    int mjpegDecodeFrame(unsigned char* src, unsigned int size, char* dst, long dst_addr, int stride, int sliceHeight);
+    //maps an android zone on the preview image to the driver image, zone: lx ty rx dy
+    int AndroidZoneMapping(
+			const char* tag,
+			__s32 pre_w,
+			__s32 pre_h,
+			__s32 drv_w,
+			__s32 drv_h,
+			bool bPre2Drv,
+			__s32 *zone);
 
 private:
     class CameraPreviewThread :public Thread
@@ -1054,6 +1188,7 @@ private:
             : Thread(false), mPreivewCameraAdapter(adapter) { }
 
         virtual bool threadLoop() {
+            CameraThreadConfig::enter("CameraPreviewThread");
             mPreivewCameraAdapter->previewThread();
 
             return false;
@@ -1068,6 +1203,7 @@ private:
             : Thread(false), mCameraAdapter(hw) { }
 
         virtual bool threadLoop() {
+            CameraThreadConfig::enter("AutoFocusThread");
             mCameraAdapter->autofocusThread();
 
             return false;
@@ -1093,6 +1229,7 @@ protected:
     BufferProvider* mPreviewBufProvider;
     int mCamDrvWidth;
     int mCamDrvHeight;
+    int mCamDrvStride;      //bytes per line from VIDIOC_S_FMT, 0: not reported
     int mCamPreviewH ;
     int mCamPreviewW ;
     int mVideoWidth;
@@ -1122,6 +1259,7 @@ protected:
 
     mjpeg_interface_t mMjpegDecoder;
     void* mLibstageLibHandle;
+    CameraMjpegDecoder mMjpegSwDecoder;
 
     int mZoomVal;
     int mZoomMin;
@@ -1130,6 +1268,9 @@ protected:
     
     int mCamFd;
     int mCamId;
+
+    //hal af for lenses the driver only positions, fed by previewThread
+    CameraContrastAf mContrastAf;
 };
 
 //soc camera adapter
@@ -1184,6 +1325,24 @@ private:
     struct v4l2_querymenu mFlashMode_menu[20];
     int mFlashMode_number;
 
+    //(control id, menu name) -> menu entry, open addressing over the menus above
+    #define SOC_MENU_HASH_SIZE      128
+    const struct v4l2_querymenu* mMenuHash[SOC_MENU_HASH_SIZE];
+    void menuHashAdd(const struct v4l2_querymenu* menu);
+    const struct v4l2_querymenu* menuFind(__u32 id, const char* name);
+
+    //controls changed by one cameraConfig, written with one VIDIOC_S_EXT_CTRLS per class
+    #define SOC_CTRL_BATCH_MAX      10
+    typedef struct soc_ctrl_batch {
+        struct v4l2_ext_control ctrl[SOC_CTRL_BATCH_MAX];
+        __u32 ctrlClass[SOC_CTRL_BATCH_MAX];
+        const char* label[SOC_CTRL_BATCH_MAX];
+        const char* value[SOC_CTRL_BATCH_MAX];
+        int count;
+    } soc_ctrl_batch_t;
+    void ctrlQueue(soc_ctrl_batch_t* batch, __u32 ctrlClass, __u32 id, __s32 val, const char* label, const char* value);
+    int ctrlApply(soc_ctrl_batch_t* batch);
+
 	//TAE & TAF
 	__u32 m_focus_mode;
 	static const __u32 focus_fixed = 0xFFFFFFFF;
@@ -1191,14 +1350,6 @@ private:
 	__s32 m_taf_roi[4];
 
 	int GetAFParameters(const CameraParameters params);
-	int AndroidZoneMapping(
-			const char* tag,
-			__s32 pre_w,
-			__s32 pre_h,
-			__s32 drv_w,
-			__s32 drv_h,
-			bool bPre2Drv,
-			__s32 *zone);
 
 };
 
@@ -1215,10 +1366,13 @@ public:
     virtual int setParameters(const CameraParameters &params_set,bool &isRestartValue);
     virtual void initDefaultParameters(int camFd);
     virtual int reprocessFrame(FramInfo_s* frame);
+    virtual int cameraAutoFocus(bool auto_trig_only);
 
 
 private:
     int cameraConfig(const CameraParameters &tmpparams,bool isInit,bool &isRestartValue);
+    //focus areas as set by the app, mapped to the driver image when a search starts
+    __s32 mAfZone[4];
     
     int mCamDriverFrmWidthMax;
     int mCamDriverFrmHeightMax;
@@ -1256,6 +1410,7 @@ class DisplayAdapter//:public CameraHal_Tracer
             : Thread(false), mDisplayAdapter(disadap){}
 
         virtual bool threadLoop() {
+            CameraThreadConfig::enter("DisplayThread");
             mDisplayAdapter->displayThread();
 
             return false;
@@ -1391,6 +1546,27 @@ typedef struct cameraparam_info{
 	cameraparam_info_s cameraparam; 
  }picture_info_s;
 
+//one picture between the prepare(scale) and jpeg encode stage
+typedef struct picture_slot{
+    int index;                  /* raw & jpeg buffer index */
+    FramInfo_s* frame;          /* NULL once the isp frame is returned */
+    long frame_used_flag;
+    long input_phy;
+    long input_vir;
+    unsigned int pictureSize;
+    int encodetype;
+    picture_info_s info;
+    int thumbwidth;
+    int thumbheight;
+    int thumbquality;
+    cam_thumb_job_t thumbJob;
+    RkExifInfo exif;
+    RkGPSInfo gps;
+    bool hasGps;
+    char makernote[640];
+    char gpsmethod[45];
+ }picture_slot_t;
+
 
 //picture encode used
 struct CamCaptureInfo_s
@@ -1488,6 +1664,7 @@ private:
 			: Thread(false),mAppMsgNotifier(hw) { }
 	
 		virtual bool threadLoop() {
+			CameraThreadConfig::enter("CamHalAppEventThread");
 			mAppMsgNotifier->eventThread();
 	
 			return false;
@@ -1510,6 +1687,7 @@ private:
 			: Thread(false),mAppMsgNotifier(hw) { }
 	
 		virtual bool threadLoop() {
+			CameraThreadConfig::enter("CamHalAppFaceThread");
 			mAppMsgNotifier->faceDetectThread();
 	
 			return false;
@@ -1531,8 +1709,28 @@ private:
 			: Thread(false),mAppMsgNotifier(hw) { }
 	
 		virtual bool threadLoop() {
+			CameraThreadConfig::enter("CamHalAppEncThread");
 			mAppMsgNotifier->encProcessThread();
 	
+			return false;
+		}
+	};
+	class JpegEncodeThread : public Thread {
+	public:
+	    enum JPEGENC_THREAD_CMD{
+            CMD_JPEGENC_SLOT,
+            CMD_JPEGENC_EXIT,
+	    };
+	protected:
+		AppMsgNotifier* mAppMsgNotifier;
+	public:
+		JpegEncodeThread(AppMsgNotifier* hw)
+			: Thread(false),mAppMsgNotifier(hw) { }
+	
+		virtual bool threadLoop() {
+			CameraThreadConfig::enter("CamHalJpegEncThread");
+			mAppMsgNotifier->jpegEncodeThread();
+	
 			return false;
 		}
 	};
@@ -1558,6 +1756,7 @@ private:
 			: Thread(false),mAppMsgNotifier(hw) { }
 	
 		virtual bool threadLoop() {
+			CameraThreadConfig::enter("CamHalCallbckThread");
 			mAppMsgNotifier->callbackThread();
 	
 			return false;
@@ -1565,6 +1764,7 @@ private:
     };
 
 	friend class EncProcessThread;
+	friend class JpegEncodeThread;
 public:
     AppMsgNotifier(CameraAdapter *camAdp);
     ~AppMsgNotifier();
@@ -1604,7 +1804,7 @@ public:
 	void callback_compressed_image(camera_memory_t* frame);
 	void callback_notify_error();
 	void callback_preview_metadata(camera_memory_t* datacbFrameMem, camera_frame_metadata_t *facedata, struct RectFace *faces);
-	void callback_video_frame(camera_memory_t* video_frame);
+	void callback_video_frame(camera_memory_t* video_frame, int index, nsecs_t timestamp);
     int enableMsgType(int32_t msgtype);
     int disableMsgType(int32_t msgtype);
     void setCallbacks(camera_notify_callback notify_cb,
@@ -1633,18 +1833,29 @@ public:
 private:
 
    void encProcessThread();
+   void jpegEncodeThread();
    void eventThread();
    void faceDetectThread();
    void callbackThread();
 
-	int captureEncProcessPicture(FramInfo_s* frame);
+	int capturePreparePicture(FramInfo_s* frame, long frame_used_flag, int pending);
+	int captureEncodePicture(picture_slot_t* slot);
+	picture_slot_t* pictureSlotGet(unsigned int pictureSize, int pending);
+	void pictureSlotPut(picture_slot_t* slot);
+	void pictureSlotFreeLocked();
+	int jpegOutBufGet(int size, long* phy, long* vir);
     int processPreviewDataCb(FramInfo_s* frame);
     int processVideoCb(FramInfo_s* frame);
+    const unsigned char* acquireSharedFrame(FramInfo_s* frame, int consumer, int width, int height, int fmt, bool mirror);
+    void publishSharedSpec(int consumer, int width, int height, int fmt, bool mirror);
+    void publishDataCbSpec();
     int processFaceDetect(FramInfo_s* frame, long frame_used_flag);
     
     int copyAndSendRawImage(void *raw_image, int size);
     int copyAndSendCompressedImage(void *compressed_image, int size);
-    int Jpegfillexifinfo(RkExifInfo *exifInfo,picture_info_s &params);
+    bool sendCompressedImage(int fd, int size);
+    void buildExifTemplate();
+    int Jpegfillexifinfo(RkExifInfo *exifInfo,picture_info_s &params,char *makernote,int makernoteSize);
     int Jpegfillgpsinfo(RkGPSInfo *gpsInfo,picture_info_s &params);
     int initializeFaceDetec(int width,int height);
     void deInitializeFaceDetec();
@@ -1658,6 +1869,23 @@ private:
     int mEncPictureNum;
     Mutex mPictureLock;
 
+    //burst pipeline: a slot is busy from scale until its jpeg is sent
+    picture_slot_t mPicSlot[CONFIG_CAMERA_PIC_SLOT_CNT];
+    int mPicSlotCnt;            /* raw/jpeg buffers allocated */
+    int mPicSlotBusy;
+    unsigned int mPicSlotSize;
+    int mPicSeqCnt;
+    nsecs_t mPicSeqStart;
+    Mutex mPicSlotLock;
+    Condition mPicSlotCond;
+    int mJpegOutSize;           /* one jpeg output, sized per picture and grown on overflow */
+    int mJpegOutRetry;
+    char* mMirrorLine[CONFIG_CAMERA_PIC_SLOT_CNT];  /* mirror/flip line of each slot, kept between pictures */
+    int mMirrorLineSize[CONFIG_CAMERA_PIC_SLOT_CNT];
+    CameraJpegThumb mJpegThumb; /* thumbnail of the next picture while the hw encodes */
+    RkExifInfo mExifTemplate;
+    bool mExifTemplateValid;
+
     Mutex mRecordingLock;
 //    bool mRecordingRunning;
     int mRecordW;
@@ -1676,6 +1904,7 @@ private:
     bool mFaceDetecInit;
     void* mFaceContext;
     bool mFaceDetectionDone;
+    CameraFaceTracker mFaceTracker;
 
     //applied to this situation: msgtype CAMERA_MSG_PREVIEW_FRAME is enabled
     //but hal status isn't allowed to send this msg,
@@ -1684,6 +1913,7 @@ private:
 
     sp<CameraAppMsgThread> mCameraAppMsgThread;
     sp<EncProcessThread> mEncProcessThread;
+    sp<JpegEncodeThread> mJpegEncodeThread;
     sp<CameraAppFaceDetThread> mFaceDetThread;
     sp<CameraAppCallbackThread> mCallbackThread;
 	
@@ -1699,11 +1929,14 @@ private:
     void  *mCallbackCookie;
 
     MessageQueue encProcessThreadCommandQ;
+    MessageQueue jpegEncThreadCommandQ;
     MessageQueue eventThreadCommandQ;
     MessageQueue faceDetThreadCommandQ;
 	MessageQueue callbackThreadCommandQ;
 	
     camera_memory_t* mVideoBufs[CONFIG_CAMERA_VIDEO_BUF_CNT];
+    nsecs_t mVideoFrameTime[CONFIG_CAMERA_VIDEO_BUF_CNT];   /* stamp sent with the video buffer */
+    nsecs_t mVideoLastTime;
 
     char mPreviewDataFmt[30];
     int mPreviewDataW;
@@ -2017,6 +2250,7 @@ private:
             : Thread(false), mHardware(hw) { }
 
         virtual bool threadLoop() {
+            CameraThreadConfig::enter("CameraCmdThread");
             mHardware->commandThread();
 
             return false;
@@ -2031,6 +2265,17 @@ private:
 
    void updateParameters(CameraParameters & tmpPara);
    CameraParameters mParameters;
+   //flattened parameters, from mPendingParams while a coalesced update is queued
+   const char* flatParametersLocked();
+   void invalidateParameters();
+   int coalesceParameters(const CameraParameters& params, unsigned int changed, const String8& flat);
+   int takePendingParameters(CameraParameters& params);
+   Mutex mParamsLock;
+   String8 mParamsFlat;
+   bool mParamsFlatValid;
+   CameraParameters mPendingParams;
+   bool mParamsPending;
+   unsigned int mParamsCoalesced;
 
 
    mutable Mutex mLock;        // API lock -- all public methods
@@ -2038,6 +2283,7 @@ private:
   // bool mPreviewCmdReceived;
    int mCamFd;
    unsigned int mCameraStatus;
+   nsecs_t mShutterTime;       /* takePicture() call, for zsl */
    int mCamId;
    sp<SensorListener> mSensorListener;
 };
@@ -258,27 +258,105 @@ extern "C" void arm__scale_crop_nv12torgb565(int srcW, int srcH,int dstW,int dst
 }
 
 
-extern "C" void arm_nv12torgb565(int width, int height, char *src, short int *dst,int dstbuf_w)
+extern "C" int camFrameDescInit(cam_frame_desc_t* desc, int fmt, void* vir, long fd,
+                                int width, int height, int stride)
+{
+    unsigned char* base = (unsigned char*)vir;
+    int i;
+
+    memset(desc, 0, sizeof(cam_frame_desc_t));
+    desc->fmt = fmt;
+    desc->width = width;
+    desc->height = height;
+    desc->fd = fd;
+    switch (fmt) {
+        case V4L2_PIX_FMT_NV12:
+        case V4L2_PIX_FMT_NV21:
+            desc->planes = 2;
+            desc->plane[0].stride = stride ? stride : width;
+            desc->plane[1].stride = desc->plane[0].stride;
+            desc->plane[1].offset = (long)desc->plane[0].stride*height;
+            break;
+        case V4L2_PIX_FMT_YUV420:
+            desc->planes = 3;
+            desc->plane[0].stride = stride ? stride : width;
+            desc->plane[1].stride = desc->plane[0].stride/2;
+            desc->plane[2].stride = desc->plane[0].stride/2;
+            desc->plane[1].offset = (long)desc->plane[0].stride*height;
+            desc->plane[2].offset = desc->plane[1].offset + (long)desc->plane[1].stride*height/2;
+            break;
+        case V4L2_PIX_FMT_YUYV:
+        case V4L2_PIX_FMT_RGB565:
+            desc->planes = 1;
+            desc->plane[0].stride = stride ? stride : width*2;
+            break;
+        default:
+            LOGE("%s(%d): format 0x%x can't be described",__FUNCTION__,__LINE__,fmt);
+            return -1;
+    }
+    for (i = 0; i < desc->planes; i++)
+        desc->plane[i].vir = base ? (base + desc->plane[i].offset) : NULL;
+    return 0;
+}
+
+extern "C" void camFrameDescSetUv(cam_frame_desc_t* desc, long uv_offset)
+{
+    if ((desc->planes != 2) || (uv_offset == 0))
+        return;
+    if (desc->plane[0].vir)
+        desc->plane[1].vir = desc->plane[0].vir - desc->plane[0].offset + uv_offset;
+    desc->plane[1].offset = uv_offset;
+}
+
+extern "C" int camFrameDescFromFrame(cam_frame_desc_t* desc, const FramInfo_s* frame)
+{
+    if (camFrameDescInit(desc, frame->frame_fmt, (void*)frame->vir_addr, (long)frame->phy_addr,
+                         frame->frame_width, frame->frame_height, frame->y_stride))
+        return -1;
+    camFrameDescSetUv(desc, (long)frame->uv_offset);
+    return 0;
+}
+
+//planes in the order and at the places a stride-less helper expects them
+extern "C" bool camFrameDescPacked(const cam_frame_desc_t* desc)
+{
+    int line = (desc->planes == 1) ? desc->plane[0].stride : desc->width;
+
+    if (desc->crop.left || desc->crop.top
+        || (DESC_CROP_W(desc) != desc->width) || (DESC_CROP_H(desc) != desc->height))
+        return false;
+    if ((desc->planes > 1) && ((desc->plane[0].stride != line)
+        || (desc->plane[1].offset != (long)line*desc->height)))
+        return false;
+    if ((desc->planes > 2) && (desc->plane[2].offset != desc->plane[1].offset + (long)line*desc->height/4))
+        return false;
+    return true;
+}
+
+extern "C" void arm_nv12torgb565_desc(const cam_frame_desc_t* src, const cam_frame_desc_t* dst)
 {
     int line, col;
-    int y, u, v, yy, vr, ug, vg, ub;
+    int u, v, yy, vr, ug, vg, ub;
     int r, g, b;
-    char *py, *pu, *pv;    
-
-    py = src;
-    pu = py + (width * height);
-    pv = pu + 1;
-    y = *py++;
-    yy = y << 8;
-    u = *pu - 128;
-    ug = 88 * u;
-    ub = 454 * u;
-    v = *pv - 128;
-    vg = 183 * v;
-    vr = 359 * v;
-    
+    int width = DESC_CROP_W(src), height = DESC_CROP_H(src);
+    unsigned char *py, *puv;
+    short int *pdst;
+
+    u = v = 0;
     for (line = 0; line < height; line++) {
+        py = src->plane[0].vir + (src->crop.top + line)*src->plane[0].stride + src->crop.left;
+        puv = src->plane[1].vir + ((src->crop.top + line)>>1)*src->plane[1].stride + (src->crop.left & ~0x01);
+        pdst = (short int*)(dst->plane[0].vir + line*dst->plane[0].stride);
         for (col = 0; col < width; col++) {
+            if ((col & 1) == 0) {
+                u = puv[col] - 128;
+                v = puv[col+1] - 128;
+            }
+            yy = py[col] << 8;
+            ug = 88 * u;
+            ub = 454 * u;
+            vg = 183 * v;
+            vr = 359 * v;
             r = (yy +      vr) >> 8;
             g = (yy - ug - vg) >> 8;
             b = (yy + ub     ) >> 8;
@@ -289,32 +367,19 @@ extern "C" void arm_nv12torgb565(int width, int height, char *src, short int *ds
             if (b < 0)   b = 0;
             if (b > 255) b = 255;
             
-            *dst++ = (((__u16)r>>3)<<11) | (((__u16)g>>2)<<5) | (((__u16)b>>3)<<0);
-
-            y = *py++;
-            yy = y << 8;
-            if (col & 1) {
-                pu += 2;
-                pv = pu+1;
-                u = *pu - 128;
-                ug =   88 * u;
-                ub = 454 * u;
-                v = *pv - 128;
-                vg = 183 * v;
-                vr = 359 * v;
-            }
-        }
-        dst += dstbuf_w - width;
-        if ((line & 1) == 0) { 
-            //even line: rewind
-            pu -= width;
-            pv = pu+1;
+            *pdst++ = (((__u16)r>>3)<<11) | (((__u16)g>>2)<<5) | (((__u16)b>>3)<<0);
         }
     }
 }
 
+extern "C" void arm_nv12torgb565(int width, int height, char *src, short int *dst,int dstbuf_w)
+{
+    cam_frame_desc_t src_desc, dst_desc;
 
-
+    camFrameDescInit(&src_desc, V4L2_PIX_FMT_NV12, src, -1, width, height, 0);
+    camFrameDescInit(&dst_desc, V4L2_PIX_FMT_RGB565, dst, -1, width, height, dstbuf_w*2);
+    arm_nv12torgb565_desc(&src_desc, &dst_desc);
+}
 
 extern "C" int rga_nv12torgb565(int src_width, int src_height, char *src, short int *dst, int dstbuf_width,int dst_width,int dst_height)
 {
@@ -418,7 +483,8 @@ extern "C" int rga_nv12torgb565(int src_width, int src_height, char *src, short
 }
 
 extern "C"  int arm_camera_yuv420_scale_arm(int v4l2_fmt_src, int v4l2_fmt_dst, 
-									char *srcbuf, char *dstbuf,int src_w, int src_h,int dst_w, int dst_h,bool mirror,int zoom_val);
+									char *srcbuf, char *dstbuf,int src_w, int src_h,int dst_w, int dst_h,bool mirror,int zoom_val,
+									int src_stride,long src_uv_offset);
 
 extern "C" int util_get_gralloc_buf_fd(buffer_handle_t handle,int* fd){
 	int err = 0;
@@ -448,13 +514,16 @@ extern "C" int util_get_gralloc_buf_fd(buffer_handle_t handle,int* fd){
 extern "C" int rga_nv12_scale_crop(
 		int src_width, int src_height, char *src_fd, short int *dst_fd, 
 		int dst_width,int dst_height,int zoom_val,bool mirror,
-		bool isNeedCrop,bool isDstNV21,int dst_stride,bool is_viraddr_valid)
+		bool isNeedCrop,bool isDstNV21,int dst_stride,bool is_viraddr_valid,
+		int src_stride,long src_uv_offset)
 {
     int ret = 0;
 	rga_info_t src,dst;
 	int src_cropW,src_cropH,dst_cropW,dst_cropH,zoom_cropW,zoom_cropH;
 	int ratio = 0;
 	int src_top_offset=0,src_left_offset=0,dst_top_offset=0,dst_left_offset=0,zoom_top_offset=0,zoom_left_offset=0;
+	int src_wstride = src_stride ? src_stride : src_width;
+	int src_hstride = src_height;
 	
 	RockchipRga& rkRga(RockchipRga::get());
 	
@@ -499,6 +568,16 @@ extern "C" int rga_nv12_scale_crop(
 			goto failed;
 	}
 
+	//rga takes the uv plane at wstride*hstride, a gap of whole lines is a taller virtual height
+	if (src_uv_offset) {
+		if (src_uv_offset % src_wstride) {
+			LOG1("%s(%d): uv plane %ld bytes apart isn't line aligned, switch to arm",__FUNCTION__,__LINE__,src_uv_offset);
+			ret = -1;
+			goto failed;
+		}
+		src_hstride = src_uv_offset / src_wstride;
+	}
+
 	//2) use rga
 
 	//need crop ? when cts FOV,don't crop
@@ -524,7 +603,7 @@ extern "C" int rga_nv12_scale_crop(
 	}
 
 	rga_set_rect(&src.rect, zoom_left_offset,zoom_top_offset,
-		zoom_cropW,zoom_cropH,src_width,src_height,HAL_PIXEL_FORMAT_YCrCb_NV12);
+		zoom_cropW,zoom_cropH,src_wstride,src_hstride,HAL_PIXEL_FORMAT_YCrCb_NV12);
 	if (isDstNV21)
 		rga_set_rect(&dst.rect, 0,0,dst_width,dst_height,
 				dst_stride ? dst_stride : dst_width,
@@ -548,7 +627,8 @@ failed:
 }
 #else
 extern "C" int rga_nv12_scale_crop(int src_width, int src_height, char *src, short int *dst, 
-										int dst_width,int dst_height,int zoom_val,bool mirror,bool isNeedCrop,bool isDstNV21,bool is_viraddr_valid)
+										int dst_width,int dst_height,int zoom_val,bool mirror,bool isNeedCrop,bool isDstNV21,bool is_viraddr_valid,
+										int src_stride,long src_uv_offset)
 {
     int rgafd = -1,ret = -1;
 	int scale_times_w = 0,scale_times_h = 0,h = 0,w = 0;
@@ -558,25 +638,35 @@ extern "C" int rga_nv12_scale_crop(int src_width, int src_height, char *src, sho
 	int src_cropW,src_cropH,dst_cropW,dst_cropH,zoom_cropW,zoom_cropH;
 	int ratio = 0;
 	int src_top_offset=0,src_left_offset=0,dst_top_offset=0,dst_left_offset=0,zoom_top_offset=0,zoom_left_offset=0;
+	int src_vir_w = src_stride ? src_stride : src_width;
+	int src_vir_h = src_height;
 
 	/*has something wrong with rga of rk312x mirror operation*/
 	#if defined(TARGET_RK312x)
 		if(mirror){
 			return arm_camera_yuv420_scale_arm(V4L2_PIX_FMT_NV12, (isDstNV21 ? V4L2_PIX_FMT_NV21:V4L2_PIX_FMT_NV12), 
-				src, (char *)dst,src_width, src_height,dst_width, dst_height,mirror,zoom_val);
+				src, (char *)dst,src_width, src_height,dst_width, dst_height,mirror,zoom_val,src_stride,src_uv_offset);
 		}
 	#endif 
 	/*rk3188 do not support yuv to yuv scale by rga*/
 	#if defined(TARGET_RK3188)
 		return arm_camera_yuv420_scale_arm(V4L2_PIX_FMT_NV12, (isDstNV21 ? V4L2_PIX_FMT_NV21:V4L2_PIX_FMT_NV12), 
-			src, (char *)dst,src_width, src_height,dst_width, dst_height,mirror,zoom_val);
+			src, (char *)dst,src_width, src_height,dst_width, dst_height,mirror,zoom_val,src_stride,src_uv_offset);
 	#endif
 	
 	if((dst_width > RGA_VIRTUAL_W) || (dst_height > RGA_VIRTUAL_H)){
 		LOGE("%s(%d):(dst_width > RGA_VIRTUAL_W) || (dst_height > RGA_VIRTUAL_H), switch to arm ",__FUNCTION__,__LINE__);
 		
 		return arm_camera_yuv420_scale_arm(V4L2_PIX_FMT_NV12, (isDstNV21 ? V4L2_PIX_FMT_NV21:V4L2_PIX_FMT_NV12), 
-			src, (char *)dst,src_width, src_height,dst_width, dst_height,mirror,zoom_val);
+			src, (char *)dst,src_width, src_height,dst_width, dst_height,mirror,zoom_val,src_stride,src_uv_offset);
+	}
+
+	//rga takes the uv plane at vir_w*vir_h, a gap of whole lines is a taller virtual height
+	if (src_uv_offset) {
+		if (src_uv_offset % src_vir_w)
+			return arm_camera_yuv420_scale_arm(V4L2_PIX_FMT_NV12, (isDstNV21 ? V4L2_PIX_FMT_NV21:V4L2_PIX_FMT_NV12), 
+				src, (char *)dst,src_width, src_height,dst_width, dst_height,mirror,zoom_val,src_stride,src_uv_offset);
+		src_vir_h = src_uv_offset / src_vir_w;
 	}
 
 	//need crop ? when cts FOV,don't crop
@@ -640,7 +730,7 @@ extern "C" int rga_nv12_scale_crop(int src_width, int src_height, char *src, sho
 
 		#if defined(TARGET_RK3188)
 			Rga_Request.src.yrgb_addr =  (long)psY;
-		    Rga_Request.src.uv_addr  = (long)psY + src_width * src_height;
+		    Rga_Request.src.uv_addr  = (long)psY + src_vir_w * src_vir_h;
 		#else
         	#if (defined(TARGET_RK312x) || defined(TARGET_RK3328)) && defined(ANDROID_7_X)
             if (is_viraddr_valid) {
@@ -656,8 +746,8 @@ extern "C" int rga_nv12_scale_crop(int src_width, int src_height, char *src, sho
             #endif
 		#endif
 		    Rga_Request.src.v_addr   =  0;
-		    Rga_Request.src.vir_w =  src_width;
-		    Rga_Request.src.vir_h = src_height;
+		    Rga_Request.src.vir_w =  src_vir_w;
+		    Rga_Request.src.vir_h = src_vir_h;
 		    Rga_Request.src.format = RK_FORMAT_YCbCr_420_SP;
 		    Rga_Request.src.act_w = src_cropW & (~0x01);
 		    Rga_Request.src.act_h = src_cropH & (~0x01);
@@ -739,11 +829,10 @@ extern "C" int rga_nv12_scale_crop(int src_width, int src_height, char *src, sho
 }
 #endif
 
-extern "C"  int arm_camera_yuv420_scale_arm(int v4l2_fmt_src, int v4l2_fmt_dst, 
-									char *srcbuf, char *dstbuf,int src_w, int src_h,int dst_w, int dst_h,bool mirror,int zoom_val)
+extern "C"  int arm_yuv420_scale_desc(const cam_frame_desc_t* src_desc, const cam_frame_desc_t* dst_desc,
+									bool mirror,int zoom_val)
 {
 	unsigned char *psY,*pdY,*psUV,*pdUV; 
-	unsigned char *src,*dst;
 	int srcW,srcH,cropW,cropH,dstW,dstH;
 	long zoomindstxIntInv,zoomindstyIntInv;
 	long x,y;
@@ -754,24 +843,44 @@ extern "C"  int arm_camera_yuv420_scale_arm(int v4l2_fmt_src, int v4l2_fmt_dst,
 	bool nv21DstFmt = false;
 	int ratio = 0;
 	int top_offset=0,left_offset=0;
-	if((v4l2_fmt_src != V4L2_PIX_FMT_NV12) ||
-		((v4l2_fmt_dst != V4L2_PIX_FMT_NV12) && (v4l2_fmt_dst != V4L2_PIX_FMT_NV21) )){
+	//the source is read from its crop, both sides may be padded or have their planes apart
+	int src_w = DESC_CROP_W(src_desc), src_h = DESC_CROP_H(src_desc);
+	int dst_w = dst_desc->width, dst_h = dst_desc->height;
+	int stride = src_desc->plane[0].stride, uv_stride = src_desc->plane[1].stride;
+	int dst_stride = dst_desc->plane[0].stride, dst_uv_stride = dst_desc->plane[1].stride;
+	unsigned char *srcY = src_desc->plane[0].vir + src_desc->crop.top*stride + src_desc->crop.left;
+	unsigned char *srcUV = src_desc->plane[1].vir + (src_desc->crop.top>>1)*uv_stride + (src_desc->crop.left & ~0x01);
+	bool packed = camFrameDescPacked(src_desc) && camFrameDescPacked(dst_desc);
+
+	if((src_desc->fmt != V4L2_PIX_FMT_NV12) ||
+		((dst_desc->fmt != V4L2_PIX_FMT_NV12) && (dst_desc->fmt != V4L2_PIX_FMT_NV21) )){
 		LOGE("%s:%d,not suppport this format ",__FUNCTION__,__LINE__);
 		return -1;
 	}
+	if (!src_desc->plane[0].vir || !dst_desc->plane[0].vir) {
+		LOGE("%s:%d,frame isn't mapped",__FUNCTION__,__LINE__);
+		return -1;
+	}
 
     //just copy ?
-    if((v4l2_fmt_src == v4l2_fmt_dst) && (mirror == false)
+    if((src_desc->fmt == dst_desc->fmt) && (mirror == false)
         &&(src_w == dst_w) && (src_h == dst_h) && (zoom_val == 100)){
-        memcpy(dstbuf,srcbuf,src_w*src_h*3/2);
+        if (packed) {
+            memcpy(dst_desc->plane[0].vir,srcY,src_w*src_h*3/2);
+        } else {
+            for (y = 0; y < src_h; y++)
+                memcpy(dst_desc->plane[0].vir+y*dst_stride, srcY+y*stride, src_w);
+            for (y = 0; y < src_h/2; y++)
+                memcpy(dst_desc->plane[1].vir+y*dst_uv_stride, srcUV+y*uv_stride, src_w);
+        }
         return 0;
-    }else if((v4l2_fmt_dst == V4L2_PIX_FMT_NV21) 
+    }else if(packed && (dst_desc->fmt == V4L2_PIX_FMT_NV21) 
             && (src_w == dst_w) && (src_h == dst_h) 
             && (mirror == false) && (zoom_val == 100)){
     //just convert fmt
 
         cameraFormatConvert(V4L2_PIX_FMT_NV12, V4L2_PIX_FMT_NV21, NULL, 
-    					    srcbuf, dstbuf,0,0,src_w*src_h*3/2,
+    					    (char*)srcY, (char*)dst_desc->plane[0].vir,0,0,src_w*src_h*3/2,
     					    src_w, src_h,src_w,
     					    dst_w, dst_h,dst_w,
     						mirror);
@@ -779,7 +888,7 @@ extern "C"  int arm_camera_yuv420_scale_arm(int v4l2_fmt_src, int v4l2_fmt_dst,
 
     }
 
-	if ((v4l2_fmt_dst == V4L2_PIX_FMT_NV21)){
+	if ((dst_desc->fmt == V4L2_PIX_FMT_NV21)){
 		nv21DstFmt = true;
 		
 	}
@@ -807,9 +916,9 @@ extern "C"  int arm_camera_yuv420_scale_arm(int v4l2_fmt_src, int v4l2_fmt_dst,
 		top_offset=((src_h-cropH)>>1) & (~0x01);
     }
 
-	src = psY = (unsigned char*)(srcbuf)+top_offset*src_w+left_offset;
+	psY = srcY+top_offset*stride+left_offset;
 	//psUV = psY +src_w*src_h+top_offset*src_w/2+left_offset;
-	psUV = (unsigned char*)(srcbuf) +src_w*src_h+top_offset*src_w/2+left_offset;
+	psUV = srcUV+(top_offset>>1)*uv_stride+left_offset;
 
 	
 	srcW =src_w;
@@ -818,8 +927,8 @@ extern "C"  int arm_camera_yuv420_scale_arm(int v4l2_fmt_src, int v4l2_fmt_dst,
 //	cropH = src_h;
 
 	
-	dst = pdY = (unsigned char*)dstbuf; 
-	pdUV = pdY + dst_w*dst_h;
+	pdY = dst_desc->plane[0].vir; 
+	pdUV = dst_desc->plane[1].vir;
 	dstW = dst_w;
 	dstH = dst_h;
 
@@ -837,10 +946,10 @@ extern "C"  int arm_camera_yuv420_scale_arm(int v4l2_fmt_src, int v4l2_fmt_dst,
 			xCoeff01 = 0xffff - xCoeff00;	
 			sX = (x*zoomindstxIntInv >> 16);
 			sX = (sX >= srcW -1)?(srcW- 2) : sX;
-			a = psY[sY*srcW + sX];
-			b = psY[sY*srcW + sX + 1];
-			c = psY[(sY+1)*srcW + sX];
-			d = psY[(sY+1)*srcW + sX + 1];
+			a = psY[sY*stride + sX];
+			b = psY[sY*stride + sX + 1];
+			c = psY[(sY+1)*stride + sX];
+			d = psY[(sY+1)*stride + sX + 1];
 
 			r0 = (a * xCoeff01 + b * xCoeff00)>>16 ;
 			r1 = (c * xCoeff01 + d * xCoeff00)>>16 ;
@@ -851,7 +960,7 @@ extern "C"  int arm_camera_yuv420_scale_arm(int v4l2_fmt_src, int v4l2_fmt_dst,
 			else
 				pdY[x] = r0;
 		}
-		pdY += dstW;
+		pdY += dst_stride;
 	}
 
 	dstW /= 2;
@@ -872,10 +981,10 @@ extern "C"  int arm_camera_yuv420_scale_arm(int v4l2_fmt_src, int v4l2_fmt_dst,
 			sX = (x*zoomindstxIntInv >> 16);
 			sX = (sX >= srcW -1)?(srcW- 2) : sX;
 			//U
-			a = psUV[(sY*srcW + sX)*2];
-			b = psUV[(sY*srcW + sX + 1)*2];
-			c = psUV[((sY+1)*srcW + sX)*2];
-			d = psUV[((sY+1)*srcW + sX + 1)*2];
+			a = psUV[sY*uv_stride + sX*2];
+			b = psUV[sY*uv_stride + (sX + 1)*2];
+			c = psUV[(sY+1)*uv_stride + sX*2];
+			d = psUV[(sY+1)*uv_stride + (sX + 1)*2];
 
 			r0 = (a * xCoeff01 + b * xCoeff00)>>16 ;
 			r1 = (c * xCoeff01 + d * xCoeff00)>>16 ;
@@ -890,10 +999,10 @@ extern "C"  int arm_camera_yuv420_scale_arm(int v4l2_fmt_src, int v4l2_fmt_dst,
 			else
 				pdUV[x*2] = r0;
 			//V
-			a = psUV[(sY*srcW + sX)*2 + 1];
-			b = psUV[(sY*srcW + sX + 1)*2 + 1];
-			c = psUV[((sY+1)*srcW + sX)*2 + 1];
-			d = psUV[((sY+1)*srcW + sX + 1)*2 + 1];
+			a = psUV[sY*uv_stride + sX*2 + 1];
+			b = psUV[sY*uv_stride + (sX + 1)*2 + 1];
+			c = psUV[(sY+1)*uv_stride + sX*2 + 1];
+			d = psUV[(sY+1)*uv_stride + (sX + 1)*2 + 1];
 
 			r0 = (a * xCoeff01 + b * xCoeff00)>>16 ;
 			r1 = (c * xCoeff01 + d * xCoeff00)>>16 ;
@@ -908,11 +1017,24 @@ extern "C"  int arm_camera_yuv420_scale_arm(int v4l2_fmt_src, int v4l2_fmt_dst,
 			else
 				pdUV[x*2 + 1] = r0;
 		}
-		pdUV += dstW*2;
+		pdUV += dst_uv_stride;
 	}
-	return 0;
+	return ret;
 }	
 
+extern "C"  int arm_camera_yuv420_scale_arm(int v4l2_fmt_src, int v4l2_fmt_dst, 
+									char *srcbuf, char *dstbuf,int src_w, int src_h,int dst_w, int dst_h,bool mirror,int zoom_val,
+									int src_stride,long src_uv_offset)
+{
+	cam_frame_desc_t src, dst;
+
+	if (camFrameDescInit(&src, v4l2_fmt_src, srcbuf, -1, src_w, src_h, src_stride)
+		|| camFrameDescInit(&dst, v4l2_fmt_dst, dstbuf, -1, dst_w, dst_h, 0))
+		return -1;
+	camFrameDescSetUv(&src, src_uv_offset);
+	return arm_yuv420_scale_desc(&src, &dst, mirror, zoom_val);
+}
+
 extern "C" int rk_camera_zoom_ipp(int v4l2_fmt_src, int srcbuf, int src_w, int src_h,int dstbuf,int zoom_value)
 {
 	int vipdata_base;
@@ -1161,37 +1283,48 @@ extern "C"  int UVData_Mirror_Line(int v4l2_fmt_src, int *psrc, int *pdst, int w
 
     return 0;
 }
-extern "C"  int YuvData_Mirror_Flip(int v4l2_fmt_src, char *pdata, char *pline_tmp, int w, int h)
+extern "C"  int YuvData_Mirror_Flip_desc(const cam_frame_desc_t* frame, char *pline_tmp)
 {
     int *pdata_tmp = NULL;
     int *ptop, *pbottom;
-    int err = 0,i,j;
+    int err = 0,j;
+    int w = frame->width, h = frame->height;
+    int stride = frame->plane[0].stride, uv_stride = frame->plane[1].stride;
 
+    if ((frame->planes != 2) || !frame->plane[0].vir) {
+        LOGE("%s(%d): format 0x%x isn't semi planar",__FUNCTION__,__LINE__,frame->fmt);
+        err = -1;
+        goto YuvData_Mirror_Flip_end;
+    }
     pdata_tmp = (int*)pline_tmp;
     
     // Y mirror and flip
-    ptop = (int*)pdata;
-    pbottom = (int*)(pdata+w*(h-1));    
     for (j=0; j<(h>>1); j++) {
-        YData_Mirror_Line(v4l2_fmt_src, ptop, pdata_tmp+((w>>2)-1),w);
-        YData_Mirror_Line(v4l2_fmt_src, pbottom, ptop+((w>>2)-1), w);
+        ptop = (int*)(frame->plane[0].vir+j*stride);
+        pbottom = (int*)(frame->plane[0].vir+(h-1-j)*stride);
+        YData_Mirror_Line(frame->fmt, ptop, pdata_tmp+((w>>2)-1),w);
+        YData_Mirror_Line(frame->fmt, pbottom, ptop+((w>>2)-1), w);
         memcpy(pbottom, pdata_tmp, w);
-        ptop += (w>>2);
-        pbottom -= (w>>2);
     }
     // UV mirror and flip
-    ptop = (int*)(pdata+w*h);
-    pbottom = (int*)(pdata+w*(h*3/2-1));    
     for (j=0; j<(h>>2); j++) {
-        UVData_Mirror_Line(v4l2_fmt_src, ptop, pdata_tmp+((w>>2)-1),w);
-        UVData_Mirror_Line(v4l2_fmt_src, pbottom, ptop+((w>>2)-1), w);
+        ptop = (int*)(frame->plane[1].vir+j*uv_stride);
+        pbottom = (int*)(frame->plane[1].vir+((h>>1)-1-j)*uv_stride);
+        UVData_Mirror_Line(frame->fmt, ptop, pdata_tmp+((w>>2)-1),w);
+        UVData_Mirror_Line(frame->fmt, pbottom, ptop+((w>>2)-1), w);
         memcpy(pbottom, pdata_tmp, w);
-        ptop += (w>>2);
-        pbottom -= (w>>2);
     }
 YuvData_Mirror_Flip_end:
     return err;
 }
+extern "C"  int YuvData_Mirror_Flip(int v4l2_fmt_src, char *pdata, char *pline_tmp, int w, int h)
+{
+    cam_frame_desc_t frame;
+
+    if (camFrameDescInit(&frame, v4l2_fmt_src, pdata, -1, w, h, 0))
+        return -1;
+    return YuvData_Mirror_Flip_desc(&frame, pline_tmp);
+}
 extern "C" int YUV420_rotate(const unsigned char* srcy, int src_stride,  unsigned char* srcuv,
                    unsigned char* dsty, int dst_stride, unsigned char* dstuv,
                    int width, int height,int rotate_angle){
@@ -17,6 +17,7 @@ MemManagerBase::MemManagerBase()
 	mRawBufferInfo = NULL;
 	mJpegBufferInfo = NULL;
 	mVideoEncBufferInfo = NULL;
+	memset(&mCacheSyncStats, 0, sizeof(mCacheSyncStats));
 }
 MemManagerBase::~MemManagerBase()
 {
@@ -26,29 +27,32 @@ MemManagerBase::~MemManagerBase()
 	mVideoEncBufferInfo = NULL;
 }
 
-unsigned int MemManagerBase::getBufferAddr(enum buffer_type_enum buf_type, unsigned int buf_idx, buffer_addr_t addr_type)
+struct bufferinfo_s* MemManagerBase::getBufferInfo(enum buffer_type_enum buf_type)
 {
-    unsigned long addr = 0x00;
-    struct bufferinfo_s *buf_info;
-   
     switch(buf_type)
     {
 		case PREVIEWBUFFER:			
-			buf_info = mPreviewBufferInfo;
-			break;
+			return mPreviewBufferInfo;
 		case RAWBUFFER:
-			buf_info = mRawBufferInfo;
-			break;
+			return mRawBufferInfo;
 		case JPEGBUFFER:
-			buf_info = mJpegBufferInfo;
-			break;
+			return mJpegBufferInfo;
 		case VIDEOENCBUFFER:
-			buf_info = mVideoEncBufferInfo;
-			break;
+			return mVideoEncBufferInfo;
         default:
             LOGE("Buffer type(0x%x) is invaildate",buf_type);
-            goto getVirAddr_end;
+            return NULL;
     }
+}
+
+unsigned int MemManagerBase::getBufferAddr(enum buffer_type_enum buf_type, unsigned int buf_idx, buffer_addr_t addr_type)
+{
+    unsigned long addr = 0x00;
+    struct bufferinfo_s *buf_info;
+   
+    buf_info = getBufferInfo(buf_type);
+    if (buf_info == NULL)
+        goto getVirAddr_end;
 
     if (buf_idx > buf_info->mNumBffers) {
         LOGE("Buffer index(0x%x) is invalidate, Total buffer is 0x%x",
@@ -67,9 +71,71 @@ getVirAddr_end:
     return addr;
 }
 
+int MemManagerBase::syncCacheMem(buffer_type_enum buftype,unsigned int buf_idx,unsigned int offset,unsigned int len,cache_sync_dir_t dir)
+{
+    struct bufferinfo_s *buf_info;
+    nsecs_t start;
+    int ret;
+
+    if ((unsigned int)dir >= CACHE_SYNC_DIR_MAX)
+        return -1;
+    {
+        Mutex::Autolock lock(mLock);
+        buf_info = getBufferInfo(buftype);
+        if ((buf_info == NULL) || (buf_idx >= buf_info->mNumBffers)) {
+            LOGE("%s(%d): buffer(type %d, index %d) is invalidate",__FUNCTION__,__LINE__,buftype,buf_idx);
+            return -1;
+        }
+        if ((len == 0) || (offset + len > buf_info->mPerBuffersize))
+            len = buf_info->mPerBuffersize - ((offset < buf_info->mPerBuffersize) ? offset : 0);
+    }
+
+    start = systemTime(CLOCK_MONOTONIC);
+    ret = doSyncCacheMem(buftype, buf_idx, offset, len, dir);
+
+    Mutex::Autolock lock(mCacheSyncLock);
+    mCacheSyncStats.count[dir]++;
+    mCacheSyncStats.bytes[dir] += len;
+    mCacheSyncStats.time[dir] += systemTime(CLOCK_MONOTONIC) - start;
+    return ret;
+}
+
+int MemManagerBase::doSyncCacheMem(buffer_type_enum buftype,unsigned int buf_idx,unsigned int offset,unsigned int len,cache_sync_dir_t dir)
+{
+    size_t per_size;
+    {
+        Mutex::Autolock lock(mLock);
+        struct bufferinfo_s *buf_info = getBufferInfo(buftype);
+        if (buf_info == NULL)
+            return -1;
+        per_size = buf_info->mPerBuffersize;
+    }
+    //buffers of a type are carved from one region
+    return flushCacheMem(buftype, buf_idx*per_size + offset, len);
+}
+
+void MemManagerBase::getCacheSyncStats(cache_sync_stats_t* stats,bool reset)
+{
+    Mutex::Autolock lock(mCacheSyncLock);
+    *stats = mCacheSyncStats;
+    if (reset)
+        memset(&mCacheSyncStats, 0, sizeof(mCacheSyncStats));
+}
+
 int MemManagerBase::dump()
 {
-    
+    static const char* dir_name[CACHE_SYNC_DIR_MAX] = {"cpu->dev","dev->cpu","bidir"};
+    cache_sync_stats_t stats;
+    int i;
+
+    getCacheSyncStats(&stats, false);
+    for (i = 0; i < CACHE_SYNC_DIR_MAX; i++) {
+        if (stats.count[i] == 0)
+            continue;
+        LOGD("%s(%d): cache sync %s: %d syncs, %lld KB, %lld us total, %lld us per sync",__FUNCTION__,__LINE__,
+            dir_name[i],stats.count[i],(long long)(stats.bytes[i] >> 10),(long long)(stats.time[i]/1000),
+            (long long)(stats.time[i]/1000/stats.count[i]));
+    }
     return 0;
 }
 
@@ -912,6 +978,133 @@ int IonDmaMemManager::flushCacheMem(buffer_type_enum buftype,unsigned int offset
 /******************GRALLOC DRM BUFFER START*******************/
 
 #if (CONFIG_CAMERA_MEM == CAMERA_MEM_GRALLOC_DRM)
+static GrallocDrmMemCache gGrallocDrmMemCache;
+
+GrallocDrmMemCache::GrallocDrmMemCache()
+			     :mOps(NULL),
+			      mHandle(NULL),
+			      mCount(0),
+			      mUsers(0),
+			      mBudget(0),
+			      mBytes(0),
+			      mHits(0),
+			      mMisses(0),
+			      mEvicts(0)
+{
+	memset(mEntry, 0, sizeof(mEntry));
+	memset(mUsage, 0, sizeof(mUsage));
+}
+
+GrallocDrmMemCache::~GrallocDrmMemCache()
+{
+	//cached buffers go with the process, gralloc may already be torn down here
+}
+
+void GrallocDrmMemCache::acquire()
+{
+	char prop[PROPERTY_VALUE_MAX];
+	Mutex::Autolock lock(mLock);
+
+	if (mUsers++ == 0) {
+		property_get(CAMERAHAL_MEMCACHE_PROPERTY_KEY, prop, "");
+		mBudget = (size_t)(prop[0] ? atoi(prop) : CAMERA_MEMCACHE_BUDGET_DEFAULT) << 20;
+	}
+}
+
+void GrallocDrmMemCache::release()
+{
+	Mutex::Autolock lock(mLock);
+
+	if ((mUsers > 0) && (--mUsers == 0)) {
+		LOG1("%s(%d): last camera closed, free %d cached buffers",__FUNCTION__,__LINE__,mCount);
+		trimLocked(0);
+	}
+}
+
+cam_mem_info_t* GrallocDrmMemCache::get(cam_mem_handle_t* handle,size_t size)
+{
+	Mutex::Autolock lock(mLock);
+	cam_mem_info_t* mem;
+	int i,best = -1;
+
+	if (handle == NULL)
+		return NULL;
+	for (i = 0; i < mCount; i++) {
+		if ((mUsage[i] == handle->flag) && (mEntry[i]->size >= size) && (mEntry[i]->size - size <= size/4)
+			&& ((best < 0) || (mEntry[i]->size < mEntry[best]->size)))
+			best = i;
+	}
+	if (best < 0) {
+		mMisses++;
+		return NULL;
+	}
+	mem = mEntry[best];
+	for (i = best; i < mCount - 1; i++) {
+		mEntry[i] = mEntry[i + 1];
+		mUsage[i] = mUsage[i + 1];
+	}
+	mEntry[--mCount] = NULL;
+	mBytes -= mem->size;
+	mHits++;
+	mem->handlle = handle;
+	LOG1("%s(%d): reuse %d bytes buffer(fd %d) for %d bytes",__FUNCTION__,__LINE__,(int)mem->size,mem->fd,(int)size);
+	return mem;
+}
+
+bool GrallocDrmMemCache::put(cam_mem_ops_t* ops,cam_mem_info_t* mem)
+{
+	Mutex::Autolock lock(mLock);
+	size_t budget = mBudget;
+
+	//no camera left to reuse it
+	if (mUsers == 0)
+		budget = 0;
+	if ((budget == 0) || (mem->size > budget) || mem->iommu_maped) {
+		trimLocked(budget);
+		return false;
+	}
+	if (mHandle == NULL) {
+		mHandle = ops->init(0,
+					CAM_MEM_FLAG_HW_WRITE | CAM_MEM_FLAG_HW_READ | CAM_MEM_FLAG_SW_WRITE | CAM_MEM_FLAG_SW_READ,
+					0);
+		if (mHandle == NULL)
+			return false;
+		mOps = ops;
+	}
+	trimLocked(budget - mem->size);
+	mUsage[mCount] = mem->handlle->flag;
+	mem->handlle = mHandle;
+	mEntry[mCount++] = mem;
+	mBytes += mem->size;
+	return true;
+}
+
+void GrallocDrmMemCache::trimLocked(size_t budget)
+{
+	int i;
+
+	//keep a free slot for the caller
+	while ((mCount > 0) && ((mBytes > budget) || (mCount >= CAMERA_MEMCACHE_ENTRY_MAX))) {
+		cam_mem_info_t* mem = mEntry[0];
+		for (i = 0; i < mCount - 1; i++) {
+			mEntry[i] = mEntry[i + 1];
+			mUsage[i] = mUsage[i + 1];
+		}
+		mEntry[--mCount] = NULL;
+		mBytes -= mem->size;
+		mEvicts++;
+		mOps->free(mHandle, mem);
+	}
+}
+
+void GrallocDrmMemCache::dump()
+{
+	Mutex::Autolock lock(mLock);
+
+	LOGD("%s(%d): %d buffers, %d/%d KB cached, %d hits, %d misses, %d evicts",__FUNCTION__,__LINE__,
+		mCount,(int)(mBytes >> 10),(int)(mBudget >> 10),mHits,mMisses,mEvicts);
+}
+
 GrallocDrmMemManager::GrallocDrmMemManager(bool iommuEnabled)
 			     :MemManagerBase(),
 			      mPreviewData(NULL),
@@ -927,6 +1120,7 @@ GrallocDrmMemManager::GrallocDrmMemManager(bool iommuEnabled)
 		mHandle = mOps->init(iommuEnabled ? 1:0,
 					CAM_MEM_FLAG_HW_WRITE | CAM_MEM_FLAG_HW_READ | CAM_MEM_FLAG_SW_WRITE | CAM_MEM_FLAG_SW_READ,
 					0);
+	gGrallocDrmMemCache.acquire();
 }
 
 GrallocDrmMemManager::~GrallocDrmMemManager()
@@ -953,7 +1147,7 @@ GrallocDrmMemManager::~GrallocDrmMemManager()
 	}
 	if(mHandle)
 		mOps->deInit(mHandle);
-
+	gGrallocDrmMemCache.release();
 }
 
 int GrallocDrmMemManager::createGrallocDrmBuffer(struct bufferinfo_s* grallocbuf)
@@ -1016,7 +1210,9 @@ int GrallocDrmMemManager::createGrallocDrmBuffer(struct bufferinfo_s* grallocbuf
     }
 
     for(i = 0;i < numBufs;i++){
-		*tmpalloc = mOps->alloc(mHandle,grallocbuf->mPerBuffersize);
+		*tmpalloc = gGrallocDrmMemCache.get(mHandle,grallocbuf->mPerBuffersize);
+		if (*tmpalloc == NULL)
+			*tmpalloc = mOps->alloc(mHandle,grallocbuf->mPerBuffersize);
 		if (*tmpalloc) {
 			#if 0
 			//if iommu needed,should get camsys_fd first
@@ -1052,7 +1248,8 @@ int GrallocDrmMemManager::createGrallocDrmBuffer(struct bufferinfo_s* grallocbuf
 			//if iommu needed,should get camsys_fd first
             mOps->iommu_map(mHandle,*tmpalloc);
 #endif
-			mOps->free(mHandle,*tmpalloc);
+			if (!gGrallocDrmMemCache.put(mOps,*tmpalloc))
+				mOps->free(mHandle,*tmpalloc);
         }
     	switch(grallocbuf->mBufType){
         	case PREVIEWBUFFER:
@@ -1124,7 +1321,9 @@ void GrallocDrmMemManager::destroyGrallocDrmBuffer(buffer_type_enum buftype)
 			//if iommu needed,should get camsys_fd first
             mOps->iommu_map(mHandle,*tmpalloc);
 #endif
-			mOps->free(mHandle,*tmpalloc);
+			//a jpeg output can still be mapped by the client it was handed to, never reuse it
+			if ((buftype == JPEGBUFFER) || !gGrallocDrmMemCache.put(mOps,*tmpalloc))
+				mOps->free(mHandle,*tmpalloc);
         }
         tmpalloc++;
     }
@@ -1378,6 +1577,48 @@ int GrallocDrmMemManager::flushCacheMem(buffer_type_enum buftype,unsigned int of
  
     return 0;
 }
+
+int GrallocDrmMemManager::dump()
+{
+	MemManagerBase::dump();
+	gGrallocDrmMemCache.dump();
+	return 0;
+}
+
+int GrallocDrmMemManager::doSyncCacheMem(buffer_type_enum buftype,unsigned int buf_idx,unsigned int offset,unsigned int len,cache_sync_dir_t dir)
+{
+    Mutex::Autolock lock(mLock);
+	cam_mem_info_t** tmpalloc = NULL;
+	int ret;
+
+	switch(buftype)
+	{
+		case PREVIEWBUFFER:
+			tmpalloc = mPreviewData;
+			break;
+		case RAWBUFFER:
+			tmpalloc = mRawData;
+			break;
+		case JPEGBUFFER:
+			tmpalloc = mJpegData;
+			break;
+		case VIDEOENCBUFFER:
+			tmpalloc = mVideoEncData;
+			break;
+		default:
+			LOGE("buffer type is wrong !");
+			return -1;
+	}
+	//index has been checked against mNumBffers by syncCacheMem
+	if (!tmpalloc || !tmpalloc[buf_idx] || !tmpalloc[buf_idx]->vir_addr)
+		return -1;
+
+	if (mOps->sync_cache)
+		ret = mOps->sync_cache(mHandle, tmpalloc[buf_idx], offset, len, (enum cam_mem_sync_dir_e)dir);
+	else
+		ret = mOps->flush_cache(mHandle, tmpalloc[buf_idx]);
+    return ret;
+}
 #endif
 /******************GRALLOC DRM BUFFER END*******************/
 
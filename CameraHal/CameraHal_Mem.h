@@ -63,6 +63,19 @@ typedef enum buffer_addr_e {
 	buffer_sharre_fd
 }buffer_addr_t;
 
+typedef enum cache_sync_dir_e {
+    CACHE_SYNC_CPU_TO_DEVICE,   /* cpu wrote the buffer, device reads it next */
+    CACHE_SYNC_DEVICE_TO_CPU,   /* device wrote the buffer, cpu reads it next */
+    CACHE_SYNC_BIDIRECTIONAL,   /* caller doesn't know the order */
+    CACHE_SYNC_DIR_MAX
+}cache_sync_dir_t;
+
+typedef struct cache_sync_stats_s {
+    unsigned int count[CACHE_SYNC_DIR_MAX];
+    uint64_t bytes[CACHE_SYNC_DIR_MAX];
+    nsecs_t time[CACHE_SYNC_DIR_MAX];
+}cache_sync_stats_t;
+
 class MemManagerBase{
 public :
 	MemManagerBase();
@@ -77,6 +90,9 @@ public :
 	virtual int destroyJpegBuffer() = 0;
 	virtual int destroyVideoEncBuffer() = 0;
 	virtual int flushCacheMem(buffer_type_enum buftype,unsigned int offset, unsigned int len) = 0;
+	//sync one buffer for dir, len 0 means the whole buffer; counted in the cache sync stats
+	int syncCacheMem(buffer_type_enum buftype,unsigned int buf_idx,unsigned int offset,unsigned int len,cache_sync_dir_t dir);
+	void getCacheSyncStats(cache_sync_stats_t* stats,bool reset);
 	#if 0
 	struct bufferinfo_s& getPreviewBufInfo(){
 		return mPreviewBufferInfo;}
@@ -88,13 +104,18 @@ public :
 		return mVideoEncBufferInfo;}
 	#endif
     unsigned int getBufferAddr(enum buffer_type_enum buf_type, unsigned int buf_idx, buffer_addr_t addr_type);
-    int dump();
+    virtual int dump();
 protected:
+	struct bufferinfo_s* getBufferInfo(enum buffer_type_enum buf_type);
+	//default: flush the buffer's range with flushCacheMem
+	virtual int doSyncCacheMem(buffer_type_enum buftype,unsigned int buf_idx,unsigned int offset,unsigned int len,cache_sync_dir_t dir);
 	struct bufferinfo_s* mPreviewBufferInfo;
 	struct bufferinfo_s* mRawBufferInfo;
 	struct bufferinfo_s* mJpegBufferInfo;
 	struct bufferinfo_s* mVideoEncBufferInfo;
 	mutable Mutex mLock;
+	Mutex mCacheSyncLock;
+	cache_sync_stats_t mCacheSyncStats;
 };
 #if (CONFIG_CAMERA_MEM == CAMERA_MEM_PMEM)
 class PmemManager:public MemManagerBase{
@@ -200,6 +221,46 @@ class IonDmaMemManager:public MemManagerBase{
 #endif
 
 #if (CONFIG_CAMERA_MEM == CAMERA_MEM_GRALLOC_DRM)
+#define CAMERAHAL_MEMCACHE_PROPERTY_KEY     "sys_graphic.cam_hal.memcache"  /* budget in MB, 0: off */
+#define CAMERA_MEMCACHE_BUDGET_DEFAULT      64
+#define CAMERA_MEMCACHE_ENTRY_MAX           32
+
+/*
+ * Process wide cache of released gralloc allocations, so preview restarts and
+ * capture size switches of an open camera don't go back to gralloc/cma.
+ * A request is served by the smallest cached buffer with the same gralloc
+ * usage that fits and wastes at most a quarter of the request; the oldest
+ * entries go first when the cache is over budget. Once the last camera's
+ * memory manager is gone the cache is drained, so no cma stays pinned.
+ */
+class GrallocDrmMemCache{
+	public :
+		GrallocDrmMemCache();
+		~GrallocDrmMemCache();
+		//a memory manager was created, the first one reads the budget
+		void acquire();
+		//a memory manager is gone, the last one drains the cache
+		void release();
+		cam_mem_info_t* get(cam_mem_handle_t* handle,size_t size);
+		//false: not cached, caller frees mem
+		bool put(cam_mem_ops_t* ops,cam_mem_info_t* mem);
+		void dump();
+	private:
+		void trimLocked(size_t budget);
+		Mutex mLock;
+		cam_mem_ops_t* mOps;
+		cam_mem_handle_t* mHandle;		/* owns the cached buffers, outlives the managers */
+		cam_mem_info_t* mEntry[CAMERA_MEMCACHE_ENTRY_MAX];	/* oldest first */
+		unsigned int mUsage[CAMERA_MEMCACHE_ENTRY_MAX];	/* gralloc usage the entry was allocated with */
+		int mCount;
+		int mUsers;
+		size_t mBudget;
+		size_t mBytes;
+		unsigned int mHits;
+		unsigned int mMisses;
+		unsigned int mEvicts;
+};
+
 class GrallocDrmMemManager:public MemManagerBase{
 	public :
 		GrallocDrmMemManager(bool iommuEnabled);
@@ -215,12 +276,15 @@ class GrallocDrmMemManager:public MemManagerBase{
 		virtual int destroyJpegBuffer();
 		virtual int destroyVideoEncBuffer();
 		virtual int flushCacheMem(buffer_type_enum buftype,unsigned int offset, unsigned int len);
+		virtual int dump();
 
 		//map
 
 		//unmap
 
 		//share
+	protected:
+		virtual int doSyncCacheMem(buffer_type_enum buftype,unsigned int buf_idx,unsigned int offset,unsigned int len,cache_sync_dir_t dir);
 	private:
 		int createGrallocDrmBuffer(struct bufferinfo_s* grallocbuf);
 		void destroyGrallocDrmBuffer(buffer_type_enum buftype);
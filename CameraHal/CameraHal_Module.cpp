@@ -30,6 +30,7 @@
 #include <time.h>
 #include "vpu.h"
 #include "cam_api/cam_engine_interface.h"
+#include "ReplayCameraAdapter.h"
 
 rk_cam_info_t gCamInfos[CAMERAS_SUPPORT_MAX];
 static android::CameraHal* gCameraHals[CAMERAS_SUPPORT_MAX];
@@ -763,6 +764,32 @@ int camera_get_number_of_cameras(void)
         delete camEngVerItf;
 
     }
+
+    /* replay camera is a virtual back camera, no board profile or v4l2 node behind it */
+    property_get("sys.cam_hal.type", property, "none");
+    if (strcmp(property, "replaycamera") == 0) {
+        //kept across calls, the cameras are queried again when the usb camera changes
+        static rk_cam_total_info* pReplayInfo = NULL;
+
+        if (pReplayInfo == NULL)
+            pReplayInfo = new rk_cam_total_info();
+        strcpy(pReplayInfo->mHardInfo.mSensorInfo.mSensorName, "replaycamera");
+        pReplayInfo->mHardInfo.mSensorInfo.mFacing = 0;
+        pReplayInfo->mHardInfo.mSensorInfo.mOrientation = 0;
+        pReplayInfo->mHardInfo.mSensorInfo.mPhy.type = CamSys_Phy_end;
+        property_get(CAMERAHAL_REPLAYCAMERA_IOMMU_KEY, property, "1");
+        pReplayInfo->mIsIommuEnabled = (strtol(property,0,0) != 0);
+        pReplayInfo->mIsConnect = 1;
+
+        memset(&gCamInfos[0],0x00,sizeof(rk_cam_info_t));
+        strcpy(gCamInfos[0].device_path, "replay");
+        strcpy(gCamInfos[0].driver, "replaycamera");
+        gCamInfos[0].facing_info.facing = CAMERA_FACING_BACK;
+        gCamInfos[0].facing_info.orientation = 0;
+        gCamInfos[0].pcam_total_info = pReplayInfo;
+        gCamerasNumber = 1;
+        goto camera_get_number_of_cameras_end;
+    }
     
     memset(&camInfoTmp[0],0x00,sizeof(rk_cam_info_t));
     memset(&camInfoTmp[1],0x00,sizeof(rk_cam_info_t));
@@ -34,6 +34,7 @@
 
 #include "CameraHal_board_xml_parse.h"
 #include "CameraHal_Tracer.h"
+#include "CameraThreadConfig.h"
 
 static int rk_sensor_pwrseq(int dev, rk_cam_total_info* pCamInfo, int on)
 {
@@ -922,6 +923,8 @@ void camera_board_profiles::StartElementHandler(void *userData, const char *name
 	    }else{
             ALOGE("%s(%d): Warnimg camdevice malloc fail! \n", __FUNCTION__,__LINE__);
 	    }
+	}else if (strcmp(name,"HalThread")==0) {
+        CameraThreadConfig::parseXml(atts);
 	}else if (strstr(name, "Sensor")) {
         ParserSensorInfo(name, atts, userData);
     } else if (strstr(name, "VCM")) {
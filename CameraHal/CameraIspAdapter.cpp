@@ -13,6 +13,38 @@ namespace android{
 
 #define USE_RGA_TODO_ZOOM   (1)
 
+#define PREVIEW_STATS_INTERVAL  8                   /* frames between luma statistics */
+#define PREVIEW_STATS_STEP      8                   /* luma subsampling in both directions */
+#define PREVIEW_STATS_MAX_AGE   500000000LL         /* ns, older statistics are not used */
+
+//moves the uv plane of a nv12 frame right after its lines, for consumers taking one packed buffer
+static void ispPackNv12(unsigned char* vir, int width, int height, int stride, ulong_t uv_offset)
+{
+    int i;
+
+    //planes only move down, line by line in address order is safe
+    if (stride != width) {
+        for (i = 1; i < height; i++)
+            memmove(vir + i*width, vir + i*stride, width);
+    }
+    for (i = 0; i < height/2; i++)
+        memmove(vir + width*height + i*width, vir + uv_offset + i*stride, width);
+}
+
+static int zslRingDepth()
+{
+    char prop_value[PROPERTY_VALUE_MAX];
+    int depth;
+
+    property_get(CAMERAHAL_ZSL_PROPERTY_KEY, prop_value, "0");
+    depth = atoi(prop_value);
+    if (depth < 0)
+        depth = 0;
+    else if (depth > ISP_ZSL_RING_MAX)
+        depth = ISP_ZSL_RING_MAX;
+    return depth;
+}
+
 /******************************************************************************
  * MainWindow_AfpsResChangeCb
  *****************************************************************************/
@@ -64,10 +96,6 @@ CameraIspAdapter::CameraIspAdapter(int cameraId)
     mISPOutputFmt = ISP_OUT_YUV420SP;
     mISPTunningRun = false;
     mIsSendToTunningTh = false;
-    mDispFrameLeak = 0;
-    mVideoEncFrameLeak = 0;
-    mPreviewCBFrameLeak = 0;
-    mPicEncFrameLeak = 0;
 	mCtxCbResChange.res = 0;
 	mCtxCbResChange.pIspAdapter =NULL;
 
@@ -79,18 +107,36 @@ CameraIspAdapter::CameraIspAdapter(int cameraId)
 	mCameraGL = new CameraGL();
     mGPUCommandThread = new GPUCommandThread(this);
     mGPUCommandThreadState = STA_GPUCMD_IDLE;
-    mGPUCommandThread->run("GPUCommandThread",ANDROID_PRIORITY_DISPLAY);
+    mGPUCommandThread->run("GPUCommandThread",CameraThreadConfig::priority("GPUCommandThread"));
 
 	mfdISO = 2;
+    mAecWinDirty = true;
 	mMutliFrameDenoise = NULL;
 	mfd_buffers_capture = NULL;
     mfd_buffers_capture = new cv_fimc_buffer();
     memset(mfd_buffers_capture,0x0,sizeof(cv_fimc_buffer));
     memset(&mfd,0x0,sizeof(mfdprocess));
     mMutliFrameDenoise = new MutliFrameDenoise();
+    mMfdCpu = new MutliFrameDenoiseCpu();
+    mMfdUseCpu = false;
+    memset(&mPreviewLuma, 0, sizeof(mPreviewLuma));
+    mPreviewLumaTime = 0;
+    mPreviewStatsCnt = 0;
+    mFrameSeq = 0;
+    mFrameStampMisses = 0;
+    mBufMapCnt = 0;
+    mBufMapHits = 0;
+    mBufMapMisses = 0;
+    memset(mZslRing, 0, sizeof(mZslRing));
+    mZslDepth = 0;
+    mZslHead = 0;
+    mZslCnt = 0;
+    mZslShutter = 0;
+    mZslPicks = 0;
+    mZslLagMax = 0;
     mMFDCommandThread = new MFDCommandThread(this);
     mMFDCommandThreadState = STA_GPUCMD_IDLE;
-    mMFDCommandThread->run("MFDCommandThread",ANDROID_PRIORITY_DISPLAY);
+    mMFDCommandThread->run("MFDCommandThread",CameraThreadConfig::priority("MFDCommandThread"));
 
 	LOG_FUNCTION_NAME_EXIT
 	if(mCameraGL == NULL){
@@ -132,23 +178,11 @@ CameraIspAdapter::~CameraIspAdapter()
         delete mfd_buffers_capture;
         mfd_buffers_capture = NULL;
     }
-    cameraDestroy();
-    if(mDispFrameLeak != 0){
-        LOGE("\n\n\n\nmay have disp frame mem leak,count is %d\n\n\n\n",mDispFrameLeak);
-    }
-    
-    if(mVideoEncFrameLeak!=0){
-        LOGE("\n\n\n\nmay have video frame mem leak,count is %d\n\n\n\n",mVideoEncFrameLeak);
-    }
-    
-    if(mPreviewCBFrameLeak != 0){
-        LOGE("\n\n\n\nmay have previewcb frame mem leak,count is %d\n\n\n\n",mPreviewCBFrameLeak);
-    }
-    
-    if(mPicEncFrameLeak != 0){
-        LOGE("\n\n\n\nmay have pic enc frame mem leak,count is %d\n\n\n\n",mPicEncFrameLeak);
+    if (mMfdCpu != NULL) {
+        delete mMfdCpu;
+        mMfdCpu = NULL;
     }
-	
+    cameraDestroy();
 }
 int CameraIspAdapter::cameraCreate(int cameraId)
 {
@@ -214,7 +248,7 @@ int CameraIspAdapter::cameraCreate(int cameraId)
         ListInit(&mAfListenerQue.list);
 
         mAfListenerThread = new CameraAfThread(this);
-        mAfListenerThread->run("CamAfLisThread",ANDROID_PRIORITY_NORMAL);
+        mAfListenerThread->run("CamAfLisThread",CameraThreadConfig::priority("CamAfLisThread"));
 
         if (mISPTunningRun == false) {
             m_camDevice->resetAf(CAM_ENGINE_AUTOFOCUS_SEARCH_ALGORITHM_ADAPTIVE_RANGE);
@@ -337,7 +371,13 @@ void CameraIspAdapter::setupPreview(int width_sensor,int height_sensor,int previ
     }else{
         LOGE("%s:isp don't support this format %d now",__func__,mISPOutputFmt);
     }
+	//frames held by the zsl ring come on top of what the pipeline needs
+	mZslDepth = ((mISPOutputFmt == ISP_OUT_YUV420SP) && isZslEnabled()) ? zslRingDepth() : 0;
+	bufNum += mZslDepth;
+	//plus what the consumers were short of last time
+	bufNum += mBufferLease.growBy();
 	m_camDevice->setIspBufferInfo(bufNum, bufSize);
+	mBufferLease.setPool(bufNum);
     LOGD("Sensor output: %dx%d --(%d,%d,%d,%d)--> User request: %dx%d",width_sensor,height_sensor,
         dcWin.hOffset,dcWin.vOffset,dcWin.width,dcWin.height,preview_w,preview_h);
 
@@ -531,6 +571,7 @@ status_t CameraIspAdapter::startPreview(int preview_w,int preview_h,int w, int h
     flashControl(enable_flash);
 
     mPreviewRunning = 1;
+    mAecWinDirty = true;
 
     LOG_FUNCTION_NAME_EXIT
     return 0;
@@ -547,6 +588,10 @@ status_t CameraIspAdapter::stopPreview()
         m_camDevice->stopAf();
     }
     
+    //give back the isp buffers still queued for cpu denoise before the engine stops
+    mMfdCpu->flush();
+    mfd.frame_cnt = 0;
+
     if(mPreviewRunning) {
         if(-1 == stop())
 			return -1;
@@ -561,7 +606,9 @@ int CameraIspAdapter::setParameters(const CameraParameters &params_set,bool &isR
 {
     int fps_min,fps_max;
     int framerate=0;
+    unsigned int changed = CameraParamDiff::diff(mParameters, params_set);
     
+    LOG2("%s(%d): changed groups 0x%x",__FUNCTION__,__LINE__,changed);
     if (strstr(mParameters.get(CameraParameters::KEY_SUPPORTED_PREVIEW_SIZES), params_set.get(CameraParameters::KEY_PREVIEW_SIZE)) == NULL) {
         LOGE("PreviewSize(%s) not supported",params_set.get(CameraParameters::KEY_PREVIEW_SIZE));        
         return BAD_VALUE;
@@ -592,12 +639,14 @@ int CameraIspAdapter::setParameters(const CameraParameters &params_set,bool &isR
         return BAD_VALUE;
     }
 
-    params_set.getPreviewFpsRange(&fps_min,&fps_max);
-    if ((fps_min < 0) || (fps_max < 0) || (fps_max < fps_min)) {
-        LOGE("FpsRange(%s) is invalidate",params_set.get(CameraParameters::KEY_PREVIEW_FPS_RANGE));
-        return BAD_VALUE;
+    if (changed & CAM_PARAM_FPS) {
+        params_set.getPreviewFpsRange(&fps_min,&fps_max);
+        if ((fps_min < 0) || (fps_max < 0) || (fps_max < fps_min)) {
+            LOGE("FpsRange(%s) is invalidate",params_set.get(CameraParameters::KEY_PREVIEW_FPS_RANGE));
+            return BAD_VALUE;
+        }
     }
-	{
+	if (changed & CAM_PARAM_3DNR) {
 		if(params_set.get("3dnr_enabled")!= NULL)
 		{
 			if (strcmp(params_set.get("3dnr_enabled"),mParameters.get("3dnr_enabled"))) {
@@ -618,7 +667,8 @@ int CameraIspAdapter::setParameters(const CameraParameters &params_set,bool &isR
 	}
 
 
-    {/* ddl@rock-chips.com: v1.5.0 */
+    //the same window again would only restart the aec histogram
+    if ((changed & CAM_PARAM_METERING_AREAS) || mAecWinDirty) {/* ddl@rock-chips.com: v1.5.0 */
         if (params_set.get(CameraParameters::KEY_MAX_NUM_METERING_AREAS) != NULL) {
             if (params_set.getInt(CameraParameters::KEY_MAX_NUM_METERING_AREAS) >= 1) {
                 int hOff,vOff,w,h,weight;
@@ -666,6 +716,7 @@ int CameraIspAdapter::setParameters(const CameraParameters &params_set,bool &isR
 	                    } else {
 	                       m_camDevice->setAecHistMeasureWinAndMode(hOff,vOff,w,h,CentreWeightMetering);
 	                    }
+                        mAecWinDirty = false;
                     }
     	    	}
 
@@ -676,7 +727,11 @@ int CameraIspAdapter::setParameters(const CameraParameters &params_set,bool &isR
     }
 
 
-    {
+    if (!(changed & (CAM_PARAM_FOCUS_MODE | CAM_PARAM_FOCUS_AREAS))) {
+        //focus areas are the same, autoFocus only checks the af shot
+        if (mParameters.getInt(CameraParameters::KEY_MAX_NUM_FOCUS_AREAS) == 1)
+            mAfChk = false;
+    } else {
         bool err_af = false;
 
         if (strstr(mParameters.get(CameraParameters::KEY_SUPPORTED_FOCUS_MODES),params_set.get(CameraParameters::KEY_FOCUS_MODE))) {            
@@ -791,7 +846,7 @@ int CameraIspAdapter::setParameters(const CameraParameters &params_set,bool &isR
     }
   
 
-    {
+    if (changed & CAM_PARAM_FLASH) {
         CamEngineFlashCfg_t flash_cfg;
 
         if (mParameters.get(CameraParameters::KEY_SUPPORTED_FLASH_MODES) && mParameters.get(CameraParameters::KEY_FLASH_MODE)) {
@@ -844,7 +899,7 @@ int CameraIspAdapter::setParameters(const CameraParameters &params_set,bool &isR
         }
 
     }
-	if (!cameraConfig(params_set,false,isRestartValue)) {        
+	if (!cameraConfig(params_set,false,isRestartValue,changed)) {        
         LOG1("PreviewSize(%s)", mParameters.get(CameraParameters::KEY_PREVIEW_SIZE));
         LOG1("PreviewFormat(%s)",params_set.getPreviewFormat());  
         LOG1("FPS Range(%s)",mParameters.get(CameraParameters::KEY_PREVIEW_FPS_RANGE));
@@ -1373,20 +1428,19 @@ LOGD ("Support Picture sizes: %s    %s(default)",params.get(CameraParameters::KE
     LOGD ("Support AWB: %s ",params.get(CameraParameters::KEY_SUPPORTED_WHITE_BALANCE));
     LOGD("Support FOV test h(%f) v(%f)\n", pCamInfo->mHardInfo.mSensorInfo.fov_h,pCamInfo->mHardInfo.mSensorInfo.fov_v);
 
-	cameraConfig(params,true,isRestartPreview);
+	cameraConfig(params,true,isRestartPreview,CAM_PARAM_ALL);
     LOG_FUNCTION_NAME_EXIT
 }
 
-int CameraIspAdapter::cameraConfig(const CameraParameters &tmpparams,bool isInit,bool &isRestartValue)
+int CameraIspAdapter::cameraConfig(const CameraParameters &tmpparams,bool isInit,bool &isRestartValue,unsigned int changed)
 {
 	int err = 0, i = 0;
 	CameraParameters params = tmpparams;
 	
     /*white balance setting*/
     const char *white_balance = params.get(CameraParameters::KEY_WHITE_BALANCE);
-	const char *mwhite_balance = mParameters.get(CameraParameters::KEY_WHITE_BALANCE);
-	if (params.get(CameraParameters::KEY_SUPPORTED_WHITE_BALANCE)) {	
-		if ( !mwhite_balance || strcmp(white_balance, mwhite_balance) ){
+	if ((changed & CAM_PARAM_WHITE_BALANCE) && params.get(CameraParameters::KEY_SUPPORTED_WHITE_BALANCE)) {	
+		if ( white_balance ){
 			if(!isInit) {
 				char prfName[10];
 				uint32_t illu_index = 1; 
@@ -1441,7 +1495,7 @@ int CameraIspAdapter::cameraConfig(const CameraParameters &tmpparams,bool isInit
 	/*zoom setting*/
     const int zoom = params.getInt(CameraParameters::KEY_ZOOM);
 	const int mzoom = mParameters.getInt(CameraParameters::KEY_ZOOM);
-	if (params.get(CameraParameters::KEY_ZOOM_SUPPORTED)) {
+	if ((changed & CAM_PARAM_ZOOM) && params.get(CameraParameters::KEY_ZOOM_SUPPORTED)) {
 		//TODO
         if((zoom != mzoom) && (!isInit)){
             CamEnginePathConfig_t pathConfig;
@@ -1459,24 +1513,20 @@ int CameraIspAdapter::cameraConfig(const CameraParameters &tmpparams,bool isInit
     /*color effect setting*/
     const char *effect = params.get(CameraParameters::KEY_EFFECT);
 	const char *meffect = mParameters.get(CameraParameters::KEY_EFFECT);
-	if (params.get(CameraParameters::KEY_SUPPORTED_EFFECTS)) {
+	if ((changed & CAM_PARAM_EFFECT) && params.get(CameraParameters::KEY_SUPPORTED_EFFECTS)) {
 		//TODO
 	}
 	
     /*anti-banding setting*/
     const char *anti_banding = params.get(CameraParameters::KEY_ANTIBANDING);
-	const char *manti_banding = mParameters.get(CameraParameters::KEY_ANTIBANDING);
-	if (anti_banding != NULL) {
-		if ( !manti_banding || (anti_banding && strcmp(anti_banding, manti_banding)) ) {
-			//TODO
-		}
+	if ((changed & CAM_PARAM_ANTIBANDING) && (anti_banding != NULL)) {
+		//TODO
 	}
 	
 	/*scene setting*/
     const char *scene = params.get(CameraParameters::KEY_SCENE_MODE);
-	const char *mscene = mParameters.get(CameraParameters::KEY_SCENE_MODE);
-	if (params.get(CameraParameters::KEY_SUPPORTED_SCENE_MODES)) {
-		if ( !mscene || strcmp(scene, mscene) ) {
+	if ((changed & CAM_PARAM_SCENE) && params.get(CameraParameters::KEY_SUPPORTED_SCENE_MODES)) {
+		if ( scene ) {
 			//TODO
 		}
 	}
@@ -1485,7 +1535,7 @@ int CameraIspAdapter::cameraConfig(const CameraParameters &tmpparams,bool isInit
     const char *focusMode = params.get(CameraParameters::KEY_FOCUS_MODE);
 	const char *mfocusMode = mParameters.get(CameraParameters::KEY_FOCUS_MODE);
 	if (params.get(CameraParameters::KEY_SUPPORTED_FOCUS_MODES)) {
-		if ( !mfocusMode || strcmp(focusMode, mfocusMode) ) {
+		if ( (changed & CAM_PARAM_FOCUS_MODE) && focusMode ) {
        		//if(!cameraAutoFocus(isInit)){
         	//	params.set(CameraParameters::KEY_FOCUS_MODE,(mfocusMode?mfocusMode:CameraParameters::FOCUS_MODE_FIXED));
         	//	err = -1;
@@ -1498,21 +1548,19 @@ int CameraIspAdapter::cameraConfig(const CameraParameters &tmpparams,bool isInit
 	
 	/*flash mode setting*/
     const char *flashMode = params.get(CameraParameters::KEY_FLASH_MODE);
-	const char *mflashMode = mParameters.get(CameraParameters::KEY_FLASH_MODE);
 	
-	if (params.get(CameraParameters::KEY_SUPPORTED_FLASH_MODES)) {
-		if ( !mflashMode || strcmp(flashMode, mflashMode) ) {
+	if ((changed & CAM_PARAM_FLASH) && params.get(CameraParameters::KEY_SUPPORTED_FLASH_MODES)) {
+		if ( flashMode ) {
 			//TODO
 		}
 	}
     
     /*exposure setting*/
 	const char *exposure = params.get(CameraParameters::KEY_EXPOSURE_COMPENSATION);
-    const char *mexposure = mParameters.get(CameraParameters::KEY_EXPOSURE_COMPENSATION);
     
-	if (strcmp("0", params.get(CameraParameters::KEY_MAX_EXPOSURE_COMPENSATION))
-		|| strcmp("0", params.get(CameraParameters::KEY_MIN_EXPOSURE_COMPENSATION))) {
-	    if (!mexposure || (exposure && strcmp(exposure,mexposure))) {
+	if ((changed & CAM_PARAM_EXPOSURE) && (strcmp("0", params.get(CameraParameters::KEY_MAX_EXPOSURE_COMPENSATION))
+		|| strcmp("0", params.get(CameraParameters::KEY_MIN_EXPOSURE_COMPENSATION)))) {
+	    if (isInit || exposure) {
             if (m_camDevice->isSOCSensor() == false) {
     			if(isInit)
     			{
@@ -1851,6 +1899,7 @@ void CameraIspAdapter::loadCalibData(const char* fileName )
 
 bool CameraIspAdapter::connectCamera(){
     bool result = false;
+    resetIspBufferMap();
     result = m_camDevice->connectCamera( true, this );
     if ( true != result)
     {
@@ -1915,7 +1964,67 @@ void CameraIspAdapter::disconnectCamera()
             m_camDevice->cProcDisable();
     }
     
+    zslFlush();
     m_camDevice->disconnectCamera();
+    resetIspBufferMap();
+}
+
+int CameraIspAdapter::mapIspBuffer(HalHandle_t hal, ulong_t bus_addr, void** vir, int* fd)
+{
+    Mutex::Autolock lock(mBufMapLock);
+    isp_buf_map_s* map = NULL;
+    int i;
+
+    for (i = 0; i < mBufMapCnt; i++) {
+        if (mBufMap[i].bus_addr == bus_addr) {
+            map = &mBufMap[i];
+            break;
+        }
+    }
+    if ((map == NULL) && (mBufMapCnt < ISP_BUF_MAP_MAX)) {
+        map = &mBufMap[mBufMapCnt++];
+        map->bus_addr = bus_addr;
+        map->vir_addr = NULL;
+        map->fd = -1;
+    }
+
+    if (vir) {
+        if (map && map->vir_addr) {
+            *vir = map->vir_addr;
+            mBufMapHits++;
+        } else {
+            mBufMapMisses++;
+            if (HalMapMemory(hal, bus_addr, 100, HAL_MAPMEM_READWRITE, vir) != RET_SUCCESS)
+                return -1;
+            if (map)
+                map->vir_addr = *vir;
+        }
+    }
+    if (fd) {
+        if (map && (map->fd >= 0)) {
+            *fd = map->fd;
+            mBufMapHits++;
+        } else {
+            mBufMapMisses++;
+            if (HalGetMemoryMapFd(hal, bus_addr, fd) != RET_SUCCESS)
+                return -1;
+            if (map)
+                map->fd = *fd;
+        }
+    }
+    return 0;
+}
+
+void CameraIspAdapter::resetIspBufferMap()
+{
+    Mutex::Autolock lock(mBufMapLock);
+
+    if (mBufMapCnt)
+        LOG1("%s(%d): %d isp buffer planes, %d hits, %d misses",__FUNCTION__,__LINE__,
+            mBufMapCnt,mBufMapHits,mBufMapMisses);
+    mBufMapCnt = 0;
+    mBufMapHits = 0;
+    mBufMapMisses = 0;
 }
 
 int CameraIspAdapter::start()
@@ -1972,9 +2081,12 @@ int CameraIspAdapter::stop()
         return -1;
     }
 
+    //the engine wants its buffers back to stop
+    zslFlush();
     if ( true == m_camDevice->stopPreview() )
     {
-    
+        //output size may change before the next start, pools are rebuilt then
+        resetIspBufferMap();
         LOGD("m_camDevice->stopPreview success!");
 		return 0;
     }
@@ -1987,79 +2099,32 @@ int CameraIspAdapter::stop()
 
 void CameraIspAdapter::clearFrameArray(){
     LOG_FUNCTION_NAME
-    MediaBuffer_t *pMediaBuffer = NULL;
-    FramInfo_s *tmpFrame = NULL;
-    Mutex::Autolock lock(mFrameArrayLock);
-
-    int num = mFrameInfoArray.size();
-    while(--num >= 0){
-        tmpFrame = (FramInfo_s *)mFrameInfoArray.keyAt(num);
-        if(mFrameInfoArray.indexOfKey((void*)tmpFrame) < 0){
-            LOGE("this frame is not in frame array,used_flag is %d!",tmpFrame->used_flag);
-        }else{
-            pMediaBuffer = (MediaBuffer_t *)mFrameInfoArray.valueAt(num);
-            switch (tmpFrame->used_flag){
-                case 0:
-                    mDispFrameLeak--;
-                    break;
-                case 1:
-                    mVideoEncFrameLeak--;
-                    break;
-                case 2:
-                    mPicEncFrameLeak--;
-                    break;
-                case 3:
-                    mPreviewCBFrameLeak--;
-                    break;
-                default:
-                    LOGE("not the valid used_flag %d",tmpFrame->used_flag);
-            }
-            //remove item
-            mFrameInfoArray.removeItem((void*)tmpFrame);
-            free(tmpFrame);
-            //unlock
-            
-            MediaBufUnlockBuffer( pMediaBuffer );
-        }
-    }
-    mFrameInfoArray.clear();
+    mBufferLease.dump();
+    mBufferLease.clear();
+    mFrameFanout.dump();
+    mFrameFanout.flush();
     LOG_FUNCTION_NAME_EXIT
 }
 int CameraIspAdapter::adapterReturnFrame(long index,int cmd){
     FramInfo_s* tmpFrame = ( FramInfo_s *)index;
-    Mutex::Autolock lock(mFrameArrayLock);
-    if(mFrameInfoArray.size() > 0){
-        if(mFrameInfoArray.indexOfKey((void*)tmpFrame) < 0){
-            LOGE("this frame is not in frame array,used_flag is %d!",tmpFrame->used_flag);
-        }else{
-            MediaBuffer_t *pMediaBuffer = (MediaBuffer_t *)mFrameInfoArray.valueFor((void*)tmpFrame);
-            {	
-                switch (tmpFrame->used_flag){
-                    case 0:
-                        mDispFrameLeak--;
-                        break;
-                    case 1:
-                        mVideoEncFrameLeak--;
-                        break;
-                    case 2:
-                        mPicEncFrameLeak--;
-                        break;
-                    case 3:
-                        mPreviewCBFrameLeak--;
-                        break;
-                    default:
-                        LOG1("not the valid used_flag %d",tmpFrame->used_flag);
-                }
-                //remove item
-                mFrameInfoArray.removeItem((void*)tmpFrame);
-                free(tmpFrame);
-                
-                //unlock
-                MediaBufUnlockBuffer( pMediaBuffer );
-            }
-        }
-    }else{
-        LOGD("frame array has been cleard!");
+    //read before the lease is given back, the slot may be reused right after
+    ulong_t vir_addr = tmpFrame->vir_addr;
+
+    switch (mBufferLease.release(tmpFrame)){
+        case LEASE_DISPLAY:
+            mFrameFanout.release(vir_addr, FANOUT_CONSUMER_DISPLAY);
+            break;
+        case LEASE_VIDEO:
+            mFrameFanout.release(vir_addr, FANOUT_CONSUMER_VIDEO);
+            break;
+        case LEASE_DATACB:
+            mFrameFanout.release(vir_addr, FANOUT_CONSUMER_DATACB);
+            break;
+        case -1:
+            LOGD("%s(%d): frame %p is not leased, lease has been cleared?",__FUNCTION__,__LINE__,tmpFrame);
+            break;
+        default:
+            break;
     }
     return 0;
 }
@@ -2192,13 +2257,43 @@ void CameraIspAdapter::sendBlockedMsg(int message) {
 
 }
 
-void CameraIspAdapter::mfdCommandThread()
+void CameraIspAdapter::mfdSelectFrames()
 {
-    Message_cam msg;
-	float mfdsetISO;
 	char mfd_set_enable;
 	float get_mfdISO[3];
 	float mfdFrames[3];
+
+	m_camDevice->getGain(mfdISO);
+	m_camDevice->getMfdGain(&mfd_set_enable, get_mfdISO, mfdFrames);
+	if(mfd_set_enable == 1) {
+		if(mfdISO > get_mfdISO[2]) {
+			mfd.process_frames = mfdFrames[2];
+		}
+		else if(mfdISO > get_mfdISO[1]){
+			mfd.process_frames = mfdFrames[1];
+		}
+		else {
+			mfd.process_frames = mfdFrames[0];
+		}
+	} else {
+		mfd.process_frames = 2;
+	}
+}
+
+void CameraIspAdapter::mfdCpuReleaseFrame(void* ctx, void* arg)
+{
+    MediaBufUnlockBuffer((MediaBuffer_t*)arg);
+}
+
+void CameraIspAdapter::ispTuneReleaseFrame(void* ctx, void* arg)
+{
+    FramInfo_s *frame = (FramInfo_s*)arg;
+    ((CameraIspAdapter*)ctx)->adapterReturnFrame(frame->frame_index, frame->used_flag);
+}
+
+void CameraIspAdapter::mfdCommandThread()
+{
+    Message_cam msg;
     while (mMFDCommandThreadState != STA_GPUCMD_STOP) {
     gpu_receive_cmd:
         if (mfdCmdThreadCommandQ.isEmpty() == false ) {
@@ -2244,22 +2339,7 @@ void CameraIspAdapter::mfdCommandThread()
                 }
                 case CMD_GPU_PROCESS_SETFRAMES:
                 {
-					m_camDevice->getGain(mfdISO);
-
-					m_camDevice->getMfdGain(&mfd_set_enable, get_mfdISO, mfdFrames);
-					if(mfd_set_enable == 1) {
-						if(mfdISO > get_mfdISO[2]) {
-							mfd.process_frames = mfdFrames[2];
-						}
-						else if(mfdsetISO > get_mfdISO[1]){
-							mfd.process_frames = mfdFrames[1];
-						}
-						else {
-							mfd.process_frames = mfdFrames[0];
-						}
-					} else {
-						mfd.process_frames = 2;
-					}
+					mfdSelectFrames();
 					mMutliFrameDenoise->setFrames(mfd.process_frames);
                     if(msg.arg1)
                         ((Semaphore*)msg.arg1)->Signal();
@@ -2318,6 +2398,138 @@ int CameraIspAdapter::selectPreferedDrvSize(int *width,int * height,bool is_capt
     return 0;
 }
 
+bool CameraIspAdapter::isZslEnabled()
+{
+    //soc sensors have their own bufferCb without the ring
+    return (zslRingDepth() > 0) && !mIsSendToTunningTh && m_camDevice && !m_camDevice->isSOCSensor();
+}
+
+bool CameraIspAdapter::setZslShutter(nsecs_t shutter)
+{
+    //flash pictures need the pre-flash sequence of the normal path
+    if (isNeedToEnableFlash())
+        return false;
+
+    Mutex::Autolock lock(mZslLock);
+    if ((mZslDepth == 0) || (mZslCnt == 0))
+        return false;
+    mZslShutter = shutter;
+    return true;
+}
+
+//the engine stamp if it is on the monotonic clock and before the arrival, else the arrival;
+//the buffer meta data has no exposure, gain or lens position, they stay unknown
+void CameraIspAdapter::ispFrameMeta(const PicBufMetaData_t* pic, nsecs_t now, cam_frame_meta_t* meta)
+{
+    nsecs_t stamp = us2ns((nsecs_t)pic->TimeStampUs);
+
+    memset(meta, 0, sizeof(cam_frame_meta_t));
+    if ((stamp > 0) && (stamp <= now) && ((now - stamp) < s2ns(1))) {
+        meta->timestamp = stamp;
+    } else {
+        meta->timestamp = now;
+        if ((mFrameStampMisses++ % 300) == 0)
+            LOG1("%s(%d): engine stamp %lld us is off the monotonic clock, frames are stamped on arrival",
+                __FUNCTION__,__LINE__,(long long)pic->TimeStampUs);
+    }
+    meta->sequence = mFrameSeq++;
+    meta->lens_pos = -1;
+}
+
+void CameraIspAdapter::zslPush(MediaBuffer_t* buf, void* vir, ulong_t phy, int width, int height,
+                               int y_stride, ulong_t uv_offset, int fmt, const cam_frame_meta_t* meta)
+{
+    isp_zsl_frame_s* frame;
+
+    Mutex::Autolock lock(mZslLock);
+    frame = &mZslRing[mZslHead];
+    if (mZslCnt == mZslDepth)
+        MediaBufUnlockBuffer(frame->buf);
+    else
+        mZslCnt++;
+    MediaBufLockBuffer(buf);
+    frame->buf = buf;
+    frame->vir_addr = vir;
+    frame->phy_addr = phy;
+    frame->width = width;
+    frame->height = height;
+    frame->y_stride = y_stride;
+    frame->uv_offset = uv_offset;
+    frame->fmt = fmt;
+    frame->meta = *meta;
+    mZslHead = (mZslHead + 1) % mZslDepth;
+}
+
+//the ring keeps its own lock on the picked buffer, the caller takes another one
+bool CameraIspAdapter::zslPick(isp_zsl_frame_s* frame)
+{
+    Mutex::Autolock lock(mZslLock);
+    nsecs_t best = -1, lag;
+    int i,cur,idx = -1;
+
+    if ((mZslShutter == 0) || (mZslCnt == 0))
+        return false;
+    for (i = 0; i < mZslCnt; i++) {
+        cur = (zslOldest() + i) % mZslDepth;
+        lag = mZslRing[cur].meta.timestamp - mZslShutter;
+        if (lag < 0)
+            lag = -lag;
+        if ((best < 0) || (lag < best)) {
+            best = lag;
+            idx = cur;
+        }
+    }
+    *frame = mZslRing[idx];
+    LOG1("%s(%d): frame %lld us from shutter",__FUNCTION__,__LINE__,
+        (long long)((frame->meta.timestamp - mZslShutter)/1000));
+    mZslShutter = 0;
+    mZslPicks++;
+    if (best > mZslLagMax)
+        mZslLagMax = best;
+    return true;
+}
+
+void CameraIspAdapter::zslFlush()
+{
+    Mutex::Autolock lock(mZslLock);
+    int i;
+
+    for (i = 0; i < mZslCnt; i++)
+        MediaBufUnlockBuffer(mZslRing[(zslOldest() + i) % mZslDepth].buf);
+    if (mZslPicks)
+        LOG1("%s(%d): %d zsl pictures, max %lld us from shutter",__FUNCTION__,__LINE__,
+            mZslPicks,(long long)(mZslLagMax/1000));
+    memset(mZslRing, 0, sizeof(mZslRing));
+    mZslHead = 0;
+    mZslCnt = 0;
+    mZslShutter = 0;
+    mZslPicks = 0;
+    mZslLagMax = 0;
+}
+
+//mZslLock held
+int CameraIspAdapter::zslOldest()
+{
+    return (mZslHead + mZslDepth - mZslCnt) % mZslDepth;
+}
+
+//gives the oldest kept frame back to the engine
+void CameraIspAdapter::zslDropOldest()
+{
+    Mutex::Autolock lock(mZslLock);
+
+    if (mZslCnt == 0)
+        return;
+    MediaBufUnlockBuffer(mZslRing[zslOldest()].buf);
+    mZslCnt--;
+}
+
+int CameraIspAdapter::zslHeld()
+{
+    Mutex::Autolock lock(mZslLock);
+    return mZslCnt;
+}
+
 void CameraIspAdapter::bufferCb( MediaBuffer_t* pMediaBuffer )
 {
     static int writeoneframe = 0;
@@ -2328,6 +2540,10 @@ void CameraIspAdapter::bufferCb( MediaBuffer_t* pMediaBuffer )
     int fmt = 0;
 	int tem_val;
 	ulong_t phy_addr=0;
+	nsecs_t now;
+	int y_stride = 0;
+	ulong_t uv_offset = 0;
+	cam_frame_meta_t meta;
 
 	Mutex::Autolock lock(mLock);
     // get & check buffer meta data
@@ -2350,35 +2566,43 @@ void CameraIspAdapter::bufferCb( MediaBuffer_t* pMediaBuffer )
             width = pPicBufMetaData->Data.YCbCr.semiplanar.Y.PicWidthPixel;
             height = pPicBufMetaData->Data.YCbCr.semiplanar.Y.PicHeightPixel;
             //get vir addr
-            HalMapMemory( tmpHandle, y_addr, 100, HAL_MAPMEM_READWRITE, &y_addr_vir );
-            HalMapMemory( tmpHandle, uv_addr, 100, HAL_MAPMEM_READWRITE, &uv_addr_vir );
+            mapIspBuffer(tmpHandle, y_addr, &y_addr_vir, NULL);
+            mapIspBuffer(tmpHandle, uv_addr, &uv_addr_vir, NULL);
 
 			
 #if defined(RK_DRM_GRALLOC) // should use fd
-			HalGetMemoryMapFd(tmpHandle, y_addr,(int*)&phy_addr);
+			mapIspBuffer(tmpHandle, y_addr, NULL, (int*)&phy_addr);
 #else
             if(gCamInfos[mCamId].pcam_total_info->mIsIommuEnabled)
-                HalGetMemoryMapFd(tmpHandle, y_addr,(int*)&phy_addr);
+                mapIspBuffer(tmpHandle, y_addr, NULL, (int*)&phy_addr);
             else
                 phy_addr = y_addr;
 #endif
            
             /* ddl@rock-chips.com:  v1.3.0 */
+            //consumers read the planes in place, only the ones taking a single packed buffer need them moved
             y_size = pPicBufMetaData->Data.YCbCr.semiplanar.Y.PicWidthPixel*pPicBufMetaData->Data.YCbCr.semiplanar.Y.PicHeightPixel;
-            if (uv_addr > (y_addr+y_size)) {
-                memcpy((void*)((ulong_t)y_addr_vir+y_size),uv_addr_vir, y_size/2);
+            y_stride = pPicBufMetaData->Data.YCbCr.semiplanar.Y.PicWidthBytes;
+            uv_offset = uv_addr - y_addr;
+            if ((y_stride == width) && (uv_offset == y_size)) {
+                y_stride = 0;
+                uv_offset = 0;
+            } else if (y_addr_vir && (mIsSendToTunningTh || mfd.enable || uvnr.enable)) {
+                ispPackNv12((unsigned char*)y_addr_vir, width, height, y_stride ? y_stride : width, uv_offset);
+                y_stride = 0;
+                uv_offset = 0;
             }
             
         }else if(pPicBufMetaData->Layout == PIC_BUF_LAYOUT_COMBINED){
             y_addr = (ulong_t)(pPicBufMetaData->Data.YCbCr.combined.pBuffer );
             width = pPicBufMetaData->Data.YCbCr.combined.PicWidthPixel>>1;
             height = pPicBufMetaData->Data.YCbCr.combined.PicHeightPixel;
-            HalMapMemory( tmpHandle, y_addr, 100, HAL_MAPMEM_READWRITE, &y_addr_vir );
+            mapIspBuffer(tmpHandle, y_addr, &y_addr_vir, NULL);
 #if defined(RK_DRM_GRALLOC) // should use fd
-			HalGetMemoryMapFd(tmpHandle, y_addr,(int*)&phy_addr);
+			mapIspBuffer(tmpHandle, y_addr, NULL, (int*)&phy_addr);
 #else
             if(gCamInfos[mCamId].pcam_total_info->mIsIommuEnabled)
-                HalGetMemoryMapFd(tmpHandle, y_addr,(int*)&phy_addr);
+                mapIspBuffer(tmpHandle, y_addr, NULL, (int*)&phy_addr);
             else
                 phy_addr = y_addr;
 #endif
@@ -2390,12 +2614,12 @@ void CameraIspAdapter::bufferCb( MediaBuffer_t* pMediaBuffer )
         width = pPicBufMetaData->Data.raw.PicWidthPixel;
         height = pPicBufMetaData->Data.raw.PicHeightPixel;
         fmt = V4L2_PIX_FMT_SBGGR10;
-        HalMapMemory( tmpHandle, y_addr, 100, HAL_MAPMEM_READWRITE, &y_addr_vir );
+        mapIspBuffer(tmpHandle, y_addr, &y_addr_vir, NULL);
 #if defined(RK_DRM_GRALLOC) // should use fd
-		HalGetMemoryMapFd(tmpHandle, y_addr,(int*)&phy_addr);
+		mapIspBuffer(tmpHandle, y_addr, NULL, (int*)&phy_addr);
 #else
         if(gCamInfos[mCamId].pcam_total_info->mIsIommuEnabled)
-            HalGetMemoryMapFd(tmpHandle, y_addr,(int*)&phy_addr);
+            mapIspBuffer(tmpHandle, y_addr, NULL, (int*)&phy_addr);
         else
             phy_addr = y_addr;
 #endif		
@@ -2427,28 +2651,27 @@ void CameraIspAdapter::bufferCb( MediaBuffer_t* pMediaBuffer )
 #endif
 
 
+    if(!mIsSendToTunningTh && y_addr_vir && ((fmt == V4L2_PIX_FMT_NV12) || (fmt == V4L2_PIX_FMT_YUYV))
+        && ((mPreviewStatsCnt++ % PREVIEW_STATS_INTERVAL) == 0)) {
+        updatePreviewStats((const unsigned char*)y_addr_vir, width, height, y_stride, fmt);
+    }
+
+    now = systemTime(CLOCK_MONOTONIC);
+    ispFrameMeta(pPicBufMetaData, now, &meta);
     if(mIsSendToTunningTh){
-        MediaBufLockBuffer( pMediaBuffer );
-        //new frames
-        FramInfo_s *tmpFrame=(FramInfo_s *)malloc(sizeof(FramInfo_s));
-        if(!tmpFrame){
-            MediaBufUnlockBuffer( pMediaBuffer );
-            return;
-        }
-        //add to vector
-        memset(tmpFrame, 0x0, sizeof(*tmpFrame));
-        tmpFrame->frame_index = (ulong_t)tmpFrame; 
+        FramInfo_s *tmpFrame = mBufferLease.acquire(pMediaBuffer, LEASE_TUNING, now);
+        if(!tmpFrame)
+            goto end;
         tmpFrame->phy_addr = (ulong_t)phy_addr;
         tmpFrame->frame_width = width;
         tmpFrame->frame_height= height;
         tmpFrame->vir_addr = (ulong_t)y_addr_vir;
+        tmpFrame->y_stride = y_stride;
+        tmpFrame->uv_offset = uv_offset;
+        tmpFrame->meta = meta;
         tmpFrame->frame_fmt = fmt;
         tmpFrame->used_flag = (ulong_t)pMediaBuffer; // tunning thread will use pMediaBuffer
 
-        {
-            Mutex::Autolock lock(mFrameArrayLock);
-            mFrameInfoArray.add((void*)tmpFrame,(void*)pMediaBuffer);
-        }
         Message_cam msg;
         msg.command = ISP_TUNNING_CMD_PROCESS_FRAME;
         msg.arg2 = (void*)(tmpFrame);
@@ -2456,55 +2679,66 @@ void CameraIspAdapter::bufferCb( MediaBuffer_t* pMediaBuffer )
         mISPTunningQ->put(&msg);
 
     }else{
+        if ((mZslDepth > 0) && y_addr_vir && (fmt == V4L2_PIX_FMT_NV12))
+            zslPush(pMediaBuffer, y_addr_vir, phy_addr, width, height, y_stride, uv_offset, fmt, &meta);
+        //engine close to running dry: give back the oldest zsl frame, late consumers skip this one
+        int held = zslHeld();
+        if (mBufferLease.starving(held) && held) {
+            zslDropOldest();
+            held = zslHeld();
+        }
+        bool sendDisplay = mRefDisplayAdapter->isNeedSendToDisplay() && mBufferLease.admit(LEASE_DISPLAY, held, now);
+        bool sendVideo = mRefEventNotifier->isNeedSendToVideo() && mBufferLease.admit(LEASE_VIDEO, held, now);
+        bool sendDataCb = mRefEventNotifier->isNeedSendToDataCB() && (mRefDisplayAdapter->getDisplayStatus() == 0)
+                            && mBufferLease.admit(LEASE_DATACB, held, now);
+        //leased before the fanout mask is set, a consumer without a lease just skips this frame
+        FramInfo_s *displayFrame = sendDisplay ? mBufferLease.acquire(pMediaBuffer, LEASE_DISPLAY, now) : NULL;
+        FramInfo_s *videoFrame = sendVideo ? mBufferLease.acquire(pMediaBuffer, LEASE_VIDEO, now) : NULL;
+        FramInfo_s *dataCbFrame = sendDataCb ? mBufferLease.acquire(pMediaBuffer, LEASE_DATACB, now) : NULL;
+        sendDisplay = (displayFrame != NULL);
+        sendVideo = (videoFrame != NULL);
+        sendDataCb = (dataCbFrame != NULL);
+
+        //outputs wanted by more than one consumer are rendered once
+        if (y_addr_vir && (fmt == V4L2_PIX_FMT_NV12)) {
+            unsigned int mask = (sendDisplay ? (1 << FANOUT_CONSUMER_DISPLAY) : 0)
+                                | (sendVideo ? (1 << FANOUT_CONSUMER_VIDEO) : 0)
+                                | (sendDataCb ? (1 << FANOUT_CONSUMER_DATACB) : 0);
+            mFrameFanout.beginFrame((unsigned long)y_addr_vir, width, height, y_stride, (long)uv_offset, mZoomVal, mask);
+        }
         //need to send face detection ?
-    	if(mRefEventNotifier->isNeedSendToFaceDetect()){  
-    	    MediaBufLockBuffer( pMediaBuffer );
-    		//new frames
-    		FramInfo_s *tmpFrame=(FramInfo_s *)malloc(sizeof(FramInfo_s));
-    		if(!tmpFrame){
-    			MediaBufUnlockBuffer( pMediaBuffer );
-    			return;
-          }
-          //add to vector
-          memset(tmpFrame, 0x0, sizeof(*tmpFrame));
-          tmpFrame->frame_index = (ulong_t)tmpFrame; 
+    	FramInfo_s *faceFrame = NULL;
+    	if(mRefEventNotifier->isNeedSendToFaceDetect() && mBufferLease.admit(LEASE_FACEDETECT, held, now))
+    	    faceFrame = mBufferLease.acquire(pMediaBuffer, LEASE_FACEDETECT, now);
+    	if(faceFrame){  
+    	    FramInfo_s *tmpFrame = faceFrame;
           tmpFrame->phy_addr = (ulong_t)phy_addr;
           tmpFrame->frame_width = width;
           tmpFrame->frame_height= height;
           tmpFrame->vir_addr = (ulong_t)y_addr_vir;
+          tmpFrame->y_stride = y_stride;
+          tmpFrame->uv_offset = uv_offset;
+          tmpFrame->meta = meta;
           tmpFrame->frame_fmt = fmt;
     	  
-          tmpFrame->used_flag = 4;
 
           tmpFrame->zoom_value = mZoomVal;
         
-          {
-            Mutex::Autolock lock(mFrameArrayLock);
-            mFrameInfoArray.add((void*)tmpFrame,(void*)pMediaBuffer);
-
-          }
           mRefEventNotifier->notifyNewFaceDecFrame(tmpFrame);
         }
     	//need to display ?
-    	if(mRefDisplayAdapter->isNeedSendToDisplay()){  
+    	if(sendDisplay){  
 	    	property_set("sys.hdmiin.display", "1");//just used by hdmi-in
-    	    MediaBufLockBuffer( pMediaBuffer );
-    		//new frames
-    		FramInfo_s *tmpFrame=(FramInfo_s *)malloc(sizeof(FramInfo_s));
-    		if(!tmpFrame){
-    			MediaBufUnlockBuffer( pMediaBuffer );
-    			return;
-          }
-          //add to vector
-          memset(tmpFrame, 0x0, sizeof(*tmpFrame));
-          tmpFrame->frame_index = (ulong_t)tmpFrame; 
+    	    FramInfo_s *tmpFrame = displayFrame;
           tmpFrame->phy_addr = (ulong_t)phy_addr;
           tmpFrame->frame_width = width;
           tmpFrame->frame_height= height;
           tmpFrame->vir_addr = (ulong_t)y_addr_vir;
+          tmpFrame->y_stride = y_stride;
+          tmpFrame->uv_offset = uv_offset;
+          tmpFrame->meta = meta;
           tmpFrame->frame_fmt = fmt;
     	  
-          tmpFrame->used_flag = 0;
 
           #if (USE_RGA_TODO_ZOOM == 1)  
              tmpFrame->zoom_value = mZoomVal;
@@ -2515,34 +2749,21 @@ void CameraIspAdapter::bufferCb( MediaBuffer_t* pMediaBuffer )
              tmpFrame->zoom_value = 100;
           #endif
         
-          {
-            Mutex::Autolock lock(mFrameArrayLock);
-            mFrameInfoArray.add((void*)tmpFrame,(void*)pMediaBuffer);
-            mDispFrameLeak++;
-
-          }
           mRefDisplayAdapter->notifyNewFrame(tmpFrame);
 
         }
 
     	//video enc ?
-    	if(mRefEventNotifier->isNeedSendToVideo()) {
-            MediaBufLockBuffer( pMediaBuffer );
-            //new frames
-            FramInfo_s *tmpFrame=(FramInfo_s *)malloc(sizeof(FramInfo_s));
-            if(!tmpFrame){
-            	MediaBufUnlockBuffer( pMediaBuffer );
-            	return;
-            }          
-            //add to vector
-            memset(tmpFrame, 0x0, sizeof(*tmpFrame));
-            tmpFrame->frame_index = (ulong_t)tmpFrame; 
+    	if(sendVideo) {
+            FramInfo_s *tmpFrame = videoFrame;
             tmpFrame->phy_addr = (ulong_t)phy_addr;
             tmpFrame->frame_width = width;
             tmpFrame->frame_height= height;
             tmpFrame->vir_addr = (ulong_t)y_addr_vir;
+            tmpFrame->y_stride = y_stride;
+            tmpFrame->uv_offset = uv_offset;
+            tmpFrame->meta = meta;
             tmpFrame->frame_fmt = fmt;
-            tmpFrame->used_flag = 1;
 #if (USE_RGA_TODO_ZOOM == 1)  
             tmpFrame->zoom_value = mZoomVal;
 #else
@@ -2553,45 +2774,80 @@ void CameraIspAdapter::bufferCb( MediaBuffer_t* pMediaBuffer )
             }
 #endif
           
-            {
-                Mutex::Autolock lock(mFrameArrayLock);
-                mFrameInfoArray.add((void*)tmpFrame,(void*)pMediaBuffer);
-                mVideoEncFrameLeak++;
-            }
             mRefEventNotifier->notifyNewVideoFrame(tmpFrame);		
     	}
         
     	//picture ?
     	if(mRefEventNotifier->isNeedSendToPicture()){
             bool send_to_pic = true;
-			MediaBufLockBuffer( pMediaBuffer );
-            //new frames
-            FramInfo_s *tmpFrame=(FramInfo_s *)malloc(sizeof(FramInfo_s));
-            if(!tmpFrame){
-				MediaBufUnlockBuffer( pMediaBuffer );
-				return;
+            MediaBuffer_t* picMediaBuffer = pMediaBuffer;
+            void* picVir = y_addr_vir;
+            ulong_t picPhy = phy_addr;
+            int picWidth = width, picHeight = height;
+            int picStride = y_stride;
+            ulong_t picUvOffset = uv_offset;
+            cam_frame_meta_t picMeta = meta;
+            isp_zsl_frame_s zsl;
+            //zsl: encode the kept frame closest to the shutter, multi-frame denoise takes live frames
+            bool zsl_hit = !mfd.enable && zslPick(&zsl);
+            if (zsl_hit) {
+                picMediaBuffer = zsl.buf;
+                picVir = zsl.vir_addr;
+                picPhy = zsl.phy_addr;
+                picWidth = zsl.width;
+                picHeight = zsl.height;
+                picStride = zsl.y_stride;
+                picUvOffset = zsl.uv_offset;
+                picMeta = zsl.meta;
             }
-			memset(tmpFrame, 0x0, sizeof(*tmpFrame));
-			{
+			FramInfo_s *tmpFrame = mBufferLease.acquire(picMediaBuffer, LEASE_PICTURE, now);
+			//no lease: the picture takes a later frame, the other consumers still get this one
+			if (tmpFrame) {
 				if (mfd.enable) {
-					mfd_buffers_capture->start = y_addr_vir;
-					mfd_buffers_capture->share_fd = phy_addr;
-					mfd_buffers_capture->length = width * height * 3 / 2;
+					mfd_buffers_capture->start = picVir;
+					mfd_buffers_capture->share_fd = picPhy;
+					mfd_buffers_capture->length = picWidth * picHeight * 3 / 2;
 					mfd_buffers_capture->handle = NULL;
-					if (!mMutliFrameDenoise->initialized) {
-						mMfdFBOWidth = width;
-						mMfdFBOHeight = height;
-						mfdsendBlockedMsg(CMD_GPU_PROCESS_INIT);
+					if (!mMfdUseCpu && !mMutliFrameDenoise->initialized) {
+						char mfd_engine[PROPERTY_VALUE_MAX];
+						property_get(CAMERAHAL_MFD_ENGINE_PROPERTY_KEY, mfd_engine, "auto");
+						mMfdFBOWidth = picWidth;
+						mMfdFBOHeight = picHeight;
+						if (strcmp(mfd_engine, "cpu"))
+							mfdsendBlockedMsg(CMD_GPU_PROCESS_INIT);
+						if (!mMutliFrameDenoise->initialized && strcmp(mfd_engine, "gpu")) {
+							LOGD("%s(%d): gpu multi-frame denoise unavailable, use cpu engine",__FUNCTION__,__LINE__);
+							mMfdUseCpu = true;
+						}
 					}
-					if((mfd.frame_cnt == 0) && (mMutliFrameDenoise->initialized)) {
-						LOGE("mMutliFrameDenoise->initialized:%d,mfd.frame_cnt:%d	hcc101802!",mMutliFrameDenoise->initialized,mfd.frame_cnt);
-						mfdsendBlockedMsg(CMD_GPU_PROCESS_SETFRAMES);
-						LOGE("CMD_GPU_PROCESS_SETFRAMES finish!");
+					if (mMfdUseCpu && mMfdCpu->init(picWidth, picHeight))
+						mfd.frame_cnt = mfd.process_frames;
+					if(mfd.frame_cnt == 0) {
+						if (mMfdUseCpu) {
+							mfdSelectFrames();
+							//the engine merges at most MFD_CPU_FRAMES_MAX, don't feed it more
+							if (mfd.process_frames > MFD_CPU_FRAMES_MAX)
+								mfd.process_frames = MFD_CPU_FRAMES_MAX;
+							else if (mfd.process_frames < 1)
+								mfd.process_frames = 1;
+							mMfdCpu->setFrames(mfd.process_frames, mfdISO);
+						} else if (mMutliFrameDenoise->initialized) {
+							LOGE("mMutliFrameDenoise->initialized:%d,mfd.frame_cnt:%d	hcc101802!",mMutliFrameDenoise->initialized,mfd.frame_cnt);
+							mfdsendBlockedMsg(CMD_GPU_PROCESS_SETFRAMES);
+							LOGE("CMD_GPU_PROCESS_SETFRAMES finish!");
+						}
 					}
 					if(mfd.frame_cnt < mfd.process_frames) {
-						mfdsendBlockedMsg(CMD_GPU_PROCESS_UPDATE);
+						if (mMfdUseCpu) {
+							//queued by reference, the engine unlocks it once merged; a dropped frame doesn't count
+							MediaBufLockBuffer( picMediaBuffer );
+							if (mMfdCpu->updateImageData((void*)picVir, mfdCpuReleaseFrame, this, picMediaBuffer) == 0)
+								mfd.frame_cnt++ ;
+						} else {
+							mfdsendBlockedMsg(CMD_GPU_PROCESS_UPDATE);
+							mfd.frame_cnt++ ;
+						}
 						mfd.buffer_full = false;
-						mfd.frame_cnt++ ;
 					} else {
 						mfd.frame_cnt = 0;
 						mfd.buffer_full = true;
@@ -2602,7 +2858,7 @@ void CameraIspAdapter::bufferCb( MediaBuffer_t* pMediaBuffer )
 				}
 			}
 
-			if(mfd.buffer_full == true) {
+			if(tmpFrame && (mfd.buffer_full == true)) {
 				#if 0
 	             if(mFlashStatus && ((ulong_t)(pPicBufMetaData->priv) != 1)){
 	                pPicBufMetaData->priv = NULL;
@@ -2612,8 +2868,10 @@ void CameraIspAdapter::bufferCb( MediaBuffer_t* pMediaBuffer )
 	            #endif
 				if (send_to_pic) {
 					float flash_luminance = 0;
-					tmpFrame->vir_addr = (ulong_t)y_addr_vir;
-	                if ((mMutliFrameDenoise->initialized) && (mfd.enable)) {
+					tmpFrame->vir_addr = (ulong_t)picVir;
+	                if (mMfdUseCpu && mfd.enable) {
+	                    mMfdCpu->getResult(tmpFrame->vir_addr);
+	                } else if ((mMutliFrameDenoise->initialized) && (mfd.enable)) {
 						mfdsendBlockedMsg(CMD_GPU_PROCESS_RENDER);
 	                    mMutliFrameDenoise->getResult(tmpFrame->vir_addr);
 	                }
@@ -2624,14 +2882,14 @@ void CameraIspAdapter::bufferCb( MediaBuffer_t* pMediaBuffer )
 
 					if (uvnr.enable) {
 						if (!mCameraGL->initialized) {
-							mGpuFBOWidth = width;
-							mGpuFBOHeight = height;
+							mGpuFBOWidth = picWidth;
+							mGpuFBOHeight = picHeight;
 							sendBlockedMsg(CMD_GPU_PROCESS_INIT);
 						}
 
 						m_buffers_capture->start = (void *)tmpFrame->vir_addr;
-						m_buffers_capture->share_fd = phy_addr;
-						m_buffers_capture->length = width * height * 3 / 2;
+						m_buffers_capture->share_fd = picPhy;
+						m_buffers_capture->length = picWidth * picHeight * 3 / 2;
 						m_buffers_capture->handle = NULL;
 
 						sendBlockedMsg(CMD_GPU_PROCESS_UPDATE);
@@ -2641,14 +2899,15 @@ void CameraIspAdapter::bufferCb( MediaBuffer_t* pMediaBuffer )
 					if( tmpFrame->vir_addr == NULL) {
 						LOGE("uvnr tmpFrame->vir_addr is NULL!");
 					}
-	                //add to vector
-	                tmpFrame->frame_index = (ulong_t)tmpFrame; 
-	                tmpFrame->phy_addr = (ulong_t)phy_addr;
-	                tmpFrame->frame_width = width;
-	                tmpFrame->frame_height= height;
+	                tmpFrame->phy_addr = (ulong_t)picPhy;
+	                tmpFrame->frame_width = picWidth;
+	                tmpFrame->frame_height= picHeight;
+	                //packed when denoise is on, bufferCb packs the source for it
+	                tmpFrame->y_stride = picStride;
+	                tmpFrame->uv_offset = picUvOffset;
+	                tmpFrame->meta = picMeta;
 	                //tmpFrame->vir_addr = (ulong_t)y_addr_vir;
 	                tmpFrame->frame_fmt = fmt;
-	                tmpFrame->used_flag = 2;
 	                tmpFrame->res = &mImgAllFovReq;
 #if (USE_RGA_TODO_ZOOM == 1)  
 	                tmpFrame->zoom_value = mZoomVal;
@@ -2659,36 +2918,32 @@ void CameraIspAdapter::bufferCb( MediaBuffer_t* pMediaBuffer )
 	                    tmpFrame->zoom_value = 100;
 	                }
 #endif
-	                {
-	                    Mutex::Autolock lock(mFrameArrayLock);
-	                    mFrameInfoArray.add((void*)tmpFrame,(void*)pMediaBuffer);
-	                    mPicEncFrameLeak++;
-	                }
 	                picture_info_s &picinfo = mRefEventNotifier->getPictureInfoRef();
 	                getCameraParamInfo(picinfo.cameraparam);
+	                //a producer that knows the frame's own exposure overrides the engine state
+	                if (picMeta.exposure > 0) {
+	                    picinfo.cameraparam.ExposureTime = picMeta.exposure;
+	                    picinfo.cameraparam.ISOSpeedRatings = picMeta.gain;
+	                }
 	                mRefEventNotifier->notifyNewPicFrame(tmpFrame);
 	            }
+            } else if (tmpFrame) {
+                //burst frame consumed by denoise, not sent to picture
+                mBufferLease.release(tmpFrame);
             }
     	}
 
     	//preview data callback ?
-    	if(mRefEventNotifier->isNeedSendToDataCB() && (mRefDisplayAdapter->getDisplayStatus() == 0)) {
-            MediaBufLockBuffer( pMediaBuffer );
-            //new frames
-            FramInfo_s *tmpFrame=(FramInfo_s *)malloc(sizeof(FramInfo_s));
-            if(!tmpFrame){
-            	MediaBufUnlockBuffer( pMediaBuffer );
-            	return;
-            }
-            //add to vector
-            memset(tmpFrame, 0x0, sizeof(*tmpFrame));
-            tmpFrame->frame_index = (ulong_t)tmpFrame; 
+    	if(sendDataCb) {
+            FramInfo_s *tmpFrame = dataCbFrame;
             tmpFrame->phy_addr = (ulong_t)phy_addr;
             tmpFrame->frame_width = width;
             tmpFrame->frame_height= height;
             tmpFrame->vir_addr = (ulong_t)y_addr_vir;
+            tmpFrame->y_stride = y_stride;
+            tmpFrame->uv_offset = uv_offset;
+            tmpFrame->meta = meta;
             tmpFrame->frame_fmt = fmt;
-            tmpFrame->used_flag = 3;
 #if (USE_RGA_TODO_ZOOM == 1)  
             tmpFrame->zoom_value = mZoomVal;
 #else
@@ -2699,11 +2954,6 @@ void CameraIspAdapter::bufferCb( MediaBuffer_t* pMediaBuffer )
             }
 #endif
 
-            {
-                Mutex::Autolock lock(mFrameArrayLock);
-                mFrameInfoArray.add((void*)tmpFrame,(void*)pMediaBuffer);
-                mPreviewCBFrameLeak++;
-            }
                 mRefEventNotifier->notifyNewPreviewCbFrame(tmpFrame);			
         }
     }
@@ -2738,7 +2988,7 @@ void CameraIspAdapter::dump(int cameraId)
         //parse tunning xml file
         mIspTunningTask = CameraIspTunning::createInstance();
         if(mIspTunningTask){
-            mISPTunningThread->run("CamISPTunningThread",ANDROID_PRIORITY_NORMAL);
+            mISPTunningThread->run("CamISPTunningThread",CameraThreadConfig::priority("CamISPTunningThread"));
             msg.command = ISP_TUNNING_CMD_START;
             mISPTunningQ->put(&msg);
             mISPTunningRun = true;
@@ -2830,6 +3080,18 @@ bool CameraIspAdapter::isLowIllumin(const float lumaThreshold)
     m_camDevice->getGainLimits(mingain,maxgain,step);
     m_camDevice->getIntegrationTimeLimits(mintime,maxtime,step);
     meanluma = m_camDevice->getAecMeanLuminance();
+    {
+        Mutex::Autolock lock(mPreviewStatsLock);
+        if (mPreviewLuma.count && ((systemTime() - mPreviewLumaTime) < PREVIEW_STATS_MAX_AGE)) {
+            LOG1("    frame luma mean %d p10 %d p50 %d p90 %d, dark %d%% clipped %d%%",
+                CameraFrameStats::mean(&mPreviewLuma), CameraFrameStats::percentile(&mPreviewLuma, 10),
+                CameraFrameStats::percentile(&mPreviewLuma, 50), CameraFrameStats::percentile(&mPreviewLuma, 90),
+                mPreviewLuma.clip_low*100/mPreviewLuma.count, mPreviewLuma.clip_high*100/mPreviewLuma.count);
+            //aec mean luma is stale once aec is stopped (manual exposure, tuning)
+            if (!m_camDevice->isAecEnabled())
+                meanluma = CameraFrameStats::mean(&mPreviewLuma);
+        }
+    }
 
     m_camDevice->getAfStatus(enabled,searchAlgorithm,&sharpness);  /* ddl@rock-chips.com: v0.0x32.0 */     
 
@@ -2845,6 +3107,21 @@ bool CameraIspAdapter::isLowIllumin(const float lumaThreshold)
         return false;
 }
 
+void CameraIspAdapter::updatePreviewStats(const unsigned char* y, int width, int height, int stride, int fmt)
+{
+    cam_frame_stats_t stats;
+    int bpp = (fmt == V4L2_PIX_FMT_YUYV) ? 2 : 1;
+
+    //yuyv: even bytes are luma, an even column step keeps us on them; rows are rows either way
+    if (mPreviewStats.computeLuma8(y, width*bpp, height, stride ? stride : width*bpp,
+                                   PREVIEW_STATS_STEP*bpp, PREVIEW_STATS_STEP,
+                                   16, 235, CAM_STATS_FLAG_HIST, &stats) < 0)
+        return;
+    Mutex::Autolock lock(mPreviewStatsLock);
+    mPreviewLuma = stats;
+    mPreviewLumaTime = systemTime();
+}
+
 void CameraIspAdapter::flashControl(bool on)
 {
     if(mFlashStatus && !on){
@@ -3169,6 +3446,7 @@ PROCESS_CMD:
             case ISP_TUNNING_CMD_EXIT:
                 //restore saved config
                 mIsSendToTunningTh = false;
+                mIspTunningTask->ispTuneStreamClose();
                 stopPreview();
                 //mISPOutputFmt = oldFmt;
                 startPreview(800, 600, 0, 0, ISP_OUT_YUV420SP, false);
@@ -3179,6 +3457,7 @@ PROCESS_CMD:
 				FramInfo_s *frame = (FramInfo_s*)msg.arg2;
                 float newtime,newgain;
                 bool isStore = false;
+                isp_tune_frame_header_t frameInfo;
                 LOG1("tunning thread receive a frame !!");
                 //
                 if(skip_frames-- > 0)
@@ -3261,10 +3540,6 @@ PROCESS_CMD:
                 }
 
                 curTuneTask->mTunePicNum--;
-                //generate base file name
-                    
-                snprintf( szBaseFileName, sizeof(szBaseFileName)-1, "%st%0.3f_g%0.3f", "/data/isptune/",time, gain );
-                szBaseFileName[99] = '\0';
 
                 //store this frame
                 curTuneTask->y_addr = frame->vir_addr;
@@ -3275,16 +3550,36 @@ PROCESS_CMD:
                     curTuneTask->mForceRGBOut = false;
                 }
 
-                mIspTunningTask->ispTuneStoreBuffer(curTuneTask, (MediaBuffer_t * )frame->used_flag, 
-                                                    szBaseFileName, 0);
+                if(mIspTunningTask->mTuneStream){
+                    //one container per task, exposure and awb go to the frame header
+                    snprintf( szBaseFileName, sizeof(szBaseFileName)-1, "/data/isptune/task%02d", mIspTunningTask->mCurTunIndex );
+                    szBaseFileName[99] = '\0';
+                    memset(&frameInfo, 0, sizeof(frameInfo));
+                    frameInfo.integration_time = time;
+                    frameInfo.gain = gain;
+                    m_camDevice->wbGainGet(&frameInfo.wb_gain[0], &frameInfo.wb_gain[1], &frameInfo.wb_gain[2], &frameInfo.wb_gain[3]);
+                    //frame is returned by the writer once it has been packed
+                    mIspTunningTask->ispTuneStreamBuffer(curTuneTask, (MediaBuffer_t * )frame->used_flag,
+                                                        szBaseFileName, &frameInfo, ispTuneReleaseFrame, this, frame);
+                    frame = NULL;
+                }else{
+                    //generate base file name
+                    snprintf( szBaseFileName, sizeof(szBaseFileName)-1, "%st%0.3f_g%0.3f", "/data/isptune/",time, gain );
+                    szBaseFileName[99] = '\0';
+                    mIspTunningTask->ispTuneStoreBuffer(curTuneTask, (MediaBuffer_t * )frame->used_flag, 
+                                                        szBaseFileName, 0);
+                }
                 PROCESS_OVER:
                 //return this frame buffer
-                adapterReturnFrame(frame->frame_index, frame->used_flag);
+                if(frame)
+                    adapterReturnFrame(frame->frame_index, frame->used_flag);
 
                 //current task has been finished ? start next capture?
                 if(curTuneTask->mTunePicNum <= 0){
                     skip_frames = 0;
                     mIsSendToTunningTh = false;
+                    //drain the writer before preview stop takes the buffers back
+                    mIspTunningTask->ispTuneStreamClose();
                     stopPreview();
                     //remove redundant frame in queue
                     while(!mISPTunningQ->isEmpty())
@@ -3376,6 +3671,7 @@ int CameraIspAdapter::faceNotify(struct RectFace* faces, int* num)
     } else if (*num == 0) {
         m_camDevice->setAfMeasureWindow(0,0,0,0);
         m_camDevice->setAecHistMeasureWinAndMode(0,0,0,0,CentreWeightMetering);
+        mAecWinDirty = true;
     }
 
     return 0;
@@ -9,6 +9,9 @@
 #include <utils/KeyedVector.h>
 #include "CameraGL.h"
 #include "MutliFrameDenoise.h"
+#include "MutliFrameDenoiseCpu.h"
+#include "CameraFrameStats.h"
+#include "CameraBufferLease.h"
 
 namespace android{
 
@@ -31,6 +34,29 @@ typedef struct manExpConfig{
 	float clmtolerance;
 }manExpConfig_s;
 
+#define ISP_BUF_MAP_MAX     32      /* isp buffer planes whose mapping is remembered */
+
+typedef struct isp_buf_map{
+    ulong_t bus_addr;
+    void* vir_addr;                 /* NULL: not mapped yet */
+    int fd;                         /* -1: not queried yet */
+}isp_buf_map_s;
+
+#define CAMERAHAL_ZSL_PROPERTY_KEY  "sys_graphic.cam_hal.zsl"    /* frames kept for zsl, 0: off */
+#define ISP_ZSL_RING_MAX    4
+
+typedef struct isp_zsl_frame{
+    MediaBuffer_t* buf;             /* locked while in the ring */
+    void* vir_addr;
+    ulong_t phy_addr;
+    int width;
+    int height;
+    int y_stride;                   /* plane layout as in FramInfo_s */
+    ulong_t uv_offset;
+    int fmt;
+    cam_frame_meta_t meta;
+}isp_zsl_frame_s;
+
 typedef struct uvnrprocess{
 	bool enable;
 }uvnrprocess_s;
@@ -70,6 +96,8 @@ public:
     virtual status_t cancelAutoFocus();
     virtual int getCurPreviewState(int *drv_w,int *drv_h);
     virtual int selectPreferedDrvSize(int *width,int * height,bool is_capture);
+    virtual bool isZslEnabled();
+    virtual bool setZslShutter(nsecs_t shutter);
     void AfpsResChangeCb();
     virtual void bufferCb( MediaBuffer_t* pMediaBuffer );
 
@@ -95,6 +123,7 @@ public:
             : Thread(false), mCameraIspAdapter(disadap){}
 
         virtual bool threadLoop() {
+            CameraThreadConfig::enter("MFDCommandThread");
             mCameraIspAdapter->mfdCommandThread();
 
             return false;
@@ -104,6 +133,9 @@ public:
        void mfdsendBlockedMsg(int message);
        MutliFrameDenoise* mMutliFrameDenoise;
        struct cv_fimc_buffer* mfd_buffers_capture;
+       //cpu engine, used instead of the gpu one when the gpu can't be initialized
+       MutliFrameDenoiseCpu* mMfdCpu;
+       bool mMfdUseCpu;
 
 
     int mGPUCommandThreadState;
@@ -114,6 +146,7 @@ public:
             : Thread(false), mCameraIspAdapter(disadap){}
 
         virtual bool threadLoop() {
+            CameraThreadConfig::enter("GPUCommandThread");
             mCameraIspAdapter->gpuCommandThread();
 
             return false;
@@ -128,6 +161,7 @@ private:
     virtual int cameraCreate(int cameraId);
     virtual int cameraDestroy();
     virtual int adapterReturnFrame(long index,int cmd);
+    virtual CameraFrameFanout* getFrameFanout(){return &mFrameFanout;}
 
 
     //for isp
@@ -148,10 +182,17 @@ private:
     int stop();
 
     int afListenerThread(void);
-    int cameraConfig(const CameraParameters &tmpparams,bool isInit,bool &isRestartValue);
+    //changed: CAM_PARAM_* groups that differ from mParameters, only those are programmed
+    int cameraConfig(const CameraParameters &tmpparams,bool isInit,bool &isRestartValue,unsigned int changed);
     bool isLowIllumin(const float lumaThreshold);
     void flashControl(bool on);
     bool isNeedToEnableFlash();
+    void updatePreviewStats(const unsigned char* y, int width, int height, int stride, int fmt);
+    CameraFrameStats mPreviewStats;
+    cam_frame_stats_t mPreviewLuma;     /* subsampled luma of a recent preview frame */
+    nsecs_t mPreviewLumaTime;
+    unsigned int mPreviewStatsCnt;
+    Mutex mPreviewStatsLock;
 	void setMwb(const char *white_balance);
 	void setMe(const char *exposure);
     Mutex mMfdOPLock;
@@ -161,6 +202,9 @@ private:
     sp<MFDCommandThread> mMFDCommandThread;
     MessageQueue mfdCmdThreadCommandQ;
     void mfdCommandThread();
+    void mfdSelectFrames();
+    static void mfdCpuReleaseFrame(void* ctx, void* arg);
+    static void ispTuneReleaseFrame(void* ctx, void* arg);
 	uvnrprocess uvnr;
 
     Mutex mGpuOPLock;
@@ -174,16 +218,45 @@ private:
 
 protected:
     CamDevice       *m_camDevice;
-    KeyedVector<void *, void *> mFrameInfoArray;
-    Mutex  mFrameArrayLock;     
+    CameraBufferLease mBufferLease;
     void clearFrameArray();
 	mutable Mutex mLock;
+    //HalMapMemory/HalGetMemoryMapFd once per isp buffer, reset with the engine's buffer pools
+    int mapIspBuffer(HalHandle_t hal, ulong_t bus_addr, void** vir, int* fd);
+    void resetIspBufferMap();
+    isp_buf_map_s mBufMap[ISP_BUF_MAP_MAX];
+    int mBufMapCnt;
+    unsigned int mBufMapHits;
+    unsigned int mBufMapMisses;
+    Mutex mBufMapLock;
+    CameraFrameFanout mFrameFanout;
+    //capture state of an engine buffer, read once and copied into every frame made of it
+    void ispFrameMeta(const PicBufMetaData_t* pic, nsecs_t now, cam_frame_meta_t* meta);
+    unsigned int mFrameSeq;
+    unsigned int mFrameStampMisses;     /* engine stamps not on the monotonic clock */
+    //zsl ring of the latest main path frames, taken in bufferCb's picture path
+    void zslPush(MediaBuffer_t* buf, void* vir, ulong_t phy, int width, int height,
+                 int y_stride, ulong_t uv_offset, int fmt, const cam_frame_meta_t* meta);
+    bool zslPick(isp_zsl_frame_s* frame);
+    void zslFlush();
+    void zslDropOldest();
+    int zslHeld();
+    int zslOldest();
+    isp_zsl_frame_s mZslRing[ISP_ZSL_RING_MAX];
+    int mZslDepth;
+    int mZslHead;
+    int mZslCnt;
+    nsecs_t mZslShutter;            /* 0: no zsl picture pending */
+    unsigned int mZslPicks;
+    nsecs_t mZslLagMax;
+    Mutex mZslLock;
 
     std::string mSensorDriverFile[3];
     int mSensorItfCur;
     bool mFlashStatus;
 	CtxCbResChange_t mCtxCbResChange;
     bool mAfChk;
+    bool mAecWinDirty;                  /* engine aec window may differ from KEY_METERING_AREAS */
     class CameraAfThread :public Thread
     {
         //deque ֡ҪַDisplayAdapter༰EventNotifierࡣ
@@ -193,6 +266,7 @@ protected:
             : Thread(false), mCameraAdapter(adapter) { }
 
         virtual bool threadLoop() {
+            CameraThreadConfig::enter("CamAfLisThread");
             mCameraAdapter->afListenerThread();
 
             return false;
@@ -217,6 +291,7 @@ protected:
             : Thread(false), mCameraAdapter(adapter) { }
 
         virtual bool threadLoop() {
+            CameraThreadConfig::enter("CamISPTunningThread");
             mCameraAdapter->ispTunningThread();
 
             return false;
@@ -229,11 +304,6 @@ protected:
     int mISPOutputFmt;
     bool mISPTunningRun;
     bool mIsSendToTunningTh;    
-
-    int mDispFrameLeak;
-    int mVideoEncFrameLeak;
-    int mPreviewCBFrameLeak;
-    int mPicEncFrameLeak;
 private:
     
     awbStatus curAwbStatus;
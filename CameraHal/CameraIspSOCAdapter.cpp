@@ -44,8 +44,9 @@ void CameraIspSOCAdapter::setupPreview(int width_sensor,int height_sensor,int pr
                             CAMERIC_MI_DATAMODE_RAW12,CAMERIC_MI_DATASTORAGE_INTERLEAVED,(bool_t)false);
 	getSensorMaxRes(max_w,max_h);
 	bufSize = max_w*max_h*2*2;
-	bufNum = CONFIG_CAMERA_ISP_BUF_REQ_CNT; 
+	bufNum = CONFIG_CAMERA_ISP_BUF_REQ_CNT + mBufferLease.growBy(); 
 	m_camDevice->setIspBufferInfo(bufNum, bufSize);
+	mBufferLease.setPool(bufNum);
 }
 
 //for soc camera test
@@ -256,7 +257,7 @@ void CameraIspSOCAdapter::bufferCb( MediaBuffer_t* pMediaBuffer )
                 y_addr = (unsigned long)(pPicBufMetaData->Data.raw.pBuffer );
                 width = pPicBufMetaData->Data.raw.PicWidthPixel >> 1;
                 height = pPicBufMetaData->Data.raw.PicHeightPixel;
-                HalMapMemory( tmpHandle, y_addr, 100, HAL_MAPMEM_READWRITE, &y_addr_vir );
+                mapIspBuffer(tmpHandle, y_addr, &y_addr_vir, NULL);
                 m_camDevice->getYCSequence();
                 arm_isp_yuyv_12bit_to_8bit(width,height,(char*)y_addr_vir,m_camDevice->getYCSequence(),mIs10bit0To0);
                 y_addr += width*height*2;
@@ -287,142 +288,85 @@ void CameraIspSOCAdapter::bufferCb( MediaBuffer_t* pMediaBuffer )
         MediaBufLockBuffer( (MediaBuffer_t*)pMediaBuffer->pNext );
     }
 #if 1
+    nsecs_t now = systemTime(CLOCK_MONOTONIC);
+    cam_frame_meta_t meta;
+    ispFrameMeta(pPicBufMetaData, now, &meta);
     //need to send face detection ?
-	if(mRefEventNotifier->isNeedSendToFaceDetect()){  
-	    MediaBufLockBuffer( pMediaBuffer );
-		//new frames
-		FramInfo_s *tmpFrame=(FramInfo_s *)malloc(sizeof(FramInfo_s));
-		if(!tmpFrame){
-			MediaBufUnlockBuffer( pMediaBuffer );
-			return;
-      }
-      //add to vector
-      memset(tmpFrame, 0x0, sizeof(*tmpFrame));
-      tmpFrame->frame_index = (long)tmpFrame; 
+	if(mRefEventNotifier->isNeedSendToFaceDetect() && mBufferLease.admit(LEASE_FACEDETECT, 0, now)){  
+	    FramInfo_s *tmpFrame = mBufferLease.acquire(pMediaBuffer, LEASE_FACEDETECT, now);
+	    if(!tmpFrame)
+	        return;
       tmpFrame->phy_addr = (long)phy_addr;
       tmpFrame->frame_width = width;
       tmpFrame->frame_height= height;
       tmpFrame->vir_addr = (long)y_addr_vir;
       tmpFrame->frame_fmt = fmt;
-      tmpFrame->used_flag = 4;
       tmpFrame->zoom_value = mZoomVal;
-      {
-        Mutex::Autolock lock(mFrameArrayLock);
-        mFrameInfoArray.add((void*)tmpFrame,(void*)pMediaBuffer);
-
-      }
+      tmpFrame->meta = meta;
       mRefEventNotifier->notifyNewFaceDecFrame(tmpFrame);
     }
 	//need to display ?
-	if(mRefDisplayAdapter->isNeedSendToDisplay()){  
-	    MediaBufLockBuffer( pMediaBuffer );
-		//new frames
-		FramInfo_s *tmpFrame=(FramInfo_s *)malloc(sizeof(FramInfo_s));
-		if(!tmpFrame){
-			MediaBufUnlockBuffer( pMediaBuffer );
-			return;
-      }
-      //add to vector
-      memset(tmpFrame, 0x0, sizeof(*tmpFrame));
-      tmpFrame->frame_index = (long)tmpFrame; 
+	if(mRefDisplayAdapter->isNeedSendToDisplay() && mBufferLease.admit(LEASE_DISPLAY, 0, now)){  
+	    FramInfo_s *tmpFrame = mBufferLease.acquire(pMediaBuffer, LEASE_DISPLAY, now);
+	    if(!tmpFrame)
+	        return;
       tmpFrame->phy_addr = (long)(phy_addr);
       tmpFrame->frame_width = width;
       tmpFrame->frame_height= height;
       tmpFrame->vir_addr = (long)y_addr_vir;
       tmpFrame->frame_fmt = fmt;
       tmpFrame->zoom_value = mZoomVal;
-      tmpFrame->used_flag = 0;
+      tmpFrame->meta = meta;
       tmpFrame->vir_addr_valid = true;
-      {
-        Mutex::Autolock lock(mFrameArrayLock);
-        mFrameInfoArray.add((void*)tmpFrame,(void*)pMediaBuffer);
-        mDispFrameLeak++;
-      }
       mRefDisplayAdapter->notifyNewFrame(tmpFrame);
     }
 
 	//video enc ?
-	if(mRefEventNotifier->isNeedSendToVideo()){
-	    MediaBufLockBuffer( pMediaBuffer );
-		//new frames
-		FramInfo_s *tmpFrame=(FramInfo_s *)malloc(sizeof(FramInfo_s));
-		if(!tmpFrame){
-			MediaBufUnlockBuffer( pMediaBuffer );
-			return;
-      }
-      //add to vector
-      memset(tmpFrame, 0x0, sizeof(*tmpFrame));
-      tmpFrame->frame_index = (long)tmpFrame; 
+	if(mRefEventNotifier->isNeedSendToVideo() && mBufferLease.admit(LEASE_VIDEO, 0, now)){
+	    FramInfo_s *tmpFrame = mBufferLease.acquire(pMediaBuffer, LEASE_VIDEO, now);
+	    if(!tmpFrame)
+	        return;
       tmpFrame->phy_addr = (long)(phy_addr);
       tmpFrame->frame_width = width;
       tmpFrame->frame_height= height;
       tmpFrame->vir_addr = (long)y_addr_vir;
       tmpFrame->frame_fmt = fmt;
       tmpFrame->zoom_value = mZoomVal;
-      tmpFrame->used_flag = 1;
+      tmpFrame->meta = meta;
       tmpFrame->vir_addr_valid = true;
-      {
-        Mutex::Autolock lock(mFrameArrayLock);
-        mFrameInfoArray.add((void*)tmpFrame,(void*)pMediaBuffer);
-        mVideoEncFrameLeak++;
-      }
       mRefEventNotifier->notifyNewVideoFrame(tmpFrame);		
 	}
 	//picture ?
 	if(mRefEventNotifier->isNeedSendToPicture()){
-		MediaBufLockBuffer( pMediaBuffer );
-		//new frames
-		FramInfo_s *tmpFrame=(FramInfo_s *)malloc(sizeof(FramInfo_s));
-		if(!tmpFrame){
-			MediaBufUnlockBuffer( pMediaBuffer );
-			return;
-		}
-	  //add to vector
-	  memset(tmpFrame, 0x0, sizeof(*tmpFrame));
+		FramInfo_s *tmpFrame = mBufferLease.acquire(pMediaBuffer, LEASE_PICTURE, now);
+		if(!tmpFrame)
+		    return;
 	  //fmt = V4L2_PIX_FMT_NV12;
-	  tmpFrame->frame_index = (long)tmpFrame; 
 	  tmpFrame->phy_addr = (long)(phy_addr);
 	  tmpFrame->frame_width = width;
 	  tmpFrame->frame_height= height;
 	  tmpFrame->vir_addr = (long)y_addr_vir;
 	  tmpFrame->frame_fmt = fmt;
       tmpFrame->zoom_value = mZoomVal;
-      tmpFrame->used_flag = 2;
+      tmpFrame->meta = meta;
       tmpFrame->res = &mImgAllFovReq;
       tmpFrame->vir_addr_valid = true;
-	  {
-        Mutex::Autolock lock(mFrameArrayLock);
-        mFrameInfoArray.add((void*)tmpFrame,(void*)pMediaBuffer);
-        mPicEncFrameLeak++;
-      }
 	  mRefEventNotifier->notifyNewPicFrame(tmpFrame);	
 	}
 
 	//preview data callback ?
-	if(mRefEventNotifier->isNeedSendToDataCB()){
-		MediaBufLockBuffer( pMediaBuffer );
-		//new frames
-		FramInfo_s *tmpFrame=(FramInfo_s *)malloc(sizeof(FramInfo_s));
-		if(!tmpFrame){
-			MediaBufUnlockBuffer( pMediaBuffer );
-			return;
-		}
-	  //add to vector
-	  memset(tmpFrame, 0x0, sizeof(*tmpFrame));
-	  tmpFrame->frame_index = (long)tmpFrame; 
+	if(mRefEventNotifier->isNeedSendToDataCB() && mBufferLease.admit(LEASE_DATACB, 0, now)){
+		FramInfo_s *tmpFrame = mBufferLease.acquire(pMediaBuffer, LEASE_DATACB, now);
+		if(!tmpFrame)
+		    return;
 	  tmpFrame->phy_addr = (long)(phy_addr);
 	  tmpFrame->frame_width = width;
 	  tmpFrame->frame_height= height;
 	  tmpFrame->vir_addr =  (long)y_addr_vir;
 	  tmpFrame->frame_fmt = fmt;
       tmpFrame->zoom_value = mZoomVal;
-      tmpFrame->used_flag = 3;
+      tmpFrame->meta = meta;
       tmpFrame->vir_addr_valid = true;
-      {
-        Mutex::Autolock lock(mFrameArrayLock);
-        mFrameInfoArray.add((void*)tmpFrame,(void*)pMediaBuffer);
-        mPreviewCBFrameLeak++;
-      }
 	  mRefEventNotifier->notifyNewPreviewCbFrame(tmpFrame);			
 	}
 	#endif
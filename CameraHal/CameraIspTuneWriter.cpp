@@ -0,0 +1,297 @@
+#include "CameraIspTuneWriter.h"
+#include "CameraHal_Tracer.h"
+#include "Semaphore.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace android {
+
+#define ISP_TUNE_ALIGN_UP(x)    (((x) + ISP_TUNE_ALIGN - 1) & ~((size_t)ISP_TUNE_ALIGN - 1))
+
+CameraIspTuneWriter::CameraIspTuneWriter()
+    :mFd(-1),
+     mDirect(false),
+     mRecordSize(0),
+     mStaging(NULL),
+     mError(0),
+     mPending(0),
+     mPendingMax(0),
+     mWaits(0),
+     mFrames(0),
+     mBytes(0),
+     mOpenTime(0),
+     mWriteTime(0),
+     mJobQ("IspTuneWriterQ")
+{
+    memset(&mHeader, 0, sizeof(mHeader));
+}
+
+CameraIspTuneWriter::~CameraIspTuneWriter()
+{
+    close();
+}
+
+int CameraIspTuneWriter::open(const char* path, const isp_tune_file_header_t* header, bool direct)
+{
+    unsigned int i;
+    size_t payload = 0;
+
+    if (mFd >= 0)
+        close();
+
+    for (i = 0; i < header->plane_count && i < ISP_TUNE_PLANE_MAX; i++)
+        payload += header->row_bytes[i]*header->rows[i];
+    mRecordSize = ISP_TUNE_ALIGN_UP(sizeof(isp_tune_frame_header_t) + payload);
+    if (posix_memalign((void**)&mStaging, ISP_TUNE_ALIGN, mRecordSize) != 0) {
+        mStaging = NULL;
+        LOGE("%s(%d): alloc %d bytes staging buffer failed",__FUNCTION__,__LINE__,(int)mRecordSize);
+        return -1;
+    }
+
+    mDirect = false;
+    if (direct) {
+        mFd = ::open(path, O_WRONLY|O_CREAT|O_TRUNC|O_DIRECT, 0666);
+        if (mFd >= 0)
+            mDirect = true;
+        else
+            LOGD("%s(%d): O_DIRECT not supported for %s(%s), use buffered io",__FUNCTION__,__LINE__,path,strerror(errno));
+    }
+    if (mFd < 0)
+        mFd = ::open(path, O_WRONLY|O_CREAT|O_TRUNC, 0666);
+    if (mFd < 0) {
+        LOGE("%s(%d): open %s failed(%s)",__FUNCTION__,__LINE__,path,strerror(errno));
+        goto open_fail;
+    }
+
+    mHeader = *header;
+    mHeader.magic = CAMERA_ISPTUNE_MAGIC;
+    mHeader.version = CAMERA_ISPTUNE_VERSION;
+    mHeader.header_size = ISP_TUNE_ALIGN;
+    mHeader.align = ISP_TUNE_ALIGN;
+    mHeader.frame_count = 0;
+    mError = 0;
+    mPending = 0;
+    mPendingMax = 0;
+    mWaits = 0;
+    mFrames = 0;
+    mBytes = 0;
+    mWriteTime = 0;
+    mOpenTime = systemTime(CLOCK_MONOTONIC);
+    memset(mStaging, 0, ISP_TUNE_ALIGN);
+    memcpy(mStaging, &mHeader, sizeof(mHeader));
+    if (writeAll(mStaging, ISP_TUNE_ALIGN) < 0)
+        goto open_fail;
+
+    mThread = new TuneWriterThread(this);
+    mThread->run("IspTuneWriter", CameraThreadConfig::priority("IspTuneWriter"));
+    LOGD("%s(%d): %s %dx%d type 0x%x layout 0x%x, %d bytes per record%s",__FUNCTION__,__LINE__,
+        path,mHeader.width,mHeader.height,mHeader.pic_type,mHeader.pic_layout,(int)mRecordSize,
+        mDirect ? ", O_DIRECT" : "");
+    return 0;
+
+open_fail:
+    if (mFd >= 0) {
+        ::close(mFd);
+        mFd = -1;
+    }
+    free(mStaging);
+    mStaging = NULL;
+    return -1;
+}
+
+int CameraIspTuneWriter::queueFrame(const isp_tune_plane_t* planes, const isp_tune_frame_header_t* info,
+                                    isp_tune_release_func release, void* ctx, void* arg)
+{
+    isp_tune_job_t* job;
+    Message_cam msg;
+    unsigned int i;
+
+    if (mFd < 0) {
+        release(ctx, arg);
+        return -1;
+    }
+    job = (isp_tune_job_t*)malloc(sizeof(isp_tune_job_t));
+    if (job == NULL) {
+        release(ctx, arg);
+        return -1;
+    }
+    for (i = 0; i < ISP_TUNE_PLANE_MAX; i++) {
+        if (i < mHeader.plane_count)
+            job->planes[i] = planes[i];
+        else
+            memset(&job->planes[i], 0, sizeof(job->planes[i]));
+    }
+    job->info = *info;
+    job->release = release;
+    job->ctx = ctx;
+    job->arg = arg;
+
+    {
+        Mutex::Autolock lock(mJobLock);
+        //back pressure: the isp pool is small, don't hold more of it
+        if (mPending >= ISP_TUNE_QUEUE_MAX) {
+            mWaits++;
+            while (mPending >= ISP_TUNE_QUEUE_MAX)
+                mJobCond.wait(mJobLock);
+        }
+        mPending++;
+        if (mPending > mPendingMax)
+            mPendingMax = mPending;
+    }
+
+    msg.command = CMD_TUNEWRITER_FRAME;
+    msg.arg2 = (void*)job;
+    mJobQ.put(&msg);
+    return 0;
+}
+
+int CameraIspTuneWriter::close()
+{
+    Semaphore sem;
+    Message_cam msg;
+    nsecs_t elapsed;
+    int ret = 0;
+
+    if (mFd < 0)
+        return 0;
+
+    if (mThread != NULL) {
+        sem.Create();
+        msg.command = CMD_TUNEWRITER_EXIT;
+        msg.arg3 = (void*)&sem;
+        mJobQ.put(&msg);
+        sem.Wait();
+        mThread->requestExitAndWait();
+        mThread.clear();
+    }
+
+    //frame count lives in the first block, rewrite it whole to stay O_DIRECT friendly
+    mHeader.frame_count = mFrames;
+    memset(mStaging, 0, ISP_TUNE_ALIGN);
+    memcpy(mStaging, &mHeader, sizeof(mHeader));
+    if (pwrite(mFd, mStaging, ISP_TUNE_ALIGN, 0) != ISP_TUNE_ALIGN) {
+        LOGE("%s(%d): update header failed(%s)",__FUNCTION__,__LINE__,strerror(errno));
+        ret = -1;
+    }
+    fdatasync(mFd);
+    ::close(mFd);
+    mFd = -1;
+    free(mStaging);
+    mStaging = NULL;
+    if (mError)
+        ret = -1;
+
+    elapsed = systemTime(CLOCK_MONOTONIC) - mOpenTime;
+    LOGD("%s(%d): %d frames, %lld KB in %lld ms: %d.%d MB/s sustained, %d.%d MB/s in write, queue max %d, %d waits%s",
+        __FUNCTION__,__LINE__,mFrames,(long long)(mBytes >> 10),(long long)(elapsed/1000000),
+        elapsed ? (int)(mBytes*1000/elapsed) : 0, elapsed ? (int)(mBytes*10000/elapsed%10) : 0,
+        mWriteTime ? (int)(mBytes*1000/mWriteTime) : 0, mWriteTime ? (int)(mBytes*10000/mWriteTime%10) : 0,
+        mPendingMax,mWaits,mError ? ", write error" : "");
+    return ret;
+}
+
+void CameraIspTuneWriter::writerThread()
+{
+    Message_cam msg;
+    bool loop = true;
+
+    while (loop) {
+        memset(&msg, 0, sizeof(msg));
+        mJobQ.get(&msg);
+        switch (msg.command)
+        {
+            case CMD_TUNEWRITER_FRAME:
+            {
+                isp_tune_job_t* job = (isp_tune_job_t*)msg.arg2;
+                if (!mError && (writeJob(job) < 0))
+                    mError = -1;
+                if (job->release) {
+                    //an earlier write failed, drop the frame
+                    job->release(job->ctx, job->arg);
+                    Mutex::Autolock lock(mJobLock);
+                    mPending--;
+                    mJobCond.signal();
+                }
+                free(job);
+                break;
+            }
+            case CMD_TUNEWRITER_EXIT:
+                loop = false;
+                ((Semaphore*)msg.arg3)->Signal();
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+int CameraIspTuneWriter::writeJob(isp_tune_job_t* job)
+{
+    unsigned char* dst = mStaging + sizeof(isp_tune_frame_header_t);
+    isp_tune_frame_header_t* info = (isp_tune_frame_header_t*)mStaging;
+    unsigned int i,y;
+    size_t payload;
+
+    //pack rows without stride gaps so the record goes out in a few large writes
+    for (i = 0; i < mHeader.plane_count; i++) {
+        unsigned int rowBytes = mHeader.row_bytes[i], rows = mHeader.rows[i];
+        const unsigned char* src = job->planes[i].addr;
+        if (job->planes[i].stride == rowBytes) {
+            memcpy(dst, src, rowBytes*rows);
+            dst += rowBytes*rows;
+        } else {
+            for (y = 0; y < rows; y++) {
+                memcpy(dst, src, rowBytes);
+                dst += rowBytes;
+                src += job->planes[i].stride;
+            }
+        }
+    }
+    payload = dst - mStaging - sizeof(isp_tune_frame_header_t);
+
+    //isp buffer is not needed anymore
+    job->release(job->ctx, job->arg);
+    job->release = NULL;
+    {
+        Mutex::Autolock lock(mJobLock);
+        mPending--;
+        mJobCond.signal();
+    }
+
+    memset(dst, 0, mStaging + mRecordSize - dst);
+    *info = job->info;
+    info->magic = CAMERA_ISPTUNE_MAGIC;
+    info->record_size = mRecordSize;
+    info->payload_size = payload;
+    info->index = mFrames;
+    if (writeAll(mStaging, mRecordSize) < 0)
+        return -1;
+    mFrames++;
+    return 0;
+}
+
+int CameraIspTuneWriter::writeAll(const unsigned char* buf, size_t size)
+{
+    nsecs_t start = systemTime(CLOCK_MONOTONIC);
+    size_t done = 0;
+    ssize_t n;
+
+    while (done < size) {
+        n = write(mFd, buf + done, (size - done > ISP_TUNE_WRITE_CHUNK) ? ISP_TUNE_WRITE_CHUNK : (size - done));
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            LOGE("%s(%d): write failed(%s), %d of %d bytes",__FUNCTION__,__LINE__,strerror(errno),(int)done,(int)size);
+            return -1;
+        }
+        done += n;
+    }
+    mWriteTime += systemTime(CLOCK_MONOTONIC) - start;
+    mBytes += size;
+    return 0;
+}
+
+}
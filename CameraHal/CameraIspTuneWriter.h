@@ -0,0 +1,130 @@
+#ifndef ANDROID_HARDWARE_CAMERA_ISPTUNE_WRITER_H
+#define ANDROID_HARDWARE_CAMERA_ISPTUNE_WRITER_H
+
+//streaming writer for isp tuning captures: one container file per tune task
+#include <stdint.h>
+#include <utils/threads.h>
+#include <utils/Timers.h>
+#include "MessageQueue.h"
+#include "CameraThreadConfig.h"
+
+#define CAMERAHAL_ISPTUNE_STORE_PROPERTY_KEY    "sys_graphic.cam_hal.tunestore"     /* stream | file */
+#define CAMERAHAL_ISPTUNE_DIRECT_PROPERTY_KEY   "sys_graphic.cam_hal.tunedirect"    /* 1: open container with O_DIRECT */
+
+/*
+ * tune container layout (little endian), every record starts on an
+ * ISP_TUNE_ALIGN boundary so the file can be written with O_DIRECT:
+ *   isp_tune_file_header_t, padded to ISP_TUNE_ALIGN
+ *   { isp_tune_frame_header_t, plane rows without stride gaps, padding } * frame_count
+ * pic_type/pic_layout are the PIC_BUF_TYPE_* / PIC_BUF_LAYOUT_* of the isp buffer.
+ */
+#define CAMERA_ISPTUNE_MAGIC        0x43544b52      /* 'RKTC' */
+#define CAMERA_ISPTUNE_VERSION      1
+#define ISP_TUNE_ALIGN              4096
+#define ISP_TUNE_PLANE_MAX          2
+#define ISP_TUNE_QUEUE_MAX          3               /* locked isp buffers waiting for the writer */
+#define ISP_TUNE_WRITE_CHUNK        (1024*1024)
+
+typedef struct isp_tune_file_header_s {
+    unsigned int magic;
+    unsigned int version;
+    unsigned int header_size;
+    unsigned int align;
+    unsigned int pic_type;
+    unsigned int pic_layout;
+    unsigned int width;
+    unsigned int height;
+    unsigned int frame_count;           /* patched on close */
+    unsigned int plane_count;
+    unsigned int row_bytes[ISP_TUNE_PLANE_MAX];
+    unsigned int rows[ISP_TUNE_PLANE_MAX];
+    char illumination[16];
+} isp_tune_file_header_t;
+
+typedef struct isp_tune_frame_header_s {
+    unsigned int magic;
+    unsigned int record_size;           /* header + payload + padding */
+    unsigned int payload_size;
+    unsigned int index;
+    int64_t timestamp_us;
+    float integration_time;
+    float gain;
+    float wb_gain[4];                   /* r, gr, gb, b */
+} isp_tune_frame_header_t;
+
+namespace android {
+
+typedef void (*isp_tune_release_func)(void* ctx, void* arg);
+
+typedef struct isp_tune_plane_s {
+    const unsigned char* addr;
+    unsigned int stride;            /* row sizes come from the file header */
+} isp_tune_plane_t;
+
+class CameraIspTuneWriter {
+public:
+    enum TuneWriterCommands {
+        CMD_TUNEWRITER_FRAME,
+        CMD_TUNEWRITER_EXIT
+    };
+
+    CameraIspTuneWriter();
+    ~CameraIspTuneWriter();
+    int open(const char* path, const isp_tune_file_header_t* header, bool direct);
+    bool isOpen() { return mFd >= 0; }
+    //blocks only while ISP_TUNE_QUEUE_MAX frames are pending; release(ctx, arg) once the planes are packed
+    int queueFrame(const isp_tune_plane_t* planes, const isp_tune_frame_header_t* info,
+                   isp_tune_release_func release, void* ctx, void* arg);
+    //drains the queue, patches the frame count and reports throughput
+    int close();
+
+private:
+    typedef struct isp_tune_job {
+        isp_tune_plane_t planes[ISP_TUNE_PLANE_MAX];
+        isp_tune_frame_header_t info;
+        isp_tune_release_func release;
+        void* ctx;
+        void* arg;
+    } isp_tune_job_t;
+
+    class TuneWriterThread : public Thread {
+        CameraIspTuneWriter* mWriter;
+    public:
+        TuneWriterThread(CameraIspTuneWriter* writer)
+            : Thread(false), mWriter(writer) {}
+
+        virtual bool threadLoop() {
+            CameraThreadConfig::enter("IspTuneWriter");
+            mWriter->writerThread();
+            return false;
+        }
+    };
+
+    void writerThread();
+    int writeJob(isp_tune_job_t* job);
+    int writeAll(const unsigned char* buf, size_t size);
+
+    int mFd;
+    bool mDirect;
+    isp_tune_file_header_t mHeader;
+    size_t mRecordSize;
+    unsigned char* mStaging;
+    int mError;
+
+    Mutex mJobLock;
+    Condition mJobCond;
+    int mPending;
+    int mPendingMax;
+    unsigned int mWaits;
+
+    unsigned int mFrames;
+    uint64_t mBytes;
+    nsecs_t mOpenTime;
+    nsecs_t mWriteTime;
+
+    sp<TuneWriterThread> mThread;
+    MessageQueue mJobQ;
+};
+
+}
+#endif
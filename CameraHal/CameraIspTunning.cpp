@@ -1,11 +1,14 @@
 #include "CameraIspTunning.h"
 #include <expat.h>
+#include <cutils/properties.h>
 #include "CameraHal_Tracer.h"
 
 
 namespace android{
 
-CameraIspTunning::CameraIspTunning(){
+CameraIspTunning::CameraIspTunning()
+    :mTuneStream(false)
+{
 
 }
 
@@ -31,6 +34,13 @@ CameraIspTunning* CameraIspTunning::createInstance()
     LOGD("open xml file(%s) success\n", RK_ISP_TUNNING_FILE_PATH);
 
     profiles = new CameraIspTunning();
+
+    {
+        char prop[PROPERTY_VALUE_MAX];
+        property_get(CAMERAHAL_ISPTUNE_STORE_PROPERTY_KEY, prop, "stream");
+        profiles->mTuneStream = (strcmp(prop, "file") != 0);
+    }
+    profiles->mFrameStats.init(0);
     
     XML_Parser parser = XML_ParserCreate(NULL);
     if(parser==NULL){
@@ -728,48 +738,114 @@ int CameraIspTunning::ispTuneStoreBuffer
     return result;
 }
 
+int CameraIspTunning::ispTuneStreamBuffer
+(
+    ispTuneTaskInfo_s    *pIspTuneTaskInfo,
+    MediaBuffer_t       *pBuffer,
+    const char          *szName,
+    isp_tune_frame_header_t *pFrameInfo,
+    isp_tune_release_func release,
+    void                *ctx,
+    void                *arg
+)
+{
+    isp_tune_file_header_t header;
+    isp_tune_plane_t planes[ISP_TUNE_PLANE_MAX];
+    PicBufMetaData_t *pPicBufMetaData = NULL;
+
+    if ( (pIspTuneTaskInfo == NULL) || (pBuffer == NULL) )
+        goto stream_fail;
+    pPicBufMetaData = (PicBufMetaData_t *)(pBuffer->pMetaData);
+    if (pPicBufMetaData == NULL)
+        goto stream_fail;
+
+    // rows are stored as the isp wrote them: no rgb conversion, that's left to the offline tools
+    memset(&header, 0, sizeof(header));
+    header.pic_type = pPicBufMetaData->Type;
+    header.pic_layout = pPicBufMetaData->Layout;
+    switch ( pPicBufMetaData->Type )
+    {
+        case PIC_BUF_TYPE_RAW8:
+        case PIC_BUF_TYPE_RAW16:
+            header.width = pPicBufMetaData->Data.raw.PicWidthPixel;
+            header.height = pPicBufMetaData->Data.raw.PicHeightPixel;
+            header.plane_count = 1;
+            header.row_bytes[0] = header.width * ((pPicBufMetaData->Type == PIC_BUF_TYPE_RAW16) ? 2 : 1);
+            header.rows[0] = header.height;
+            planes[0].addr = (const unsigned char*)pIspTuneTaskInfo->y_addr;
+            planes[0].stride = pPicBufMetaData->Data.raw.PicWidthBytes;
+            break;
+        case PIC_BUF_TYPE_YCbCr422:
+            if (pPicBufMetaData->Layout != PIC_BUF_LAYOUT_SEMIPLANAR)
+                goto stream_fail;
+            header.width = pPicBufMetaData->Data.YCbCr.semiplanar.Y.PicWidthPixel;
+            header.height = pPicBufMetaData->Data.YCbCr.semiplanar.Y.PicHeightPixel;
+            header.plane_count = 2;
+            header.row_bytes[0] = header.width;
+            header.rows[0] = header.height;
+            header.row_bytes[1] = pPicBufMetaData->Data.YCbCr.semiplanar.CbCr.PicWidthPixel;
+            header.rows[1] = pPicBufMetaData->Data.YCbCr.semiplanar.CbCr.PicHeightPixel;
+            planes[0].addr = (const unsigned char*)pIspTuneTaskInfo->y_addr;
+            planes[0].stride = pPicBufMetaData->Data.YCbCr.semiplanar.Y.PicWidthBytes;
+            planes[1].addr = (const unsigned char*)pIspTuneTaskInfo->uv_addr;
+            planes[1].stride = pPicBufMetaData->Data.YCbCr.semiplanar.CbCr.PicWidthBytes;
+            break;
+        default:
+            goto stream_fail;
+    }
+
+    if (!mTuneWriter.isOpen()) {
+        char szFileName[FILENAME_MAX] = "";
+        char szDateTime[20] = "";
+        char prop[PROPERTY_VALUE_MAX];
+        time_t t = time( NULL );
+
+        strftime( szDateTime, sizeof(szDateTime), "_%Y%m%d_%H%M%S", localtime(&t) );
+        if (strlen(pIspTuneTaskInfo->mWhiteBalance.illumination))
+            snprintf( szFileName, FILENAME_MAX, "%s_%s_%dx%d%s.rktc", szName, pIspTuneTaskInfo->mWhiteBalance.illumination,
+                      header.width, header.height, szDateTime );
+        else
+            snprintf( szFileName, FILENAME_MAX, "%s_%dx%d%s.rktc", szName, header.width, header.height, szDateTime );
+        strncpy(header.illumination, pIspTuneTaskInfo->mWhiteBalance.illumination, sizeof(header.illumination)-1);
+
+        property_get(CAMERAHAL_ISPTUNE_DIRECT_PROPERTY_KEY, prop, "0");
+        if (mTuneWriter.open(szFileName, &header, (strcmp(prop, "1") == 0)) < 0)
+            goto stream_fail;
+    }
+
+    pFrameInfo->timestamp_us = pPicBufMetaData->TimeStampUs;
+    return mTuneWriter.queueFrame(planes, pFrameInfo, release, ctx, arg);
+
+stream_fail:
+    release(ctx, arg);
+    return -1;
+}
+
+int CameraIspTunning::ispTuneStreamClose()
+{
+    return mTuneWriter.close();
+}
+
 int  CameraIspTunning::ispTuneDesiredExp(long raw_ddr,int width,int height,int min_raw,int max_raw,int threshold){
-	int max_raw_num = 0,min_raw_num = 0;
-	int num,value,result = 0;
+    cam_frame_stats_t stats;
+	int result = 0;
 	int proportion;
-	short unsigned int *p= NULL;
-	p = (short unsigned int*)raw_ddr;
-	//TRACE_D(0, "%s @@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@(enter)\n", __FUNCTION__);
-
-    min_raw <<= 8;
-    max_raw <<= 8;
-	
-	for(num = 0; num < width*height; num++)
-		{
-			value = *p++;
-			if(value > max_raw)
-				max_raw_num++;
-			if(value < min_raw)
-				min_raw_num++;
-		}
-	
-	//TRACE_D(0, "min_raw = %d \n", min_raw);
-	//TRACE_D(0, "max_raw = %d \n", max_raw);
-	//TRACE_D(0, "threshold = %d \n", threshold);
-	//TRACE_D(0, "width*height = %d \n", width*height);
-
-	//TRACE_D(0, "min_raw_num = %.1f \n", min_raw_num);
-	//TRACE_D(0, "max_raw_num = %.1f \n", max_raw_num);
-	
-	proportion = min_raw_num*100/(width*height);
+
+    if(mFrameStats.computeRaw16((const unsigned short*)raw_ddr, width, height, width*2, 1,
+                                min_raw << 8, max_raw << 8, 0, &stats) < 0)
+        return 0;
+
+	proportion = stats.clip_low*100/stats.count;
 	if(proportion > threshold){
         result |= 0x1;
 	}
     TRACE_D(0, "min_raw %d !!!!!!!!!!!\n", proportion);
-	proportion = max_raw_num*100/(width*height);
+	proportion = stats.clip_high*100/stats.count;
 	if(proportion > threshold){
         result |= 0x2;
-		//TRACE_D(0, "%.5f ~~~~~~~~~~~\n", proportion);
-        
 	}
 	TRACE_D(0, "max_raw %d ~~~~~~~~~~~\n", proportion);
 
-	//TRACE_D(0, "%s @@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@(exit)\n", __FUNCTION__);
     return result;
 } 
 };
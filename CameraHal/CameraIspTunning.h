@@ -3,6 +3,8 @@
 #include <utils/Vector.h>
 #include "cam_api/camdevice.h"
 #include "oslayer/oslayer.h"
+#include "CameraIspTuneWriter.h"
+#include "CameraFrameStats.h"
 
 #define RK_ISP_TUNNING_FILE_PATH "/data/capcmd.xml"
 
@@ -74,7 +76,7 @@ public:
     ~CameraIspTunning();
     static CameraIspTunning* createInstance();
     static void StartElementHandler(void *userData, const char *name, const char **atts);
-    static int ispTuneDesiredExp(long raw_ddr,int width,int height,int min_raw,int max_raw,int threshold);
+    int ispTuneDesiredExp(long raw_ddr,int width,int height,int min_raw,int max_raw,int threshold);
 
     static int ispTuneStoreBufferRAW
     (
@@ -100,6 +102,19 @@ public:
         char     *szNmae,
         int      index     
     );
+
+    //queue the frame to the task container, release(ctx, arg) is always called
+    int ispTuneStreamBuffer
+    (
+        ispTuneTaskInfo_s    *pIspTuneTaskInfo,
+        MediaBuffer_t       *pBuffer,
+        const char          *szName,
+        isp_tune_frame_header_t *pFrameInfo,
+        isp_tune_release_func release,
+        void                *ctx,
+        void                *arg
+    );
+    int ispTuneStreamClose();
 private:
     static void ConvertYCbCr444combToRGBcomb
     (
@@ -116,6 +131,9 @@ public:
     float mCurIntegrationTime;
     float mCurGain;
     int mCurAeRoundNum;
+    bool mTuneStream;
+    CameraIspTuneWriter mTuneWriter;
+    CameraFrameStats mFrameStats;
 };
 
 };
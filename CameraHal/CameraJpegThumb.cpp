@@ -0,0 +1,318 @@
+#include "CameraJpegThumb.h"
+#include "CameraHal_Tracer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+extern "C" {
+#include "jpeglib.h"
+}
+
+namespace android {
+
+#define THUMB_SAMPLES       4           /* per direction in each source area */
+#define THUMB_ALIGN(x)      (((x) + 15) & ~15)
+
+typedef struct thumb_dest_mgr {
+    struct jpeg_destination_mgr pub;
+    unsigned char* buf;
+    size_t size;
+    bool overflow;
+} thumb_dest_mgr_t;
+
+typedef struct thumb_error_mgr {
+    struct jpeg_error_mgr pub;
+    jmp_buf jump;
+} thumb_error_mgr_t;
+
+static void thumb_init_destination(j_compress_ptr cinfo)
+{
+    thumb_dest_mgr_t* dest = (thumb_dest_mgr_t*)cinfo->dest;
+    dest->pub.next_output_byte = dest->buf;
+    dest->pub.free_in_buffer = dest->size;
+}
+
+static boolean thumb_empty_output_buffer(j_compress_ptr cinfo)
+{
+    //output is thrown away, keep libjpeg running to the end
+    thumb_dest_mgr_t* dest = (thumb_dest_mgr_t*)cinfo->dest;
+    dest->overflow = true;
+    dest->pub.next_output_byte = dest->buf;
+    dest->pub.free_in_buffer = dest->size;
+    return TRUE;
+}
+
+static void thumb_term_destination(j_compress_ptr cinfo)
+{
+}
+
+static void thumb_error_exit(j_common_ptr cinfo)
+{
+    thumb_error_mgr_t* err = (thumb_error_mgr_t*)cinfo->err;
+    longjmp(err->jump, 1);
+}
+
+/* sample positions of a THUMB_SAMPLES grid over each output pixel's source area */
+static void thumb_sample_pos(int* pos, int src, int dst)
+{
+    int i,j,start,len;
+
+    for (i = 0; i < dst; i++) {
+        start = (int)((long)i*src/dst);
+        len = (int)((long)(i + 1)*src/dst) - start;
+        if (len < 1)
+            len = 1;
+        for (j = 0; j < THUMB_SAMPLES; j++)
+            pos[i*THUMB_SAMPLES + j] = start + (len*(2*j + 1))/(2*THUMB_SAMPLES);
+    }
+}
+
+/* nv12 -> y/u/v planes of (dstW x dstH) padded to the 16x16 mcu with the edge pixels */
+static int thumb_downscale(const cam_thumb_job_t* job, unsigned char* y, unsigned char* u, unsigned char* v)
+{
+    int yw = THUMB_ALIGN(job->dstW), yh = THUMB_ALIGN(job->dstH);
+    int cw = yw/2, ch = yh/2, dcw = (job->dstW + 1)/2, dch = (job->dstH + 1)/2;
+    const unsigned char* srcUv = job->src + job->srcW*job->srcH;
+    int *xpos, *ypos;
+    int i,j,m,n;
+
+    xpos = (int*)malloc(sizeof(int)*THUMB_SAMPLES*(yw + yh));
+    if (xpos == NULL)
+        return -1;
+    ypos = xpos + THUMB_SAMPLES*yw;
+
+    thumb_sample_pos(xpos, job->srcW, job->dstW);
+    thumb_sample_pos(ypos, job->srcH, job->dstH);
+    for (j = 0; j < yh; j++) {
+        unsigned char* row = y + j*yw;
+        if (j >= job->dstH) {
+            memcpy(row, row - yw, yw);
+            continue;
+        }
+        for (i = 0; i < job->dstW; i++) {
+            unsigned int sum = 0;
+            for (n = 0; n < THUMB_SAMPLES; n++) {
+                const unsigned char* s = job->src + ypos[j*THUMB_SAMPLES + n]*job->srcW;
+                for (m = 0; m < THUMB_SAMPLES; m++)
+                    sum += s[xpos[i*THUMB_SAMPLES + m]];
+            }
+            row[i] = sum/(THUMB_SAMPLES*THUMB_SAMPLES);
+        }
+        memset(row + job->dstW, row[job->dstW - 1], yw - job->dstW);
+    }
+
+    thumb_sample_pos(xpos, job->srcW/2, dcw);
+    thumb_sample_pos(ypos, job->srcH/2, dch);
+    for (j = 0; j < ch; j++) {
+        unsigned char* urow = u + j*cw;
+        unsigned char* vrow = v + j*cw;
+        if (j >= dch) {
+            memcpy(urow, urow - cw, cw);
+            memcpy(vrow, vrow - cw, cw);
+            continue;
+        }
+        for (i = 0; i < dcw; i++) {
+            unsigned int usum = 0, vsum = 0;
+            for (n = 0; n < THUMB_SAMPLES; n++) {
+                const unsigned char* s = srcUv + ypos[j*THUMB_SAMPLES + n]*job->srcW;
+                for (m = 0; m < THUMB_SAMPLES; m++) {
+                    usum += s[2*xpos[i*THUMB_SAMPLES + m]];
+                    vsum += s[2*xpos[i*THUMB_SAMPLES + m] + 1];
+                }
+            }
+            urow[i] = usum/(THUMB_SAMPLES*THUMB_SAMPLES);
+            vrow[i] = vsum/(THUMB_SAMPLES*THUMB_SAMPLES);
+        }
+        memset(urow + dcw, urow[dcw - 1], cw - dcw);
+        memset(vrow + dcw, vrow[dcw - 1], cw - dcw);
+    }
+    free(xpos);
+    return 0;
+}
+
+int CameraJpegThumb::encode(cam_thumb_job_t* job)
+{
+    struct jpeg_compress_struct cinfo;
+    thumb_error_mgr_t jerr;
+    thumb_dest_mgr_t dest;
+    JSAMPROW yrows[16], urows[8], vrows[8];
+    JSAMPARRAY planes[3] = {yrows, urows, vrows};
+    unsigned char *y = NULL, *u, *v;
+    unsigned char* out = NULL;
+    int yw,yh,cw,i;
+    unsigned int row;
+
+    job->out = NULL;
+    job->outLen = 0;
+    if ((job->src == NULL) || (job->dstW < 2) || (job->dstH < 2)
+        || (job->srcW < job->dstW) || (job->srcH < job->dstH))
+        return -1;
+
+    yw = THUMB_ALIGN(job->dstW);
+    yh = THUMB_ALIGN(job->dstH);
+    cw = yw/2;
+    y = (unsigned char*)malloc(yw*yh*3/2);
+    //a thumbnail never gets near its uncompressed size
+    dest.size = yw*yh*3/2 + 1024;
+    out = (unsigned char*)malloc(dest.size);
+    if ((y == NULL) || (out == NULL))
+        goto encode_fail;
+    u = y + yw*yh;
+    v = u + cw*yh/2;
+    if (thumb_downscale(job, y, u, v) < 0)
+        goto encode_fail;
+
+    dest.pub.init_destination = thumb_init_destination;
+    dest.pub.empty_output_buffer = thumb_empty_output_buffer;
+    dest.pub.term_destination = thumb_term_destination;
+    dest.buf = out;
+    dest.overflow = false;
+    cinfo.err = jpeg_std_error(&jerr.pub);
+    jerr.pub.error_exit = thumb_error_exit;
+    if (setjmp(jerr.jump)) {
+        LOGE("%s(%d): libjpeg failed on %dx%d thumbnail",__FUNCTION__,__LINE__,job->dstW,job->dstH);
+        jpeg_destroy_compress(&cinfo);
+        goto encode_fail;
+    }
+    jpeg_create_compress(&cinfo);
+    cinfo.dest = &dest.pub;
+    cinfo.image_width = job->dstW;
+    cinfo.image_height = job->dstH;
+    cinfo.input_components = 3;
+    cinfo.in_color_space = JCS_YCbCr;
+    jpeg_set_defaults(&cinfo);
+    jpeg_set_quality(&cinfo, job->quality, TRUE);
+    cinfo.raw_data_in = TRUE;
+    cinfo.dct_method = JDCT_IFAST;
+    cinfo.comp_info[0].h_samp_factor = 2;
+    cinfo.comp_info[0].v_samp_factor = 2;
+    cinfo.comp_info[1].h_samp_factor = 1;
+    cinfo.comp_info[1].v_samp_factor = 1;
+    cinfo.comp_info[2].h_samp_factor = 1;
+    cinfo.comp_info[2].v_samp_factor = 1;
+    jpeg_start_compress(&cinfo, TRUE);
+    for (row = 0; row < cinfo.image_height; row += 16) {
+        for (i = 0; i < 16; i++)
+            yrows[i] = y + (row + i)*yw;
+        for (i = 0; i < 8; i++) {
+            urows[i] = u + (row/2 + i)*cw;
+            vrows[i] = v + (row/2 + i)*cw;
+        }
+        jpeg_write_raw_data(&cinfo, planes, 16);
+    }
+    jpeg_finish_compress(&cinfo);
+    jpeg_destroy_compress(&cinfo);
+    if (dest.overflow) {
+        LOGE("%s(%d): %dx%d thumbnail overflow",__FUNCTION__,__LINE__,job->dstW,job->dstH);
+        goto encode_fail;
+    }
+
+    free(y);
+    job->out = out;
+    job->outLen = dest.size - dest.pub.free_in_buffer;
+    return job->outLen;
+
+encode_fail:
+    free(y);
+    free(out);
+    return -1;
+}
+
+CameraJpegThumb::CameraJpegThumb()
+    :mWorkerQ("JpegThumbQ")
+{
+}
+
+CameraJpegThumb::~CameraJpegThumb()
+{
+    destroy();
+}
+
+int CameraJpegThumb::init()
+{
+    if (mWorker != NULL)
+        return 0;
+    mWorker = new JpegThumbThread(this);
+    mWorker->run("CamJpegThumb", CameraThreadConfig::priority("CamJpegThumb"));
+    return 0;
+}
+
+void CameraJpegThumb::destroy()
+{
+    Message_cam msg;
+
+    if (mWorker == NULL)
+        return;
+    msg.command = CMD_JPEGTHUMB_EXIT;
+    mWorkerQ.put(&msg);
+    mWorker->requestExitAndWait();
+    mWorker.clear();
+}
+
+int CameraJpegThumb::queue(cam_thumb_job_t* job)
+{
+    Message_cam msg;
+
+    job->out = NULL;
+    job->outLen = 0;
+    if (mWorker == NULL) {
+        encode(job);
+        job->state = CAM_THUMB_DONE;
+        return 0;
+    }
+    job->state = CAM_THUMB_QUEUED;
+    msg.command = CMD_JPEGTHUMB_RUN;
+    msg.arg2 = (void*)job;
+    mWorkerQ.put(&msg);
+    return 0;
+}
+
+int CameraJpegThumb::wait(cam_thumb_job_t* job)
+{
+    Mutex::Autolock lock(mJobLock);
+    while (job->state == CAM_THUMB_QUEUED)
+        mJobCond.wait(mJobLock);
+    return (job->state == CAM_THUMB_DONE) ? job->outLen : 0;
+}
+
+void CameraJpegThumb::release(cam_thumb_job_t* job)
+{
+    wait(job);
+    free(job->out);
+    job->out = NULL;
+    job->outLen = 0;
+    job->state = CAM_THUMB_IDLE;
+}
+
+void CameraJpegThumb::workerThread()
+{
+    Message_cam msg;
+    bool loop = true;
+
+    while (loop) {
+        memset(&msg, 0, sizeof(msg));
+        mWorkerQ.get(&msg);
+        switch (msg.command)
+        {
+            case CMD_JPEGTHUMB_RUN:
+            {
+                cam_thumb_job_t* job = (cam_thumb_job_t*)msg.arg2;
+                nsecs_t start = systemTime(CLOCK_MONOTONIC);
+                encode(job);
+                LOG2("%s(%d): %dx%d thumbnail %d bytes in %lld us",__FUNCTION__,__LINE__,job->dstW,job->dstH,
+                    job->outLen,(long long)((systemTime(CLOCK_MONOTONIC) - start)/1000));
+                Mutex::Autolock lock(mJobLock);
+                job->state = CAM_THUMB_DONE;
+                mJobCond.broadcast();
+                break;
+            }
+            case CMD_JPEGTHUMB_EXIT:
+                loop = false;
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+}
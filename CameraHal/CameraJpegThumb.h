@@ -0,0 +1,76 @@
+#ifndef ANDROID_HARDWARE_CAMERA_JPEG_THUMB_H
+#define ANDROID_HARDWARE_CAMERA_JPEG_THUMB_H
+
+//exif thumbnail: area downscale of the nv12 picture and a small sw jpeg encode
+#include <utils/threads.h>
+#include "MessageQueue.h"
+#include "CameraThreadConfig.h"
+
+namespace android {
+
+enum CamThumbState {
+    CAM_THUMB_IDLE,
+    CAM_THUMB_QUEUED,
+    CAM_THUMB_DONE
+};
+
+typedef struct cam_thumb_job_s {
+    const unsigned char* src;           /* nv12, uv plane follows y */
+    int srcW;
+    int srcH;
+    int dstW;
+    int dstH;
+    int quality;                        /* 1..100 */
+    unsigned char* out;                 /* jpeg, NULL if it failed */
+    int outLen;
+    int state;
+} cam_thumb_job_t;
+
+/*
+ * Jobs run in order on one worker so the thumbnail of a picture is made
+ * while the hw encoder is busy with the one before it. Each output pixel
+ * averages a 4x4 grid sampled over its source area, so the cost depends
+ * on the thumbnail size only.
+ */
+class CameraJpegThumb {
+public:
+    enum JpegThumbCommands {
+        CMD_JPEGTHUMB_RUN,
+        CMD_JPEGTHUMB_EXIT
+    };
+
+    CameraJpegThumb();
+    ~CameraJpegThumb();
+    int init();
+    void destroy();
+    //runs on the caller's thread without init()
+    int queue(cam_thumb_job_t* job);
+    //returns outLen, 0 if no thumbnail was made
+    int wait(cam_thumb_job_t* job);
+    void release(cam_thumb_job_t* job);
+    static int encode(cam_thumb_job_t* job);
+
+private:
+    class JpegThumbThread : public Thread {
+        CameraJpegThumb* mThumb;
+    public:
+        JpegThumbThread(CameraJpegThumb* thumb)
+            : Thread(false), mThumb(thumb) {}
+
+        virtual bool threadLoop() {
+            CameraThreadConfig::enter("CamJpegThumb");
+            mThumb->workerThread();
+            return false;
+        }
+    };
+
+    void workerThread();
+
+    Mutex mJobLock;
+    Condition mJobCond;
+    sp<JpegThumbThread> mWorker;
+    MessageQueue mWorkerQ;
+};
+
+}
+#endif
@@ -0,0 +1,679 @@
+#include "CameraMjpegDecoder.h"
+#include "CameraHal.h"
+#include <setjmp.h>
+extern "C" {
+#include "jpeglib.h"
+}
+
+namespace android {
+
+#define MJPEG_HW_FAIL_MAX       3       /* vpu errors in a row before it is given up */
+#define MJPEG_JUDGE_FRAMES      16      /* frames averaged before switching path */
+#define MJPEG_HOLD_FRAMES       300     /* vpu kept after sw turned out slower */
+#define MJPEG_STATS_FRAMES      300
+
+typedef struct mjpeg_src_mgr {
+    struct jpeg_source_mgr pub;
+    JOCTET eoi[2];
+} mjpeg_src_mgr_t;
+
+typedef struct mjpeg_error_mgr {
+    struct jpeg_error_mgr pub;
+    jmp_buf jump;
+} mjpeg_error_mgr_t;
+
+/* standard huffman tables (jpeg spec K.3), uvc mjpeg frames come without DHT */
+static const UINT8 mjpeg_dc_bits[2][17] = {
+    { 0, 0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0 },
+    { 0, 0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0 }
+};
+static const UINT8 mjpeg_dc_val[12] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11 };
+static const UINT8 mjpeg_ac_bits[2][17] = {
+    { 0, 0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7d },
+    { 0, 0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77 }
+};
+static const UINT8 mjpeg_ac_val[2][162] = {
+    {
+        0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07,
+        0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xa1, 0x08, 0x23, 0x42, 0xb1, 0xc1, 0x15, 0x52, 0xd1, 0xf0,
+        0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0a, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x25, 0x26, 0x27, 0x28,
+        0x29, 0x2a, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49,
+        0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69,
+        0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+        0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7,
+        0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5,
+        0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xe1, 0xe2,
+        0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+        0xf9, 0xfa
+    },
+    {
+        0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71,
+        0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91, 0xa1, 0xb1, 0xc1, 0x09, 0x23, 0x33, 0x52, 0xf0,
+        0x15, 0x62, 0x72, 0xd1, 0x0a, 0x16, 0x24, 0x34, 0xe1, 0x25, 0xf1, 0x17, 0x18, 0x19, 0x1a, 0x26,
+        0x27, 0x28, 0x29, 0x2a, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48,
+        0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68,
+        0x69, 0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+        0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5,
+        0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3,
+        0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda,
+        0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+        0xf9, 0xfa
+    }
+};
+
+static void mjpeg_std_huff_tables(j_decompress_ptr cinfo)
+{
+    int i;
+
+    for (i = 0; i < 2; i++) {
+        if (cinfo->dc_huff_tbl_ptrs[i] == NULL) {
+            cinfo->dc_huff_tbl_ptrs[i] = jpeg_alloc_huff_table((j_common_ptr)cinfo);
+            memcpy(cinfo->dc_huff_tbl_ptrs[i]->bits, mjpeg_dc_bits[i], sizeof(mjpeg_dc_bits[i]));
+            memcpy(cinfo->dc_huff_tbl_ptrs[i]->huffval, mjpeg_dc_val, sizeof(mjpeg_dc_val));
+        }
+        if (cinfo->ac_huff_tbl_ptrs[i] == NULL) {
+            cinfo->ac_huff_tbl_ptrs[i] = jpeg_alloc_huff_table((j_common_ptr)cinfo);
+            memcpy(cinfo->ac_huff_tbl_ptrs[i]->bits, mjpeg_ac_bits[i], sizeof(mjpeg_ac_bits[i]));
+            memcpy(cinfo->ac_huff_tbl_ptrs[i]->huffval, mjpeg_ac_val[i], sizeof(mjpeg_ac_val[i]));
+        }
+    }
+}
+
+static void mjpeg_init_source(j_decompress_ptr cinfo)
+{
+}
+
+static boolean mjpeg_fill_input_buffer(j_decompress_ptr cinfo)
+{
+    //truncated frame: feed EOI, libjpeg pads the missing mcus
+    mjpeg_src_mgr_t* src = (mjpeg_src_mgr_t*)cinfo->src;
+    src->eoi[0] = 0xff;
+    src->eoi[1] = JPEG_EOI;
+    src->pub.next_input_byte = src->eoi;
+    src->pub.bytes_in_buffer = 2;
+    return TRUE;
+}
+
+static void mjpeg_skip_input_data(j_decompress_ptr cinfo, long num_bytes)
+{
+    mjpeg_src_mgr_t* src = (mjpeg_src_mgr_t*)cinfo->src;
+
+    if (num_bytes <= 0)
+        return;
+    if ((size_t)num_bytes > src->pub.bytes_in_buffer) {
+        mjpeg_fill_input_buffer(cinfo);
+        return;
+    }
+    src->pub.next_input_byte += num_bytes;
+    src->pub.bytes_in_buffer -= num_bytes;
+}
+
+static void mjpeg_term_source(j_decompress_ptr cinfo)
+{
+}
+
+static void mjpeg_error_exit(j_common_ptr cinfo)
+{
+    mjpeg_error_mgr_t* err = (mjpeg_error_mgr_t*)cinfo->err;
+    longjmp(err->jump, 1);
+}
+
+static void mjpeg_output_message(j_common_ptr cinfo)
+{
+    char msg[JMSG_LENGTH_MAX];
+
+    (*cinfo->err->format_message)(cinfo, msg);
+    LOG2("%s(%d): %s",__FUNCTION__,__LINE__,msg);
+}
+
+CameraMjpegDecoder::CameraMjpegDecoder()
+    :mWorkers(1),
+     mPending(0),
+     mRstOff(NULL),
+     mRstMax(0)
+{
+    memset(mStripeBuf, 0, sizeof(mStripeBuf));
+    memset(mStripeBufSize, 0, sizeof(mStripeBufSize));
+    reset(false, 0);
+}
+
+CameraMjpegDecoder::~CameraMjpegDecoder()
+{
+    int i;
+
+    destroy();
+    for (i = 0; i < CAM_MJPEG_WORKER_MAX; i++)
+        free(mStripeBuf[i]);
+    free(mRstOff);
+}
+
+int CameraMjpegDecoder::init(int workers)
+{
+    int i;
+
+    if (mWorkers > 1)
+        return 0;
+    if (workers <= 0)
+        workers = sysconf(_SC_NPROCESSORS_ONLN);
+    if (workers < 1)
+        workers = 1;
+    else if (workers > CAM_MJPEG_WORKER_MAX)
+        workers = CAM_MJPEG_WORKER_MAX;
+
+    //stripe 0 runs on the caller
+    for (i = 1; i < workers; i++) {
+        mWorker[i] = new MjpegDecodeThread(this, i);
+        mWorker[i]->run("CamMjpegDec", CameraThreadConfig::priority("CamMjpegDec"));
+    }
+    mWorkers = workers;
+    return 0;
+}
+
+void CameraMjpegDecoder::destroy()
+{
+    Message_cam msg;
+    int i;
+
+    Mutex::Autolock lock(mRunLock);
+    for (i = 1; i < mWorkers; i++) {
+        msg.command = CMD_MJPEGDEC_EXIT;
+        mWorkerQ[i].put(&msg);
+        mWorker[i]->requestExitAndWait();
+        mWorker[i].clear();
+    }
+    mWorkers = 1;
+}
+
+void CameraMjpegDecoder::workerThread(int id)
+{
+    Message_cam msg;
+    bool loop = true;
+
+    while (loop) {
+        memset(&msg, 0, sizeof(msg));
+        mWorkerQ[id].get(&msg);
+        switch (msg.command)
+        {
+            case CMD_MJPEGDEC_RUN:
+            {
+                decodeStripe((mjpeg_job_t*)msg.arg2, id);
+                Mutex::Autolock lock(mJobLock);
+                if (--mPending == 0)
+                    mJobCond.signal();
+                break;
+            }
+            case CMD_MJPEGDEC_EXIT:
+                loop = false;
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+int CameraMjpegDecoder::parseHeader(const unsigned char* src, int size, mjpeg_header_t* hdr)
+{
+    int pos = 2, len, i, maxH = 1, maxV = 1;
+    const unsigned char* p;
+    unsigned char m;
+
+    memset(hdr, 0, sizeof(*hdr));
+    if ((size < 4) || (src[0] != 0xff) || (src[1] != 0xd8))
+        return -1;
+
+    while (pos + 4 <= size) {
+        if (src[pos] != 0xff)
+            return -1;
+        m = src[pos + 1];
+        if (m == 0xff) {
+            pos++;
+            continue;
+        }
+        if (((m >= JPEG_RST0) && (m <= JPEG_RST0 + 7)) || (m == 0x01)) {
+            pos += 2;
+            continue;
+        }
+        len = (src[pos + 2] << 8) | src[pos + 3];
+        if ((len < 2) || (pos + 2 + len > size))
+            return -1;
+        p = src + pos + 4;
+
+        if ((m >= 0xc0) && (m <= 0xcf) && (m != 0xc4) && (m != 0xc8) && (m != 0xcc)) {
+            //SOFn
+            if ((len < 8) || (len < 8 + 3*p[5]) || (p[5] == 0))
+                return -1;
+            hdr->height = (p[1] << 8) | p[2];
+            hdr->width = (p[3] << 8) | p[4];
+            hdr->comps = p[5];
+            hdr->sofHeightOff = pos + 5;
+            hdr->sequential = (m == 0xc0) || (m == 0xc1);
+            for (i = 0; i < hdr->comps; i++) {
+                if ((p[7 + 3*i] >> 4) > maxH)
+                    maxH = p[7 + 3*i] >> 4;
+                if ((p[7 + 3*i] & 0x0f) > maxV)
+                    maxV = p[7 + 3*i] & 0x0f;
+            }
+            if (hdr->comps == 1)
+                maxH = maxV = 1;
+        } else if (m == 0xc4) {
+            hdr->hasDht = true;
+        } else if (m == 0xdd) {
+            if (len < 4)
+                return -1;
+            hdr->restart = (p[0] << 8) | p[1];
+        } else if (m == 0xda) {
+            if ((hdr->width == 0) || (hdr->height == 0))
+                return -1;
+            //the stripes need every component in this one scan
+            if (p[0] != hdr->comps)
+                hdr->sequential = false;
+            hdr->scanOff = pos + 2 + len;
+            hdr->mcuW = maxH*DCTSIZE;
+            hdr->mcuH = maxV*DCTSIZE;
+            hdr->mcusPerRow = (hdr->width + hdr->mcuW - 1)/hdr->mcuW;
+            hdr->mcuRows = (hdr->height + hdr->mcuH - 1)/hdr->mcuH;
+            return 0;
+        } else if (m == JPEG_EOI) {
+            return -1;
+        }
+        pos += 2 + len;
+    }
+    return -1;
+}
+
+unsigned char* CameraMjpegDecoder::stripeBuf(int id, int size)
+{
+    if (mStripeBufSize[id] < size) {
+        free(mStripeBuf[id]);
+        //some slack so a slightly bigger frame doesn't realloc
+        mStripeBufSize[id] = size + size/8;
+        mStripeBuf[id] = (unsigned char*)malloc(mStripeBufSize[id]);
+        if (mStripeBuf[id] == NULL) {
+            mStripeBufSize[id] = 0;
+            return NULL;
+        }
+    }
+    return mStripeBuf[id];
+}
+
+/* returns the stripes built into job, <= 1 if the frame has to be decoded in one piece */
+int CameraMjpegDecoder::split(const unsigned char* src, int size, const mjpeg_header_t* hdr, mjpeg_job_t* job)
+{
+    int i,k,n = 0,end = size,units,stripes,segs,segsPerUnit,rowsPerUnit;
+    unsigned char m;
+
+    for (i = hdr->scanOff; i + 1 < size; i++) {
+        if (src[i] != 0xff)
+            continue;
+        m = src[i + 1];
+        if ((m == 0x00) || (m == 0xff))
+            continue;
+        if ((m < JPEG_RST0) || (m > JPEG_RST0 + 7)) {
+            end = i;
+            break;
+        }
+        if (n == mRstMax) {
+            int* off = (int*)realloc(mRstOff, sizeof(int)*(mRstMax + 256));
+            if (off == NULL)
+                return 1;
+            mRstOff = off;
+            mRstMax += 256;
+        }
+        mRstOff[n++] = i++;
+    }
+
+    //segment k: [k ? mRstOff[k-1] + 2 : scanOff, k < n ? mRstOff[k] : end)
+    segs = n + 1;
+    if (segs != (hdr->mcusPerRow*hdr->mcuRows + hdr->restart - 1)/hdr->restart)
+        return 1;
+    if ((hdr->mcusPerRow % hdr->restart) == 0) {
+        segsPerUnit = hdr->mcusPerRow/hdr->restart;
+        rowsPerUnit = 1;
+    } else if ((hdr->restart % hdr->mcusPerRow) == 0) {
+        segsPerUnit = 1;
+        rowsPerUnit = hdr->restart/hdr->mcusPerRow;
+    } else {
+        return 1;
+    }
+    units = (segs + segsPerUnit - 1)/segsPerUnit;
+    stripes = (mWorkers > units) ? units : mWorkers;
+    if (stripes < 2)
+        return 1;
+
+    for (i = 0; i < stripes; i++) {
+        int s0 = (units*i/stripes)*segsPerUnit;
+        int s1 = (units*(i + 1)/stripes)*segsPerUnit;
+        int row0 = (units*i/stripes)*rowsPerUnit*hdr->mcuH;
+        int row1 = (units*(i + 1)/stripes)*rowsPerUnit*hdr->mcuH;
+        int len = hdr->scanOff + 2, h;
+        unsigned char* buf;
+
+        if (s1 > segs)
+            s1 = segs;
+        if (row1 > hdr->height)
+            row1 = hdr->height;
+        for (k = s0; k < s1; k++)
+            len += ((k < n) ? mRstOff[k] : end) - (k ? mRstOff[k - 1] + 2 : hdr->scanOff) + 2;
+        buf = stripeBuf(i, len);
+        if (buf == NULL)
+            return 1;
+
+        memcpy(buf, src, hdr->scanOff);
+        h = row1 - row0;
+        buf[hdr->sofHeightOff] = h >> 8;
+        buf[hdr->sofHeightOff + 1] = h & 0xff;
+        len = hdr->scanOff;
+        for (k = s0; k < s1; k++) {
+            int start = k ? mRstOff[k - 1] + 2 : hdr->scanOff;
+            int stop = (k < n) ? mRstOff[k] : end;
+            //restart numbering starts over in every stripe
+            if (k > s0) {
+                buf[len++] = 0xff;
+                buf[len++] = JPEG_RST0 + ((k - s0 - 1) & 7);
+            }
+            memcpy(buf + len, src + start, stop - start);
+            len += stop - start;
+        }
+        buf[len++] = 0xff;
+        buf[len++] = JPEG_EOI;
+
+        job->stripe[i].jpg = buf;
+        job->stripe[i].len = len;
+        job->stripe[i].row = row0;
+        job->stripe[i].ret = 0;
+    }
+    return stripes;
+}
+
+int CameraMjpegDecoder::decodeStripe(const mjpeg_job_t* job, int id)
+{
+    mjpeg_stripe_t* stripe = (mjpeg_stripe_t*)&job->stripe[id];
+    struct jpeg_decompress_struct cinfo;
+    mjpeg_error_mgr_t jerr;
+    mjpeg_src_mgr_t src;
+    unsigned char* volatile line = NULL;
+    unsigned char* uvPlane = job->dst + job->stride*job->sliceHeight;
+    int uvRows = job->sliceHeight/2;
+    int i,j,x,y,w;
+    bool raw;
+
+    cinfo.err = jpeg_std_error(&jerr.pub);
+    jerr.pub.error_exit = mjpeg_error_exit;
+    jerr.pub.output_message = mjpeg_output_message;
+    if (setjmp(jerr.jump)) {
+        LOGE("%s(%d): libjpeg failed on stripe %d at row %d",__FUNCTION__,__LINE__,id,stripe->row);
+        jpeg_destroy_decompress(&cinfo);
+        free(line);
+        stripe->ret = -1;
+        return -1;
+    }
+    jpeg_create_decompress(&cinfo);
+    src.pub.init_source = mjpeg_init_source;
+    src.pub.fill_input_buffer = mjpeg_fill_input_buffer;
+    src.pub.skip_input_data = mjpeg_skip_input_data;
+    src.pub.resync_to_restart = jpeg_resync_to_restart;
+    src.pub.term_source = mjpeg_term_source;
+    src.pub.next_input_byte = stripe->jpg;
+    src.pub.bytes_in_buffer = stripe->len;
+    cinfo.src = &src.pub;
+    jpeg_read_header(&cinfo, TRUE);
+    mjpeg_std_huff_tables(&cinfo);
+
+    //4:2:2 and 4:2:0 come out as planes, anything else through the color converter
+    raw = (cinfo.num_components == 3) && (cinfo.jpeg_color_space == JCS_YCbCr)
+        && (cinfo.comp_info[0].h_samp_factor == 2)
+        && ((cinfo.comp_info[0].v_samp_factor == 1) || (cinfo.comp_info[0].v_samp_factor == 2))
+        && (cinfo.comp_info[1].h_samp_factor == 1) && (cinfo.comp_info[1].v_samp_factor == 1)
+        && (cinfo.comp_info[2].h_samp_factor == 1) && (cinfo.comp_info[2].v_samp_factor == 1);
+    cinfo.dct_method = JDCT_IFAST;
+    cinfo.do_fancy_upsampling = FALSE;
+    if (raw) {
+        cinfo.raw_data_out = TRUE;
+    } else {
+        cinfo.out_color_space = (cinfo.num_components == 1) ? JCS_GRAYSCALE : JCS_YCbCr;
+    }
+    jpeg_start_decompress(&cinfo);
+
+    if (raw) {
+        int mcuH = cinfo.max_v_samp_factor*DCTSIZE;
+        int yw = cinfo.comp_info[0].width_in_blocks*DCTSIZE;
+        int cw = cinfo.comp_info[1].width_in_blocks*DCTSIZE;
+        JSAMPROW yrows[2*DCTSIZE], urows[DCTSIZE], vrows[DCTSIZE];
+        JSAMPARRAY planes[3] = {yrows, urows, vrows};
+        unsigned char *u, *v;
+
+        line = (unsigned char*)malloc(yw*mcuH + 2*cw*DCTSIZE);
+        if (line == NULL)
+            goto stripe_fail;
+        u = line + yw*mcuH;
+        v = u + cw*DCTSIZE;
+        for (i = 0; i < mcuH; i++)
+            yrows[i] = line + i*yw;
+        for (i = 0; i < DCTSIZE; i++) {
+            urows[i] = u + i*cw;
+            vrows[i] = v + i*cw;
+        }
+        w = (yw < job->stride) ? yw : job->stride;
+
+        while (cinfo.output_scanline < cinfo.output_height) {
+            int row = stripe->row + cinfo.output_scanline;
+            if (jpeg_read_raw_data(&cinfo, planes, mcuH) == 0)
+                break;
+            for (j = 0; (j < mcuH) && (row + j < job->sliceHeight); j++)
+                memcpy(job->dst + (long)(row + j)*job->stride, yrows[j], w);
+            for (j = 0; (j < mcuH/2) && (row/2 + j < uvRows); j++) {
+                unsigned char* uv = uvPlane + (long)(row/2 + j)*job->stride;
+                if (mcuH == 2*DCTSIZE) {
+                    for (x = 0; x < w/2; x++) {
+                        uv[2*x] = urows[j][x];
+                        uv[2*x + 1] = vrows[j][x];
+                    }
+                } else {
+                    //4:2:2, two chroma rows for each nv12 one
+                    const unsigned char *u0 = urows[2*j], *u1 = urows[2*j + 1];
+                    const unsigned char *v0 = vrows[2*j], *v1 = vrows[2*j + 1];
+                    for (x = 0; x < w/2; x++) {
+                        uv[2*x] = (u0[x] + u1[x] + 1) >> 1;
+                        uv[2*x + 1] = (v0[x] + v1[x] + 1) >> 1;
+                    }
+                }
+            }
+        }
+    } else {
+        JSAMPROW row;
+
+        line = (unsigned char*)malloc(cinfo.output_width*cinfo.output_components);
+        if (line == NULL)
+            goto stripe_fail;
+        row = line;
+        w = ((int)cinfo.output_width < job->stride) ? (int)cinfo.output_width : job->stride;
+        while (cinfo.output_scanline < cinfo.output_height) {
+            y = stripe->row + cinfo.output_scanline;
+            if (jpeg_read_scanlines(&cinfo, &row, 1) == 0)
+                break;
+            if (y >= job->sliceHeight)
+                continue;
+            if (cinfo.output_components == 1) {
+                memcpy(job->dst + (long)y*job->stride, line, w);
+                if ((y & 1) == 0)
+                    memset(uvPlane + (long)(y/2)*job->stride, 128, w & ~1);
+                continue;
+            }
+            for (x = 0; x < w; x++)
+                job->dst[(long)y*job->stride + x] = line[3*x];
+            if ((y & 1) == 0) {
+                unsigned char* uv = uvPlane + (long)(y/2)*job->stride;
+                for (x = 0; x + 1 < w; x += 2) {
+                    uv[x] = line[3*x + 1];
+                    uv[x + 1] = line[3*x + 2];
+                }
+            }
+        }
+    }
+
+    jpeg_destroy_decompress(&cinfo);
+    free(line);
+    stripe->ret = 0;
+    return 0;
+
+stripe_fail:
+    jpeg_destroy_decompress(&cinfo);
+    stripe->ret = -1;
+    return -1;
+}
+
+int CameraMjpegDecoder::decode(const unsigned char* src, int size, unsigned char* dst, int stride, int sliceHeight)
+{
+    mjpeg_header_t hdr;
+    mjpeg_job_t job;
+    Message_cam msg;
+    nsecs_t start = systemTime(CLOCK_MONOTONIC), cost;
+    int i,stripes = 1,ret = 0;
+
+    Mutex::Autolock lock(mRunLock);
+    if ((src == NULL) || (dst == NULL) || (parseHeader(src, size, &hdr) < 0)) {
+        LOGE("%s(%d): mjpeg header is error!",__FUNCTION__,__LINE__);
+        mSwFails++;
+        return -1;
+    }
+    if ((hdr.width > stride) || (hdr.height > sliceHeight)) {
+        LOGE("%s(%d): %dx%d mjpeg frame doesn't fit %dx%d",__FUNCTION__,__LINE__,
+            hdr.width,hdr.height,stride,sliceHeight);
+        mSwFails++;
+        return -1;
+    }
+    job.dst = dst;
+    job.stride = stride;
+    job.sliceHeight = sliceHeight;
+    if ((mWorkers > 1) && hdr.sequential && (hdr.restart > 0))
+        stripes = split(src, size, &hdr, &job);
+    if (stripes < 2) {
+        stripes = 1;
+        job.stripe[0].jpg = src;
+        job.stripe[0].len = size;
+        job.stripe[0].row = 0;
+        job.stripe[0].ret = 0;
+    }
+
+    if (stripes > 1) {
+        mJobLock.lock();
+        mPending = stripes - 1;
+        mJobLock.unlock();
+        for (i = 1; i < stripes; i++) {
+            msg.command = CMD_MJPEGDEC_RUN;
+            msg.arg2 = (void*)&job;
+            mWorkerQ[i].put(&msg);
+        }
+    }
+    decodeStripe(&job, 0);
+    if (stripes > 1) {
+        Mutex::Autolock jobLock(mJobLock);
+        while (mPending > 0)
+            mJobCond.wait(mJobLock);
+    }
+    for (i = 0; i < stripes; i++) {
+        if (job.stripe[i].ret < 0)
+            ret = -1;
+    }
+
+    cost = systemTime(CLOCK_MONOTONIC) - start;
+    if (ret < 0)
+        mSwFails++;
+    mSwFrames++;
+    if (stripes > 1)
+        mSwStriped++;
+    mSwTotal += cost;
+    if (cost > mSwMax)
+        mSwMax = cost;
+    if ((mSwFrames % MJPEG_STATS_FRAMES) == 0) {
+        LOG1("%s(%d): sw mjpeg %dx%d: %u frames, %u striped, avg %lld us, max %lld us",__FUNCTION__,__LINE__,
+            hdr.width,hdr.height,mSwFrames,mSwStriped,(long long)(mSwTotal/mSwFrames/1000),(long long)(mSwMax/1000));
+    }
+
+    //sw was picked for speed: go back to the vpu if it isn't faster
+    if (mSwForSpeed) {
+        mSwCost = mSwCost ? (mSwCost*7 + cost)/8 : cost;
+        if ((++mFrameCnt >= MJPEG_JUDGE_FRAMES) && (mSwCost >= mHwCostAtSwitch)) {
+            LOGD("%s(%d): sw mjpeg %lld us isn't faster than vpu %lld us, back to vpu",__FUNCTION__,__LINE__,
+                (long long)(mSwCost/1000),(long long)(mHwCostAtSwitch/1000));
+            mSwForSpeed = false;
+            mHoldHw = MJPEG_HOLD_FRAMES;
+            mFrameCnt = 0;
+            mHwCost = 0;
+        }
+    }
+    return ret;
+}
+
+void CameraMjpegDecoder::reset(bool hwReady, int fps)
+{
+    char prop[PROPERTY_VALUE_MAX];
+
+    property_get(CAMERAHAL_MJPEG_SW_PROPERTY_KEY, prop, "0");
+    mMode = atoi(prop);
+    if ((mMode < CAM_MJPEG_MODE_AUTO) || (mMode > CAM_MJPEG_MODE_HW))
+        mMode = CAM_MJPEG_MODE_AUTO;
+    mHwReady = hwReady;
+    mHwOff = false;
+    mSwForSpeed = false;
+    mHwFailCnt = 0;
+    mFrameCnt = 0;
+    mHoldHw = 0;
+    mFramePeriod = (fps > 0) ? s2ns(1)/fps : 0;
+    mHwCost = 0;
+    mSwCost = 0;
+    mHwCostAtSwitch = 0;
+    mSwFrames = 0;
+    mSwFails = 0;
+    mSwStriped = 0;
+    mHwFrames = 0;
+    mSwTotal = 0;
+    mSwMax = 0;
+}
+
+bool CameraMjpegDecoder::useHw()
+{
+    if (!mHwReady || (mMode == CAM_MJPEG_MODE_SW))
+        return false;
+    if (mMode == CAM_MJPEG_MODE_HW)
+        return true;
+    return !mHwOff && !mSwForSpeed;
+}
+
+void CameraMjpegDecoder::hwDone(bool ok, nsecs_t cost)
+{
+    mHwFrames++;
+    if (!ok) {
+        if ((++mHwFailCnt >= MJPEG_HW_FAIL_MAX) && (mMode == CAM_MJPEG_MODE_AUTO) && !mHwOff) {
+            LOGD("%s(%d): vpu mjpeg decoder failed %d times, use sw decoder",__FUNCTION__,__LINE__,mHwFailCnt);
+            mHwOff = true;
+        }
+        return;
+    }
+    mHwFailCnt = 0;
+    mHwCost = mHwCost ? (mHwCost*7 + cost)/8 : cost;
+    if (mHoldHw > 0) {
+        mHoldHw--;
+        return;
+    }
+    if (++mFrameCnt < MJPEG_JUDGE_FRAMES)
+        return;
+    mFrameCnt = 0;
+    //the vpu is shared with the encoders, it may not keep up with the stream
+    if ((mMode == CAM_MJPEG_MODE_AUTO) && (mFramePeriod > 0) && (mHwCost > mFramePeriod) && (mWorkers > 1)) {
+        LOGD("%s(%d): vpu mjpeg %lld us per frame, behind %lld us frame period, try sw decoder",__FUNCTION__,__LINE__,
+            (long long)(mHwCost/1000),(long long)(mFramePeriod/1000));
+        mSwForSpeed = true;
+        mHwCostAtSwitch = mHwCost;
+        mSwCost = 0;
+    }
+}
+
+void CameraMjpegDecoder::dump()
+{
+    LOGD("%s(%d): mode %d vpu %s: vpu %u frames avg %lld us, sw %u frames (%u striped, %u failed) avg %lld us max %lld us",
+        __FUNCTION__,__LINE__,mMode,(mHwReady && !mHwOff) ? "on" : "off",mHwFrames,(long long)(mHwCost/1000),
+        mSwFrames,mSwStriped,mSwFails,(long long)(mSwFrames ? mSwTotal/mSwFrames/1000 : 0),(long long)(mSwMax/1000));
+}
+
+}
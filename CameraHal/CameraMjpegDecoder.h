@@ -0,0 +1,139 @@
+#ifndef ANDROID_HARDWARE_CAMERA_MJPEG_DECODER_H
+#define ANDROID_HARDWARE_CAMERA_MJPEG_DECODER_H
+
+//sw mjpeg -> nv12 decoder, and the choice between it and the vpu decoder
+#include <utils/threads.h>
+#include <utils/Timers.h>
+#include "MessageQueue.h"
+#include "CameraThreadConfig.h"
+
+#define CAMERAHAL_MJPEG_SW_PROPERTY_KEY     "sys_graphic.cam_hal.mjpeg_sw"  /* 0: auto, 1: sw only, 2: vpu only */
+
+namespace android {
+
+#define CAM_MJPEG_WORKER_MAX    4
+
+enum CamMjpegMode {
+    CAM_MJPEG_MODE_AUTO,
+    CAM_MJPEG_MODE_SW,
+    CAM_MJPEG_MODE_HW
+};
+
+/*
+ * Frames carrying restart markers are cut at the restart intervals that end
+ * a mcu row; each stripe becomes a small jpeg of its own (same tables, the
+ * height patched, markers renumbered) and the stripes are decoded on the
+ * workers, the caller's thread taking the first one. Frames without restart
+ * markers are decoded on the caller's thread. UVC cameras usually leave the
+ * huffman tables out, the standard ones are used then.
+ *
+ * useHw()/hwDone() pick the decoder per frame: the vpu one while it works
+ * and keeps up with the frame rate, this one otherwise.
+ */
+class CameraMjpegDecoder {
+public:
+    enum MjpegDecoderCommands {
+        CMD_MJPEGDEC_RUN,
+        CMD_MJPEGDEC_EXIT
+    };
+
+    CameraMjpegDecoder();
+    ~CameraMjpegDecoder();
+    int init(int workers);
+    void destroy();
+    //nv12: y plane stride x sliceHeight, uv plane follows it. Rows and columns past
+    //the picture are filled from the mcu padding up to stride and sliceHeight
+    int decode(const unsigned char* src, int size, unsigned char* dst, int stride, int sliceHeight);
+
+    //new stream; fps is the expected frame rate
+    void reset(bool hwReady, int fps);
+    bool useHw();
+    //cost: time spent in the vpu decode call
+    void hwDone(bool ok, nsecs_t cost);
+    void dump();
+
+private:
+    typedef struct mjpeg_header {
+        int width;
+        int height;
+        int comps;
+        int mcuW;
+        int mcuH;
+        int mcusPerRow;
+        int mcuRows;
+        int restart;                    /* mcus per restart interval, 0: none */
+        bool sequential;                /* one interleaved huffman scan */
+        bool hasDht;
+        int sofHeightOff;               /* offset of the frame height in the SOF */
+        int scanOff;                    /* first byte of entropy coded data */
+    } mjpeg_header_t;
+
+    typedef struct mjpeg_stripe {
+        const unsigned char* jpg;
+        int len;
+        int row;                        /* first picture row */
+        int ret;
+    } mjpeg_stripe_t;
+
+    typedef struct mjpeg_job {
+        unsigned char* dst;
+        int stride;
+        int sliceHeight;
+        mjpeg_stripe_t stripe[CAM_MJPEG_WORKER_MAX];
+    } mjpeg_job_t;
+
+    class MjpegDecodeThread : public Thread {
+        CameraMjpegDecoder* mDecoder;
+        int mId;
+    public:
+        MjpegDecodeThread(CameraMjpegDecoder* decoder, int id)
+            : Thread(false), mDecoder(decoder), mId(id) {}
+
+        virtual bool threadLoop() {
+            CameraThreadConfig::enter("CamMjpegDec");
+            mDecoder->workerThread(mId);
+            return false;
+        }
+    };
+
+    static int parseHeader(const unsigned char* src, int size, mjpeg_header_t* hdr);
+    static int decodeStripe(const mjpeg_job_t* job, int id);
+    void workerThread(int id);
+    int split(const unsigned char* src, int size, const mjpeg_header_t* hdr, mjpeg_job_t* job);
+    unsigned char* stripeBuf(int id, int size);
+
+    int mWorkers;
+    Mutex mRunLock;                     /* one frame at a time */
+    Mutex mJobLock;
+    Condition mJobCond;
+    int mPending;
+    unsigned char* mStripeBuf[CAM_MJPEG_WORKER_MAX];
+    int mStripeBufSize[CAM_MJPEG_WORKER_MAX];
+    int* mRstOff;                       /* restart marker offsets of the current frame */
+    int mRstMax;
+
+    sp<MjpegDecodeThread> mWorker[CAM_MJPEG_WORKER_MAX];
+    MessageQueue mWorkerQ[CAM_MJPEG_WORKER_MAX];
+
+    int mMode;
+    bool mHwReady;
+    bool mHwOff;                        /* vpu decoder failed, sw for the rest of the stream */
+    bool mSwForSpeed;                   /* sw because the vpu decoder fell behind */
+    int mHwFailCnt;
+    int mFrameCnt;                      /* frames on the current path */
+    int mHoldHw;                        /* frames before the vpu decoder may be judged slow again */
+    nsecs_t mFramePeriod;
+    nsecs_t mHwCost;                    /* running averages */
+    nsecs_t mSwCost;
+    nsecs_t mHwCostAtSwitch;
+
+    unsigned int mSwFrames;
+    unsigned int mSwFails;
+    unsigned int mSwStriped;
+    unsigned int mHwFrames;
+    nsecs_t mSwTotal;
+    nsecs_t mSwMax;
+};
+
+}
+#endif
@@ -0,0 +1,198 @@
+#include "CameraParamDiff.h"
+#include <stdlib.h>
+#include <string.h>
+
+namespace android {
+
+typedef struct param_key {
+    const char* key;
+    unsigned int group;
+} param_key_t;
+
+static const param_key_t param_keys[] = {
+    { CameraParameters::KEY_PREVIEW_SIZE,               CAM_PARAM_PREVIEW_SIZE },
+    { CameraParameters::KEY_PREVIEW_FORMAT,             CAM_PARAM_PREVIEW_SIZE },
+    { CameraParameters::KEY_PICTURE_SIZE,               CAM_PARAM_PICTURE },
+    { CameraParameters::KEY_PICTURE_FORMAT,             CAM_PARAM_PICTURE },
+    { CameraParameters::KEY_VIDEO_SIZE,                 CAM_PARAM_VIDEO },
+    { CameraParameters::KEY_RECORDING_HINT,             CAM_PARAM_VIDEO },
+    { CameraParameters::KEY_PREVIEW_FPS_RANGE,          CAM_PARAM_FPS },
+    { CameraParameters::KEY_PREVIEW_FRAME_RATE,         CAM_PARAM_FPS },
+    { CameraParameters::KEY_ZOOM,                       CAM_PARAM_ZOOM },
+    { "3dnr_enabled",                                   CAM_PARAM_3DNR },
+    { CameraParameters::KEY_METERING_AREAS,             CAM_PARAM_METERING_AREAS },
+    { CameraParameters::KEY_FOCUS_MODE,                 CAM_PARAM_FOCUS_MODE },
+    { CameraParameters::KEY_FOCUS_AREAS,                CAM_PARAM_FOCUS_AREAS },
+    { CameraParameters::KEY_FLASH_MODE,                 CAM_PARAM_FLASH },
+    { CameraParameters::KEY_WHITE_BALANCE,              CAM_PARAM_WHITE_BALANCE },
+    { CameraParameters::KEY_EXPOSURE_COMPENSATION,      CAM_PARAM_EXPOSURE },
+    { CameraParameters::KEY_SCENE_MODE,                 CAM_PARAM_SCENE },
+    { CameraParameters::KEY_EFFECT,                     CAM_PARAM_EFFECT },
+    { CameraParameters::KEY_ANTIBANDING,                CAM_PARAM_ANTIBANDING },
+};
+
+#define PARAM_KEY_CNT   (int)(sizeof(param_keys)/sizeof(param_keys[0]))
+
+typedef struct param_span {
+    const char* key;
+    int klen;
+    const char* val;
+    int vlen;
+} param_span_t;
+
+static int param_span_cmp(const void* a, const void* b)
+{
+    const param_span_t* x = (const param_span_t*)a;
+    const param_span_t* y = (const param_span_t*)b;
+    int ret = memcmp(x->key, y->key, (x->klen < y->klen) ? x->klen : y->klen);
+
+    return ret ? ret : (x->klen - y->klen);
+}
+
+/* "k1=v1;k2=v2" -> spans sorted by key, same rules as CameraParameters::unflatten */
+static int param_split(const char* str, param_span_t** out)
+{
+    param_span_t* span;
+    const char *p, *end, *eq;
+    int cnt = 1, n = 0;
+
+    for (p = str; *p; p++) {
+        if (*p == ';')
+            cnt++;
+    }
+    span = (param_span_t*)malloc(sizeof(param_span_t)*cnt);
+    if (span == NULL)
+        return -1;
+    for (p = str; *p; p = (*end) ? end + 1 : end) {
+        end = strchr(p, ';');
+        if (end == NULL)
+            end = p + strlen(p);
+        eq = (const char*)memchr(p, '=', end - p);
+        if (eq == NULL)
+            continue;
+        span[n].key = p;
+        span[n].klen = eq - p;
+        span[n].val = eq + 1;
+        span[n].vlen = end - eq - 1;
+        n++;
+    }
+    qsort(span, n, sizeof(param_span_t), param_span_cmp);
+    *out = span;
+    return n;
+}
+
+unsigned int CameraParamDiff::group(const char* key, int len)
+{
+    int i;
+
+    for (i = 0; i < PARAM_KEY_CNT; i++) {
+        if ((strncmp(param_keys[i].key, key, len) == 0) && (param_keys[i].key[len] == 0))
+            return param_keys[i].group;
+    }
+    return CAM_PARAM_OTHER;
+}
+
+unsigned int CameraParamDiff::diff(const CameraParameters& cur, const CameraParameters& next)
+{
+    unsigned int changed = 0;
+    const char *a, *b;
+    int i;
+
+    for (i = 0; i < PARAM_KEY_CNT; i++) {
+        if (changed & param_keys[i].group)
+            continue;
+        a = cur.get(param_keys[i].key);
+        b = next.get(param_keys[i].key);
+        if ((a != b) && ((a == NULL) || (b == NULL) || strcmp(a, b)))
+            changed |= param_keys[i].group;
+    }
+    return changed;
+}
+
+unsigned int CameraParamDiff::diff(const char* cur, const char* next)
+{
+    param_span_t *a = NULL, *b = NULL;
+    unsigned int changed = 0;
+    int na, nb, i = 0, j = 0, c;
+
+    if ((cur == NULL) || (next == NULL))
+        return CAM_PARAM_ALL;
+    na = param_split(cur, &a);
+    nb = param_split(next, &b);
+    if ((na < 0) || (nb < 0)) {
+        changed = CAM_PARAM_ALL;
+        goto diff_end;
+    }
+    while ((i < na) || (j < nb)) {
+        if (i == na)
+            c = 1;
+        else if (j == nb)
+            c = -1;
+        else
+            c = param_span_cmp(&a[i], &b[j]);
+        if (c < 0) {
+            changed |= group(a[i].key, a[i].klen);
+            i++;
+        } else if (c > 0) {
+            changed |= group(b[j].key, b[j].klen);
+            j++;
+        } else {
+            if ((a[i].vlen != b[j].vlen) || memcmp(a[i].val, b[j].val, a[i].vlen))
+                changed |= group(a[i].key, a[i].klen);
+            i++;
+            j++;
+        }
+    }
+
+diff_end:
+    free(a);
+    free(b);
+    return changed;
+}
+
+void CameraParamDiff::merge(CameraParameters& dst, const CameraParameters& src, unsigned int groups)
+{
+    const char* val;
+    int i;
+
+    for (i = 0; i < PARAM_KEY_CNT; i++) {
+        if ((param_keys[i].group & groups) == 0)
+            continue;
+        val = src.get(param_keys[i].key);
+        if (val)
+            dst.set(param_keys[i].key, val);
+        else
+            dst.remove(param_keys[i].key);
+    }
+}
+
+bool CameraParamDiff::parseArea(const char* str, cam_param_area_t* area)
+{
+    int v[5], i;
+    char* end;
+
+    if ((str == NULL) || (*str != '('))
+        return false;
+    str++;
+    for (i = 0; i < 5; i++) {
+        v[i] = strtol(str, &end, 10);
+        if ((end == str) || (*end != ((i < 4) ? ',' : ')')))
+            return false;
+        str = end + 1;
+    }
+    if (*str != 0)
+        return false;
+
+    area->left = v[0];
+    area->top = v[1];
+    area->right = v[2];
+    area->bottom = v[3];
+    area->weight = v[4];
+    if ((v[0] == 0) && (v[1] == 0) && (v[2] == 0) && (v[3] == 0) && (v[4] == 0))
+        return true;
+    return (v[0] >= -1000) && (v[1] >= -1000) && (v[2] <= 1000) && (v[3] <= 1000)
+        && (v[2] > v[0]) && (v[3] > v[1])
+        && (v[4] >= 1) && (v[4] <= 1000);
+}
+
+}
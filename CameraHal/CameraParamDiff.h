@@ -0,0 +1,52 @@
+#ifndef ANDROID_HARDWARE_CAMERA_PARAM_DIFF_H
+#define ANDROID_HARDWARE_CAMERA_PARAM_DIFF_H
+
+//which groups of camera parameters differ between two parameter sets
+#include <camera/CameraParameters.h>
+
+namespace android {
+
+#define CAM_PARAM_PREVIEW_SIZE      (1 << 0)    /* preview size and format */
+#define CAM_PARAM_PICTURE           (1 << 1)    /* picture size and format */
+#define CAM_PARAM_VIDEO             (1 << 2)    /* video size, recording hint */
+#define CAM_PARAM_FPS               (1 << 3)
+#define CAM_PARAM_ZOOM              (1 << 4)
+#define CAM_PARAM_3DNR              (1 << 5)
+#define CAM_PARAM_METERING_AREAS    (1 << 6)
+#define CAM_PARAM_FOCUS_MODE        (1 << 7)
+#define CAM_PARAM_FOCUS_AREAS       (1 << 8)
+#define CAM_PARAM_FLASH             (1 << 9)
+#define CAM_PARAM_WHITE_BALANCE     (1 << 10)
+#define CAM_PARAM_EXPOSURE          (1 << 11)
+#define CAM_PARAM_SCENE             (1 << 12)
+#define CAM_PARAM_EFFECT            (1 << 13)
+#define CAM_PARAM_ANTIBANDING       (1 << 14)
+#define CAM_PARAM_OTHER             (1u << 31)  /* a key outside the table */
+#define CAM_PARAM_ALL               0xffffffff
+
+//what apps push every frame (sliders, touch regions); applied asynchronously, latest wins
+#define CAM_PARAM_COALESCE          (CAM_PARAM_ZOOM | CAM_PARAM_METERING_AREAS | CAM_PARAM_FOCUS_AREAS)
+
+typedef struct cam_param_area_s {
+    int left;                           /* -1000..1000 */
+    int top;
+    int right;
+    int bottom;
+    int weight;                         /* 1..1000, all 0: no area */
+} cam_param_area_t;
+
+class CameraParamDiff {
+public:
+    //keys in the table only, both sets must have the table keys the adapter relies on
+    static unsigned int diff(const CameraParameters& cur, const CameraParameters& next);
+    //every key of two flattened strings, in any key order
+    static unsigned int diff(const char* cur, const char* next);
+    static unsigned int group(const char* key, int len);
+    //copies the table keys of groups from src into dst, removing those src lacks
+    static void merge(CameraParameters& dst, const CameraParameters& src, unsigned int groups);
+    //a single "(l,t,r,b,w)" area; false for several areas or values out of range
+    static bool parseArea(const char* str, cam_param_area_t* area);
+};
+
+}
+#endif
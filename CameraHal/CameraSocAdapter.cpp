@@ -31,6 +31,8 @@ CameraSOCAdapter::CameraSOCAdapter(int cameraId)
 	mFlashMode_number = 0;
 	m_focus_mode = CameraSOCAdapter::focus_fixed;
 	m_focus_value = 0;
+	memset(m_taf_roi, 0, sizeof(m_taf_roi));
+    memset(mMenuHash, 0, sizeof(mMenuHash));
 
 }
 CameraSOCAdapter::~CameraSOCAdapter()
@@ -202,6 +204,7 @@ void CameraSOCAdapter::initDefaultParameters(int camFd)
 	
 	LOG_FUNCTION_NAME	 
 	memset(str_picturesize,0x00,sizeof(str_picturesize));
+    memset(mMenuHash, 0, sizeof(mMenuHash));
 
 	fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
 	fmt.fmt.pix.pixelformat= mCamDriverPreviewFmt;
@@ -375,6 +378,7 @@ void CameraSOCAdapter::initDefaultParameters(int camFd)
 				if (whiteBalance.default_value == i) {
 					strcpy(cur_param, (char *)whiteBalance_menu->name);
 				}
+				menuHashAdd(whiteBalance_menu);
 				mWhiteBalance_number++;
 			}
 			whiteBalance_menu++;
@@ -401,6 +405,7 @@ void CameraSOCAdapter::initDefaultParameters(int camFd)
 				if (effect.default_value == i) {
 					strcpy(cur_param, (char *)effect_menu->name);
 				}
+				menuHashAdd(effect_menu);
 				mEffect_number++;
 			}
 			effect_menu++;
@@ -427,6 +432,7 @@ void CameraSOCAdapter::initDefaultParameters(int camFd)
 				if (scene.default_value == i) {
 					strcpy(cur_param, (char *)scene_menu->name);
 				}
+				menuHashAdd(scene_menu);
 				mScene_number++;
 			}
 			scene_menu++;
@@ -453,6 +459,7 @@ void CameraSOCAdapter::initDefaultParameters(int camFd)
 				if (Antibanding.default_value == i) {
 					strcpy(cur_param, (char *)Antibanding_menu->name);
 				}
+				menuHashAdd(Antibanding_menu);
 				mAntibanding_number++;
 			}
 			Antibanding_menu++;
@@ -512,6 +519,7 @@ void CameraSOCAdapter::initDefaultParameters(int camFd)
 				if (flashMode.default_value == i) {
 					strcpy(cur_param, (char *)flashMode_menu->name);
 				}
+				menuHashAdd(flashMode_menu);
 				mFlashMode_number++;
 				flashMode_menu++;				 
 			}
@@ -521,11 +529,14 @@ void CameraSOCAdapter::initDefaultParameters(int camFd)
 	}
 	/*focus mode setting*/
 	struct v4l2_queryctrl focus;
+	bool driverAf;
 	
 	parameterString = CameraParameters::FOCUS_MODE_FIXED;
 	params.set(CameraParameters::KEY_FOCUS_MODE, CameraParameters::FOCUS_MODE_FIXED);
 	focus.id = V4L2_CID_FOCUS_AUTO;
-	if (!ioctl(mCamFd, VIDIOC_QUERYCTRL, &focus)) {
+	driverAf = !ioctl(mCamFd, VIDIOC_QUERYCTRL, &focus);
+	//without driver af, a lens with absolute focus is focused by the hal
+	if (mContrastAf.init(mCamFd, driverAf) || driverAf) {
 		parameterString.append(",");
 		parameterString.append(CameraParameters::FOCUS_MODE_AUTO);
 		params.set(CameraParameters::KEY_FOCUS_MODE, CameraParameters::FOCUS_MODE_AUTO);
@@ -550,7 +561,7 @@ void CameraSOCAdapter::initDefaultParameters(int camFd)
 	focus.id = V4L2_CID_FOCUSZONE;
 	 
 	// focus area settings
-	if (!ioctl(mCamFd, VIDIOC_QUERYCTRL, &focus)) {
+	if (mContrastAf.active() || !ioctl(mCamFd, VIDIOC_QUERYCTRL, &focus)) {
 	
 	   params.set(CameraParameters::KEY_MAX_NUM_FOCUS_AREAS,"1");
 	}else{
@@ -759,34 +770,146 @@ int CameraSOCAdapter::setParameters(const CameraParameters &params_set,bool &isR
     return 0;
 }
 
-int CameraSOCAdapter::cameraConfig(const CameraParameters &tmpparams,bool isInit,bool &isRestartValue)
+/* FNV-1a over the menu name, seeded with the control id */
+static unsigned int soc_menu_hash(__u32 id, const char* name)
 {
-    int err = 0, i = 0;
+    unsigned int h = 2166136261u ^ id;
+
+    while (*name) {
+        h ^= (unsigned char)*name++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+void CameraSOCAdapter::menuHashAdd(const struct v4l2_querymenu* menu)
+{
+    unsigned int i, h = soc_menu_hash(menu->id, (const char*)menu->name);
+
+    for (i = 0; i < SOC_MENU_HASH_SIZE; i++) {
+        const struct v4l2_querymenu** slot = &mMenuHash[(h + i) & (SOC_MENU_HASH_SIZE - 1)];
+        if ((*slot == NULL) || (*slot == menu)) {
+            *slot = menu;
+            return;
+        }
+    }
+    LOGE("%s(%d): menu hash full, %s not added",__FUNCTION__,__LINE__,(const char*)menu->name);
+}
+
+const struct v4l2_querymenu* CameraSOCAdapter::menuFind(__u32 id, const char* name)
+{
+    unsigned int i, h;
+    const struct v4l2_querymenu* menu;
+
+    if (name == NULL)
+        return NULL;
+    h = soc_menu_hash(id, name);
+    for (i = 0; i < SOC_MENU_HASH_SIZE; i++) {
+        menu = mMenuHash[(h + i) & (SOC_MENU_HASH_SIZE - 1)];
+        if (menu == NULL)
+            break;
+        if ((menu->id == id) && !strcmp((const char*)menu->name, name))
+            return menu;
+    }
+    return NULL;
+}
+
+void CameraSOCAdapter::ctrlQueue(soc_ctrl_batch_t* batch, __u32 ctrlClass, __u32 id, __s32 val, const char* label, const char* value)
+{
+    int n = batch->count;
+
+    if (n >= SOC_CTRL_BATCH_MAX) {
+        LOGE("%s(%d): too many controls, %s(%s) dropped",__FUNCTION__,__LINE__,label,value);
+        return;
+    }
+    memset(&batch->ctrl[n], 0, sizeof(struct v4l2_ext_control));
+    batch->ctrl[n].id = id;
+    batch->ctrl[n].value = val;
+    batch->ctrlClass[n] = ctrlClass;
+    batch->label[n] = label;
+    batch->value[n] = value;
+    batch->count++;
+}
+
+/* one ioctl per control class; if the driver refuses a batch, its controls are set one by one */
+int CameraSOCAdapter::ctrlApply(soc_ctrl_batch_t* batch)
+{
+    struct v4l2_ext_control ctrls[SOC_CTRL_BATCH_MAX];
+    struct v4l2_ext_controls extCtrInfos;
     struct v4l2_control control;
-	struct v4l2_ext_control extCtrInfo;
-	struct v4l2_ext_controls extCtrInfos;
+    int idx[SOC_CTRL_BATCH_MAX];
+    bool done[SOC_CTRL_BATCH_MAX];
+    int i, j, n, err, ret = 0;
+
+    memset(done, 0, sizeof(done));
+    for (i = 0; i < batch->count; i++) {
+        if (done[i])
+            continue;
+        n = 0;
+        for (j = i; j < batch->count; j++) {
+            if (!done[j] && (batch->ctrlClass[j] == batch->ctrlClass[i])) {
+                ctrls[n] = batch->ctrl[j];
+                idx[n++] = j;
+                done[j] = true;
+            }
+        }
+
+        memset(&extCtrInfos, 0, sizeof(extCtrInfos));
+        extCtrInfos.ctrl_class = batch->ctrlClass[i];
+        extCtrInfos.count = n;
+        extCtrInfos.controls = ctrls;
+        err = ioctl(mCamFd, VIDIOC_S_EXT_CTRLS, &extCtrInfos);
+        if (err == 0) {
+            for (j = 0; j < n; j++)
+                LOGD("%s(%d): Set %s(%s) success",__FUNCTION__,__LINE__,batch->label[idx[j]],batch->value[idx[j]]);
+            continue;
+        }
+
+        LOG1("%s(%d): batch of %d controls (class 0x%x) failed, set them one by one",
+            __FUNCTION__,__LINE__,n,batch->ctrlClass[i]);
+        for (j = 0; j < n; j++) {
+            if (batch->ctrlClass[i] == V4L2_CTRL_CLASS_USER) {
+                control.id = ctrls[j].id;
+                control.value = ctrls[j].value;
+                err = ioctl(mCamFd, VIDIOC_S_CTRL, &control);
+            } else {
+                extCtrInfos.count = 1;
+                extCtrInfos.controls = &ctrls[j];
+                err = ioctl(mCamFd, VIDIOC_S_EXT_CTRLS, &extCtrInfos);
+            }
+            if (err < 0) {
+                LOGE("%s(%d): Set %s(%s) failed",__FUNCTION__,__LINE__,batch->label[idx[j]],batch->value[idx[j]]);
+                ret = -1;
+            } else {
+                LOGD("%s(%d): Set %s(%s) success",__FUNCTION__,__LINE__,batch->label[idx[j]],batch->value[idx[j]]);
+            }
+        }
+    }
+    batch->count = 0;
+    return ret;
+}
+
+int CameraSOCAdapter::cameraConfig(const CameraParameters &tmpparams,bool isInit,bool &isRestartValue)
+{
+    int err = 0;
+    const struct v4l2_querymenu* menu;
+    soc_ctrl_batch_t batch;
 	CameraParameters params = tmpparams;
 
-    LOGD("set whitebalance");
+    //controls are only queued here, nothing reaches the driver if the set is refused
+    batch.count = 0;
+
     /*white balance setting*/
     const char *white_balance = params.get(CameraParameters::KEY_WHITE_BALANCE);
 	const char *mwhite_balance = mParameters.get(CameraParameters::KEY_WHITE_BALANCE);
 	if (params.get(CameraParameters::KEY_SUPPORTED_WHITE_BALANCE)) {
 		if ( !mwhite_balance || strcmp(white_balance, mwhite_balance) ) {
             /* ddl@rock-chips.com: v0.4.9 */
-    			for (i = 0; i < mWhiteBalance_number; i++) {
-    				if (!strcmp((char *)mWhiteBalance_menu[i].name, white_balance)) {
-    					break;
-    				}
-    			}
-    			control.id = mWhiteBalance_menu[i].id;
-    			control.value = mWhiteBalance_menu[i].index;
-    			err = ioctl(mCamFd, VIDIOC_S_CTRL, &control);
-
-            if (err<0) {
-                LOGE("%s(%d): Set white balance(%s) failed",__FUNCTION__,__LINE__,white_balance);
-            } else {                    
-                LOGD("%s(%d): Set white balance(%s) success",__FUNCTION__,__LINE__,white_balance);
+            menu = menuFind(V4L2_CID_DO_WHITE_BALANCE, white_balance);
+            if (menu == NULL) {
+                LOGE("%s(%d): white balance(%s) is not support",__FUNCTION__,__LINE__,white_balance);
+            } else {
+                ctrlQueue(&batch, V4L2_CTRL_CLASS_USER, menu->id, menu->index, "white balance", (const char*)menu->name);
             }
 		}
 	}
@@ -801,141 +924,68 @@ int CameraSOCAdapter::cameraConfig(const CameraParameters &tmpparams,bool isInit
 			return BAD_VALUE;
 	}
 
-
-    LOGD("set color effect");
-
     /*color effect setting*/
     const char *effect = params.get(CameraParameters::KEY_EFFECT);
 	const char *meffect = mParameters.get(CameraParameters::KEY_EFFECT);
 	if (params.get(CameraParameters::KEY_SUPPORTED_EFFECTS)) {
 		if ( ( !meffect || strcmp(effect, meffect) ) ) {
-			for (i = 0; i < mEffect_number; i++) {
-				if (!strcmp((char *)mEffect_menu[i].name, effect)) {
-					break;
-				}
-			}
-
-			extCtrInfo.id = mEffect_menu[i].id;
-			extCtrInfo.value = mEffect_menu[i].index;
-			extCtrInfos.ctrl_class = V4L2_CTRL_CLASS_CAMERA;
-			extCtrInfos.count = 1;
-			extCtrInfos.controls = &extCtrInfo;
-			err = ioctl(mCamFd, VIDIOC_S_EXT_CTRLS, &extCtrInfos);
-			if ( err < 0 ){
-				LOGE ("%s(%d): Set effect(%s) fail",__FUNCTION__,__LINE__,effect);
-			} else {
-			    LOGD("%s(%d): Set effect %s",__FUNCTION__,__LINE__, (char *)mEffect_menu[i].name);
-			}
+            menu = menuFind(V4L2_CID_EFFECT, effect);
+            if (menu == NULL) {
+				LOGE ("%s(%d): effect(%s) is not support",__FUNCTION__,__LINE__,effect);
+            } else {
+                ctrlQueue(&batch, V4L2_CTRL_CLASS_CAMERA, menu->id, menu->index, "effect", (const char*)menu->name);
+            }
 		}
 	}
 
-    LOGD("set scene");
 	/*scene setting*/
     const char *scene = params.get(CameraParameters::KEY_SCENE_MODE);
 	const char *mscene = mParameters.get(CameraParameters::KEY_SCENE_MODE);
 	if (params.get(CameraParameters::KEY_SUPPORTED_SCENE_MODES)) {
 		if ( !mscene || strcmp(scene, mscene) ) {
-			for (i = 0; i < mScene_number; i++) {
-				if (!strcmp((char *)mScene_menu[i].name, scene)) {
-					break;
-				}
-			}
-			extCtrInfo.id = mScene_menu[i].id;
-			extCtrInfo.value = mScene_menu[i].index;
-			extCtrInfos.ctrl_class = V4L2_CTRL_CLASS_CAMERA;
-			extCtrInfos.count = 1;
-			extCtrInfos.controls = &extCtrInfo;
-			err = ioctl(mCamFd, VIDIOC_S_EXT_CTRLS, &extCtrInfos);
-			if ( err < 0 ){
-				LOGE("%s(%d): Set scene(%s) failed",__FUNCTION__,__LINE__,scene);
-			} else {
-			    LOGD ("%s(%d): Set scene %s ",__FUNCTION__,__LINE__, (char *)mScene_menu[i].name);
-			}
+            menu = menuFind(V4L2_CID_SCENE, scene);
+            if (menu == NULL) {
+				LOGE("%s(%d): scene(%s) is not support",__FUNCTION__,__LINE__,scene);
+            } else {
+                ctrlQueue(&batch, V4L2_CTRL_CLASS_CAMERA, menu->id, menu->index, "scene", (const char*)menu->name);
+            }
 		}
 	}
 
-    LOGD("set anti banding");
-
 	const char *antibanding = params.get(CameraParameters::KEY_ANTIBANDING);
 	const char *mantibanding = mParameters.get(CameraParameters::KEY_ANTIBANDING);
 	if (params.get(CameraParameters::KEY_SUPPORTED_ANTIBANDING)){
 		if (!mantibanding || strcmp(antibanding, mantibanding)) {
-
-			for (i = 0; i < mAntibanding_number; i++) {
-				if (!strcmp((char *)mAntibanding_menu[i].name, antibanding)) {
-					break;
-				}
-			}
-			extCtrInfo.id = mAntibanding_menu[i].id;
-			extCtrInfo.value = mAntibanding_menu[i].index;
-			extCtrInfos.ctrl_class = V4L2_CTRL_CLASS_CAMERA;
-			extCtrInfos.count = 1;
-			extCtrInfos.controls = &extCtrInfo;
-			err = ioctl(mCamFd, VIDIOC_S_EXT_CTRLS, &extCtrInfos);
-
-			if ( err < 0 ){
-				LOGE("%s(%d): Set antibanding(%s) failed",__FUNCTION__,__LINE__,antibanding);
-			} else {
-			    LOGD ("%s(%d): Set antibanding %s ",__FUNCTION__,__LINE__, (char *)mAntibanding_menu[i].name);
-			}
+            menu = menuFind(V4L2_CID_ANTIBANDING, antibanding);
+            if (menu == NULL) {
+				LOGE("%s(%d): antibanding(%s) is not support",__FUNCTION__,__LINE__,antibanding);
+            } else {
+                ctrlQueue(&batch, V4L2_CTRL_CLASS_CAMERA, menu->id, menu->index, "antibanding", (const char*)menu->name);
+            }
 	    }
 	}
 
-    LOGD("set white balance lock");
-
 	const char *WhiteBalanceLock = params.get(CameraParameters::KEY_AUTO_WHITEBALANCE_LOCK);
 	const char *mWhiteBalanceLock = mParameters.get(CameraParameters::KEY_AUTO_WHITEBALANCE_LOCK);
 	if (params.get(CameraParameters::KEY_AUTO_WHITEBALANCE_LOCK_SUPPORTED)){
 		if (!mWhiteBalanceLock || strcmp(WhiteBalanceLock, mWhiteBalanceLock)) {
-    		extCtrInfo.id = V4L2_CID_WHITEBALANCE_LOCK;
-			if(strcmp(WhiteBalanceLock,"true") == 0){
-				extCtrInfo.value = 1;
-			}else{
-	    		extCtrInfo.value = 0;
-			}
-			extCtrInfos.ctrl_class = V4L2_CTRL_CLASS_CAMERA;
-			extCtrInfos.count = 1;
-			extCtrInfos.controls = &extCtrInfo;
-			err = ioctl(mCamFd, VIDIOC_S_EXT_CTRLS, &extCtrInfos);
-
-			if ( err < 0 ){
-				LOGE("%s(%d): Set WhiteBalanceLock(%s) failed",__FUNCTION__,__LINE__,WhiteBalanceLock);
-			} else {
-				LOGD ("%s(%d): Set WhiteBalanceLock %s ",__FUNCTION__,__LINE__, WhiteBalanceLock);
-			}
+            ctrlQueue(&batch, V4L2_CTRL_CLASS_CAMERA, V4L2_CID_WHITEBALANCE_LOCK,
+                (strcmp(WhiteBalanceLock,"true") == 0) ? 1 : 0, "WhiteBalanceLock", WhiteBalanceLock);
 		}
 	}
 
-    LOGD("set exposurelock ");
-
 	const char *ExposureLock = params.get(CameraParameters::KEY_AUTO_EXPOSURE_LOCK);
 	const char *mExposureLock = mParameters.get(CameraParameters::KEY_AUTO_EXPOSURE_LOCK);
 	if (params.get(CameraParameters::KEY_AUTO_EXPOSURE_LOCK_SUPPORTED)){
 		if (!mExposureLock || strcmp(ExposureLock, mExposureLock)) {
-    		extCtrInfo.id = V4L2_CID_EXPOSURE_LOCK;
-			if(strcmp(ExposureLock,"true") == 0){
-				extCtrInfo.value = 1;
-			}else{
-	    		extCtrInfo.value = 0;
-			}
-			extCtrInfos.ctrl_class = V4L2_CTRL_CLASS_CAMERA;
-			extCtrInfos.count = 1;
-			extCtrInfos.controls = &extCtrInfo;
-			err = ioctl(mCamFd, VIDIOC_S_EXT_CTRLS, &extCtrInfos);
-
-			if ( err < 0 ){
-				LOGE("%s(%d): Set ExposureLock(%s) failed",__FUNCTION__,__LINE__,ExposureLock);
-			} else {
-				LOGD ("%s(%d): Set ExposureLock %s ",__FUNCTION__,__LINE__, ExposureLock);
-			}
+            ctrlQueue(&batch, V4L2_CTRL_CLASS_CAMERA, V4L2_CID_EXPOSURE_LOCK,
+                (strcmp(ExposureLock,"true") == 0) ? 1 : 0, "ExposureLock", ExposureLock);
 		}
 	}
 
-    LOGD("set focus ");
     /*focus setting*/
     const char *focusMode = params.get(CameraParameters::KEY_FOCUS_MODE);
 	const char *mfocusMode = mParameters.get(CameraParameters::KEY_FOCUS_MODE);
-	int weight;
 	if (strstr(params.get(CameraParameters::KEY_SUPPORTED_FOCUS_MODES),focusMode)) {
 		err = GetAFParameters(params);		
    		if(err < 0)
@@ -943,7 +993,8 @@ int CameraSOCAdapter::cameraConfig(const CameraParameters &tmpparams,bool isInit
 		
 		if ( !mfocusMode || strcmp(focusMode, mfocusMode) ) {
 			if(strcmp(focusMode,CameraParameters::FOCUS_MODE_FIXED)){
-	       		if(!cameraAutoFocus(isInit)){
+				//a contrast af search only runs on the autofocus thread
+	       		if(!cameraAutoFocus(isInit || mContrastAf.active())){
 	        		params.set(CameraParameters::KEY_FOCUS_MODE,(mfocusMode?mfocusMode:CameraParameters::FOCUS_MODE_FIXED));
 	        		err = -1;
 	   			}
@@ -953,7 +1004,6 @@ int CameraSOCAdapter::cameraConfig(const CameraParameters &tmpparams,bool isInit
 		params.set(CameraParameters::KEY_FOCUS_MODE,(mfocusMode?mfocusMode:CameraParameters::FOCUS_MODE_FIXED));
 		return BAD_VALUE;
 	}
-    LOGD("set flash ");
 
 	/*flash mode setting*/
     const char *flashMode = params.get(CameraParameters::KEY_FLASH_MODE);
@@ -961,152 +1011,35 @@ int CameraSOCAdapter::cameraConfig(const CameraParameters &tmpparams,bool isInit
 	
 	if (params.get(CameraParameters::KEY_SUPPORTED_FLASH_MODES)) {
 		if ( !mflashMode || strcmp(flashMode, mflashMode) ) {
-			for (i = 0; i < mFlashMode_number; i++) {
-				if (!strcmp((char *)mFlashMode_menu[i].name, flashMode)) {
-					break;
-				}
-			}
-			if(i== mFlashMode_number || mFlashMode_number == 0){
+            menu = menuFind(V4L2_CID_FLASH, flashMode);
+			if (menu == NULL) {
 				params.set(CameraParameters::KEY_FLASH_MODE,(mflashMode?mflashMode:CameraParameters::FLASH_MODE_OFF));
 				err = -1;
                 LOGE("%s(%d): flashMode %s is not support",__FUNCTION__,__LINE__,flashMode);
 			} else {
-				extCtrInfo.id = mFlashMode_menu[i].id;
-				extCtrInfo.value = mFlashMode_menu[i].index;
-				extCtrInfos.ctrl_class = V4L2_CTRL_CLASS_CAMERA;
-				extCtrInfos.count = 1;
-				extCtrInfos.controls = &extCtrInfo;
-				err = ioctl(mCamFd, VIDIOC_S_EXT_CTRLS, &extCtrInfos);
-				if ( err < 0 ){
-					LOGE ("%s(%d): Set flash(%s) failed",__FUNCTION__,__LINE__,flashMode );				
-				} else {
-				    LOGD ("%s(%d): Set flash %s",__FUNCTION__,__LINE__, (char *)mFlashMode_menu[i].name);
-				}
+                ctrlQueue(&batch, V4L2_CTRL_CLASS_CAMERA, menu->id, menu->index, "flash", (const char*)menu->name);
 			}
 		}
 	}
 
-    LOGD("set exposure ");
-
     /*exposure setting*/
 	const char *exposure = params.get(CameraParameters::KEY_EXPOSURE_COMPENSATION);
     const char *mexposure = mParameters.get(CameraParameters::KEY_EXPOSURE_COMPENSATION);
 	if (strcmp("0", params.get(CameraParameters::KEY_MAX_EXPOSURE_COMPENSATION))
 		|| strcmp("0", params.get(CameraParameters::KEY_MIN_EXPOSURE_COMPENSATION))) {
 	    if (!mexposure || (exposure && strcmp(exposure,mexposure))) {
-    		control.id = V4L2_CID_EXPOSURE;
-    		control.value = atoi(exposure);
-    		err = ioctl(mCamFd, VIDIOC_S_CTRL, &control);
-    		if ( err < 0 ){
-    		    LOGE("%s(%d): Set exposure(%s) failed",__FUNCTION__,__LINE__,exposure);
-    		} else {	    
-		        LOGD("%s(%d): Set exposure %s",__FUNCTION__,__LINE__,exposure);
-    		}
+            ctrlQueue(&batch, V4L2_CTRL_CLASS_USER, V4L2_CID_EXPOSURE, atoi(exposure), "exposure", exposure);
 	    }
 	}    
 
-    LOGD("config out ");
+    //a control the driver refused fails the set, the others are already applied
+    err = ctrlApply(&batch);
 
     mParameters = params;
 	//changeVideoPreviewSize();
 	isRestartValue = isNeedToRestartPreview();
 	
-	return 0;
-}
-
-//mapping TAE/TAF area coordinate
-// zone arrange: (-1000, 1000) with width 2001
-// bPre2Drv: true - input is base on preview image size
-//			 false - input is base on driver image size
-// zone : order lx ty rx dy
-int CameraSOCAdapter::AndroidZoneMapping(
-			const char* tag,
-			__s32 pre_w,
-			__s32 pre_h,
-			__s32 drv_w,
-			__s32 drv_h,
-			bool bPre2Drv,
-			__s32 *zone)
-{
-	bool bHeight = false;
-	long long ll_pre_w, ll_pre_h, ll_drv_w, ll_drv_h;
-
-	if (pre_w <= 0 ||
-		pre_h <= 0 ||
-		drv_w <= 0 ||
-		drv_h <= 0) {
-		LOGE("%s(%s)", __FUNCTION__, tag?tag:"NA");
-		LOGE("%s invalid parameters", __FUNCTION__);
-		return -EINVAL;
-	}
-
-	ll_pre_w = pre_w;
-	ll_pre_h = pre_h;
-	ll_drv_w = drv_w;
-	ll_drv_h = drv_h;
-
-	if (ll_pre_w * ll_drv_h == ll_pre_h * ll_drv_w) {
-		return 0;
-	}
-
-	LOGE("%s(%s)", __FUNCTION__, tag?tag:"NA");
-	LOGE("%s pre %dx%d drv %dx%d",
-			__FUNCTION__,
-			pre_w,
-			pre_h,
-			drv_w,
-			drv_h);
-	LOGE("%s from (%d, %d) (%d, %d)",
-			__FUNCTION__,
-			zone[0],
-			zone[1],
-			zone[2],
-			zone[3]);
-
-	if ( ((float) pre_h)/((float)pre_w) <
-		 ((float) drv_h)/((float)drv_w)) {
-		bHeight = true;
-	}
-
-
-	// y' * h' = y * h
-
-	if (bPre2Drv) {
-		// h = drv_h * pre_w / drv_w
-		//
-		// y = y'*h'/h
-		//   = y' * h' * drv_w / (drv_h * pre_w)
-
-		if (bHeight) {
-			zone[1] = (__s32) ( zone[1] * ll_pre_h * ll_drv_w / (ll_drv_h * ll_pre_w) );
-			zone[3] = (__s32) ( zone[3] * ll_pre_h * ll_drv_w / (ll_drv_h * ll_pre_w) );
-		} else {
-			zone[0] = (__s32) ( zone[0] * ll_pre_w * ll_drv_h / (ll_drv_w * ll_pre_h) );
-			zone[2] = (__s32) ( zone[2] * ll_pre_w * ll_drv_h / (ll_drv_w * ll_pre_h) );
-		}
-	} else {
-		// h = drv_h * pre_w /drv_w
-		//
-		// y' = y * h / h'
-		//    = y * drv_h * pre_w / (h' * drv_w)
-
-		if (bHeight) {
-			zone[1] = (__s32) ( zone[1] * ll_drv_h * ll_pre_w / (ll_pre_h * ll_drv_w) );
-			zone[3] = (__s32) ( zone[3] * ll_drv_h * ll_pre_w / (ll_pre_h * ll_drv_w) );
-		} else {
-			zone[0] = (__s32) ( zone[0] * ll_drv_w * ll_pre_h / (ll_pre_w * ll_drv_h) );
-			zone[2] = (__s32) ( zone[2] * ll_drv_w * ll_pre_h / (ll_pre_w * ll_drv_h) );
-		}
-	}
-
-	LOGE("%s to (%d, %d) (%d, %d)",
-				__FUNCTION__,
-				zone[0],
-				zone[1],
-				zone[2],
-				zone[3]);
-
-	return 0;
+	return err;
 }
 
 int CameraSOCAdapter::GetAFParameters(const CameraParameters params)
@@ -1233,6 +1166,15 @@ int CameraSOCAdapter::cameraAutoFocus(bool auto_trig_only)
     extCtrInfo.rect[1] = 0;
     extCtrInfo.rect[2] = 0;
     extCtrInfo.rect[3] = 0;   
+    if ((m_focus_mode == V4L2_CID_FOCUS_AUTO) && mContrastAf.active()) {
+		if (!auto_trig_only) {
+			mContrastAf.setWindow(m_taf_roi);
+			err = mContrastAf.search();
+		} else {
+			err = true;
+		}
+		goto cameraAutoFocus_end;
+    }
     if (m_focus_mode == V4L2_CID_FOCUS_AUTO) {
 			extCtrInfo.rect[0] = m_taf_roi[0];
 			extCtrInfo.rect[1] = m_taf_roi[1];
@@ -0,0 +1,206 @@
+#include "CameraThreadConfig.h"
+#include "CameraHal.h"
+#include <sched.h>
+
+namespace android {
+
+typedef struct cam_thread_cfg {
+    char name[CAM_THREAD_NAME_LEN];
+    int cls;
+    int nice;
+    int fifo;                           /* SCHED_FIFO priority, 0: SCHED_OTHER at nice */
+    unsigned int cpus;                  /* bit n: cpu n, 0: any cpu */
+    pid_t tid;                          /* last thread that entered, 0: never ran */
+    unsigned long long wait_ns;         /* schedstat at the previous dump */
+    unsigned long long slices;
+} cam_thread_cfg_t;
+
+static const char* cam_thread_class_name[CAM_THREAD_CLASS_MAX] = {
+    "frame", "interactive", "background"
+};
+
+/* nice of a class set from the board file without nice, 4 stays out of the background cgroup */
+static const int cam_thread_class_nice[CAM_THREAD_CLASS_MAX] = {
+    ANDROID_PRIORITY_DISPLAY,
+    ANDROID_PRIORITY_NORMAL,
+    4,
+};
+
+static cam_thread_cfg_t cam_thread_cfg[] = {
+    {"CameraPreviewThread",  CAM_THREAD_FRAME_CRITICAL, ANDROID_PRIORITY_DISPLAY,        0, 0, 0, 0, 0},
+    {"DisplayThread",        CAM_THREAD_FRAME_CRITICAL, ANDROID_PRIORITY_DISPLAY,        0, 0, 0, 0, 0},
+    {"CamHalAppEventThread", CAM_THREAD_FRAME_CRITICAL, ANDROID_PRIORITY_DISPLAY,        0, 0, 0, 0, 0},
+    {"CamMjpegDec",          CAM_THREAD_FRAME_CRITICAL, ANDROID_PRIORITY_DISPLAY,        0, 0, 0, 0, 0},
+    {"CamFrameStats",        CAM_THREAD_FRAME_CRITICAL, ANDROID_PRIORITY_NORMAL,         0, 0, 0, 0, 0},
+    {"CameraCmdThread",      CAM_THREAD_INTERACTIVE,    ANDROID_PRIORITY_URGENT_DISPLAY, 0, 0, 0, 0, 0},
+    {"AutoFocusThread",      CAM_THREAD_INTERACTIVE,    ANDROID_PRIORITY_URGENT_DISPLAY, 0, 0, 0, 0, 0},
+    {"CamAfLisThread",       CAM_THREAD_INTERACTIVE,    ANDROID_PRIORITY_NORMAL,         0, 0, 0, 0, 0},
+    {"CamHalCallbckThread",  CAM_THREAD_INTERACTIVE,    ANDROID_PRIORITY_NORMAL,         0, 0, 0, 0, 0},
+    {"MFDCommandThread",     CAM_THREAD_INTERACTIVE,    ANDROID_PRIORITY_DISPLAY,        0, 0, 0, 0, 0},
+    {"GPUCommandThread",     CAM_THREAD_INTERACTIVE,    ANDROID_PRIORITY_DISPLAY,        0, 0, 0, 0, 0},
+    {"CamHalAppEncThread",   CAM_THREAD_BACKGROUND,     ANDROID_PRIORITY_NORMAL,         0, 0, 0, 0, 0},
+    {"CamHalJpegEncThread",  CAM_THREAD_BACKGROUND,     ANDROID_PRIORITY_NORMAL,         0, 0, 0, 0, 0},
+    {"CamHalAppFaceThread",  CAM_THREAD_BACKGROUND,     4,                               0, 0, 0, 0, 0},
+    {"CamISPTunningThread",  CAM_THREAD_BACKGROUND,     ANDROID_PRIORITY_NORMAL,         0, 0, 0, 0, 0},
+    {"CamJpegThumb",         CAM_THREAD_BACKGROUND,     ANDROID_PRIORITY_NORMAL,         0, 0, 0, 0, 0},
+    {"MFDCpuWorker",         CAM_THREAD_BACKGROUND,     ANDROID_PRIORITY_NORMAL,         0, 0, 0, 0, 0},
+    {"IspTuneWriter",        CAM_THREAD_BACKGROUND,     ANDROID_PRIORITY_NORMAL,         0, 0, 0, 0, 0},
+};
+static const int cam_thread_cnt = sizeof(cam_thread_cfg) / sizeof(cam_thread_cfg[0]);
+static Mutex cam_thread_lock;
+
+static cam_thread_cfg_t* threadCfgFind(const char* name)
+{
+    int i;
+
+    for (i = 0; i < cam_thread_cnt; i++) {
+        if (strcmp(cam_thread_cfg[i].name, name) == 0)
+            return &cam_thread_cfg[i];
+    }
+    return NULL;
+}
+
+int CameraThreadConfig::priority(const char* name)
+{
+    Mutex::Autolock lock(cam_thread_lock);
+    cam_thread_cfg_t* cfg = threadCfgFind(name);
+
+    if (cfg == NULL) {
+        LOGE("%s(%d): %s isn't in the thread table, runs at normal priority",__FUNCTION__,__LINE__,name);
+        return ANDROID_PRIORITY_NORMAL;
+    }
+    return cfg->nice;
+}
+
+void CameraThreadConfig::enter(const char* name)
+{
+    cam_thread_cfg_t cfg;
+    cam_thread_cfg_t* entry;
+    struct sched_param param;
+    cpu_set_t set;
+    int i;
+
+    {
+        Mutex::Autolock lock(cam_thread_lock);
+        entry = threadCfgFind(name);
+        if (entry == NULL)
+            return;
+        entry->tid = gettid();
+        entry->wait_ns = 0;
+        entry->slices = 0;
+        cfg = *entry;
+    }
+
+    if (cfg.cpus) {
+        CPU_ZERO(&set);
+        for (i = 0; (i < 32) && (i < CPU_SETSIZE); i++) {
+            if (cfg.cpus & (1u << i))
+                CPU_SET(i, &set);
+        }
+        if (sched_setaffinity(0, sizeof(set), &set))
+            LOGE("%s(%d): %s can't be bound to cpus 0x%x(%s)",__FUNCTION__,__LINE__,name,cfg.cpus,strerror(errno));
+    }
+    if (cfg.fifo > 0) {
+        memset(&param, 0, sizeof(param));
+        param.sched_priority = cfg.fifo;
+        if (sched_setscheduler(0, SCHED_FIFO, &param))
+            LOGE("%s(%d): %s can't run SCHED_FIFO %d(%s), stays at nice %d",__FUNCTION__,__LINE__,
+                name,cfg.fifo,strerror(errno),cfg.nice);
+    }
+    LOG1("%s(%d): %s tid %d, %s, nice %d, fifo %d, cpus 0x%x",__FUNCTION__,__LINE__,
+        name,cfg.tid,cam_thread_class_name[cfg.cls],cfg.nice,cfg.fifo,cfg.cpus);
+}
+
+void CameraThreadConfig::parseXml(const char** atts)
+{
+    Mutex::Autolock lock(cam_thread_lock);
+    cam_thread_cfg_t* cfg = NULL;
+    bool nice_set = false;
+    int i, j;
+
+    for (i = 0; atts[i] && atts[i+1]; i += 2) {
+        if (strcmp(atts[i], "name") == 0)
+            cfg = threadCfgFind(atts[i+1]);
+    }
+    if (cfg == NULL) {
+        LOGE("%s(%d): HalThread without a known name, ignored",__FUNCTION__,__LINE__);
+        return;
+    }
+
+    for (i = 0; atts[i] && atts[i+1]; i += 2) {
+        if (strcmp(atts[i], "class") == 0) {
+            for (j = 0; j < CAM_THREAD_CLASS_MAX; j++) {
+                if (strcmp(atts[i+1], cam_thread_class_name[j]) == 0)
+                    cfg->cls = j;
+            }
+        } else if (strcmp(atts[i], "nice") == 0) {
+            cfg->nice = atoi(atts[i+1]);
+            nice_set = true;
+        } else if (strcmp(atts[i], "fifo") == 0) {
+            cfg->fifo = atoi(atts[i+1]);
+        } else if (strcmp(atts[i], "cpus") == 0) {
+            cfg->cpus = strtoul(atts[i+1], NULL, 0);
+        }
+    }
+    if (!nice_set)
+        cfg->nice = cam_thread_class_nice[cfg->cls];
+    if (cfg->nice < ANDROID_PRIORITY_URGENT_DISPLAY)
+        cfg->nice = ANDROID_PRIORITY_URGENT_DISPLAY;
+    else if (cfg->nice > ANDROID_PRIORITY_LOWEST)
+        cfg->nice = ANDROID_PRIORITY_LOWEST;
+    //a spinning fifo thread starves everything below it, keep it to the frame path
+    if ((cfg->fifo < 0) || (cfg->cls != CAM_THREAD_FRAME_CRITICAL))
+        cfg->fifo = 0;
+    else if (cfg->fifo > CAM_THREAD_FIFO_MAX)
+        cfg->fifo = CAM_THREAD_FIFO_MAX;
+
+    LOGD("%s(%d): %s: %s, nice %d, fifo %d, cpus 0x%x",__FUNCTION__,__LINE__,
+        cfg->name,cam_thread_class_name[cfg->cls],cfg->nice,cfg->fifo,cfg->cpus);
+}
+
+void CameraThreadConfig::dump()
+{
+    Mutex::Autolock lock(cam_thread_lock);
+    char path[64];
+    unsigned long long run_ns, wait_ns, slices;
+    cam_thread_cfg_t* cfg;
+    FILE* fp;
+    int i;
+
+    for (i = 0; i < cam_thread_cnt; i++) {
+        cfg = &cam_thread_cfg[i];
+        if (cfg->tid == 0)
+            continue;
+        snprintf(path, sizeof(path), "/proc/self/task/%d/schedstat", cfg->tid);
+        fp = fopen(path, "r");
+        if (fp == NULL)
+            continue;
+        //run ns, run queue wait ns, timeslices
+        if ((fscanf(fp, "%llu %llu %llu", &run_ns, &wait_ns, &slices) == 3) && (slices > cfg->slices)) {
+            LOG1("%s(%d): %s(%s) tid %d: %llu slices, %llu us run queue wait per slice",__FUNCTION__,__LINE__,
+                cfg->name,cam_thread_class_name[cfg->cls],cfg->tid,slices - cfg->slices,
+                (wait_ns - cfg->wait_ns) / (slices - cfg->slices) / 1000);
+            cfg->wait_ns = wait_ns;
+            cfg->slices = slices;
+        }
+        fclose(fp);
+    }
+}
+
+long long CameraThreadConfig::runQueueWait()
+{
+    char path[64];
+    unsigned long long run_ns, wait_ns;
+    FILE* fp;
+    int ret;
+
+    snprintf(path, sizeof(path), "/proc/self/task/%d/schedstat", gettid());
+    fp = fopen(path, "r");
+    if (fp == NULL)
+        return -1;
+    ret = fscanf(fp, "%llu %llu", &run_ns, &wait_ns);
+    fclose(fp);
+    return (ret == 2) ? (long long)wait_ns : -1;
+}
+
+}
@@ -0,0 +1,44 @@
+#ifndef ANDROID_HARDWARE_CAMERA_THREAD_CONFIG_H
+#define ANDROID_HARDWARE_CAMERA_THREAD_CONFIG_H
+
+//scheduling class, priority and cpu mask of the hal threads
+#include <sys/types.h>
+#include <utils/threads.h>
+
+namespace android {
+
+enum CamThreadClass {
+    CAM_THREAD_FRAME_CRITICAL = 0,      /* frame dispatch, a late run is a late or dropped frame */
+    CAM_THREAD_INTERACTIVE = 1,         /* commands and callbacks the app waits on */
+    CAM_THREAD_BACKGROUND = 2,          /* encoding, detection, tuning: may lag a few frames */
+    CAM_THREAD_CLASS_MAX
+};
+
+#define CAM_THREAD_NAME_LEN     32
+#define CAM_THREAD_FIFO_MAX     10      /* highest SCHED_FIFO priority the board file may ask for */
+
+/*
+ * One entry per hal thread, keyed by the name the thread is run() with.
+ * run() takes its nice value from priority(), the thread calls enter() first
+ * to move to its cpu mask and, for frame critical threads, to SCHED_FIFO.
+ * The built-in table is overridden by <HalThread> elements of cam_board.xml:
+ *   <HalThread name="CamHalAppFaceThread" class="background" nice="4" fifo="0" cpus="0x0f"></HalThread>
+ * a missing attribute keeps its value, a class without nice takes the nice
+ * of the class.
+ */
+class CameraThreadConfig {
+public:
+    //nice value for Thread::run()
+    static int priority(const char* name);
+    //called on the thread itself before its loop
+    static void enter(const char* name);
+    //atts: attribute pairs of a <HalThread> element
+    static void parseXml(const char** atts);
+    //run queue wait of every thread that entered, since the previous dump
+    static void dump();
+    //ns the calling thread has waited on a run queue since it started, -1: no schedstat
+    static long long runQueueWait();
+};
+
+}
+#endif
@@ -32,6 +32,7 @@ CameraUSBAdapter::CameraUSBAdapter(int cameraId)
 	mFlashMode_number = 0;
 	mCamDriverFrmWidthMax = 0;
 	mCamDriverFrmHeightMax = 0;
+	memset(mAfZone, 0, sizeof(mAfZone));
 }
 CameraUSBAdapter::~CameraUSBAdapter()
 {
@@ -388,6 +389,17 @@ void CameraUSBAdapter::initDefaultParameters(int camFd)
 	#if 1
 	params.set(CameraParameters::KEY_SUPPORTED_FOCUS_MODES, CameraParameters::FOCUS_MODE_FIXED);
 	params.set(CameraParameters::KEY_MAX_NUM_FOCUS_AREAS,"0");
+	//uvc "focus, auto" is the camera's own continuous af: the hal focuses absolute focus lenses itself
+	if (mContrastAf.init(mCamFd, false)) {
+		control.id = V4L2_CID_FOCUS_AUTO;
+		control.value = 0;
+		ioctl(mCamFd, VIDIOC_S_CTRL, &control);
+		parameterString.append(",");
+		parameterString.append(CameraParameters::FOCUS_MODE_AUTO);
+		params.set(CameraParameters::KEY_SUPPORTED_FOCUS_MODES, parameterString.string());
+		params.set(CameraParameters::KEY_FOCUS_MODE, CameraParameters::FOCUS_MODE_AUTO);
+		params.set(CameraParameters::KEY_MAX_NUM_FOCUS_AREAS,"1");
+	}
 	#else
     focus.id = V4L2_CID_FOCUS_AUTO;
     if (!ioctl(mCamFd, VIDIOC_QUERYCTRL, &focus)) {
@@ -893,6 +905,26 @@ int CameraUSBAdapter::cameraConfig(const CameraParameters &tmpparams,bool isInit
 	}
 
     /*focus setting*/
+	const char *focusAreas = params.get(CameraParameters::KEY_FOCUS_AREAS);
+	if (mContrastAf.active() && focusAreas) {
+		__s32 zone[4];
+		int weight = 0;
+
+		memset(zone, 0, sizeof(zone));
+		//one area: (lx,ty,rx,dy,weight)
+		if ((sscanf(focusAreas, "(%d,%d,%d,%d,%d)", &zone[0], &zone[1], &zone[2], &zone[3], &weight) != 5)
+			|| strstr(focusAreas + 1, "(")) {
+			LOGE("%s(%d): focus areas %s not supported",__FUNCTION__,__LINE__,focusAreas);
+			return BAD_VALUE;
+		}
+		if ((zone[0] || zone[1] || zone[2] || zone[3])
+			&& ((zone[0] < -1000) || (zone[2] > 1000) || (zone[1] < -1000) || (zone[3] > 1000)
+				|| (zone[0] >= zone[2]) || (zone[1] >= zone[3]) || (weight < 1) || (weight > 1000))) {
+			LOGE("%s(%d): focus areas %s is invalidate",__FUNCTION__,__LINE__,focusAreas);
+			return BAD_VALUE;
+		}
+		memcpy(mAfZone, zone, sizeof(mAfZone));
+	}
 
 	/*flash mode setting*/
     const char *flashMode = params.get(CameraParameters::KEY_FLASH_MODE);
@@ -958,6 +990,24 @@ end:
     return err;
 }
 
+//auto_trig_only: the app changed the focus mode, searches start from autoFocus only
+int CameraUSBAdapter::cameraAutoFocus(bool auto_trig_only)
+{
+    __s32 zone[4];
+    const char *focusMode = mParameters.get(CameraParameters::KEY_FOCUS_MODE);
+
+    if (!mContrastAf.active() || !focusMode || strcmp(focusMode, CameraParameters::FOCUS_MODE_AUTO))
+        return true;
+    if (auto_trig_only)
+        return true;
+
+    //the areas are on the preview image, the frames come at the driver size
+    memcpy(zone, mAfZone, sizeof(zone));
+    AndroidZoneMapping("AF ROI", mCamPreviewW, mCamPreviewH, mCamDrvWidth, mCamDrvHeight, true, zone);
+    mContrastAf.setWindow(zone);
+    return mContrastAf.search();
+}
+
 //define  the frame info ,such as w, h ,fmt 
 int CameraUSBAdapter::reprocessFrame(FramInfo_s* frame)
 {
@@ -973,25 +1023,21 @@ int CameraUSBAdapter::reprocessFrame(FramInfo_s* frame)
 		phy_addr = mPreviewBufProvider->getBufPhyAddr(frame->frame_index);
 #endif
     if( frame->frame_fmt == V4L2_PIX_FMT_MJPEG){
-    	   char *srcbuf = (char*)frame->vir_addr;
+    	   unsigned char *srcbuf = (unsigned char*)frame->vir_addr;
     	   if((srcbuf[0] == 0xff) && (srcbuf[1] == 0xd8) && (srcbuf[2] == 0xff)){
-        //decoder to NV12
-        VPU_FRAME outbuf; 
-        unsigned int output_len;
-        unsigned int input_len;
-        output_len = 0;
-        input_len = frame->frame_size;
-
-        if(input_len <= 0){
+        //decoder to NV12, same 16 aligned layout from the vpu and the sw decoder
+        if(frame->frame_size <= 0){
           LOGE("frame size is invalid !!!");
           return -1;
         }
-        ret = mMjpegDecoder.decode(mMjpegDecoder.decoder,
-                                    (unsigned char*)&outbuf, &output_len, 
-    		                          (unsigned char*)frame->vir_addr, &input_len,
-    		                          phy_addr);
+        ret = mjpegDecodeFrame(srcbuf, frame->frame_size,
+                               (char*)mPreviewBufProvider->getBufVirAddr(frame->frame_index), phy_addr,
+                               (frame->frame_width+15)&(~15), (frame->frame_height+15)&(~15));
         if (ret < 0){
             LOGE("%s(%d): mjpeg stream is error!",__FUNCTION__,__LINE__);
+        } else if (ret > 0) {
+            mPreviewBufProvider->flushBuffer(frame->frame_index);
+            ret = 0;
 	        }
 	    }else{
 	    		LOGE("mjpeg data error!!");
@@ -23,7 +23,7 @@ DisplayAdapter::DisplayAdapter()
     //create display thread
 
     mDisplayThread = new DisplayThread(this);
-    mDisplayThread->run("DisplayThread",ANDROID_PRIORITY_DISPLAY);
+    mDisplayThread->run("DisplayThread",CameraThreadConfig::priority("DisplayThread"));
     LOG_FUNCTION_NAME_EXIT
 }
 DisplayAdapter::~DisplayAdapter()
@@ -105,6 +105,12 @@ int DisplayAdapter::startDisplay(int width, int height)
     #endif
     mDisplayWidth = width;
     mDisplayHeight = height;
+    //nv12 displays scale through the fanout, the first frame can already be shared
+    if (mFrameProvider && mFrameProvider->getFrameFanout()
+        && (strcmp(mDisplayFormat,CAMERA_DISPLAY_FORMAT_YUV420SP) == 0)) {
+        fanout_spec_t spec = {width, height, V4L2_PIX_FMT_NV12, false};
+        mFrameProvider->getFrameFanout()->publish(FANOUT_CONSUMER_DISPLAY, &spec);
+    }
     setDisplayState(CMD_DISPLAY_START_PREPARE);
     msg.command = CMD_DISPLAY_START;
     sem.Create();
@@ -432,24 +438,23 @@ void DisplayAdapter::setBufferState(int index,int status)
     }
 }
 
-extern "C" void arm_yuyv_to_nv12(int src_w, int src_h,char *srcbuf, char *dstbuf){
+extern "C" void arm_yuyv_to_nv12_desc(const cam_frame_desc_t* src, const cam_frame_desc_t* dst){
 
-    char *srcbuf_begin;
     int *dstint_y, *dstint_uv, *srcint;
     int i = 0,j = 0;
-    int y_size = 0;
+    int src_w = src->width, src_h = src->height;
 
-	y_size = src_w*src_h;
-	dstint_y = (int*)dstbuf;
-	srcint = (int*)srcbuf;
-	dstint_uv =  (int*)(dstbuf + y_size);
 	//LOGE("-----------%s----------------zyh",__FUNCTION__);
+	//every line starts from its own plane line, either side may be padded
+	for(i=0;i<src_h;i++) {
+		srcint = (int*)(src->plane[0].vir + i*src->plane[0].stride);
+		dstint_y = (int*)(dst->plane[0].vir + i*dst->plane[0].stride);
+		dstint_uv = (int*)(dst->plane[1].vir + (i>>1)*dst->plane[1].stride);
 	/*
 	 * author :zyh
 	 * neon code for YUYV to NV12
 	 */
 #if HAVE_ARM_NEON
-	for(i=0;i<src_h;i++) {
          int n = src_w;
 		 char tmp = i%2;//get uv only when in even row
 		 asm volatile (
@@ -471,7 +476,6 @@ extern "C" void arm_yuyv_to_nv12(int src_w, int src_h,char *srcbuf, char *dstbuf
 			: [src_stride] "r" (src_w)
 			: "cc", "memory", "q0", "q1", "q2"
 			);
-	 }
 	 //LOGE("---------------neon code arm_yuyv_to_nv12-----------------------------");
 	 /*
 	  * C code YUYV to YUV420
@@ -487,7 +491,6 @@ extern "C" void arm_yuyv_to_nv12(int src_w, int src_h,char *srcbuf, char *dstbuf
 		|Y|Y|Y|Y|.....|U|V|U|V|....
 	***********************************/
 
-    for(i=0;i<src_h; i++) {
 		for (j=0; j<(src_w>>2); j++) {
 			if(i%2 == 0){
 			    *dstint_uv++ = (*(srcint+1)&0xff000000)|((*(srcint+1)&0x0000ff00)<<8)
@@ -497,9 +500,17 @@ extern "C" void arm_yuyv_to_nv12(int src_w, int src_h,char *srcbuf, char *dstbuf
 			            |((*srcint&0x00ff0000)>>8)|(*srcint&0x000000ff);
 		     srcint += 2;
 		 }
-	 }
 	 //LOGE("---------------c code arm_yuyv_to_nv12-----------------------------");
 #endif
+	}
+}
+
+extern "C" void arm_yuyv_to_nv12(int src_w, int src_h,char *srcbuf, char *dstbuf){
+    cam_frame_desc_t src, dst;
+
+    camFrameDescInit(&src, V4L2_PIX_FMT_YUYV, srcbuf, -1, src_w, src_h, 0);
+    camFrameDescInit(&dst, V4L2_PIX_FMT_NV12, dstbuf, -1, src_w, src_h, 0);
+    arm_yuyv_to_nv12_desc(&src, &dst);
 }
 
 extern "C" void arm_yuyv_to_yv12(int src_w, int src_h,char *srcbuf, char *dstbuf){
@@ -610,6 +621,8 @@ void DisplayAdapter::displayThread()
     void *y_uv[3];
     long frame_used_flag = -1;
     Rect bounds;
+    cam_frame_desc_t src_desc, dst_desc;
+    int yuv_stride;
     
     LOG_FUNCTION_NAME    
     while (mDisplayRuning != STA_DISPLAY_STOP) {
@@ -732,6 +745,11 @@ display_receive_cmd:
                             }
                         } 
 
+                    //yuv display buffers are written at the gralloc stride where rga does so too, 0: packed
+                    yuv_stride = 0;
+                    #if defined(RK_DRM_GRALLOC)
+                    yuv_stride = mDisplayBufInfo[queue_display_index].stride;
+                    #endif
                     if((frame->frame_fmt == V4L2_PIX_FMT_YUYV) && (strcmp((mDisplayFormat),CAMERA_DISPLAY_FORMAT_YUV420P)==0))
                     {
                         if((frame->frame_width == mDisplayWidth) && (frame->frame_height== mDisplayHeight))
@@ -739,64 +757,80 @@ display_receive_cmd:
                          (char*)(frame->vir_addr), (char*)mDisplayBufInfo[queue_display_index].vir_addr);
 					}else if((frame->frame_fmt == V4L2_PIX_FMT_YUYV) && (strcmp((mDisplayFormat),CAMERA_DISPLAY_FORMAT_YUV420SP)==0))
                     {
-                        if((frame->frame_width == mDisplayWidth) && (frame->frame_height== mDisplayHeight))
-						arm_yuyv_to_nv12(frame->frame_width, frame->frame_height,
-                         (char*)(frame->vir_addr), (char*)mDisplayBufInfo[queue_display_index].vir_addr);
+                        if((frame->frame_width == mDisplayWidth) && (frame->frame_height== mDisplayHeight)) {
+                            camFrameDescFromFrame(&src_desc, frame);
+                            camFrameDescInit(&dst_desc, V4L2_PIX_FMT_NV12, (void*)mDisplayBufInfo[queue_display_index].vir_addr, -1,
+                                             mDisplayWidth, mDisplayHeight, yuv_stride);
+                            arm_yuyv_to_nv12_desc(&src_desc, &dst_desc);
+                        }
                         //LOGD("display got a frame");
                     }
                     else if((frame->frame_fmt == V4L2_PIX_FMT_NV12) && (strcmp((mDisplayFormat),CAMERA_DISPLAY_FORMAT_RGB565)==0))
                     {
-                       arm_nv12torgb565(frame->frame_width, frame->frame_height,
-                						(char*)(frame->vir_addr), (short int*)mDisplayBufInfo[queue_display_index].vir_addr,
-                                         mDisplayWidth);
+                        camFrameDescFromFrame(&src_desc, frame);
+                        camFrameDescInit(&dst_desc, V4L2_PIX_FMT_RGB565, (void*)mDisplayBufInfo[queue_display_index].vir_addr, -1,
+                                         mDisplayWidth, mDisplayHeight, mDisplayBufInfo[queue_display_index].stride*2);
+                        arm_nv12torgb565_desc(&src_desc, &dst_desc);
                     }else if((frame->frame_fmt == V4L2_PIX_FMT_NV12) && (strcmp((mDisplayFormat),CAMERA_DISPLAY_FORMAT_YUV420SP)==0)){
                     #if 0
                         arm_camera_yuv420_scale_arm(V4L2_PIX_FMT_NV12, V4L2_PIX_FMT_NV12, 
 							(char*)(frame->vir_addr), (char*)mDisplayBufInfo[queue_display_index].vir_addr,
 							frame->frame_width, frame->frame_height,
 							mDisplayWidth, mDisplayHeight,
-							false,frame->zoom_value);
+							false,frame->zoom_value,FRAME_Y_STRIDE(frame),FRAME_UV_OFFSET(frame));
                     #else
 						#if defined(TARGET_RK3188)
 							rk_camera_zoom_ipp(V4L2_PIX_FMT_NV12, (int)(frame->phy_addr), frame->frame_width, frame->frame_height,(int)(mDisplayBufInfo[queue_display_index].phy_addr),frame->zoom_value);
 						#else
                             if(g_ctsV_flag &&((mDisplayWidth==176&&mDisplayHeight==144)||(mDisplayWidth==352&&mDisplayHeight==288))) {
-                                arm_camera_yuv420_scale_arm(V4L2_PIX_FMT_NV12, V4L2_PIX_FMT_NV12,
-                                        (char*)(frame->vir_addr), (char*)mDisplayBufInfo[queue_display_index].vir_addr,
-                                        frame->frame_width, frame->frame_height,
-                                        mDisplayWidth, mDisplayHeight,
-                                        false,frame->zoom_value);
+                                camFrameDescFromFrame(&src_desc, frame);
+                                camFrameDescInit(&dst_desc, V4L2_PIX_FMT_NV12, (void*)mDisplayBufInfo[queue_display_index].vir_addr, -1,
+                                                 mDisplayWidth, mDisplayHeight, yuv_stride);
+                                arm_yuv420_scale_desc(&src_desc, &dst_desc, false, frame->zoom_value);
                             }else{
+                                CameraFrameFanout* fanout = mFrameProvider ? mFrameProvider->getFrameFanout() : NULL;
+                                const unsigned char* shared = NULL;
+
+                                if (fanout) {
+                                    fanout_spec_t spec = {mDisplayWidth, mDisplayHeight, V4L2_PIX_FMT_NV12, false};
+                                    shared = fanout->acquire(frame->vir_addr, FANOUT_CONSUMER_DISPLAY, &spec);
+                                }
+                                if (shared) {
+                                    CameraFrameFanout::copyOut(shared, mDisplayWidth, mDisplayHeight,
+                                        (unsigned char*)mDisplayBufInfo[queue_display_index].vir_addr, yuv_stride);
+                                } else {
 								#if defined(RK_DRM_GRALLOC)
-								int dst_stride = mDisplayBufInfo[queue_display_index].stride;
+								int dst_stride = yuv_stride;
 
 								if (frame->vir_addr_valid){
 	                                err = rga_nv12_scale_crop(frame->frame_width, frame->frame_height,
 	                                        (char*)(frame->vir_addr), (short int *)(mDisplayBufInfo[queue_display_index].vir_addr),
-	                                        mDisplayWidth,mDisplayHeight,frame->zoom_value,false,true,false,dst_stride,frame->vir_addr_valid);
+	                                        mDisplayWidth,mDisplayHeight,frame->zoom_value,false,true,false,dst_stride,frame->vir_addr_valid,FRAME_Y_STRIDE(frame),FRAME_UV_OFFSET(frame));
                                 } else{
     								int mem_fd = -1;
 									util_get_gralloc_buf_fd(*(mDisplayBufInfo[queue_display_index].buffer_hnd),&mem_fd);
 									err = rga_nv12_scale_crop(frame->frame_width, frame->frame_height,
 											(char*)(frame->phy_addr), (short int *)((long)(mem_fd)),
-											mDisplayWidth,mDisplayHeight,frame->zoom_value,false,true,false,dst_stride,frame->vir_addr_valid);
+											mDisplayWidth,mDisplayHeight,frame->zoom_value,false,true,false,dst_stride,frame->vir_addr_valid,FRAME_Y_STRIDE(frame),FRAME_UV_OFFSET(frame));
 								}
                                 if (err){
-                                    arm_camera_yuv420_scale_arm(V4L2_PIX_FMT_NV12, V4L2_PIX_FMT_NV12, (char*)(frame->vir_addr),
-                                        (char*)(mDisplayBufInfo[queue_display_index].vir_addr),frame->frame_width, frame->frame_height,
-                                        mDisplayWidth,mDisplayHeight,false,frame->zoom_value);
+                                    camFrameDescFromFrame(&src_desc, frame);
+                                    camFrameDescInit(&dst_desc, V4L2_PIX_FMT_NV12, (void*)mDisplayBufInfo[queue_display_index].vir_addr, -1,
+                                                     mDisplayWidth, mDisplayHeight, dst_stride);
+                                    arm_yuv420_scale_desc(&src_desc, &dst_desc, false, frame->zoom_value);
                                 }
 								#else
                                 #if (defined(TARGET_RK312x) || defined(TARGET_RK3328)) && defined(ANDROID_7_X)
                                 rga_nv12_scale_crop(frame->frame_width, frame->frame_height,
                                         (char*)(frame->phy_addr), (short int *)(mDisplayBufInfo[queue_display_index].phy_addr),/* 'phy_add' is buffer fd here */
-                                        mDisplayWidth,mDisplayHeight,frame->zoom_value,false,true,false,false);
+                                        mDisplayWidth,mDisplayHeight,frame->zoom_value,false,true,false,false,FRAME_Y_STRIDE(frame),FRAME_UV_OFFSET(frame));
                                 #else
                                 rga_nv12_scale_crop(frame->frame_width, frame->frame_height,
                                         (char*)(frame->vir_addr), (short int *)(mDisplayBufInfo[queue_display_index].vir_addr),
-                                        mDisplayWidth,mDisplayHeight,frame->zoom_value,false,true,false,true);
+                                        mDisplayWidth,mDisplayHeight,frame->zoom_value,false,true,false,true,FRAME_Y_STRIDE(frame),FRAME_UV_OFFSET(frame));
                                 #endif
 								#endif
+                                }
                             }
 						#endif
 
@@ -805,6 +839,9 @@ display_receive_cmd:
 
                     setBufferState(queue_display_index, 1);
                     mapper.unlock((buffer_handle_t)mDisplayBufInfo[queue_display_index].priv_hnd);
+                    //capture time of the frame, the window takes it as the buffer time
+                    if (frame->meta.timestamp)
+                        mANativeWindow->set_timestamp(mANativeWindow, frame->meta.timestamp);
                     err = mANativeWindow->enqueue_buffer(mANativeWindow, (buffer_handle_t*)mDisplayBufInfo[queue_display_index].buffer_hnd);                    
                     if (err != 0){
                                                 
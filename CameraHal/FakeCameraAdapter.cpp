@@ -230,12 +230,17 @@ int CameraFakeAdapter::getFrame(FramInfo_s** tmpFrame)
     mPreviewFrameInfos[index].frame_height = mCamPreviewH;
     mPreviewFrameInfos[index].frame_width = mCamPreviewW;
     mPreviewFrameInfos[index].frame_index = index;
+    mPreviewFrameInfos[index].y_stride = 0;
+    mPreviewFrameInfos[index].uv_offset = 0;
     mPreviewFrameInfos[index].phy_addr = mPreviewBufProvider->getBufPhyAddr(index);
     mPreviewFrameInfos[index].vir_addr = (long)mCamDriverV4l2Buffer[index];
     //get zoom_value
     mPreviewFrameInfos[index].zoom_value = 100;
     mPreviewFrameInfos[index].used_flag = 0;
     mPreviewFrameInfos[index].frame_size = 0;
+    memset(&mPreviewFrameInfos[index].meta, 0, sizeof(cam_frame_meta_t));
+    mPreviewFrameInfos[index].meta.timestamp = systemTime(CLOCK_MONOTONIC);
+    mPreviewFrameInfos[index].meta.lens_pos = -1;
 
     //memset((void*)buf_vir, 'z', mCamPreviewW*mCamPreviewH/2);
     //memset((void*)buf_vir+mCamPreviewW*mCamPreviewH/2, 'a', mCamPreviewW*mCamPreviewH/2);
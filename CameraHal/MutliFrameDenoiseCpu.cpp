@@ -0,0 +1,605 @@
+#include "MutliFrameDenoiseCpu.h"
+#include "Semaphore.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <utils/Timers.h>
+#if defined(HAVE_ARM_NEON) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define MFD_CPU_NEON    1
+#endif
+
+namespace android {
+
+#define MFD_CPU_WEIGHT_REF      16      /* weight of the reference frame, merged frames get 0..16 */
+
+/* recip[w] = 65536/w, out = (acc*recip[w] + 32768) >> 16 */
+static unsigned int gMfdRecip[256];
+
+static unsigned int mfd_sad16(const unsigned char* a, const unsigned char* b, int stride, int rows, int rowStep)
+{
+    int r;
+#ifdef MFD_CPU_NEON
+    uint16x8_t acc = vdupq_n_u16(0);
+    for (r = 0; r < rows; r += rowStep) {
+        uint8x16_t va = vld1q_u8(a);
+        uint8x16_t vb = vld1q_u8(b);
+        acc = vabal_u8(acc, vget_low_u8(va), vget_low_u8(vb));
+        acc = vabal_u8(acc, vget_high_u8(va), vget_high_u8(vb));
+        a += stride*rowStep;
+        b += stride*rowStep;
+    }
+    uint64x2_t sum = vpaddlq_u32(vpaddlq_u16(acc));
+    return (unsigned int)(vgetq_lane_u64(sum, 0) + vgetq_lane_u64(sum, 1));
+#else
+    unsigned int sad = 0;
+    int i;
+    for (r = 0; r < rows; r += rowStep) {
+        for (i = 0; i < 16; i++)
+            sad += abs(a[i] - b[i]);
+        a += stride*rowStep;
+        b += stride*rowStep;
+    }
+    return sad;
+#endif
+}
+
+/* w = (thr - |ref - cur|)+ * scale >> 8, acc += w*cur, weight += w */
+static void mfd_merge_row(const unsigned char* ref, const unsigned char* cur, unsigned short* acc,
+                          unsigned char* weight, int n, unsigned char thr, unsigned char scale)
+{
+    int i = 0;
+#ifdef MFD_CPU_NEON
+    uint8x8_t vthr = vdup_n_u8(thr);
+    uint8x8_t vscale = vdup_n_u8(scale);
+    for (; i + 8 <= n; i += 8) {
+        uint8x8_t c = vld1_u8(cur + i);
+        uint8x8_t w = vqsub_u8(vthr, vabd_u8(vld1_u8(ref + i), c));
+        w = vshrn_n_u16(vmull_u8(w, vscale), 8);
+        vst1q_u16(acc + i, vmlal_u8(vld1q_u16(acc + i), w, c));
+        vst1_u8(weight + i, vadd_u8(vld1_u8(weight + i), w));
+    }
+#endif
+    for (; i < n; i++) {
+        int d = abs(ref[i] - cur[i]);
+        int w = (d < thr) ? (((thr - d)*scale) >> 8) : 0;
+        acc[i] += w*cur[i];
+        weight[i] += w;
+    }
+}
+
+MutliFrameDenoiseCpu::MutliFrameDenoiseCpu()
+{
+    int i;
+
+    initialized = false;
+    mWidth = 0;
+    mHeight = 0;
+    mWorkers = 0;
+    mFrameNum = 0;
+    mFrameCnt = 0;
+    mThreshold = 16;
+    mWeightScale = 255;
+    mRejectSad = 0;
+    mRef = NULL;
+    mAcc = NULL;
+    mWeight = NULL;
+    mInflight = 0;
+    mHeld = 0;
+    for (i = 0; i < MFD_CPU_WORKER_MAX; i++) {
+        mMotion[i] = NULL;
+        mBlocks[i] = 0;
+        mRejected[i] = 0;
+    }
+    for (i = 0; i < MFD_CPU_COPY_SLOTS; i++) {
+        mCopyBuf[i] = NULL;
+        mCopyBusy[i] = false;
+    }
+    if (gMfdRecip[1] == 0) {
+        for (i = 1; i < 256; i++)
+            gMfdRecip[i] = 65536/i;
+    }
+}
+
+MutliFrameDenoiseCpu::~MutliFrameDenoiseCpu()
+{
+    destroy();
+}
+
+int MutliFrameDenoiseCpu::init(int width, int height)
+{
+    int i,rows,blockRows;
+    size_t size = width*height*3/2;
+
+    if (initialized && (width == mWidth) && (height == mHeight))
+        return 0;
+    destroy();
+
+    mWidth = width;
+    mHeight = height;
+    mRef = (unsigned char*)malloc(size);
+    mAcc = (unsigned short*)malloc(size*sizeof(unsigned short));
+    mWeight = (unsigned char*)malloc(size);
+    if (!mRef || !mAcc || !mWeight) {
+        LOGE("%s(%d): alloc %dx%d merge buffers failed",__FUNCTION__,__LINE__,width,height);
+        goto init_fail;
+    }
+    for (i = 0; i < MFD_CPU_COPY_SLOTS; i++) {
+        mCopyBuf[i] = (unsigned char*)malloc(size);
+        if (mCopyBuf[i] == NULL) {
+            LOGE("%s(%d): alloc %dx%d copy slot %d failed",__FUNCTION__,__LINE__,width,height,i);
+            goto init_fail;
+        }
+    }
+
+    mWorkers = sysconf(_SC_NPROCESSORS_ONLN);
+    if (mWorkers < 1)
+        mWorkers = 1;
+    else if (mWorkers > MFD_CPU_WORKER_MAX)
+        mWorkers = MFD_CPU_WORKER_MAX;
+    blockRows = (height + MFD_CPU_BLOCK - 1)/MFD_CPU_BLOCK;
+    if (mWorkers > blockRows)
+        mWorkers = blockRows;
+    for (i = 0; i <= mWorkers; i++) {
+        rows = (blockRows*i/mWorkers)*MFD_CPU_BLOCK;
+        mBandStart[i] = (rows > height) ? height : rows;
+    }
+
+    for (i = 0; i < mWorkers; i++) {
+        mMotion[i] = (short*)malloc(((width + MFD_CPU_BLOCK - 1)/MFD_CPU_BLOCK)*2*sizeof(short));
+        if (!mMotion[i]) {
+            LOGE("%s(%d): alloc motion field failed",__FUNCTION__,__LINE__);
+            goto init_fail;
+        }
+        mWorker[i] = new MfdWorkerThread(this, i);
+        mWorker[i]->run("MFDCpuWorker", CameraThreadConfig::priority("MFDCpuWorker"));
+    }
+
+    mFrameCnt = 0;
+    initialized = true;
+    LOGD("%s(%d): %dx%d, %d workers",__FUNCTION__,__LINE__,width,height,mWorkers);
+    return 0;
+
+init_fail:
+    initialized = true;
+    destroy();
+    return -1;
+}
+
+void MutliFrameDenoiseCpu::destroy()
+{
+    Semaphore sem;
+    int i;
+
+    if (!initialized)
+        return;
+    {
+        Mutex::Autolock lock(mJobLock);
+        while (mInflight > 0)
+            mJobCond.wait(mJobLock);
+    }
+
+    sem.Create();
+    for (i = 0; i < mWorkers; i++) {
+        if (mWorker[i] != NULL) {
+            Message_cam msg;
+            msg.command = CMD_MFDCPU_EXIT;
+            msg.arg3 = (void*)&sem;
+            mWorkerQ[i].put(&msg);
+            sem.Wait();
+            mWorker[i]->requestExitAndWait();
+            mWorker[i].clear();
+        }
+        free(mMotion[i]);
+        mMotion[i] = NULL;
+    }
+    for (i = 0; i < MFD_CPU_COPY_SLOTS; i++) {
+        free(mCopyBuf[i]);
+        mCopyBuf[i] = NULL;
+        mCopyBusy[i] = false;
+    }
+    free(mRef);
+    free(mAcc);
+    free(mWeight);
+    mRef = NULL;
+    mAcc = NULL;
+    mWeight = NULL;
+    mWorkers = 0;
+    mFrameCnt = 0;
+    mHeld = 0;
+    initialized = false;
+}
+
+void MutliFrameDenoiseCpu::flush()
+{
+    if (!initialized)
+        return;
+    {
+        Mutex::Autolock lock(mJobLock);
+        while (mInflight > 0)
+            mJobCond.wait(mJobLock);
+    }
+    mFrameCnt = 0;
+}
+
+void MutliFrameDenoiseCpu::setFrames(int frameNum, float iso)
+{
+    int thr;
+
+    if (frameNum < 1)
+        frameNum = 1;
+    else if (frameNum > MFD_CPU_FRAMES_MAX)
+        frameNum = MFD_CPU_FRAMES_MAX;
+    mFrameNum = frameNum;
+    mFrameCnt = 0;
+
+    //noise grows with gain: open the merge window up, keep at least 16 for the weight scale
+    thr = 16 + (int)(iso*8);
+    if (thr < 16)
+        thr = 16;
+    else if (thr > 96)
+        thr = 96;
+    mThreshold = thr;
+    mWeightScale = ((MFD_CPU_WEIGHT_REF << 8)/thr > 255) ? 255 : (MFD_CPU_WEIGHT_REF << 8)/thr;
+    //mean abs difference above thr/2 after alignment: occlusion or motion blur, keep the reference
+    mRejectSad = (thr/2)*MFD_CPU_BLOCK*MFD_CPU_BLOCK;
+    LOG1("%s(%d): frames %d, iso %f, threshold %d",__FUNCTION__,__LINE__,frameNum,iso,thr);
+}
+
+void MutliFrameDenoiseCpu::sendToWorkers(int command, void* arg)
+{
+    int i;
+
+    for (i = 0; i < mWorkers; i++) {
+        Message_cam msg;
+        msg.command = command;
+        msg.arg2 = arg;
+        mWorkerQ[i].put(&msg);
+    }
+}
+
+int MutliFrameDenoiseCpu::updateImageData(void* src, mfd_cpu_release_func release, void* ctx, void* arg)
+{
+    mfd_cpu_job_t* job;
+    int i,command;
+
+    if (!initialized || (mFrameCnt >= MFD_CPU_FRAMES_MAX) || (src == NULL)) {
+        release(ctx, arg);
+        return -1;
+    }
+    job = (mfd_cpu_job_t*)malloc(sizeof(mfd_cpu_job_t));
+    if (job == NULL) {
+        release(ctx, arg);
+        return -1;
+    }
+    job->pending = mWorkers;
+    job->copying = 0;
+    job->copySrc = NULL;
+    job->slot = -1;
+    job->release = release;
+    job->ctx = ctx;
+    job->arg = arg;
+    job->src = (unsigned char*)src;
+
+    {
+        Mutex::Autolock lock(mJobLock);
+        if (mHeld >= MFD_CPU_HELD_MAX) {
+            //don't starve the isp buffer pool: the workers copy it into a slot
+            for (i = 0; i < MFD_CPU_COPY_SLOTS; i++) {
+                if (!mCopyBusy[i])
+                    break;
+            }
+            if (i == MFD_CPU_COPY_SLOTS) {
+                //the merge is behind, waiting here would stall the isp buffer callback
+                LOG1("%s(%d): merge queue full, frame dropped",__FUNCTION__,__LINE__);
+                release(ctx, arg);
+                free(job);
+                return -1;
+            }
+            mCopyBusy[i] = true;
+            job->slot = i;
+        }
+        if (job->slot < 0)
+            mHeld++;
+        mInflight++;
+    }
+
+    if (job->slot >= 0) {
+        job->copySrc = job->src;
+        job->src = mCopyBuf[job->slot];
+        job->copying = mWorkers;
+        for (i = 0; i < mWorkers; i++) {
+            Message_cam msg;
+            msg.command = CMD_MFDCPU_COPY;
+            msg.arg2 = job;
+            mCopyQ[i].put(&msg);
+        }
+    }
+
+    command = (mFrameCnt == 0) ? CMD_MFDCPU_REFERENCE : CMD_MFDCPU_MERGE;
+    mFrameCnt++;
+    sendToWorkers(command, job);
+    return 0;
+}
+
+void MutliFrameDenoiseCpu::copyBand(int id, mfd_cpu_job_t* job)
+{
+    int y0 = mBandStart[id], y1 = mBandStart[id + 1];
+    bool release;
+
+    memcpy(job->src + y0*mWidth, job->copySrc + y0*mWidth, (y1 - y0)*mWidth);
+    memcpy(job->src + mWidth*mHeight + (y0/2)*mWidth, job->copySrc + mWidth*mHeight + (y0/2)*mWidth,
+        (y1/2 - y0/2)*mWidth);
+    {
+        Mutex::Autolock lock(mJobLock);
+        release = (--job->copying == 0);
+        if (release)
+            mJobCond.broadcast();
+    }
+    if (release)
+        job->release(job->ctx, job->arg);
+}
+
+void MutliFrameDenoiseCpu::drainCopies(int id)
+{
+    Message_cam msg;
+
+    while (!mCopyQ[id].isEmpty()) {
+        memset(&msg, 0, sizeof(msg));
+        mCopyQ[id].get(&msg);
+        if (msg.command == CMD_MFDCPU_COPY)
+            copyBand(id, (mfd_cpu_job_t*)msg.arg2);
+    }
+}
+
+//the merge searches across bands, every band of a copied frame has to be in
+void MutliFrameDenoiseCpu::waitCopied(mfd_cpu_job_t* job)
+{
+    Mutex::Autolock lock(mJobLock);
+    while (job->copying > 0)
+        mJobCond.wait(mJobLock);
+}
+
+void MutliFrameDenoiseCpu::jobDone(mfd_cpu_job_t* job)
+{
+    bool release = false;
+    {
+        Mutex::Autolock lock(mJobLock);
+        if (--job->pending > 0)
+            return;
+        if (job->slot >= 0) {
+            mCopyBusy[job->slot] = false;
+        } else {
+            mHeld--;
+            release = true;
+        }
+        mInflight--;
+        mJobCond.broadcast();
+    }
+    if (release)
+        job->release(job->ctx, job->arg);
+    free(job);
+}
+
+int MutliFrameDenoiseCpu::getResult(long targetAddr)
+{
+    Semaphore sem;
+    unsigned int blocks = 0,rejected = 0;
+    nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
+    int i;
+
+    if (!initialized || (mFrameCnt == 0) || (targetAddr == 0))
+        return -1;
+    {
+        Mutex::Autolock lock(mJobLock);
+        while (mInflight > 0)
+            mJobCond.wait(mJobLock);
+    }
+
+    sem.Create();
+    for (i = 0; i < mWorkers; i++) {
+        Message_cam msg;
+        msg.command = CMD_MFDCPU_OUTPUT;
+        msg.arg2 = (void*)targetAddr;
+        msg.arg3 = (void*)&sem;
+        mWorkerQ[i].put(&msg);
+    }
+    for (i = 0; i < mWorkers; i++) {
+        sem.Wait();
+        blocks += mBlocks[i];
+        rejected += mRejected[i];
+        mBlocks[i] = 0;
+        mRejected[i] = 0;
+    }
+    LOGD("%s(%d): merged %d frames, rejected %d/%d blocks, drain+output %lldms",__FUNCTION__,__LINE__,
+        mFrameCnt,rejected,blocks,ns2ms(systemTime(SYSTEM_TIME_MONOTONIC) - start));
+    mFrameCnt = 0;
+    return 0;
+}
+
+void MutliFrameDenoiseCpu::workerThread(int id)
+{
+    Message_cam msg;
+    bool loop = true;
+
+    while (loop) {
+        memset(&msg, 0, sizeof(msg));
+        mWorkerQ[id].get(&msg);
+        //copies were queued before the message that woke us up
+        drainCopies(id);
+        switch (msg.command)
+        {
+            case CMD_MFDCPU_REFERENCE:
+            {
+                mfd_cpu_job_t* job = (mfd_cpu_job_t*)msg.arg2;
+                waitCopied(job);
+                referenceBand(id, job->src);
+                jobDone(job);
+                break;
+            }
+            case CMD_MFDCPU_MERGE:
+            {
+                mfd_cpu_job_t* job = (mfd_cpu_job_t*)msg.arg2;
+                waitCopied(job);
+                mergeBand(id, job->src);
+                jobDone(job);
+                break;
+            }
+            case CMD_MFDCPU_OUTPUT:
+                outputBand(id, (unsigned char*)msg.arg2);
+                ((Semaphore*)msg.arg3)->Signal();
+                break;
+            case CMD_MFDCPU_EXIT:
+                loop = false;
+                ((Semaphore*)msg.arg3)->Signal();
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+void MutliFrameDenoiseCpu::referenceBand(int id, const unsigned char* src)
+{
+    int y0 = mBandStart[id], y1 = mBandStart[id + 1];
+    int start[2] = { y0*mWidth, mWidth*mHeight + (y0/2)*mWidth };
+    int count[2] = { (y1 - y0)*mWidth, (y1/2 - y0/2)*mWidth };
+    int plane,i;
+
+    for (plane = 0; plane < 2; plane++) {
+        const unsigned char* s = src + start[plane];
+        unsigned short* acc = mAcc + start[plane];
+        memcpy(mRef + start[plane], s, count[plane]);
+        memset(mWeight + start[plane], MFD_CPU_WEIGHT_REF, count[plane]);
+        for (i = 0; i < count[plane]; i++)
+            acc[i] = s[i]*MFD_CPU_WEIGHT_REF;
+    }
+    memset(mMotion[id], 0, ((mWidth + MFD_CPU_BLOCK - 1)/MFD_CPU_BLOCK)*2*sizeof(short));
+    mBlocks[id] = 0;
+    mRejected[id] = 0;
+}
+
+unsigned int MutliFrameDenoiseCpu::matchBlock(const unsigned char* src, int bx, int by, int pdx, int pdy,
+                                              int* dx, int* dy)
+{
+    const unsigned char* ref = mRef + by*mWidth + bx;
+    int xmin = -bx, xmax = mWidth - MFD_CPU_BLOCK - bx;
+    int ymin = -by, ymax = mHeight - MFD_CPU_BLOCK - by;
+    int cx,cy,x,y,bestx = 0,besty = 0;
+    unsigned int sad,best;
+
+    //coarse: every other row, step 2 around the predictor, plus zero motion
+    best = mfd_sad16(ref, src + by*mWidth + bx, mWidth, MFD_CPU_BLOCK, 2);
+    for (cy = pdy - MFD_CPU_SEARCH; cy <= pdy + MFD_CPU_SEARCH; cy += 2) {
+        if ((cy < ymin) || (cy > ymax))
+            continue;
+        for (cx = pdx - MFD_CPU_SEARCH; cx <= pdx + MFD_CPU_SEARCH; cx += 2) {
+            if ((cx < xmin) || (cx > xmax) || ((cx == 0) && (cy == 0)))
+                continue;
+            sad = mfd_sad16(ref, src + (by + cy)*mWidth + bx + cx, mWidth, MFD_CPU_BLOCK, 2);
+            if (sad < best) {
+                best = sad;
+                bestx = cx;
+                besty = cy;
+            }
+        }
+    }
+
+    //fine: full rows, +-1 around the coarse winner
+    cx = bestx;
+    cy = besty;
+    best = mfd_sad16(ref, src + (by + cy)*mWidth + bx + cx, mWidth, MFD_CPU_BLOCK, 1);
+    for (y = cy - 1; y <= cy + 1; y++) {
+        if ((y < ymin) || (y > ymax))
+            continue;
+        for (x = cx - 1; x <= cx + 1; x++) {
+            if ((x < xmin) || (x > xmax) || ((x == cx) && (y == cy)))
+                continue;
+            sad = mfd_sad16(ref, src + (by + y)*mWidth + bx + x, mWidth, MFD_CPU_BLOCK, 1);
+            if (sad < best) {
+                best = sad;
+                bestx = x;
+                besty = y;
+            }
+        }
+    }
+    *dx = bestx;
+    *dy = besty;
+    return best;
+}
+
+void MutliFrameDenoiseCpu::mergeBlock(const unsigned char* src, int bx, int by, int bw, int bh, int dx, int dy)
+{
+    int uvOffset = mWidth*mHeight;
+    int uvdx = (dx/2)*2, uvdy = dy/2;
+    int r,off;
+
+    for (r = 0; r < bh; r++) {
+        off = (by + r)*mWidth + bx;
+        mfd_merge_row(mRef + off, src + off + dy*mWidth + dx, mAcc + off, mWeight + off,
+            bw, mThreshold, mWeightScale);
+    }
+    for (r = 0; r < bh/2; r++) {
+        off = uvOffset + (by/2 + r)*mWidth + bx;
+        mfd_merge_row(mRef + off, src + off + uvdy*mWidth + uvdx, mAcc + off, mWeight + off,
+            bw, mThreshold, mWeightScale);
+    }
+}
+
+void MutliFrameDenoiseCpu::mergeBand(int id, const unsigned char* src)
+{
+    int y0 = mBandStart[id], y1 = mBandStart[id + 1];
+    short* motion = mMotion[id];
+    int bx,by,bw,bh,col,pdx,pdy,dx,dy;
+    unsigned int sad;
+
+    for (by = y0; by < y1; by += MFD_CPU_BLOCK) {
+        bh = ((y1 - by) < MFD_CPU_BLOCK) ? (y1 - by) : MFD_CPU_BLOCK;
+        pdx = 0;
+        pdy = 0;
+        for (bx = 0, col = 0; bx < mWidth; bx += MFD_CPU_BLOCK, col++) {
+            bw = ((mWidth - bx) < MFD_CPU_BLOCK) ? (mWidth - bx) : MFD_CPU_BLOCK;
+            mBlocks[id]++;
+            if ((bw < MFD_CPU_BLOCK) || (bh < MFD_CPU_BLOCK)) {
+                //partial block at the frame edge: no search, the weights still reject ghosts
+                mergeBlock(src, bx, by, bw, bh, 0, 0);
+                continue;
+            }
+            //predict from the left neighbour, or the block above at the start of a row
+            if (col == 0) {
+                pdx = motion[0];
+                pdy = motion[1];
+            }
+            sad = matchBlock(src, bx, by, pdx, pdy, &dx, &dy);
+            motion[col*2] = dx;
+            motion[col*2 + 1] = dy;
+            pdx = dx;
+            pdy = dy;
+            if (sad > mRejectSad) {
+                mRejected[id]++;
+                continue;
+            }
+            mergeBlock(src, bx, by, bw, bh, dx, dy);
+        }
+        //frames that arrived meanwhile give their isp buffer back early
+        drainCopies(id);
+    }
+}
+
+void MutliFrameDenoiseCpu::outputBand(int id, unsigned char* dst)
+{
+    int y0 = mBandStart[id], y1 = mBandStart[id + 1];
+    int start[2] = { y0*mWidth, mWidth*mHeight + (y0/2)*mWidth };
+    int count[2] = { (y1 - y0)*mWidth, (y1/2 - y0/2)*mWidth };
+    int plane,i;
+
+    for (plane = 0; plane < 2; plane++) {
+        const unsigned short* acc = mAcc + start[plane];
+        const unsigned char* weight = mWeight + start[plane];
+        unsigned char* d = dst + start[plane];
+        for (i = 0; i < count[plane]; i++)
+            d[i] = (unsigned char)((acc[i]*gMfdRecip[weight[i]] + 32768) >> 16);
+    }
+}
+
+}
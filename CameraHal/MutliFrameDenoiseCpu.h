@@ -0,0 +1,123 @@
+#ifndef ANDROID_HARDWARE_CAMERA_MFD_CPU_H
+#define ANDROID_HARDWARE_CAMERA_MFD_CPU_H
+
+//cpu multi-frame denoise: block matching alignment + weighted temporal merge on nv12
+#include <utils/threads.h>
+#include "MessageQueue.h"
+#include "CameraThreadConfig.h"
+
+namespace android {
+
+#define MFD_CPU_WORKER_MAX      4
+#define MFD_CPU_FRAMES_MAX      8       /* 8bit weight sum holds up to 15 frames of weight 16 */
+#define MFD_CPU_HELD_MAX        2       /* frames held by reference, later ones are copied */
+#define MFD_CPU_COPY_SLOTS      (MFD_CPU_FRAMES_MAX - MFD_CPU_HELD_MAX)
+#define MFD_CPU_BLOCK           16
+#define MFD_CPU_SEARCH          8       /* luma search range in pixels */
+
+typedef void (*mfd_cpu_release_func)(void* ctx, void* arg);
+
+/*
+ * Frames are queued by reference from the isp callback and merged by a pool of
+ * workers, each owning a fixed band of rows. The first frame after setFrames()
+ * is the reference; getResult() waits for the queued frames and writes the merge.
+ *
+ * Past MFD_CPU_HELD_MAX frames in flight a frame goes into one of the copy slots
+ * allocated by init(). The workers copy their band of it between block rows of
+ * the merge they are on, the isp buffer goes back once every band is copied, and
+ * the merge of the frame waits for the last band. The callback never copies,
+ * and with every slot busy it drops the frame instead of waiting.
+ */
+class MutliFrameDenoiseCpu {
+public:
+    enum MfdCpuCommands {
+        CMD_MFDCPU_REFERENCE,
+        CMD_MFDCPU_MERGE,
+        CMD_MFDCPU_COPY,
+        CMD_MFDCPU_OUTPUT,
+        CMD_MFDCPU_EXIT
+    };
+
+    bool initialized;
+    MutliFrameDenoiseCpu();
+    ~MutliFrameDenoiseCpu();
+    //allocates for width x height, a size already set up is kept
+    int init(int width, int height);
+    void setFrames(int frameNum, float iso);
+    //never blocks on the merge; release(ctx, arg) is called once src is no longer used
+    //-1: the frame was not queued (merge queue full), it is already released
+    int updateImageData(void* src, mfd_cpu_release_func release, void* ctx, void* arg);
+    int getResult(long targetAddr);
+    //waits for the queued frames so their buffers are given back, keeps the allocations
+    void flush();
+    void destroy();
+
+private:
+    typedef struct mfd_cpu_job {
+        unsigned char* src;
+        unsigned char* copySrc;         /* isp frame a copy slot is filled from */
+        int pending;
+        int copying;                    /* bands left to copy into the slot */
+        int slot;                       /* copy slot, -1: held by reference */
+        mfd_cpu_release_func release;
+        void* ctx;
+        void* arg;
+    } mfd_cpu_job_t;
+
+    class MfdWorkerThread : public Thread {
+        MutliFrameDenoiseCpu* mEngine;
+        int mId;
+    public:
+        MfdWorkerThread(MutliFrameDenoiseCpu* engine, int id)
+            : Thread(false), mEngine(engine), mId(id) {}
+
+        virtual bool threadLoop() {
+            CameraThreadConfig::enter("MFDCpuWorker");
+            mEngine->workerThread(mId);
+            return false;
+        }
+    };
+
+    void workerThread(int id);
+    void copyBand(int id, mfd_cpu_job_t* job);
+    void drainCopies(int id);
+    void waitCopied(mfd_cpu_job_t* job);
+    void referenceBand(int id, const unsigned char* src);
+    void mergeBand(int id, const unsigned char* src);
+    void outputBand(int id, unsigned char* dst);
+    void mergeBlock(const unsigned char* src, int bx, int by, int bw, int bh, int dx, int dy);
+    unsigned int matchBlock(const unsigned char* src, int bx, int by, int pdx, int pdy, int* dx, int* dy);
+    void jobDone(mfd_cpu_job_t* job);
+    void sendToWorkers(int command, void* arg);
+
+    int mWidth;
+    int mHeight;
+    int mWorkers;
+    int mBandStart[MFD_CPU_WORKER_MAX + 1];    /* luma rows, multiples of MFD_CPU_BLOCK */
+    int mFrameNum;
+    int mFrameCnt;
+    unsigned char mThreshold;
+    unsigned char mWeightScale;
+    unsigned int mRejectSad;
+
+    unsigned char* mRef;
+    unsigned short* mAcc;
+    unsigned char* mWeight;
+    short* mMotion[MFD_CPU_WORKER_MAX];        /* per band: dx,dy of the block row above */
+    unsigned char* mCopyBuf[MFD_CPU_COPY_SLOTS];
+    bool mCopyBusy[MFD_CPU_COPY_SLOTS];
+
+    Mutex mJobLock;
+    Condition mJobCond;
+    int mInflight;
+    int mHeld;
+    unsigned int mBlocks[MFD_CPU_WORKER_MAX];
+    unsigned int mRejected[MFD_CPU_WORKER_MAX];
+
+    sp<MfdWorkerThread> mWorker[MFD_CPU_WORKER_MAX];
+    MessageQueue mWorkerQ[MFD_CPU_WORKER_MAX];
+    MessageQueue mCopyQ[MFD_CPU_WORKER_MAX];   /* band copies, taken ahead of mWorkerQ */
+};
+
+}
+#endif
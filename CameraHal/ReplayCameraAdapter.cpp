@@ -0,0 +1,798 @@
+#include "ReplayCameraAdapter.h"
+
+#include <cutils/properties.h>
+
+namespace android{
+
+#define REPLAY_DEFAULT_FPS          30
+#define REPLAY_RESYNC_THRESHOLD_NS  500000000LL     /* fall behind more than 500ms: rebase the clock */
+
+CameraReplayAdapter::CameraReplayAdapter(int cameraId)
+                   :CameraAdapter(cameraId)
+{
+    mCamDriverV4l2MemType = V4L2_MEMORY_OVERLAY;
+    mReplayFd = -1;
+    mReplayData = NULL;
+    mReplaySize = 0;
+    mReplayFmt = 0;
+    mReplayWidth = 0;
+    mReplayHeight = 0;
+    mReplayBayer = CAMERA_REPLAY_BAYER_BGGR;
+    mReplayBitDepth = 8;
+    mReplayRawMsbFirst = false;
+    mReplayAsap = false;
+    mReplayLoop = true;
+    mReplayCursor = 0;
+    mReplayBaseTime = 0;
+    mReplayBaseStamp = 0;
+    mReplayScratch = NULL;
+    mReplayDropCount = 0;
+    memset(&mMjpegDecoder, 0x00, sizeof(mjpeg_interface_t));
+    mMjpegDecoder.state = -1;
+}
+
+CameraReplayAdapter::~CameraReplayAdapter()
+{
+    cameraDestroy();
+}
+
+int CameraReplayAdapter::setParameters(const CameraParameters &params_set,bool &isRestartValue)
+{
+    mParameters = params_set;
+    isRestartValue = isNeedToRestartPreview();
+    return 0;
+}
+
+int CameraReplayAdapter::selectPreferedDrvSize(int *width,int * height,bool is_capture)
+{
+    //the recorded resolution is the only one the source can deliver
+    if (mReplayWidth && mReplayHeight) {
+        *width = mReplayWidth;
+        *height = mReplayHeight;
+    }
+    return 0;
+}
+
+void CameraReplayAdapter::initDefaultParameters(int camFd)
+{
+    CameraParameters params;
+    String8 parameterString;
+    char str_element[32];
+    int fps = REPLAY_DEFAULT_FPS;
+
+    /*preview size setting: the recorded size, app sizes are scaled by display/callback paths*/
+    snprintf(str_element, sizeof(str_element), "%dx%d", mReplayWidth, mReplayHeight);
+    parameterString.append(str_element);
+    if ((mReplayWidth > 640) && (mReplayHeight > 480))
+        parameterString.append(",640x480");
+    if ((mReplayWidth > 320) && (mReplayHeight > 240))
+        parameterString.append(",320x240");
+    params.set(CameraParameters::KEY_SUPPORTED_PREVIEW_SIZES, parameterString.string());
+    params.setPreviewSize(mReplayWidth,mReplayHeight);
+    /*picture size setting*/
+    params.set(CameraParameters::KEY_SUPPORTED_PICTURE_SIZES, str_element);
+    params.setPictureSize(mReplayWidth,mReplayHeight);
+
+    params.set(CameraParameters::KEY_SUPPORTED_PREVIEW_FORMATS, "yuv420sp,yuv420p");
+    params.setPreviewFormat(CameraParameters::PIXEL_FORMAT_YUV420SP);
+    params.set(CameraParameters::KEY_VIDEO_FRAME_FORMAT,CameraParameters::PIXEL_FORMAT_YUV420SP);
+
+ 	params.set(CameraParameters::KEY_MAX_NUM_FOCUS_AREAS,"0");
+    params.set(CameraParameters::KEY_FOCUS_MODE, CameraParameters::FOCUS_MODE_FIXED);
+	params.set(CameraParameters::KEY_SUPPORTED_FOCUS_MODES, CameraParameters::FOCUS_MODE_FIXED);
+    /*software face detection runs on the preview stream*/
+    params.set(CameraParameters::KEY_MAX_NUM_DETECTED_FACES_HW,"1");
+
+    /*picture format setting*/
+    params.set(CameraParameters::KEY_SUPPORTED_PICTURE_FORMATS, CameraParameters::PIXEL_FORMAT_JPEG);
+    params.setPictureFormat(CameraParameters::PIXEL_FORMAT_JPEG);
+    params.set(CameraParameters::KEY_JPEG_QUALITY, "70");
+    params.set(CameraParameters::KEY_ROTATION, "0");
+
+    /*only for passing cts*/
+    params.set(CameraParameters::KEY_FOCUS_DISTANCES, "0.3,50,Infinity");
+    params.set(CameraParameters::KEY_FOCAL_LENGTH, "35");
+    params.set(CameraParameters::KEY_HORIZONTAL_VIEW_ANGLE, "60");
+    params.set(CameraParameters::KEY_VERTICAL_VIEW_ANGLE, "28.9");
+
+    params.set(CameraParameters::KEY_JPEG_THUMBNAIL_QUALITY, "50");
+    params.set(CameraParameters::KEY_SUPPORTED_JPEG_THUMBNAIL_SIZES, "0x0,160x128,160x96");
+    params.set(CameraParameters::KEY_JPEG_THUMBNAIL_WIDTH, "160");
+    params.set(CameraParameters::KEY_JPEG_THUMBNAIL_HEIGHT, "128");
+    params.set(CameraParameters::KEY_RECORDING_HINT,"false");
+    params.set(CameraParameters::KEY_VIDEO_STABILIZATION_SUPPORTED,"false");
+    params.set(CameraParameters::KEY_VIDEO_SNAPSHOT_SUPPORTED,"true");
+    params.set(CameraParameters::KEY_AUTO_WHITEBALANCE_LOCK_SUPPORTED, "false");
+    params.set(CameraParameters::KEY_AUTO_EXPOSURE_LOCK_SUPPORTED, "false");
+    params.set(CameraParameters::KEY_EXPOSURE_COMPENSATION, "0");
+    params.set(CameraParameters::KEY_MAX_EXPOSURE_COMPENSATION, "1");
+    params.set(CameraParameters::KEY_MIN_EXPOSURE_COMPENSATION, "0");
+    params.set(CameraParameters::KEY_EXPOSURE_COMPENSATION_STEP, "1");
+    params.set(CameraParameters::KEY_SUPPORTED_WHITE_BALANCE, "false");
+    params.set(CameraParameters::KEY_SUPPORTED_EFFECTS, "false");
+    params.set(CameraParameters::KEY_SUPPORTED_SCENE_MODES, "false");
+    params.set(CameraParameters::KEY_SUPPORTED_ANTIBANDING, "false");
+
+    /*fps: derived from the recorded timestamps*/
+    if (mReplayFrames.size() > 1) {
+        int64_t span = mReplayFrames[mReplayFrames.size()-1].timestamp_us - mReplayFrames[0].timestamp_us;
+        if (span > 0)
+            fps = (int)(((int64_t)(mReplayFrames.size()-1)*1000000LL + span/2)/span);
+    }
+    if (fps < 1)
+        fps = 1;
+    else if (fps > 120)
+        fps = 120;
+    snprintf(str_element, sizeof(str_element), "%d,%d", fps*1000, fps*1000);
+    params.set(CameraParameters::KEY_PREVIEW_FPS_RANGE, str_element);
+    snprintf(str_element, sizeof(str_element), "(%d,%d)", fps*1000, fps*1000);
+    params.set(CameraParameters::KEY_SUPPORTED_PREVIEW_FPS_RANGE, str_element);
+    snprintf(str_element, sizeof(str_element), "%d", fps);
+    params.set(CameraParameters::KEY_SUPPORTED_PREVIEW_FRAME_RATES, str_element);
+    params.setPreviewFrameRate(fps);
+
+    mParameters = params;
+    LOGD("%s(%d): replay %dx%d '%c%c%c%c' %d frames, %dfps, pace: %s",__FUNCTION__,__LINE__,
+        mReplayWidth,mReplayHeight,mReplayFmt & 0xFF, (mReplayFmt >> 8) & 0xFF,
+        (mReplayFmt >> 16) & 0xFF, (mReplayFmt >> 24) & 0xFF,mReplayFrames.size(),fps,
+        mReplayAsap ? "asap":"realtime");
+}
+
+void CameraReplayAdapter::replayWaitFrameTime(const replay_frame_t& frame)
+{
+    nsecs_t now,due;
+
+    if (mReplayAsap)
+        return;
+
+    now = systemTime(CLOCK_MONOTONIC);
+    if (mReplayBaseTime == 0) {
+        mReplayBaseTime = now;
+        mReplayBaseStamp = frame.timestamp_us;
+        return;
+    }
+
+    due = mReplayBaseTime + (nsecs_t)(frame.timestamp_us - mReplayBaseStamp)*1000LL;
+    if (due > now) {
+        usleep((due - now)/1000);
+    } else if ((now - due) > REPLAY_RESYNC_THRESHOLD_NS) {
+        //consumers stalled for a long time, don't burst to catch up
+        mReplayBaseTime = now;
+        mReplayBaseStamp = frame.timestamp_us;
+    }
+}
+
+void CameraReplayAdapter::replayBayerToNV12(const unsigned char* src, char* dst)
+{
+    int x,y,i,s[4],r,g,b,yy,u,v;
+    int w = mReplayWidth, h = mReplayHeight;
+    int shift = (mReplayBitDepth > 8) ? (mReplayBitDepth - 8) : 0;
+    int bpp = (mReplayBitDepth > 8) ? 2 : 1;
+    unsigned char *dst_y = (unsigned char*)dst;
+    unsigned char *dst_uv = (unsigned char*)dst + w*h;
+    //index of R,G1,G2,B inside a 2x2 quad for each pattern
+    static const int quad_idx[4][4] = {
+        {3,1,2,0},  /* BGGR */
+        {2,0,3,1},  /* GBRG */
+        {1,0,3,2},  /* GRBG */
+        {0,1,2,3},  /* RGGB */
+    };
+    const int *idx = quad_idx[mReplayBayer & 0x03];
+
+    /* nearest-quad demosaic: one RGB triple per 2x2 cell, which maps exactly onto one NV12 chroma sample */
+    for (y = 0; y < h; y += 2) {
+        const unsigned char *l0 = src + y*w*bpp;
+        const unsigned char *l1 = l0 + w*bpp;
+        for (x = 0; x < w; x += 2) {
+            if (bpp == 1) {
+                s[0] = l0[x];
+                s[1] = l0[x+1];
+                s[2] = l1[x];
+                s[3] = l1[x+1];
+            } else if (mReplayRawMsbFirst) {
+                s[0] = (l0[2*x]<<8) | l0[2*x+1];
+                s[1] = (l0[2*x+2]<<8) | l0[2*x+3];
+                s[2] = (l1[2*x]<<8) | l1[2*x+1];
+                s[3] = (l1[2*x+2]<<8) | l1[2*x+3];
+            } else {
+                s[0] = l0[2*x] | (l0[2*x+1]<<8);
+                s[1] = l0[2*x+2] | (l0[2*x+3]<<8);
+                s[2] = l1[2*x] | (l1[2*x+1]<<8);
+                s[3] = l1[2*x+2] | (l1[2*x+3]<<8);
+            }
+            for (i = 0; i < 4; i++) {
+                s[i] >>= shift;
+                if (s[i] > 255)
+                    s[i] = 255;
+            }
+            r = s[idx[0]];
+            g = (s[idx[1]] + s[idx[2]] + 1) >> 1;
+            b = s[idx[3]];
+
+            yy = ((66*r + 129*g + 25*b + 128) >> 8) + 16;
+            u = ((-38*r - 74*g + 112*b + 128) >> 8) + 128;
+            v = ((112*r - 94*g - 18*b + 128) >> 8) + 128;
+            yy = (yy > 255) ? 255 : yy;
+            u = (u < 0) ? 0 : ((u > 255) ? 255 : u);
+            v = (v < 0) ? 0 : ((v > 255) ? 255 : v);
+
+            dst_y[y*w + x] = dst_y[y*w + x + 1] = yy;
+            dst_y[(y+1)*w + x] = dst_y[(y+1)*w + x + 1] = yy;
+            dst_uv[(y>>1)*w + x] = u;
+            dst_uv[(y>>1)*w + x + 1] = v;
+        }
+    }
+}
+
+unsigned long CameraReplayAdapter::replayFrameBytes()
+{
+    unsigned long pixels = (unsigned long)mReplayWidth*mReplayHeight;
+
+    switch (mReplayFmt)
+    {
+        case V4L2_PIX_FMT_NV12:
+            return pixels*3/2;
+        case V4L2_PIX_FMT_YUYV:
+            return pixels*2;
+        case V4L2_PIX_FMT_SBGGR8:
+        case V4L2_PIX_FMT_SBGGR16:
+            return pixels*((mReplayBitDepth > 8) ? 2 : 1);
+        default:
+            return 0;
+    }
+}
+
+int CameraReplayAdapter::replayConvertFrame(const replay_frame_t& frame, char* dst, long dst_phy, int dst_fd)
+{
+    int ret = 0;
+    unsigned char *src = mReplayData + frame.offset;
+
+    switch (mReplayFmt)
+    {
+        case V4L2_PIX_FMT_NV12:
+            memcpy(dst, src, mReplayWidth*mReplayHeight*3/2);
+            break;
+        case V4L2_PIX_FMT_YUYV:
+            arm_yuyv_to_nv12(mReplayWidth, mReplayHeight, (char*)src, dst);
+            break;
+        case V4L2_PIX_FMT_SBGGR8:
+        case V4L2_PIX_FMT_SBGGR16:
+            replayBayerToNV12(src, dst);
+            break;
+        case V4L2_PIX_FMT_MJPEG:
+        {
+            long out_addr;
+
+        #if defined(RK_DRM_GRALLOC)
+            out_addr = dst_fd;
+        #else
+            out_addr = dst_phy ? dst_phy : dst_fd;
+        #endif
+            //the scratch buffer is cpu only
+            if (dst == mReplayScratch)
+                out_addr = -1;
+            ret = mjpegDecodeFrame(src, frame.size, dst, out_addr, mReplayWidth, mReplayHeight);
+            if (ret < 0)
+                LOGE("%s(%d): mjpeg stream is error!",__FUNCTION__,__LINE__);
+            break;
+        }
+        default:
+            LOGE("%s(%d): replay format 0x%x isn't support",__FUNCTION__,__LINE__,mReplayFmt);
+            ret = -1;
+            break;
+    }
+    return ret;
+}
+
+int CameraReplayAdapter::getFrame(FramInfo_s** tmpFrame)
+{
+    long buf_phy, buf_vir;
+    int index = -1,ret;
+    char *dst;
+    bool scale;
+
+    if (mReplayFrames.size() == 0) {
+        usleep(30000);
+        return -1;
+    }
+
+    if (mReplayCursor >= mReplayFrames.size()) {
+        if (!mReplayLoop) {
+            usleep(30000);
+            return -1;
+        }
+        LOG1("%s(%d): replay rewind, %d frames dropped",__FUNCTION__,__LINE__,mReplayDropCount);
+        mReplayCursor = 0;
+        mReplayBaseTime = 0;
+    }
+
+    //paced before a preview buffer is taken, consumers keep every buffer during the wait
+    const replay_frame_t& frame = mReplayFrames[mReplayCursor];
+    replayWaitFrameTime(frame);
+
+    index = mPreviewBufProvider->getOneAvailableBuffer(&buf_phy,&buf_vir);
+    if(index < 0){
+        //all buffers are held by consumers, the recorded clock keeps running
+        usleep(2000);
+        return -1;
+    }
+    mReplayCursor++;
+
+    //the preview buffer was sized for the driver size, scale if it isn't the recorded one
+    scale = (mCamDrvWidth != mReplayWidth) || (mCamDrvHeight != mReplayHeight);
+    dst = scale ? mReplayScratch : (char*)buf_vir;
+    if (dst == NULL)
+        return -1;
+
+    ret = replayConvertFrame(frame, dst, mPreviewBufProvider->getBufPhyAddr(index),
+                             mPreviewBufProvider->getBufShareFd(index));
+    if (ret < 0) {
+        mReplayDropCount++;
+        return -1;
+    }
+    if (scale) {
+        arm_camera_yuv420_scale_arm(V4L2_PIX_FMT_NV12, V4L2_PIX_FMT_NV12, mReplayScratch, (char*)buf_vir,
+                                    mReplayWidth, mReplayHeight, mCamDrvWidth, mCamDrvHeight, false, 100);
+    }
+    //the vpu writes mjpeg frames itself, anything else went through the cpu
+    if ((mReplayFmt != V4L2_PIX_FMT_MJPEG) || scale || (ret > 0))
+        mPreviewBufProvider->flushBuffer(index);
+
+    // fill frame info:w,h,phy,vir
+    mPreviewFrameInfos[index].frame_fmt = V4L2_PIX_FMT_NV12;
+    mPreviewFrameInfos[index].frame_width = mCamDrvWidth;
+    mPreviewFrameInfos[index].frame_height = mCamDrvHeight;
+    mPreviewFrameInfos[index].frame_index = index;
+    //decoded and scaled frames are written packed
+    mPreviewFrameInfos[index].y_stride = 0;
+    mPreviewFrameInfos[index].uv_offset = 0;
+    mPreviewFrameInfos[index].phy_addr = mPreviewBufProvider->getBufPhyAddr(index);
+    mPreviewFrameInfos[index].vir_addr = (long)mCamDriverV4l2Buffer[index];
+    mPreviewFrameInfos[index].zoom_value = mZoomVal;
+    mPreviewFrameInfos[index].used_flag = 0;
+    mPreviewFrameInfos[index].frame_size = mCamDrvWidth*mCamDrvHeight*3/2;
+    mPreviewFrameInfos[index].res = NULL;
+    //the recorded stamp on the replay clock, asap replay has none
+    memset(&mPreviewFrameInfos[index].meta, 0, sizeof(cam_frame_meta_t));
+    if (mReplayBaseTime)
+        mPreviewFrameInfos[index].meta.timestamp = mReplayBaseTime + (nsecs_t)(frame.timestamp_us - mReplayBaseStamp)*1000LL;
+    else
+        mPreviewFrameInfos[index].meta.timestamp = systemTime(CLOCK_MONOTONIC);
+    mPreviewFrameInfos[index].meta.sequence = mPreviewFrameIndex;
+    mPreviewFrameInfos[index].meta.lens_pos = -1;
+
+    *tmpFrame = &(mPreviewFrameInfos[index]);
+    mPreviewFrameIndex++;
+    debugShowFPS();
+    return 0;
+}
+
+int CameraReplayAdapter::adapterReturnFrame(long index,int cmd)
+{
+    mCamDriverStreamLock.lock();
+    if (!mCamDriverStream) {
+        LOGD("%s(%d): preview thread is pause, so buffer %d isn't enqueue to camera",__FUNCTION__,__LINE__,index);
+        mCamDriverStreamLock.unlock();
+        return 0;
+    }
+	mPreviewBufProvider->setBufferStatus(index,0, cmd);
+    mCamDriverStreamLock.unlock();
+    return 0;
+}
+
+int CameraReplayAdapter::cameraStream(bool on)
+{
+    mCamDriverStreamLock.lock();
+    mCamDriverStream = on;
+	mCamDriverStreamLock.unlock();
+    return 0;
+}
+
+int CameraReplayAdapter::cameraStart()
+{
+    int buffer_count;
+    int previewBufStatus = ((PreviewBufferProvider::CMD_PREVIEWBUF_WRITING) | (PreviewBufferProvider::CMD_PREVIEWBUF_DISPING)
+                            |(PreviewBufferProvider::CMD_PREVIEWBUF_VIDEO_ENCING) |(PreviewBufferProvider::CMD_PREVIEWBUF_SNAPSHOT_ENCING)
+                            | (PreviewBufferProvider::CMD_PREVIEWBUF_DATACB));
+
+    if (mReplayData == NULL) {
+        LOGE("%s(%d): replay source isn't opened",__FUNCTION__,__LINE__);
+        return -1;
+    }
+
+    buffer_count = mPreviewBufProvider->getBufCount();
+    for (int i = 0; i < buffer_count; i++) {
+        mCamDriverV4l2Buffer[i] = (char*)mPreviewBufProvider->getBufVirAddr(i);
+        mPreviewBufProvider->setBufferStatus(i, 0,previewBufStatus);
+    }
+
+    if ((mCamDrvWidth != mReplayWidth) || (mCamDrvHeight != mReplayHeight)) {
+        mReplayScratch = (char*)malloc(mReplayWidth*mReplayHeight*3/2);
+        if (mReplayScratch == NULL) {
+            LOGE("%s(%d): malloc replay scratch buffer failed",__FUNCTION__,__LINE__);
+            return -1;
+        }
+    }
+
+    mPreviewErrorFrameCount = 0;
+    mPreviewFrameIndex = 0;
+    mReplayBaseTime = 0;
+    mReplayDropCount = 0;
+    cameraStream(true);
+    return 0;
+}
+
+int CameraReplayAdapter::cameraSetSize(int w, int h, int fmt, bool is_capture)
+{
+    return 0;
+}
+
+int CameraReplayAdapter::cameraStop()
+{
+    if (mReplayScratch) {
+        free(mReplayScratch);
+        mReplayScratch = NULL;
+    }
+    return 0;
+}
+
+void CameraReplayAdapter::dump(int cameraId)
+{
+    LOGD("%s(%d): replay %dx%d fmt(0x%x) cursor %d/%d, dropped %d",__FUNCTION__,__LINE__,
+        mReplayWidth,mReplayHeight,mReplayFmt,mReplayCursor,mReplayFrames.size(),mReplayDropCount);
+}
+
+int CameraReplayAdapter::replayIndexContainer()
+{
+    replay_file_header_t *hdr = (replay_file_header_t*)mReplayData;
+    replay_frame_header_t fhdr;
+    replay_frame_t frame;
+    unsigned long pos = sizeof(replay_file_header_t);
+    unsigned long frame_bytes;
+
+    if (hdr->version != CAMERA_REPLAY_VERSION) {
+        LOGE("%s(%d): replay container version %d isn't support",__FUNCTION__,__LINE__,hdr->version);
+        return -1;
+    }
+    mReplayFmt = hdr->fourcc;
+    mReplayWidth = hdr->width;
+    mReplayHeight = hdr->height;
+    mReplayBayer = hdr->bayer_pattern;
+    mReplayBitDepth = hdr->bit_depth ? hdr->bit_depth : ((mReplayFmt == V4L2_PIX_FMT_SBGGR16) ? 16 : 8);
+    mReplayRawMsbFirst = false;
+    if ((mReplayWidth <= 0) || (mReplayHeight <= 0)) {
+        LOGE("%s(%d): replay container size %dx%d is invalidate",__FUNCTION__,__LINE__,mReplayWidth,mReplayHeight);
+        return -1;
+    }
+    frame_bytes = replayFrameBytes();
+
+    while ((pos + sizeof(replay_frame_header_t)) <= mReplaySize) {
+        if (hdr->frame_count && (mReplayFrames.size() >= hdr->frame_count))
+            break;
+        memcpy(&fhdr, mReplayData + pos, sizeof(replay_frame_header_t));
+        pos += sizeof(replay_frame_header_t);
+        if ((fhdr.size == 0) || ((pos + fhdr.size) > mReplaySize)) {
+            LOGE("%s(%d): frame %d is truncated, stop indexing",__FUNCTION__,__LINE__,mReplayFrames.size());
+            break;
+        }
+        //the conversion reads a whole frame of the header format, whatever the frame says
+        if (fhdr.size < frame_bytes) {
+            LOGE("%s(%d): frame %d has %u bytes, %dx%d fmt(0x%x) needs %lu, stop indexing",__FUNCTION__,__LINE__,
+                mReplayFrames.size(),fhdr.size,mReplayWidth,mReplayHeight,mReplayFmt,frame_bytes);
+            break;
+        }
+        frame.offset = pos;
+        frame.size = fhdr.size;
+        frame.timestamp_us = fhdr.timestamp_us;
+        mReplayFrames.push(frame);
+        pos += fhdr.size;
+    }
+    return 0;
+}
+
+int CameraReplayAdapter::replayIndexRawStream()
+{
+    char value[PROPERTY_VALUE_MAX];
+    replay_frame_t frame;
+    unsigned long pos,frame_size;
+    int fps;
+
+    property_get(CAMERAHAL_REPLAYCAMERA_WIDTH_KEY, value, "0");
+    mReplayWidth = atoi(value);
+    property_get(CAMERAHAL_REPLAYCAMERA_HEIGHT_KEY, value, "0");
+    mReplayHeight = atoi(value);
+    property_get(CAMERAHAL_REPLAYCAMERA_FPS_KEY, value, "30");
+    fps = atoi(value);
+    if (fps <= 0)
+        fps = REPLAY_DEFAULT_FPS;
+    if ((mReplayWidth <= 0) || (mReplayHeight <= 0)) {
+        LOGE("%s(%d): headerless replay need %s and %s",__FUNCTION__,__LINE__,
+            CAMERAHAL_REPLAYCAMERA_WIDTH_KEY,CAMERAHAL_REPLAYCAMERA_HEIGHT_KEY);
+        return -1;
+    }
+
+    frame_size = replayFrameBytes();
+
+    for (pos = 0; (pos + frame_size) <= mReplaySize; pos += frame_size) {
+        frame.offset = pos;
+        frame.size = frame_size;
+        frame.timestamp_us = (int64_t)mReplayFrames.size()*1000000LL/fps;
+        mReplayFrames.push(frame);
+    }
+    return 0;
+}
+
+int CameraReplayAdapter::replayIndexMjpegStream()
+{
+    char value[PROPERTY_VALUE_MAX];
+    replay_frame_t frame;
+    unsigned long pos = 0,soi,seg;
+    unsigned char *p = mReplayData;
+    int fps;
+
+    property_get(CAMERAHAL_REPLAYCAMERA_FPS_KEY, value, "30");
+    fps = atoi(value);
+    if (fps <= 0)
+        fps = REPLAY_DEFAULT_FPS;
+
+    while ((pos + 4) <= mReplaySize) {
+        //seek SOI
+        if (!((p[pos] == 0xff) && (p[pos+1] == 0xd8))) {
+            pos++;
+            continue;
+        }
+        soi = pos;
+
+        //take the size from the first frame's SOF marker
+        if ((mReplayWidth == 0) && (mReplayHeight == 0)) {
+            seg = soi + 2;
+            while ((seg + 9) < mReplaySize && (p[seg] == 0xff)) {
+                unsigned char marker = p[seg+1];
+                if ((marker >= 0xc0) && (marker <= 0xc2)) {
+                    mReplayHeight = (p[seg+5]<<8) | p[seg+6];
+                    mReplayWidth = (p[seg+7]<<8) | p[seg+8];
+                    break;
+                }
+                if (marker == 0xda)
+                    break;
+                seg += 2 + ((p[seg+2]<<8) | p[seg+3]);
+            }
+        }
+
+        //seek EOI
+        for (pos = soi + 2; (pos + 1) < mReplaySize; pos++) {
+            if ((p[pos] == 0xff) && (p[pos+1] == 0xd9))
+                break;
+        }
+        if ((pos + 1) >= mReplaySize)
+            break;
+        pos += 2;
+
+        frame.offset = soi;
+        frame.size = pos - soi;
+        frame.timestamp_us = (int64_t)mReplayFrames.size()*1000000LL/fps;
+        mReplayFrames.push(frame);
+    }
+
+    if ((mReplayWidth == 0) || (mReplayHeight == 0)) {
+        LOGE("%s(%d): can't find SOF marker in mjpeg replay",__FUNCTION__,__LINE__);
+        return -1;
+    }
+    return 0;
+}
+
+int CameraReplayAdapter::replayIndexPgmStream()
+{
+    char value[PROPERTY_VALUE_MAX];
+    replay_frame_t frame;
+    unsigned long pos = 0,frame_size;
+    int field[3],n,maxval = 0,fps;
+    unsigned char *p = mReplayData;
+
+    property_get(CAMERAHAL_REPLAYCAMERA_FPS_KEY, value, "30");
+    fps = atoi(value);
+    if (fps <= 0)
+        fps = REPLAY_DEFAULT_FPS;
+    property_get(CAMERAHAL_REPLAYCAMERA_BAYER_KEY, value, "bggr");
+    if (!strcmp(value, "gbrg"))
+        mReplayBayer = CAMERA_REPLAY_BAYER_GBRG;
+    else if (!strcmp(value, "grbg"))
+        mReplayBayer = CAMERA_REPLAY_BAYER_GRBG;
+    else if (!strcmp(value, "rggb"))
+        mReplayBayer = CAMERA_REPLAY_BAYER_RGGB;
+    else
+        mReplayBayer = CAMERA_REPLAY_BAYER_BGGR;
+
+    /* concatenated binary PGM (P5) images, same header readpgmraw.h understands */
+    while ((pos + 2) < mReplaySize) {
+        if ((p[pos] != 'P') || (p[pos+1] != '5'))
+            break;
+        pos += 2;
+        for (n = 0; n < 3; n++) {
+            //skip white space and comments
+            while (pos < mReplaySize) {
+                if (p[pos] == '#') {
+                    while ((pos < mReplaySize) && (p[pos] != '\n'))
+                        pos++;
+                } else if ((p[pos] == ' ') || (p[pos] == '\t') || (p[pos] == '\r') || (p[pos] == '\n')) {
+                    pos++;
+                } else {
+                    break;
+                }
+            }
+            field[n] = 0;
+            while ((pos < mReplaySize) && (p[pos] >= '0') && (p[pos] <= '9'))
+                field[n] = field[n]*10 + (p[pos++] - '0');
+        }
+        pos++;      /* single white space before the raster */
+
+        if ((field[0] <= 0) || (field[1] <= 0) || (field[2] <= 0) || (field[2] > 65535)) {
+            LOGE("%s(%d): invalid pgm header at offset %lu",__FUNCTION__,__LINE__,pos);
+            break;
+        }
+        if (mReplayFrames.size() == 0) {
+            mReplayWidth = field[0];
+            mReplayHeight = field[1];
+            maxval = field[2];
+        } else if ((field[0] != mReplayWidth) || (field[1] != mReplayHeight) || (field[2] != maxval)) {
+            LOGE("%s(%d): pgm frame %d geometry changed, stop indexing",__FUNCTION__,__LINE__,mReplayFrames.size());
+            break;
+        }
+        frame_size = mReplayWidth*mReplayHeight*((maxval > 255) ? 2 : 1);
+        if ((pos + frame_size) > mReplaySize)
+            break;
+
+        frame.offset = pos;
+        frame.size = frame_size;
+        frame.timestamp_us = (int64_t)mReplayFrames.size()*1000000LL/fps;
+        mReplayFrames.push(frame);
+        pos += frame_size;
+    }
+
+    if (maxval > 255) {
+        mReplayFmt = V4L2_PIX_FMT_SBGGR16;
+        for (mReplayBitDepth = 9; (1 << mReplayBitDepth) <= maxval; mReplayBitDepth++);
+        mReplayRawMsbFirst = true;
+    } else {
+        mReplayFmt = V4L2_PIX_FMT_SBGGR8;
+        mReplayBitDepth = 8;
+    }
+    return 0;
+}
+
+int CameraReplayAdapter::replayOpen(const char* path)
+{
+    struct stat st;
+    char value[PROPERTY_VALUE_MAX];
+    int err = -1;
+
+    mReplayFd = open(path, O_RDONLY);
+    if (mReplayFd < 0) {
+        LOGE("%s(%d): open replay file %s failed, err: %s",__FUNCTION__,__LINE__,path,strerror(errno));
+        return -1;
+    }
+    if ((fstat(mReplayFd, &st) < 0) || (st.st_size == 0)) {
+        LOGE("%s(%d): replay file %s is empty",__FUNCTION__,__LINE__,path);
+        goto open_fail;
+    }
+    mReplaySize = st.st_size;
+    mReplayData = (unsigned char*)mmap(NULL, mReplaySize, PROT_READ, MAP_SHARED, mReplayFd, 0);
+    if (mReplayData == MAP_FAILED) {
+        LOGE("%s(%d): mmap replay file failed, err: %s",__FUNCTION__,__LINE__,strerror(errno));
+        mReplayData = NULL;
+        goto open_fail;
+    }
+    madvise(mReplayData, mReplaySize, MADV_SEQUENTIAL);
+
+    if ((mReplaySize >= sizeof(replay_file_header_t))
+        && (((replay_file_header_t*)mReplayData)->magic == CAMERA_REPLAY_MAGIC)) {
+        err = replayIndexContainer();
+    } else {
+        property_get(CAMERAHAL_REPLAYCAMERA_FMT_KEY, value, "nv12");
+        if (!strcmp(value, "mjpeg")) {
+            mReplayFmt = V4L2_PIX_FMT_MJPEG;
+            err = replayIndexMjpegStream();
+        } else if (!strcmp(value, "pgm")) {
+            err = replayIndexPgmStream();
+        } else if (!strcmp(value, "yuyv")) {
+            mReplayFmt = V4L2_PIX_FMT_YUYV;
+            err = replayIndexRawStream();
+        } else {
+            mReplayFmt = V4L2_PIX_FMT_NV12;
+            err = replayIndexRawStream();
+        }
+    }
+    if (err < 0)
+        goto open_fail;
+
+    if ((mReplayFrames.size() == 0) || (mReplayWidth <= 0) || (mReplayHeight <= 0)
+        || (mReplayWidth & 0x01) || (mReplayHeight & 0x01)) {
+        LOGE("%s(%d): replay file %s has no usable frame(%dx%d, %d frames)",__FUNCTION__,__LINE__,
+            path,mReplayWidth,mReplayHeight,mReplayFrames.size());
+        goto open_fail;
+    }
+    return 0;
+
+open_fail:
+    replayClose();
+    return -1;
+}
+
+void CameraReplayAdapter::replayClose()
+{
+    mReplayFrames.clear();
+    if (mReplayData) {
+        munmap(mReplayData, mReplaySize);
+        mReplayData = NULL;
+    }
+    mReplaySize = 0;
+    if (mReplayFd >= 0) {
+        close(mReplayFd);
+        mReplayFd = -1;
+    }
+}
+
+int CameraReplayAdapter::replayLoadMjpegDecoder()
+{
+    mLibstageLibHandle = dlopen("librk_vpuapi.so", RTLD_NOW);
+    if (mLibstageLibHandle == NULL) {
+        LOGE("%s(%d): open librk_vpuapi.so fail",__FUNCTION__,__LINE__);
+        return -1;
+    }
+    mMjpegDecoder.get = (getMjpegDecoderFun)dlsym(mLibstageLibHandle, "get_class_RkJpegDecoder");
+    mMjpegDecoder.destroy =(destroyMjpegDecoderFun)dlsym(mLibstageLibHandle, "destroy_class_RkJpegDecoder");
+    mMjpegDecoder.init = (initMjpegDecoderFun)dlsym(mLibstageLibHandle, "init_class_RkJpegDecoder");
+    mMjpegDecoder.deInit =(deInitMjpegDecoderFun)dlsym(mLibstageLibHandle, "deinit_class_RkJpegDecoder");
+    mMjpegDecoder.decode =(mjpegDecodeOneFrameFun)dlsym(mLibstageLibHandle, "dec_oneframe_RkJpegDecoder");
+    if ((mMjpegDecoder.get == NULL) || (mMjpegDecoder.destroy == NULL) || (mMjpegDecoder.init == NULL)
+        || (mMjpegDecoder.deInit == NULL) || (mMjpegDecoder.decode == NULL)) {
+        LOGE("%s(%d): dlsym RkJpegDecoder fail",__FUNCTION__,__LINE__);
+        goto load_fail;
+    }
+    mMjpegDecoder.decoder = mMjpegDecoder.get();
+    if (mMjpegDecoder.decoder == NULL) {
+        LOGE("%s(%d): get mjpeg decoder failed",__FUNCTION__,__LINE__);
+        goto load_fail;
+    }
+    mMjpegDecoder.state = mMjpegDecoder.init(mMjpegDecoder.decoder);
+    return mMjpegDecoder.state;
+
+load_fail:
+    dlclose(mLibstageLibHandle);
+    mLibstageLibHandle = NULL;
+    mMjpegDecoder.state = -1;
+    return -1;
+}
+
+int CameraReplayAdapter::cameraCreate(int cameraId)
+{
+    char value[PROPERTY_VALUE_MAX];
+
+    LOG_FUNCTION_NAME
+    property_get(CAMERAHAL_REPLAYCAMERA_PACE_KEY, value, "realtime");
+    mReplayAsap = !strcmp(value, "asap");
+    property_get(CAMERAHAL_REPLAYCAMERA_LOOP_KEY, value, "1");
+    mReplayLoop = (atoi(value) != 0);
+    property_get(CAMERAHAL_REPLAYCAMERA_FILE_KEY, value, CAMERAHAL_REPLAYCAMERA_FILE_VALUE);
+    if (replayOpen(value) < 0)
+        return -1;
+
+    if (mReplayFmt == V4L2_PIX_FMT_MJPEG) {
+        replayLoadMjpegDecoder();
+        mMjpegSwDecoder.init(0);
+    }
+
+    //frames are always delivered to the preview path as NV12
+    mCamDriverPreviewFmt = V4L2_PIX_FMT_NV12;
+    mCamDriverSupportFmt[0] = V4L2_PIX_FMT_NV12;
+    LOG_FUNCTION_NAME_EXIT
+    return 0;
+}
+
+int CameraReplayAdapter::cameraDestroy()
+{
+    replayClose();
+    return CameraAdapter::cameraDestroy();
+}
+
+}
@@ -0,0 +1,64 @@
+#ifndef ANDROID_HARDWARE_CAMERA_REPLAY_HARDWARE_H
+#define ANDROID_HARDWARE_CAMERA_REPLAY_HARDWARE_H
+
+//replay camera adapter: feed recorded frames through the normal preview path
+#include "CameraHal.h"
+#include "ReplayCameraFormat.h"
+
+namespace android{
+
+class CameraReplayAdapter: public CameraAdapter
+{
+public:
+    CameraReplayAdapter(int cameraId);
+    virtual ~CameraReplayAdapter();
+
+    virtual int setParameters(const CameraParameters &params_set,bool &isRestartValue);
+    virtual void initDefaultParameters(int camFd);
+    virtual int selectPreferedDrvSize(int *width,int * height,bool is_capture);
+    virtual int getFrame(FramInfo_s** frame);
+	virtual void dump(int cameraId);
+
+private:
+    virtual int cameraCreate(int cameraId);
+    virtual int cameraDestroy();
+    virtual int cameraSetSize(int w, int h, int fmt, bool is_capture);
+    virtual int adapterReturnFrame(long index,int cmd);
+    virtual int cameraStream(bool on);
+    virtual int cameraStart();
+    virtual int cameraStop();
+
+    int replayOpen(const char* path);
+    void replayClose();
+    int replayIndexContainer();
+    int replayIndexRawStream();
+    int replayIndexMjpegStream();
+    int replayIndexPgmStream();
+    int replayLoadMjpegDecoder();
+    void replayWaitFrameTime(const replay_frame_t& frame);
+    int replayConvertFrame(const replay_frame_t& frame, char* dst, long dst_phy, int dst_fd);
+    //bytes replayConvertFrame reads from one frame, 0: compressed
+    unsigned long replayFrameBytes();
+    void replayBayerToNV12(const unsigned char* src, char* dst);
+
+    int mReplayFd;
+    unsigned char* mReplayData;
+    unsigned long mReplaySize;
+    Vector<replay_frame_t> mReplayFrames;
+    unsigned int mReplayFmt;
+    int mReplayWidth;
+    int mReplayHeight;
+    int mReplayBayer;
+    int mReplayBitDepth;
+    bool mReplayRawMsbFirst;
+    bool mReplayAsap;
+    bool mReplayLoop;
+    unsigned int mReplayCursor;
+    nsecs_t mReplayBaseTime;
+    int64_t mReplayBaseStamp;
+    char* mReplayScratch;
+    unsigned int mReplayDropCount;
+};
+
+}
+#endif
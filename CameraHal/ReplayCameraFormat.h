@@ -0,0 +1,56 @@
+#ifndef ANDROID_HARDWARE_CAMERA_REPLAY_FORMAT_H
+#define ANDROID_HARDWARE_CAMERA_REPLAY_FORMAT_H
+
+//replay container and properties, shared by the replay adapter and offline tools
+#include <stdint.h>
+
+#define CAMERAHAL_REPLAYCAMERA_FILE_KEY    "sys_graphic.cam_hal.replayfile"
+#define CAMERAHAL_REPLAYCAMERA_FILE_VALUE  "/data/camera/replay.rkrp"
+#define CAMERAHAL_REPLAYCAMERA_PACE_KEY    "sys_graphic.cam_hal.replaypace"     /* realtime | asap */
+#define CAMERAHAL_REPLAYCAMERA_LOOP_KEY    "sys_graphic.cam_hal.replayloop"     /* 1: rewind at end of stream */
+#define CAMERAHAL_REPLAYCAMERA_IOMMU_KEY   "sys_graphic.cam_hal.replayiommu"    /* buffers for the virtual camera come from iommu heap */
+/* only used for headerless streams */
+#define CAMERAHAL_REPLAYCAMERA_FMT_KEY     "sys_graphic.cam_hal.replayfmt"      /* nv12 | yuyv | mjpeg | pgm */
+#define CAMERAHAL_REPLAYCAMERA_WIDTH_KEY   "sys_graphic.cam_hal.replaywidth"
+#define CAMERAHAL_REPLAYCAMERA_HEIGHT_KEY  "sys_graphic.cam_hal.replayheight"
+#define CAMERAHAL_REPLAYCAMERA_FPS_KEY     "sys_graphic.cam_hal.replayfps"
+#define CAMERAHAL_REPLAYCAMERA_BAYER_KEY   "sys_graphic.cam_hal.replaybayer"    /* bggr | gbrg | grbg | rggb */
+
+/*
+ * replay container layout (little endian):
+ *   replay_file_header_t
+ *   { replay_frame_header_t, payload[size] } * frame_count
+ * frame_count == 0 means "until end of file".
+ */
+#define CAMERA_REPLAY_MAGIC        0x50524b52      /* 'RKRP' */
+#define CAMERA_REPLAY_VERSION      1
+
+#define CAMERA_REPLAY_BAYER_BGGR   0
+#define CAMERA_REPLAY_BAYER_GBRG   1
+#define CAMERA_REPLAY_BAYER_GRBG   2
+#define CAMERA_REPLAY_BAYER_RGGB   3
+
+typedef struct replay_file_header_s {
+    unsigned int magic;
+    unsigned int version;
+    unsigned int fourcc;            /* V4L2_PIX_FMT_NV12/YUYV/MJPEG, SBGGR8/SBGGR16 for raw */
+    unsigned int width;
+    unsigned int height;
+    unsigned int frame_count;
+    unsigned int bayer_pattern;     /* raw only, CAMERA_REPLAY_BAYER_* */
+    unsigned int bit_depth;         /* raw only, significant bits per sample */
+} replay_file_header_t;
+
+typedef struct replay_frame_header_s {
+    int64_t timestamp_us;
+    unsigned int size;
+    unsigned int reserved;
+} replay_frame_header_t;
+
+typedef struct replay_frame_s {
+    unsigned long offset;
+    unsigned int size;
+    int64_t timestamp_us;
+} replay_frame_t;
+
+#endif
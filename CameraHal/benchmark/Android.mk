@@ -0,0 +1,29 @@
+#
+# camerahal_bench: end to end pipeline benchmark, drives the hal through the
+# replay camera with stub display/encoder/face sinks
+#
+LOCAL_PATH:= $(call my-dir)
+
+include $(CLEAR_VARS)
+LOCAL_SRC_FILES:= FaceDetectionStub.cpp
+LOCAL_MODULE:= libcam_facedetection_bench
+LOCAL_MODULE_TAGS:= optional
+include $(BUILD_SHARED_LIBRARY)
+
+include $(CLEAR_VARS)
+LOCAL_SRC_FILES:= CameraHalBench.cpp
+LOCAL_C_INCLUDES += \
+	frameworks/av/include \
+	frameworks/native/include \
+	hardware/libhardware/include \
+	system/media/camera/include
+LOCAL_SHARED_LIBRARIES:= \
+	libhardware \
+	libutils \
+	libcutils \
+	libui \
+	libcamera_client
+LOCAL_CFLAGS := -fno-short-enums
+LOCAL_MODULE:= camerahal_bench
+LOCAL_MODULE_TAGS:= optional
+include $(BUILD_EXECUTABLE)
@@ -0,0 +1,878 @@
+/*
+ * camerahal_bench: end to end pipeline benchmark for the camera hal.
+ *
+ * The hal is loaded through the normal camera module api with the replay camera
+ * (sys.cam_hal.type=replaycamera) as source, so every preview frame runs the
+ * real CameraAdapter -> DisplayAdapter/AppMsgNotifier fan-out. The sinks are
+ * stubs: a gralloc backed preview window, a callback/encoder sink that hands
+ * buffers straight back and a face detection library that reports one face.
+ *
+ * usage: camerahal_bench [-t seconds] [-s WxH[,WxH..]] [-p path[,path..]]
+ *                        [-f replay_file] [-r] [-k]
+ *   -t  measured seconds per path (default 5)
+ *   -s  resolutions (default 1280x720,1920x1080,3264x2448)
+ *   -p  paths: display,callback,video,jpeg,face (default all)
+ *   -f  use a recorded replay file instead of a generated one
+ *   -r  pace frames at their recorded rate instead of as fast as possible
+ *   -k  keep the board face detection library instead of the stub
+ *
+ * Latencies run from the capture time of a frame to its sink where the camera
+ * api carries one: the display gets it through set_timestamp and the video
+ * callback as its timestamp. A jpeg runs from take_picture. Preview callbacks
+ * and face reports have no capture time, their latency is -1. The cpu time is
+ * taken per hal thread, and the sink bytes are the frame bytes the hal wrote
+ * into the buffers of the stub sinks.
+ *
+ * Every result is printed as one "camerahal_bench:" line of key=value pairs,
+ * so runs on different commits can be diffed directly. Needs root for
+ * property_set.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <linux/videodev2.h>
+
+#include <hardware/hardware.h>
+#include <hardware/camera.h>
+#include <camera/CameraParameters.h>
+#include <cutils/properties.h>
+#include <ui/GraphicBuffer.h>
+#include <utils/Condition.h>
+#include <utils/Mutex.h>
+#include <utils/Timers.h>
+#include <utils/Vector.h>
+
+#include "../ReplayCameraFormat.h"
+
+using namespace android;
+
+#define BENCH_TAG                   "camerahal_bench"
+#define BENCH_FORMAT_VERSION        3
+#define BENCH_REPLAY_DIR            "/data/local/tmp"
+#define BENCH_REPLAY_FRAMES         4
+#define BENCH_REPLAY_INTERVAL_US    33333
+#define BENCH_WARMUP_MS             500
+#define BENCH_JPEG_TIMEOUT_MS       5000
+#define BENCH_WINDOW_BUF_MAX        16
+#define BENCH_FACE_LIB              "libcam_facedetection_bench.so"
+#define BENCH_STAMP_MAX_MS          10000   /* a capture time older than this is not a delay */
+#define BENCH_THREAD_MAX            128
+#define BENCH_STAGES_LEN            1024
+
+/* cpu clock of any thread of the process: CPUCLOCK_PERTHREAD | CPUCLOCK_SCHED of its tid */
+#define BENCH_THREAD_CPUCLOCK(tid)  ((clockid_t)((~(unsigned int)(tid) << 3) | 6))
+
+enum {
+    BENCH_PATH_DISPLAY = 0,
+    BENCH_PATH_CALLBACK,
+    BENCH_PATH_VIDEO,
+    BENCH_PATH_JPEG,
+    BENCH_PATH_FACE,
+    BENCH_PATH_MAX
+};
+
+static const char* gBenchPathName[BENCH_PATH_MAX] = {
+    "display", "callback", "video", "jpeg", "face"
+};
+
+/* samples are capture->sink delays, frames without a capture time count without one */
+typedef struct bench_stats_s {
+    Mutex lock;
+    bool measuring;
+    unsigned int frames;
+    uint64_t bytes;                     /* written into the sink buffers */
+    Vector<int64_t> samples;
+} bench_stats_t;
+
+typedef struct bench_thread_s {
+    pid_t tid;
+    char name[16];
+    nsecs_t cpu;
+} bench_thread_t;
+
+typedef struct bench_window_s {
+    preview_stream_ops_t ops;
+    Mutex lock;
+    int width;
+    int height;
+    int format;
+    int usage;
+    int count;
+    bool realloc;
+    sp<GraphicBuffer> bufs[BENCH_WINDOW_BUF_MAX];
+    bool dequeued[BENCH_WINDOW_BUF_MAX];
+    nsecs_t timestamp;                  /* set_timestamp for the next enqueue */
+} bench_window_t;
+
+typedef struct bench_memory_s {
+    camera_memory_t mem;
+    size_t size;
+    bool mapped;
+} bench_memory_t;
+
+static camera_device_t* gDev = NULL;
+static bench_window_t gWindow;
+static bench_stats_t gStats[BENCH_PATH_MAX];
+static bench_stats_t gDisplayStats;
+
+static Mutex gJpegLock;
+static Condition gJpegCond;
+static bool gJpegDone;
+static nsecs_t gJpegStart;
+static size_t gVideoFrameBytes;
+
+static void bench_stats_reset(bench_stats_t* stats, bool measuring)
+{
+    Mutex::Autolock lock(stats->lock);
+    stats->measuring = measuring;
+    stats->frames = 0;
+    stats->bytes = 0;
+    stats->samples.clear();
+}
+
+//capture: time the frame was captured, 0: unknown
+static void bench_stats_add(bench_stats_t* stats, nsecs_t now, nsecs_t capture, size_t bytes)
+{
+    Mutex::Autolock lock(stats->lock);
+    if (!stats->measuring)
+        return;
+    if ((capture > 0) && (capture <= now) && (now - capture < milliseconds_to_nanoseconds(BENCH_STAMP_MAX_MS)))
+        stats->samples.push(now - capture);
+    stats->frames++;
+    stats->bytes += bytes;
+}
+
+static int bench_cmp_int64(const void* a, const void* b)
+{
+    int64_t x = *(const int64_t*)a, y = *(const int64_t*)b;
+    return (x < y) ? -1 : ((x > y) ? 1 : 0);
+}
+
+//-1: no frame had a capture time
+static double bench_percentile_ms(Vector<int64_t>& sorted, int pct)
+{
+    if (sorted.size() == 0)
+        return -1.0;
+    return sorted[((sorted.size() - 1)*pct + 50)/100]/1000000.0;
+}
+
+//cpu time of every thread of the process, with its name
+static int bench_thread_snapshot(bench_thread_t* threads, int max)
+{
+    DIR* dir = opendir("/proc/self/task");
+    struct dirent* de;
+    struct timespec ts;
+    char path[64];
+    int fd,len,n = 0;
+
+    if (dir == NULL)
+        return 0;
+    while ((n < max) && ((de = readdir(dir)) != NULL)) {
+        bench_thread_t* t = &threads[n];
+
+        t->tid = atoi(de->d_name);
+        if (t->tid <= 0)
+            continue;
+        if (clock_gettime(BENCH_THREAD_CPUCLOCK(t->tid), &ts))
+            continue;
+        t->cpu = (nsecs_t)ts.tv_sec*1000000000LL + ts.tv_nsec;
+        strcpy(t->name, "unknown");
+        snprintf(path, sizeof(path), "/proc/self/task/%d/comm", t->tid);
+        fd = open(path, O_RDONLY);
+        if (fd >= 0) {
+            len = read(fd, t->name, sizeof(t->name) - 1);
+            if (len > 0) {
+                t->name[len] = 0;
+                for (len--; len >= 0; len--) {
+                    if ((t->name[len] == '\n') || (t->name[len] == ' ') || (t->name[len] == ','))
+                        t->name[len] = (t->name[len] == '\n') ? 0 : '_';
+                }
+            }
+            close(fd);
+        }
+        n++;
+    }
+    closedir(dir);
+    return n;
+}
+
+static int bench_cmp_thread(const void* a, const void* b)
+{
+    return strcmp(((const bench_thread_t*)a)->name, ((const bench_thread_t*)b)->name);
+}
+
+/*
+ * cpu each stage (hal thread name) spent between two snapshots. A thread
+ * started in between counts from zero, one that ended is lost with its time.
+ * Returns the sum, stages is sorted by name with one entry per name.
+ */
+static nsecs_t bench_thread_delta(const bench_thread_t* start, int start_num,
+                                  const bench_thread_t* end, int end_num,
+                                  bench_thread_t* stages, int* stage_num)
+{
+    nsecs_t sum = 0,cpu;
+    int i,j,n = 0;
+
+    for (i = 0; i < end_num; i++) {
+        cpu = end[i].cpu;
+        for (j = 0; j < start_num; j++) {
+            if (start[j].tid == end[i].tid) {
+                cpu -= start[j].cpu;
+                break;
+            }
+        }
+        for (j = 0; j < n; j++) {
+            if (!strcmp(stages[j].name, end[i].name))
+                break;
+        }
+        if (j == n) {
+            stages[n] = end[i];
+            stages[n].cpu = 0;
+            n++;
+        }
+        stages[j].cpu += cpu;
+        sum += cpu;
+    }
+    qsort(stages, n, sizeof(bench_thread_t), bench_cmp_thread);
+    *stage_num = n;
+    return sum;
+}
+
+/* ---------------- stub preview window ---------------- */
+
+static bench_window_t* bench_window(const struct preview_stream_ops* w)
+{
+    return (bench_window_t*)w;
+}
+
+static int bench_window_alloc_l(bench_window_t* win)
+{
+    int i;
+
+    for (i = 0; i < BENCH_WINDOW_BUF_MAX; i++) {
+        win->bufs[i].clear();
+        win->dequeued[i] = false;
+    }
+    for (i = 0; i < win->count; i++) {
+        win->bufs[i] = new GraphicBuffer(win->width, win->height, win->format,
+                                         win->usage | GRALLOC_USAGE_HW_TEXTURE);
+        if (win->bufs[i]->initCheck() != NO_ERROR) {
+            fprintf(stderr, "%s: preview buffer %dx%d fmt 0x%x alloc failed\n",
+                BENCH_TAG, win->width, win->height, win->format);
+            win->bufs[i].clear();
+            return -1;
+        }
+    }
+    win->realloc = false;
+    return 0;
+}
+
+static int bench_window_dequeue(struct preview_stream_ops* w, buffer_handle_t** buffer, int* stride)
+{
+    bench_window_t* win = bench_window(w);
+    Mutex::Autolock lock(win->lock);
+    int i;
+
+    if (win->realloc && bench_window_alloc_l(win))
+        return -ENOMEM;
+    for (i = 0; i < win->count; i++) {
+        if ((win->bufs[i] != NULL) && !win->dequeued[i]) {
+            win->dequeued[i] = true;
+            *buffer = &win->bufs[i]->handle;
+            *stride = win->bufs[i]->getStride();
+            return 0;
+        }
+    }
+    return -EBUSY;
+}
+
+static int bench_window_find_l(bench_window_t* win, buffer_handle_t* buffer)
+{
+    int i;
+
+    for (i = 0; i < win->count; i++) {
+        if ((win->bufs[i] != NULL) && (&win->bufs[i]->handle == buffer))
+            return i;
+    }
+    return -1;
+}
+
+//bytes the hal fills in one window buffer
+static size_t bench_window_frame_bytes(bench_window_t* win)
+{
+    switch (win->format) {
+    case HAL_PIXEL_FORMAT_RGB_565:
+        return win->width*win->height*2;
+    case HAL_PIXEL_FORMAT_RGBA_8888:
+    case HAL_PIXEL_FORMAT_RGBX_8888:
+    case HAL_PIXEL_FORMAT_BGRA_8888:
+        return win->width*win->height*4;
+    default:
+        return win->width*win->height*3/2;
+    }
+}
+
+static int bench_window_enqueue(struct preview_stream_ops* w, buffer_handle_t* buffer)
+{
+    bench_window_t* win = bench_window(w);
+    nsecs_t capture;
+    size_t bytes;
+    int index;
+    {
+        Mutex::Autolock lock(win->lock);
+        index = bench_window_find_l(win, buffer);
+        if (index < 0)
+            return -EINVAL;
+        //the stub display consumes the buffer immediately
+        win->dequeued[index] = false;
+        capture = win->timestamp;
+        win->timestamp = 0;
+        bytes = bench_window_frame_bytes(win);
+    }
+    nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+    bench_stats_add(&gDisplayStats, now, capture, bytes);
+    bench_stats_add(&gStats[BENCH_PATH_DISPLAY], now, capture, bytes);
+    return 0;
+}
+
+static int bench_window_cancel(struct preview_stream_ops* w, buffer_handle_t* buffer)
+{
+    bench_window_t* win = bench_window(w);
+    Mutex::Autolock lock(win->lock);
+    int index = bench_window_find_l(win, buffer);
+
+    if (index < 0)
+        return -EINVAL;
+    win->dequeued[index] = false;
+    return 0;
+}
+
+static int bench_window_set_buffer_count(struct preview_stream_ops* w, int count)
+{
+    bench_window_t* win = bench_window(w);
+    Mutex::Autolock lock(win->lock);
+
+    if ((count <= 0) || (count > BENCH_WINDOW_BUF_MAX))
+        return -EINVAL;
+    win->count = count;
+    win->realloc = true;
+    return 0;
+}
+
+static int bench_window_set_geometry(struct preview_stream_ops* w, int width, int height, int format)
+{
+    bench_window_t* win = bench_window(w);
+    Mutex::Autolock lock(win->lock);
+
+    win->width = width;
+    win->height = height;
+    win->format = format;
+    win->realloc = true;
+    return 0;
+}
+
+static int bench_window_set_crop(struct preview_stream_ops* w, int left, int top, int right, int bottom)
+{
+    return 0;
+}
+
+static int bench_window_set_usage(struct preview_stream_ops* w, int usage)
+{
+    bench_window_t* win = bench_window(w);
+    Mutex::Autolock lock(win->lock);
+
+    win->usage = usage;
+    win->realloc = true;
+    return 0;
+}
+
+static int bench_window_set_swap_interval(struct preview_stream_ops* w, int interval)
+{
+    return 0;
+}
+
+static int bench_window_get_min_undequeued(const struct preview_stream_ops* w, int* count)
+{
+    *count = 1;
+    return 0;
+}
+
+static int bench_window_lock(struct preview_stream_ops* w, buffer_handle_t* buffer)
+{
+    return 0;
+}
+
+static int bench_window_set_timestamp(struct preview_stream_ops* w, int64_t timestamp)
+{
+    bench_window_t* win = bench_window(w);
+    Mutex::Autolock lock(win->lock);
+
+    win->timestamp = timestamp;
+    return 0;
+}
+
+static void bench_window_init(bench_window_t* win)
+{
+    win->ops.dequeue_buffer = bench_window_dequeue;
+    win->ops.enqueue_buffer = bench_window_enqueue;
+    win->ops.cancel_buffer = bench_window_cancel;
+    win->ops.set_buffer_count = bench_window_set_buffer_count;
+    win->ops.set_buffers_geometry = bench_window_set_geometry;
+    win->ops.set_crop = bench_window_set_crop;
+    win->ops.set_usage = bench_window_set_usage;
+    win->ops.set_swap_interval = bench_window_set_swap_interval;
+    win->ops.get_min_undequeued_buffer_count = bench_window_get_min_undequeued;
+    win->ops.lock_buffer = bench_window_lock;
+    win->ops.set_timestamp = bench_window_set_timestamp;
+    win->width = 0;
+    win->height = 0;
+    win->format = 0;
+    win->usage = 0;
+    win->count = 0;
+    win->realloc = true;
+    win->timestamp = 0;
+}
+
+/* ---------------- stub client callbacks ---------------- */
+
+static void bench_release_memory(camera_memory_t* mem)
+{
+    bench_memory_t* m = (bench_memory_t*)mem->handle;
+
+    if (m->mapped)
+        munmap(m->mem.data, m->size);
+    else
+        free(m->mem.data);
+    delete m;
+}
+
+static camera_memory_t* bench_request_memory(int fd, size_t buf_size, unsigned int num_bufs, void* user)
+{
+    bench_memory_t* m = new bench_memory_t;
+
+    m->size = buf_size*num_bufs;
+    if (fd >= 0) {
+        m->mem.data = mmap(NULL, m->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        m->mapped = true;
+        if (m->mem.data == MAP_FAILED) {
+            delete m;
+            return NULL;
+        }
+    } else {
+        m->mem.data = malloc(m->size);
+        m->mapped = false;
+        if (m->mem.data == NULL) {
+            delete m;
+            return NULL;
+        }
+    }
+    m->mem.size = m->size;
+    m->mem.handle = m;
+    m->mem.release = bench_release_memory;
+    return &m->mem;
+}
+
+static void bench_notify(int32_t msg_type, int32_t ext1, int32_t ext2, void* user)
+{
+    if (msg_type == CAMERA_MSG_ERROR)
+        fprintf(stderr, "%s: hal error %d %d\n", BENCH_TAG, ext1, ext2);
+}
+
+static void bench_data(int32_t msg_type, const camera_memory_t* data, unsigned int index,
+                       camera_frame_metadata_t* metadata, void* user)
+{
+    nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+
+    switch (msg_type) {
+    case CAMERA_MSG_PREVIEW_FRAME:
+        //the callback data has no capture time
+        bench_stats_add(&gStats[BENCH_PATH_CALLBACK], now, 0, data ? data->size : 0);
+        break;
+    case CAMERA_MSG_COMPRESSED_IMAGE:
+        {
+            Mutex::Autolock lock(gJpegLock);
+            bench_stats_add(&gStats[BENCH_PATH_JPEG], now, gJpegStart, data ? data->size : 0);
+            gJpegDone = true;
+            gJpegCond.signal();
+        }
+        break;
+    case CAMERA_MSG_PREVIEW_METADATA:
+        //a face report carries no frame and no capture time
+        bench_stats_add(&gStats[BENCH_PATH_FACE], now, 0, 0);
+        break;
+    default:
+        break;
+    }
+}
+
+static void bench_data_timestamp(int64_t timestamp, int32_t msg_type, const camera_memory_t* data,
+                                 unsigned int index, void* user)
+{
+    nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+
+    if (msg_type != CAMERA_MSG_VIDEO_FRAME)
+        return;
+    //stub encoder: account the frame and hand it straight back, the hal fills a nv12 frame
+    bench_stats_add(&gStats[BENCH_PATH_VIDEO], now, timestamp, gVideoFrameBytes);
+    gDev->ops->release_recording_frame(gDev, data->data);
+}
+
+/* ---------------- replay source ---------------- */
+
+static int bench_write_replay_file(const char* path, int width, int height)
+{
+    replay_file_header_t header;
+    replay_frame_header_t frame_header;
+    unsigned int frame_size = width*height*3/2;
+    unsigned char* frame;
+    int fd,i,x,y,ret = -1;
+
+    fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        fprintf(stderr, "%s: open %s failed: %s\n", BENCH_TAG, path, strerror(errno));
+        return -1;
+    }
+    frame = (unsigned char*)malloc(frame_size);
+    if (frame == NULL)
+        goto write_end;
+
+    memset(&header, 0x00, sizeof(header));
+    header.magic = CAMERA_REPLAY_MAGIC;
+    header.version = CAMERA_REPLAY_VERSION;
+    header.fourcc = V4L2_PIX_FMT_NV12;
+    header.width = width;
+    header.height = height;
+    header.frame_count = BENCH_REPLAY_FRAMES;
+    if (write(fd, &header, sizeof(header)) != sizeof(header))
+        goto write_end;
+
+    for (i = 0; i < BENCH_REPLAY_FRAMES; i++) {
+        //moving gradient, so no two frames are identical
+        for (y = 0; y < height; y++) {
+            for (x = 0; x < width; x++)
+                frame[y*width + x] = (unsigned char)(x + y + i*16);
+        }
+        memset(frame + width*height, 0x80 + i, width*height/2);
+
+        frame_header.timestamp_us = (int64_t)i*BENCH_REPLAY_INTERVAL_US;
+        frame_header.size = frame_size;
+        frame_header.reserved = 0;
+        if ((write(fd, &frame_header, sizeof(frame_header)) != sizeof(frame_header))
+            || (write(fd, frame, frame_size) != (ssize_t)frame_size))
+            goto write_end;
+    }
+    ret = 0;
+
+write_end:
+    if (ret)
+        fprintf(stderr, "%s: write %s failed\n", BENCH_TAG, path);
+    free(frame);
+    close(fd);
+    return ret;
+}
+
+/* ---------------- paths ---------------- */
+
+static void bench_report(int width, int height, int path, nsecs_t wall, nsecs_t cpu,
+                         const bench_thread_t* stages, int stage_num)
+{
+    bench_stats_t* stats = &gStats[path];
+    Vector<int64_t> sorted;
+    unsigned int frames,disp_frames;
+    uint64_t bytes;
+    char stage_str[BENCH_STAGES_LEN];
+    int i,len = 0;
+
+    {
+        Mutex::Autolock lock(gDisplayStats.lock);
+        gDisplayStats.measuring = false;
+        disp_frames = gDisplayStats.frames;
+    }
+    {
+        Mutex::Autolock lock(stats->lock);
+        stats->measuring = false;
+        frames = stats->frames;
+        bytes = stats->bytes;
+        sorted = stats->samples;
+    }
+    qsort(sorted.editArray(), sorted.size(), sizeof(int64_t), bench_cmp_int64);
+
+    //stage=cpu ms per frame of each thread name that ran
+    stage_str[0] = 0;
+    for (i = 0; (i < stage_num) && (len < (int)sizeof(stage_str) - 1); i++) {
+        if (stages[i].cpu <= 0)
+            continue;
+        len += snprintf(stage_str + len, sizeof(stage_str) - len, "%s%s:%.3f", len ? "," : "",
+            stages[i].name, frames ? stages[i].cpu/1000000.0/frames : 0.0);
+    }
+
+    printf("%s: v=%d res=%dx%d path=%s frames=%u fps=%.2f latency_frames=%u p50_ms=%.3f p99_ms=%.3f "
+           "cpu_ms_per_frame=%.3f cpu_pct=%.1f sink_bytes_per_frame=%llu disp_fps=%.2f stages=%s\n",
+        BENCH_TAG, BENCH_FORMAT_VERSION, width, height, gBenchPathName[path], frames,
+        frames*1000000000.0/wall, (unsigned int)sorted.size(),
+        bench_percentile_ms(sorted, 50), bench_percentile_ms(sorted, 99),
+        frames ? cpu/1000000.0/frames : 0.0, cpu*100.0/wall,
+        frames ? (unsigned long long)(bytes/frames) : 0ULL,
+        disp_frames*1000000000.0/wall, stage_str[0] ? stage_str : "none");
+    fflush(stdout);
+}
+
+static int bench_run_path(int path, int seconds, int width, int height)
+{
+    static bench_thread_t start[BENCH_THREAD_MAX],end[BENCH_THREAD_MAX],stages[BENCH_THREAD_MAX];
+    nsecs_t wall,cpu,deadline;
+    int start_num,end_num,stage_num;
+    int ret = 0;
+
+    switch (path) {
+    case BENCH_PATH_CALLBACK:
+        gDev->ops->enable_msg_type(gDev, CAMERA_MSG_PREVIEW_FRAME);
+        break;
+    case BENCH_PATH_VIDEO:
+        gDev->ops->enable_msg_type(gDev, CAMERA_MSG_VIDEO_FRAME);
+        ret = gDev->ops->start_recording(gDev);
+        break;
+    case BENCH_PATH_JPEG:
+        gDev->ops->enable_msg_type(gDev, CAMERA_MSG_COMPRESSED_IMAGE);
+        break;
+    case BENCH_PATH_FACE:
+        gDev->ops->enable_msg_type(gDev, CAMERA_MSG_PREVIEW_METADATA);
+        ret = gDev->ops->send_command(gDev, CAMERA_CMD_START_FACE_DETECTION, CAMERA_FACE_DETECTION_SW, 0);
+        break;
+    default:
+        break;
+    }
+    if (ret) {
+        printf("%s: v=%d res=%dx%d path=%s error=%d\n", BENCH_TAG, BENCH_FORMAT_VERSION,
+            width, height, gBenchPathName[path], ret);
+        goto run_end;
+    }
+
+    usleep(BENCH_WARMUP_MS*1000);
+    bench_stats_reset(&gStats[path], true);
+    bench_stats_reset(&gDisplayStats, true);
+    start_num = bench_thread_snapshot(start, BENCH_THREAD_MAX);
+    wall = systemTime(SYSTEM_TIME_MONOTONIC);
+    deadline = wall + seconds_to_nanoseconds(seconds);
+
+    if (path == BENCH_PATH_JPEG) {
+        //one shot at a time, restart preview like the app does
+        while (systemTime(SYSTEM_TIME_MONOTONIC) < deadline) {
+            {
+                Mutex::Autolock lock(gJpegLock);
+                gJpegDone = false;
+                gJpegStart = systemTime(SYSTEM_TIME_MONOTONIC);
+            }
+            ret = gDev->ops->take_picture(gDev);
+            if (ret)
+                break;
+            {
+                Mutex::Autolock lock(gJpegLock);
+                while (!gJpegDone) {
+                    if (gJpegCond.waitRelative(gJpegLock, milliseconds_to_nanoseconds(BENCH_JPEG_TIMEOUT_MS))) {
+                        ret = -ETIMEDOUT;
+                        break;
+                    }
+                }
+            }
+            gDev->ops->start_preview(gDev);
+            if (ret)
+                break;
+        }
+    } else {
+        usleep(seconds*1000000);
+    }
+
+    wall = systemTime(SYSTEM_TIME_MONOTONIC) - wall;
+    end_num = bench_thread_snapshot(end, BENCH_THREAD_MAX);
+    cpu = bench_thread_delta(start, start_num, end, end_num, stages, &stage_num);
+    if (ret)
+        printf("%s: v=%d res=%dx%d path=%s error=%d\n", BENCH_TAG, BENCH_FORMAT_VERSION,
+            width, height, gBenchPathName[path], ret);
+    bench_report(width, height, path, wall, cpu, stages, stage_num);
+
+run_end:
+    switch (path) {
+    case BENCH_PATH_CALLBACK:
+        gDev->ops->disable_msg_type(gDev, CAMERA_MSG_PREVIEW_FRAME);
+        break;
+    case BENCH_PATH_VIDEO:
+        gDev->ops->stop_recording(gDev);
+        gDev->ops->disable_msg_type(gDev, CAMERA_MSG_VIDEO_FRAME);
+        break;
+    case BENCH_PATH_JPEG:
+        gDev->ops->disable_msg_type(gDev, CAMERA_MSG_COMPRESSED_IMAGE);
+        break;
+    case BENCH_PATH_FACE:
+        gDev->ops->send_command(gDev, CAMERA_CMD_STOP_FACE_DETECTION, 0, 0);
+        gDev->ops->disable_msg_type(gDev, CAMERA_MSG_PREVIEW_METADATA);
+        break;
+    default:
+        break;
+    }
+    return ret;
+}
+
+static int bench_run_resolution(camera_module_t* module, int width, int height,
+                                unsigned int paths, int seconds)
+{
+    CameraParameters params;
+    char* flat;
+    int ret,path,video_w,video_h;
+
+    ret = module->common.methods->open(&module->common, "0", (hw_device_t**)&gDev);
+    if (ret || (gDev == NULL)) {
+        fprintf(stderr, "%s: open camera 0 failed(%d)\n", BENCH_TAG, ret);
+        return -1;
+    }
+
+    bench_window_init(&gWindow);
+    gDev->ops->set_callbacks(gDev, bench_notify, bench_data, bench_data_timestamp,
+                             bench_request_memory, NULL);
+
+    flat = gDev->ops->get_parameters(gDev);
+    params.unflatten(String8(flat));
+    gDev->ops->put_parameters(gDev, flat);
+    if (width && height) {
+        params.setPreviewSize(width, height);
+        params.setPictureSize(width, height);
+        gDev->ops->set_parameters(gDev, params.flatten().string());
+    } else {
+        params.getPreviewSize(&width, &height);
+    }
+    //the hal records at the video size, at the preview size without one
+    flat = gDev->ops->get_parameters(gDev);
+    params.unflatten(String8(flat));
+    gDev->ops->put_parameters(gDev, flat);
+    params.getVideoSize(&video_w, &video_h);
+    if ((video_w <= 0) || (video_h <= 0)) {
+        video_w = width;
+        video_h = height;
+    }
+    gVideoFrameBytes = video_w*video_h*3/2;
+
+    ret = gDev->ops->set_preview_window(gDev, &gWindow.ops);
+    if (ret == 0)
+        ret = gDev->ops->start_preview(gDev);
+    if (ret) {
+        fprintf(stderr, "%s: start preview %dx%d failed(%d)\n", BENCH_TAG, width, height, ret);
+        goto resolution_end;
+    }
+
+    for (path = 0; path < BENCH_PATH_MAX; path++) {
+        if (paths & (1 << path))
+            bench_run_path(path, seconds, width, height);
+    }
+    gDev->ops->stop_preview(gDev);
+
+resolution_end:
+    gDev->ops->set_preview_window(gDev, NULL);
+    gDev->common.close(&gDev->common);
+    gDev = NULL;
+    {
+        Mutex::Autolock lock(gWindow.lock);
+        for (path = 0; path < BENCH_WINDOW_BUF_MAX; path++)
+            gWindow.bufs[path].clear();
+    }
+    return ret;
+}
+
+static unsigned int bench_parse_paths(const char* arg)
+{
+    unsigned int paths = 0;
+    int i;
+
+    for (i = 0; i < BENCH_PATH_MAX; i++) {
+        const char* p = strstr(arg, gBenchPathName[i]);
+        if (p && ((p == arg) || (p[-1] == ',')))
+            paths |= 1 << i;
+    }
+    return paths;
+}
+
+int main(int argc, char** argv)
+{
+    const char* sizes = "1280x720,1920x1080,3264x2448";
+    const char* replay_file = NULL;
+    unsigned int paths = (1 << BENCH_PATH_MAX) - 1;
+    int seconds = 5;
+    bool realtime = false,keep_face_lib = false;
+    char hal_type[PROPERTY_VALUE_MAX];
+    char hal_ver[PROPERTY_VALUE_MAX];
+    char path[PATH_MAX];
+    camera_module_t* module = NULL;
+    int opt,width,height,ret = 0;
+
+    while ((opt = getopt(argc, argv, "t:s:p:f:rk")) != -1) {
+        switch (opt) {
+        case 't': seconds = atoi(optarg); break;
+        case 's': sizes = optarg; break;
+        case 'p': paths = bench_parse_paths(optarg); break;
+        case 'f': replay_file = optarg; break;
+        case 'r': realtime = true; break;
+        case 'k': keep_face_lib = true; break;
+        default:
+            fprintf(stderr, "usage: %s [-t seconds] [-s WxH[,WxH..]] [-p display,callback,video,jpeg,face] "
+                "[-f replay_file] [-r] [-k]\n", argv[0]);
+            return -1;
+        }
+    }
+    if ((seconds <= 0) || (paths == 0)) {
+        fprintf(stderr, "%s: nothing to run\n", BENCH_TAG);
+        return -1;
+    }
+
+    property_get("sys.cam_hal.type", hal_type, "none");
+    property_set("sys.cam_hal.type", "replaycamera");
+    property_set(CAMERAHAL_REPLAYCAMERA_PACE_KEY, realtime ? "realtime" : "asap");
+    property_set(CAMERAHAL_REPLAYCAMERA_LOOP_KEY, "1");
+    if (!keep_face_lib)
+        property_set("sys_graphic.cam_hal.facelib", BENCH_FACE_LIB);
+
+    if (hw_get_module(CAMERA_HARDWARE_MODULE_ID, (const hw_module_t**)&module) || (module == NULL)) {
+        fprintf(stderr, "%s: load camera module failed\n", BENCH_TAG);
+        ret = -1;
+        goto main_end;
+    }
+    if (module->get_number_of_cameras() < 1) {
+        fprintf(stderr, "%s: replay camera not registered\n", BENCH_TAG);
+        ret = -1;
+        goto main_end;
+    }
+    property_get("sys_graphic.cam_hal.ver", hal_ver, "unknown");
+    printf("%s: v=%d hal=%s seconds=%d pace=%s face=%s\n", BENCH_TAG, BENCH_FORMAT_VERSION,
+        hal_ver, seconds, realtime ? "realtime" : "asap", keep_face_lib ? "board" : "stub");
+
+    if (replay_file) {
+        property_set(CAMERAHAL_REPLAYCAMERA_FILE_KEY, replay_file);
+        ret = bench_run_resolution(module, 0, 0, paths, seconds);
+    } else {
+        const char* s = sizes;
+        while (s && *s) {
+            if (sscanf(s, "%dx%d", &width, &height) == 2) {
+                snprintf(path, sizeof(path), "%s/%s_%dx%d.rkrp", BENCH_REPLAY_DIR, BENCH_TAG, width, height);
+                if (bench_write_replay_file(path, width, height) == 0) {
+                    property_set(CAMERAHAL_REPLAYCAMERA_FILE_KEY, path);
+                    ret |= bench_run_resolution(module, width, height, paths, seconds);
+                    unlink(path);
+                } else {
+                    ret = -1;
+                }
+            }
+            s = strchr(s, ',');
+            if (s)
+                s++;
+        }
+    }
+
+main_end:
+    property_set("sys.cam_hal.type", hal_type);
+    return ret ? 1 : 0;
+}
@@ -0,0 +1,75 @@
+/*
+ * Face detection stub for camerahal_bench.
+ * Exports the libcam_facedetection.so symbols, reads the luma plane the way a
+ * detector would and always reports one face in the centre of the frame, so the
+ * face path cost measured by the bench is the hal's own overhead.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "../FaceDetector.h"
+
+#define FACE_STUB_SAMPLE_STEP   16
+
+typedef struct face_stub_ctx_s {
+    int width;
+    int height;
+    unsigned int luma_sum;
+    struct RectFace face;
+} face_stub_ctx_t;
+
+extern "C" {
+
+void* FaceDetector_initizlize(int type, float threshold, int smileMode)
+{
+    return calloc(1, sizeof(face_stub_ctx_t));
+}
+
+void FaceDetector_destory(void *context)
+{
+    free(context);
+}
+
+void FaceDetector_start(void *context, int width, int height, int format)
+{
+    face_stub_ctx_t *ctx = (face_stub_ctx_t*)context;
+
+    ctx->width = width;
+    ctx->height = height;
+}
+
+void FaceDetector_stop(void *context)
+{
+}
+
+int FaceDetector_prepare(void *context, void* src)
+{
+    face_stub_ctx_t *ctx = (face_stub_ctx_t*)context;
+    unsigned char *y = (unsigned char*)src;
+    unsigned int sum = 0;
+    int i,j;
+
+    //the hal returns the frame right after prepare, so touch it here
+    for (j = 0; j < ctx->height; j += FACE_STUB_SAMPLE_STEP) {
+        for (i = 0; i < ctx->width; i += FACE_STUB_SAMPLE_STEP)
+            sum += y[j*ctx->width + i];
+    }
+    ctx->luma_sum = sum;
+    return 0;
+}
+
+int FaceDetector_findFaces(void *context, int orientation, float angle, int isDrawRect,
+                           int *smileMode, struct RectFace** faces, int* num)
+{
+    face_stub_ctx_t *ctx = (face_stub_ctx_t*)context;
+
+    ctx->face.width = ctx->width/4;
+    ctx->face.height = ctx->height/4;
+    ctx->face.x = (ctx->width - ctx->face.width)/2;
+    ctx->face.y = (ctx->height - ctx->face.height)/2;
+    *smileMode = 0;
+    *faces = &ctx->face;
+    *num = 1;
+    return 0;
+}
+
+}
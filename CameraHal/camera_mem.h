@@ -23,6 +23,12 @@ enum cam_mem_flag_e {
 	CAM_MEM_FLAG_SW_READ	= 0x8,
 };
 
+enum cam_mem_sync_dir_e {
+	CAM_MEM_SYNC_CPU_TO_DEV,	/* cpu wrote, device reads next */
+	CAM_MEM_SYNC_DEV_TO_CPU,	/* device wrote, cpu reads next */
+	CAM_MEM_SYNC_BIDIRECTIONAL,
+};
+
 typedef struct cam_mem_handle_s {
 	enum cam_mem_type_e mem_type;
 	int iommu_enabled;
@@ -59,6 +65,8 @@ typedef struct cam_mem_ops_s {
 	int (*flush_cache)(cam_mem_handle_t* handle,cam_mem_info_t* mem);
 	//deinit
 	int (*deInit)(cam_mem_handle_t* handle);
+	//sync cache of one buffer for a direction, appended so the isp lib layout is kept
+	int (*sync_cache)(cam_mem_handle_t* handle,cam_mem_info_t* mem,unsigned int offset,unsigned int len,enum cam_mem_sync_dir_e dir);
 }cam_mem_ops_t;
 
 
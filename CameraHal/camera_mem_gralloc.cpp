@@ -248,6 +248,12 @@ static int cam_mem_gralloc_ops_flush_cache(cam_mem_handle_t* handle,cam_mem_info
 	return 0;
 }
 
+//nothing to sync here, kept silent since it runs for every buffer handed over
+static int cam_mem_gralloc_ops_sync_cache(cam_mem_handle_t* handle,cam_mem_info_t* mem,unsigned int offset,unsigned int len,enum cam_mem_sync_dir_e dir)
+{
+	return 0;
+}
+
 //deinit
 static int cam_mem_gralloc_ops_deInit(cam_mem_handle_t* handle)
 {
@@ -528,6 +534,37 @@ static int cam_mem_gralloc_ops_flush_cache(cam_mem_handle_t* handle,cam_mem_info
 	return 0;
 }
 
+//sync cache of one buffer: START/END pair for the direction, no gralloc lock needed
+//since the buffer stays mapped from alloc. dma-buf syncs whole buffers, offset/len are ignored.
+static int cam_mem_gralloc_ops_sync_cache(cam_mem_handle_t* handle,cam_mem_info_t* mem,unsigned int offset,unsigned int len,enum cam_mem_sync_dir_e dir)
+{
+	struct dma_buf_sync sync_args;
+	__u64 rw;
+	int ret = 0;
+
+	if (!handle || !mem || (mem->fd < 0)) {
+		TRACE_E("%s:invalid mem handle!",__FUNCTION__);
+		return -1;
+	}
+
+	if (dir == CAM_MEM_SYNC_CPU_TO_DEV)
+		rw = DMA_BUF_SYNC_WRITE;
+	else if (dir == CAM_MEM_SYNC_DEV_TO_CPU)
+		rw = DMA_BUF_SYNC_READ;
+	else
+		rw = DMA_BUF_SYNC_RW;
+
+	sync_args.flags = DMA_BUF_SYNC_START | rw;
+	ret = ioctl(mem->fd, DMA_BUF_IOCTL_SYNC, &sync_args);
+	if (ret == 0) {
+		sync_args.flags = DMA_BUF_SYNC_END | rw;
+		ret = ioctl(mem->fd, DMA_BUF_IOCTL_SYNC, &sync_args);
+	}
+	if (ret != 0)
+		LOGE("%s: ret %d ,DMA_BUF_IOCTL_SYNC(dir %d) failed!", __func__, ret, dir);
+	return ret;
+}
+
 //deinit
 static int cam_mem_gralloc_ops_deInit(cam_mem_handle_t* handle)
 {
@@ -555,5 +592,6 @@ cam_mem_ops_t g_rk_gralloc_mem_ops {
 	.flush_cache = cam_mem_gralloc_ops_flush_cache,
 	//deinit
 	.deInit = cam_mem_gralloc_ops_deInit,
+	.sync_cache = cam_mem_gralloc_ops_sync_cache,
 };
 
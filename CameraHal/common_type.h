@@ -3,6 +3,17 @@
 //ĿǰֻCameraAdapterΪframe providerdisplayeventframe󣬿ͨ
 //bufferظCameraAdapter,CameraAdapterʵָýӿڡ
 
+//capture state of a frame, filled by its producer; 0: unknown, but lens_pos
+typedef struct cam_frame_meta
+{
+    long long timestamp;    /* ns, CLOCK_MONOTONIC at the start of the frame */
+    unsigned int sequence;  /* frame counter of the producer */
+    float exposure;         /* s */
+    float gain;
+    float awb_gain[4];      /* r, gr, gb, b */
+    int lens_pos;           /* focus position, -1: no lens motor or unknown */
+}cam_frame_meta_t;
+
 //֡Ϣwidthheightbufaddrfmt֡յ֡
 //zoomϢ
 typedef struct FramInfo
@@ -18,8 +29,48 @@ typedef struct FramInfo
     int frame_size;
     void* res;
     bool vir_addr_valid;
+    int y_stride;           /* bytes per Y line, 0: frame_width */
+    ulong_t uv_offset;      /* bytes from vir_addr/phy_addr to the UV plane, 0: right after Y */
+    cam_frame_meta_t meta;
 }FramInfo_s;
 
+//plane layout of a nv12 frame, consumers read the planes in place
+#define FRAME_Y_STRIDE(f)   ((f)->y_stride ? (f)->y_stride : (f)->frame_width)
+#define FRAME_UV_OFFSET(f)  ((f)->uv_offset ? (f)->uv_offset : (ulong_t)FRAME_Y_STRIDE(f)*(f)->frame_height)
+#define FRAME_IS_PACKED(f)  ((FRAME_Y_STRIDE(f) == (f)->frame_width) \
+                            && (FRAME_UV_OFFSET(f) == (ulong_t)(f)->frame_width*(f)->frame_height))
+
+//one plane of a frame, vir already points at its first pixel
+typedef struct cam_plane
+{
+    unsigned char* vir;     /* NULL: the buffer has no cpu mapping */
+    long offset;            /* bytes from the buffer start, for fd/phy users */
+    int stride;             /* bytes per line */
+}cam_plane_t;
+
+typedef struct cam_rect
+{
+    int left;
+    int top;
+    int width;              /* 0: the whole frame */
+    int height;
+}cam_rect_t;
+
+//where the pixels of a frame live, the conversion helpers read and write through it
+typedef struct cam_frame_desc
+{
+    int fmt;                /* V4L2_PIX_FMT_* */
+    int width;
+    int height;
+    long fd;                /* dma buf fd or phy address, -1: none */
+    int planes;
+    cam_plane_t plane[3];   /* nv12/nv21: y, uv; yuv420: y, u, v; packed formats: one */
+    cam_rect_t crop;        /* part of the frame a source is read from */
+}cam_frame_desc_t;
+
+#define DESC_CROP_W(d)      ((d)->crop.width ? (d)->crop.width : (d)->width)
+#define DESC_CROP_H(d)      ((d)->crop.height ? (d)->crop.height : (d)->height)
+
 typedef int (*func_displayCBForIsp)(void* frameinfo,void* cookie);
 
 #endif
@@ -36,6 +36,7 @@
 #include <ebase/types.h>
 #include <common/return_codes.h>
 #include <hal/hal_api.h>
+#include "isi_vcm.h"
 
 
 
@@ -81,13 +82,6 @@ extern "C"
 
 #define Sensor_SOFTWARE_RST                 (0x0103) // rw - Bit[7:1]not used  Bit[0]software_reset
 
-typedef struct Sensor_VcmInfo_s                 /* ddl@rock-chips.com: v0.3.0 */
-{
-    uint32_t StartCurrent;
-    uint32_t RatedCurrent;
-    uint32_t Step;
-    uint32_t StepMode;
-} Sensor_VcmInfo_t;
 
 typedef struct Sensor_Context_s
 {
@@ -124,7 +118,7 @@ typedef struct Sensor_Context_s
     uint32_t            OldFineIntegrationTime;
 
     IsiSensorMipiInfo   IsiSensorMipiInfo;
-	Sensor_VcmInfo_t    VcmInfo; 
+	IsiVcmContext_t     Vcm;
 	uint32_t			preview_minimum_framerate;
 } Sensor_Context_t;
 
@@ -69,10 +69,7 @@ CREATE_TRACER( Sensor_REG_DEBUG, "IMX214: ", INFO, 0U );
  * where 0 is the setting for infinity and 1023 for macro
  */
 #define MAX_LOG   64U
-#define MAX_REG 1023U
 
-#define MAX_VCMDRV_CURRENT      100U
-#define MAX_VCMDRV_REG          1023U
 
 
 /*!<
@@ -221,7 +218,6 @@ static RESULT Sensor_IsiCreateSensorIss
 )
 {
     RESULT result = RET_SUCCESS;
-	int32_t current_distance;
     Sensor_Context_t *pSensorCtx;
 
     TRACE( Sensor_INFO, "%s (enter)\n", __FUNCTION__);
@@ -262,13 +258,14 @@ static RESULT Sensor_IsiCreateSensorIss
     pSensorCtx->Streaming              = BOOL_FALSE;
     pSensorCtx->TestPattern            = BOOL_FALSE;
     pSensorCtx->isAfpsRun              = BOOL_FALSE;
-    /* ddl@rock-chips.com: v0.3.0 */
-    current_distance = pConfig->VcmRatedCurrent - pConfig->VcmStartCurrent;
-    current_distance = current_distance*MAX_VCMDRV_REG/MAX_VCMDRV_CURRENT;    
-    pSensorCtx->VcmInfo.Step = (current_distance+(MAX_LOG-1))/MAX_LOG;
-    pSensorCtx->VcmInfo.StartCurrent   = pConfig->VcmStartCurrent*MAX_VCMDRV_REG/MAX_VCMDRV_CURRENT;    
-    pSensorCtx->VcmInfo.RatedCurrent   = pSensorCtx->VcmInfo.StartCurrent + MAX_LOG*pSensorCtx->VcmInfo.Step;
-    pSensorCtx->VcmInfo.StepMode       = pConfig->VcmStepMode;  
+    result = IsiVcmInit( &pSensorCtx->Vcm, &pSensorCtx->IsiCtx, ISI_VCM_CHIP_DW9718, pConfig, MAX_LOG, 0U );
+    if ( result != RET_SUCCESS )
+    {
+        TRACE( Sensor_ERROR,  "%s: vcm init failed (%d)\n",  __FUNCTION__, result );
+        (void)HalDelRef( pConfig->HalHandle );
+        free ( pSensorCtx );
+        return ( result );
+    }
 
     pSensorCtx->IsiSensorMipiInfo.sensorHalDevID = pSensorCtx->IsiCtx.HalDevID;
     if(pConfig->mipiLaneNum & g_suppoted_mipi_lanenum_type)
@@ -1970,6 +1967,7 @@ static RESULT Sensor_IsiSensorSetPowerIss
 
     pSensorCtx->Configured = BOOL_FALSE;
     pSensorCtx->Streaming  = BOOL_FALSE;
+    IsiVcmInvalidate( &pSensorCtx->Vcm );
 
     result = HalSetPower( pSensorCtx->IsiCtx.HalHandle, pSensorCtx->IsiCtx.HalDevID, false );
     RETURN_RESULT_IF_DIFFERENT( RET_SUCCESS, result );
@@ -3758,11 +3756,7 @@ static RESULT Sensor_IsiMdiSetupMotoDrive
 )
 {
     Sensor_Context_t *pSensorCtx = (Sensor_Context_t *)handle;
-	uint32_t vcm_movefull_t;
-    RESULT result = RET_SUCCESS;
-	uint8_t data = 0;
-	
-    #if 1
+
     TRACE( Sensor_INFO, "%s: (enter)\n", __FUNCTION__);
 
     if ( pSensorCtx == NULL )
@@ -3770,55 +3764,7 @@ static RESULT Sensor_IsiMdiSetupMotoDrive
         return ( RET_WRONG_HANDLE );
     }
 
-    if ( pMaxStep == NULL )
-    {
-        return ( RET_NULL_POINTER );
-    }
-
-	//dw9718s
-	data = 0x00;
-	result = HalWriteI2CMem( pSensorCtx->IsiCtx.HalHandle,
-                             pSensorCtx->IsiCtx.I2cAfBusNum,
-                             pSensorCtx->IsiCtx.SlaveAfAddress,
-                             0x00,
-                             pSensorCtx->IsiCtx.NrOfAfAddressBytes,
-                             &data,
-                             1U );
-    RETURN_RESULT_IF_DIFFERENT( RET_SUCCESS, result );
-	
-	usleep(100);
-	
-	data = 0x39;
-	result = HalWriteI2CMem( pSensorCtx->IsiCtx.HalHandle,
-                             pSensorCtx->IsiCtx.I2cAfBusNum,
-                             pSensorCtx->IsiCtx.SlaveAfAddress,
-                             0x01,
-                             pSensorCtx->IsiCtx.NrOfAfAddressBytes,
-                             &data,
-                             1U );
-    RETURN_RESULT_IF_DIFFERENT( RET_SUCCESS, result );
-
-
-	data = 0x65;
-	result = HalWriteI2CMem( pSensorCtx->IsiCtx.HalHandle,
-                             pSensorCtx->IsiCtx.I2cAfBusNum,
-                             pSensorCtx->IsiCtx.SlaveAfAddress,
-                             0x05,
-                             pSensorCtx->IsiCtx.NrOfAfAddressBytes,
-                             &data,
-                             1U );
-    RETURN_RESULT_IF_DIFFERENT( RET_SUCCESS, result );
-	usleep(500);
-	
-	result = Sensor_IsiMdiFocusSet( handle, MAX_LOG);	
-	vcm_movefull_t = 50;
-	*pMaxStep = (MAX_LOG|(vcm_movefull_t<<16));
-
-    #endif
-
-
-    
-    return ( result );
+    return ( IsiVcmSetup( &pSensorCtx->Vcm, pMaxStep ) );
 }
 
 
@@ -3844,57 +3790,14 @@ static RESULT Sensor_IsiMdiFocusSet
     const uint32_t      Position
 )
 {
-	Sensor_Context_t *pSensorCtx = (Sensor_Context_t *)handle;
-
-    RESULT result = RET_SUCCESS;
-
-    
-    #if 1
-    uint32_t nPosition;
-    uint8_t  data[2] = { 0, 0 };
-
-    TRACE( Sensor_INFO, "%s: (enter)\n", __FUNCTION__);
+    Sensor_Context_t *pSensorCtx = (Sensor_Context_t *)handle;
 
     if ( pSensorCtx == NULL )
     {
-    	TRACE( Sensor_ERROR, "%s: pSensorCtx IS NULL\n", __FUNCTION__);
         return ( RET_WRONG_HANDLE );
     }
 
-	//TRACE( Sensor_ERROR, "%s: pSensorCtx Position (%d) max_position(%d)\n", __FUNCTION__,Position, MAX_LOG);
-    /* map 64 to 0 -> infinity */
-    //nPosition = ( Position >= MAX_LOG ) ? 0 : ( MAX_REG - (Position * 16U) );
-	if( Position > MAX_LOG ){
-		TRACE( Sensor_ERROR, "%s: pSensorCtx Position (%d) max_position(%d)\n", __FUNCTION__,Position, MAX_LOG);
-		//Position = MAX_LOG;
-	}
-	/* ddl@rock-chips.com: v0.3.0 */
-    if ( Position >= MAX_LOG )
-        nPosition = pSensorCtx->VcmInfo.StartCurrent;
-    else 
-        nPosition = pSensorCtx->VcmInfo.StartCurrent + (pSensorCtx->VcmInfo.Step*(MAX_LOG-Position));
-    /* ddl@rock-chips.com: v0.6.0 */
-    if (nPosition > MAX_VCMDRV_REG)  
-        nPosition = MAX_VCMDRV_REG;
-    
-	data[0] = (uint8_t)(0x00U | (( nPosition & 0xF00U ) >> 8U));                 
-	data[1] = (uint8_t)( nPosition & 0xFFU );
-
-    //TRACE( Sensor_ERROR, "%s:  dw9718s value = %d, 0x%02x 0x%02x af_addr(0x%x) bus(%d)\n", __FUNCTION__, nPosition, data[0], data[1],pSensorCtx->IsiCtx.SlaveAfAddress,pSensorCtx->IsiCtx.I2cAfBusNum );
-
-    result = HalWriteI2CMem( pSensorCtx->IsiCtx.HalHandle,
-                             pSensorCtx->IsiCtx.I2cAfBusNum,
-                             pSensorCtx->IsiCtx.SlaveAfAddress,
-                             0x02,
-                             pSensorCtx->IsiCtx.NrOfAfAddressBytes,
-                             data,
-                             2U );
-	RETURN_RESULT_IF_DIFFERENT( RET_SUCCESS, result );
-
-    TRACE( Sensor_INFO, "%s: (exit)\n", __FUNCTION__);
-    #endif
-    
-    return ( result );
+    return ( IsiVcmSet( &pSensorCtx->Vcm, Position ) );
 }
 
 
@@ -3923,63 +3826,12 @@ static RESULT Sensor_IsiMdiFocusGet
 {
     Sensor_Context_t *pSensorCtx = (Sensor_Context_t *)handle;
 
-    RESULT result = RET_SUCCESS;
-    uint8_t  data[2] = { 0, 0 };
-
-    #if 1
-    TRACE( Sensor_INFO, "%s: (enter)\n", __FUNCTION__);
-
     if ( pSensorCtx == NULL )
     {
         return ( RET_WRONG_HANDLE );
     }
 
-    if ( pAbsStep == NULL )
-    {
-        return ( RET_NULL_POINTER );
-    }
-
-	result = HalReadI2CMem( pSensorCtx->IsiCtx.HalHandle,
-					 pSensorCtx->IsiCtx.I2cAfBusNum,
-					 pSensorCtx->IsiCtx.SlaveAfAddress,
-					 0x02,
-					 pSensorCtx->IsiCtx.NrOfAfAddressBytes,
-					 &data[0],
-					 1U );
-    RETURN_RESULT_IF_DIFFERENT( RET_SUCCESS, result );
-
-
-	result = HalReadI2CMem( pSensorCtx->IsiCtx.HalHandle,
-						 pSensorCtx->IsiCtx.I2cAfBusNum,
-						 pSensorCtx->IsiCtx.SlaveAfAddress,
-						 0x03,
-						 pSensorCtx->IsiCtx.NrOfAfAddressBytes,
-						 &data[1],
-						 1U );
-	RETURN_RESULT_IF_DIFFERENT( RET_SUCCESS, result );
-	
-	*pAbsStep = ( ((uint32_t)(data[0] & 0x0F)) << 8U ) | ( ((uint32_t)data[1]) & 0xff);
-	TRACE( Sensor_ERROR, "%s: dw9718s value = 0x%02x 0x%02x\n", __FUNCTION__, data[0], data[1]);
-
-
-    /* map 0 to 64 -> infinity */	 /* ddl@rock-chips.com: v0.3.0 */
-	 if( *pAbsStep <= pSensorCtx->VcmInfo.StartCurrent)
-	 {
-		 *pAbsStep = MAX_LOG;
-	 }
-	 else if((*pAbsStep>pSensorCtx->VcmInfo.StartCurrent) && (*pAbsStep<=pSensorCtx->VcmInfo.RatedCurrent))
-	 {
-		 *pAbsStep = (pSensorCtx->VcmInfo.RatedCurrent - *pAbsStep ) / pSensorCtx->VcmInfo.Step;
-	 }
-	 else
-	 {
-		 *pAbsStep = 0;
-	 }
-	 
-    TRACE( Sensor_INFO, "%s: (exit)\n", __FUNCTION__);
-
-    #endif
-    return ( result );
+    return ( IsiVcmGet( &pSensorCtx->Vcm, pAbsStep ) );
 }
 
 
@@ -36,6 +36,7 @@
 #include <ebase/types.h>
 #include <common/return_codes.h>
 #include <hal/hal_api.h>
+#include "isi_vcm.h"
 
 
 
@@ -88,13 +89,6 @@ v0.7.0
 
 #define OV13850_SOFTWARE_RST                 (0x0103) // rw - Bit[7:1]not used  Bit[0]software_reset
 
-typedef struct OV13850_VcmInfo_s                 /* ddl@rock-chips.com: v0.3.0 */
-{
-    uint32_t StartCurrent;
-    uint32_t RatedCurrent;
-    uint32_t Step;
-    uint32_t StepMode;
-} OV13850_VcmInfo_t;
 
 typedef struct OV13850_Context_s
 {
@@ -131,7 +125,7 @@ typedef struct OV13850_Context_s
     uint32_t            OldFineIntegrationTime;
 
     IsiSensorMipiInfo   IsiSensorMipiInfo;
-	OV13850_VcmInfo_t    VcmInfo; 
+	IsiVcmContext_t     Vcm;
 	uint32_t			preview_minimum_framerate;
 } OV13850_Context_t;
 
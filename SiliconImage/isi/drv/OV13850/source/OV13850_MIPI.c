@@ -64,10 +64,7 @@ CREATE_TRACER( OV13850_REG_DEBUG, "OV13850: ", INFO, 0U );
  * where 0 is the setting for infinity and 1023 for macro
  */
 #define MAX_LOG   64U
-#define MAX_REG 1023U
 
-#define MAX_VCMDRV_CURRENT      100U
-#define MAX_VCMDRV_REG          1023U
 
 
 /*!<
@@ -216,7 +213,6 @@ static RESULT OV13850_IsiCreateSensorIss
 )
 {
     RESULT result = RET_SUCCESS;
-	int32_t current_distance;
     OV13850_Context_t *pOV13850Ctx;
 
     TRACE( OV13850_INFO, "%s (enter)\n", __FUNCTION__);
@@ -257,13 +253,14 @@ static RESULT OV13850_IsiCreateSensorIss
     pOV13850Ctx->Streaming              = BOOL_FALSE;
     pOV13850Ctx->TestPattern            = BOOL_FALSE;
     pOV13850Ctx->isAfpsRun              = BOOL_FALSE;
-    /* ddl@rock-chips.com: v0.3.0 */
-    current_distance = pConfig->VcmRatedCurrent - pConfig->VcmStartCurrent;
-    current_distance = current_distance*MAX_VCMDRV_REG/MAX_VCMDRV_CURRENT;    
-    pOV13850Ctx->VcmInfo.Step = (current_distance+(MAX_LOG-1))/MAX_LOG;
-    pOV13850Ctx->VcmInfo.StartCurrent   = pConfig->VcmStartCurrent*MAX_VCMDRV_REG/MAX_VCMDRV_CURRENT;    
-    pOV13850Ctx->VcmInfo.RatedCurrent   = pOV13850Ctx->VcmInfo.StartCurrent + MAX_LOG*pOV13850Ctx->VcmInfo.Step;
-    pOV13850Ctx->VcmInfo.StepMode       = pConfig->VcmStepMode;  
+    result = IsiVcmInit( &pOV13850Ctx->Vcm, &pOV13850Ctx->IsiCtx, ISI_VCM_CHIP_AD5820, pConfig, MAX_LOG, MDI_SLEW_RATE_CTRL );
+    if ( result != RET_SUCCESS )
+    {
+        TRACE( OV13850_ERROR,  "%s: vcm init failed (%d)\n",  __FUNCTION__, result );
+        (void)HalDelRef( pConfig->HalHandle );
+        free ( pOV13850Ctx );
+        return ( result );
+    }
 
     pOV13850Ctx->IsiSensorMipiInfo.sensorHalDevID = pOV13850Ctx->IsiCtx.HalDevID;
     if(pConfig->mipiLaneNum & g_suppoted_mipi_lanenum_type)
@@ -1729,6 +1726,7 @@ static RESULT OV13850_IsiSensorSetPowerIss
 
     pOV13850Ctx->Configured = BOOL_FALSE;
     pOV13850Ctx->Streaming  = BOOL_FALSE;
+    IsiVcmInvalidate( &pOV13850Ctx->Vcm );
 
     result = HalSetPower( pOV13850Ctx->IsiCtx.HalHandle, pOV13850Ctx->IsiCtx.HalDevID, false );
     RETURN_RESULT_IF_DIFFERENT( RET_SUCCESS, result );
@@ -3511,8 +3509,6 @@ static RESULT OV13850_IsiMdiSetupMotoDrive
 )
 {
     OV13850_Context_t *pOV13850Ctx = (OV13850_Context_t *)handle;
-	uint32_t vcm_movefull_t;
-    RESULT result = RET_SUCCESS;
 
     TRACE( OV13850_INFO, "%s: (enter)\n", __FUNCTION__);
 
@@ -3521,29 +3517,7 @@ static RESULT OV13850_IsiMdiSetupMotoDrive
         return ( RET_WRONG_HANDLE );
     }
 
-    if ( pMaxStep == NULL )
-    {
-        return ( RET_NULL_POINTER );
-    }
-    /* ddl@rock-chips.com: v0.3.0 */
-    if (pOV13850Ctx->VcmInfo.StepMode <= 7) {
-        vcm_movefull_t = 52*(1<<(pOV13850Ctx->VcmInfo.StepMode-1));
-    } else if ((pOV13850Ctx->VcmInfo.StepMode>=9) && (pOV13850Ctx->VcmInfo.StepMode<=15)) {
-        vcm_movefull_t = 2*(1<<(pOV13850Ctx->VcmInfo.StepMode-9));
-    } else {
-        TRACE( OV13850_ERROR, "%s: pOV8825Ctx->VcmInfo.StepMode: %d is invalidate!\n",__FUNCTION__, pOV13850Ctx->VcmInfo.StepMode);
-        DCT_ASSERT(0);
-    }
-
-    *pMaxStep = (MAX_LOG|(vcm_movefull_t<<16));
-
-//    *pMaxStep = MAX_LOG;
-
-    result = OV13850_IsiMdiFocusSet( handle, MAX_LOG );
-
-    TRACE( OV13850_INFO, "%s: (exit)\n", __FUNCTION__);
-
-    return ( result );
+    return ( IsiVcmSetup( &pOV13850Ctx->Vcm, pMaxStep ) );
 }
 
 
@@ -3569,55 +3543,14 @@ static RESULT OV13850_IsiMdiFocusSet
     const uint32_t      Position
 )
 {
-	OV13850_Context_t *pOV13850Ctx = (OV13850_Context_t *)handle;
-
-    RESULT result = RET_SUCCESS;
-
-    uint32_t nPosition;
-    uint8_t  data[2] = { 0, 0 };
-
-    TRACE( OV13850_INFO, "%s: (enter)\n", __FUNCTION__);
+    OV13850_Context_t *pOV13850Ctx = (OV13850_Context_t *)handle;
 
     if ( pOV13850Ctx == NULL )
     {
-    	TRACE( OV13850_ERROR, "%s: pOV13850Ctx IS NULL\n", __FUNCTION__);
         return ( RET_WRONG_HANDLE );
     }
 
-    /* map 64 to 0 -> infinity */
-    //nPosition = ( Position >= MAX_LOG ) ? 0 : ( MAX_REG - (Position * 16U) );
-	if( Position > MAX_LOG ){
-		TRACE( OV13850_ERROR, "%s: pOV13850Ctx Position (%d) max_position(%d)\n", __FUNCTION__,Position, MAX_LOG);
-		//Position = MAX_LOG;
-	}
-	/* ddl@rock-chips.com: v0.3.0 */
-    if ( Position >= MAX_LOG )
-        nPosition = pOV13850Ctx->VcmInfo.StartCurrent;
-    else 
-        nPosition = pOV13850Ctx->VcmInfo.StartCurrent + (pOV13850Ctx->VcmInfo.Step*(MAX_LOG-Position));
-    /* ddl@rock-chips.com: v0.6.0 */
-    if (nPosition > MAX_VCMDRV_REG)  
-        nPosition = MAX_VCMDRV_REG;
-
-    TRACE( OV13850_DEBUG, "%s: focus set position_reg_value(%d) position(%d) \n", __FUNCTION__, nPosition, Position);
-
-    data[0] = (uint8_t)(0x00U | (( nPosition & 0x3F0U ) >> 4U));                 // PD,  1, D9..D4, see AD5820 datasheet
-    data[1] = (uint8_t)( ((nPosition & 0x0FU) << 4U) | MDI_SLEW_RATE_CTRL );    // D3..D0, S3..S0
-
-    TRACE( OV13850_DEBUG, "%s: value = %d, 0x%02x 0x%02x af_addr(0x%x) bus(%d)\n", __FUNCTION__, nPosition, data[0], data[1],pOV13850Ctx->IsiCtx.SlaveAfAddress,pOV13850Ctx->IsiCtx.I2cAfBusNum );
-
-    result = HalWriteI2CMem( pOV13850Ctx->IsiCtx.HalHandle,
-                             pOV13850Ctx->IsiCtx.I2cAfBusNum,
-                             pOV13850Ctx->IsiCtx.SlaveAfAddress,
-                             0,
-                             pOV13850Ctx->IsiCtx.NrOfAfAddressBytes,
-                             data,
-                             2U );
-	RETURN_RESULT_IF_DIFFERENT( RET_SUCCESS, result );
-
-
-    TRACE( OV13850_INFO, "%s: (exit)\n", __FUNCTION__);
-    return ( result );
+    return ( IsiVcmSet( &pOV13850Ctx->Vcm, Position ) );
 }
 
 
@@ -3646,71 +3579,12 @@ static RESULT OV13850_IsiMdiFocusGet
 {
     OV13850_Context_t *pOV13850Ctx = (OV13850_Context_t *)handle;
 
-    RESULT result = RET_SUCCESS;
-    uint8_t  data[2] = { 0, 0 };
-
-
-    TRACE( OV13850_INFO, "%s: (enter)\n", __FUNCTION__);
-
     if ( pOV13850Ctx == NULL )
     {
         return ( RET_WRONG_HANDLE );
     }
 
-    if ( pAbsStep == NULL )
-    {
-        return ( RET_NULL_POINTER );
-    }
-
-    result = HalReadI2CMem( pOV13850Ctx->IsiCtx.HalHandle,
-                            pOV13850Ctx->IsiCtx.I2cAfBusNum,
-                            pOV13850Ctx->IsiCtx.SlaveAfAddress,
-                            0,
-                            pOV13850Ctx->IsiCtx.NrOfAfAddressBytes,
-                            data,
-                            2U );
-
-    RETURN_RESULT_IF_DIFFERENT( RET_SUCCESS, result );
-
-    TRACE( OV13850_DEBUG, "%s: value = 0x%02x 0x%02x\n", __FUNCTION__, data[0], data[1] );
-
-    /* Data[0] = PD,  1, D9..D4, see AD5820 datasheet */
-    /* Data[1] = D3..D0, S3..S0 */
-	#if 0
-    *pAbsStep = ( ((uint32_t)(data[0] & 0x3FU)) << 4U ) | ( ((uint32_t)data[1]) >> 4U );
-
-    /* map 0 to 64 -> infinity */
-    if( *pAbsStep == 0 )
-    {
-        *pAbsStep = MAX_LOG;
-    }
-    else
-    {
-        *pAbsStep = ( MAX_REG - *pAbsStep ) / 16U;
-    }
-	#endif
-	*pAbsStep = ( ((uint32_t)(data[0] & 0x3FU)) << 4U ) | ( ((uint32_t)data[1]) >> 4U );
-
-
-    /* map 0 to 64 -> infinity */   /* ddl@rock-chips.com: v0.3.0 */
-    if( *pAbsStep <= pOV13850Ctx->VcmInfo.StartCurrent)
-    {
-        *pAbsStep = MAX_LOG;
-    }
-    else if((*pAbsStep>pOV13850Ctx->VcmInfo.StartCurrent) && (*pAbsStep<=pOV13850Ctx->VcmInfo.RatedCurrent))
-    {
-        *pAbsStep = (pOV13850Ctx->VcmInfo.RatedCurrent - *pAbsStep ) / pOV13850Ctx->VcmInfo.Step;
-    }
-	else
-	{
-		*pAbsStep = 0;
-	}
-	
-
-    TRACE( OV13850_INFO, "%s: (exit)\n", __FUNCTION__);
-
-
-    return ( result );
+    return ( IsiVcmGet( &pOV13850Ctx->Vcm, pAbsStep ) );
 }
 
 
@@ -5,6 +5,7 @@
 #include <ebase/types.h>
 #include <common/return_codes.h>
 #include <hal/hal_api.h>
+#include "isi_vcm.h"
 
 
 
@@ -70,10 +71,13 @@ extern "C"
 *v1.0xa.0
 *   1). remove {0x0100,0x01} from 2A setting.
 *   2). correct OTP end address of 2A chip.
+*v1.0xb.0
+*   1). mode timing table built at create, fps change of a size only writes vts.
+*   2). OV8858_IsiGetAfpsInfoIss reads the mode timing table, no sensor access.
 */
 
 
-#define CONFIG_SENSOR_DRV_VERSION  KERNEL_VERSION(1, 0xa, 0)
+#define CONFIG_SENSOR_DRV_VERSION  KERNEL_VERSION(1, 0xb, 0)
 
 /*****************************************************************************
  * System control registers
@@ -103,16 +107,36 @@ extern "C"
 
 #define SENSOR_SPECIAL_TAG					(0xfefe5aa5)
 
+#define OV8858_TIMING_VTS_H                 (0x380e) // rw- Bit[7:0] frame length in lines[15:8]
+#define OV8858_TIMING_VTS_L                 (0x380f) // rw- Bit[7:0] frame length in lines[7:0]
+
 /*****************************************************************************
- * ov14825 context structure
+ * sensor mode timing
  *****************************************************************************/
-typedef struct OV8858_VcmInfo_s                 /* ddl@rock-chips.com: v0.3.0 */
+#define OV8858_MAX_MODES                    (12U)
+
+/* modes of one size share the size table and the pll, an fps step only changes vts */
+typedef struct OV8858_Mode_s
+{
+    uint32_t                    Resolution;
+    const IsiRegDescription_t   *pSizeRegs;         /**< written when the size changes */
+    const IsiRegDescription_t   *pSizeRegsR2A;      /**< NULL: pSizeRegs on R2A too */
+    uint16_t                    Hts;                /**< line length with blanking */
+    uint16_t                    Vts;                /**< frame length in lines */
+} OV8858_Mode_t;
+
+typedef struct OV8858_ModeTiming_s
 {
-    uint32_t StartCurrent;
-    uint32_t RatedCurrent;
-    uint32_t Step;
-    uint32_t StepMode;
-} OV8858_VcmInfo_t;
+    const OV8858_Mode_t *pMode;
+    uint32_t            Size;                   /**< index of the first mode of the same size */
+    float               VtPixClkFreq;           /**< 0: the pll of the size was not read yet */
+    float               LineTime;               /**< s, integration time increment */
+    float               MaxIntTime;             /**< s, vts - 4 lines */
+} OV8858_ModeTiming_t;
+
+/*****************************************************************************
+ * ov14825 context structure
+ *****************************************************************************/
 typedef struct OV8858_Context_s
 {
     IsiSensorContext_t  IsiCtx;                 /**< common context of ISI and ISI driver layer; @note: MUST BE FIRST IN DRIVER CONTEXT */
@@ -148,7 +172,9 @@ typedef struct OV8858_Context_s
     uint32_t            OldFineIntegrationTime;
 
     IsiSensorMipiInfo   IsiSensorMipiInfo;
-	OV8858_VcmInfo_t    VcmInfo;
+	IsiVcmContext_t     Vcm;
+    OV8858_ModeTiming_t ModeTiming[OV8858_MAX_MODES]; /**< modes of the configured lane count, built at create */
+    uint32_t            NumModes;
 	uint32_t			preview_minimum_framerate;
 } OV8858_Context_t;
 
@@ -69,10 +69,7 @@ CREATE_TRACER( OV8858_NOTICE1, "OV8858: ", TRACE_NOTICE1, 1U );
  * where 0 is the setting for infinity and 1023 for macro
  */
 #define MAX_LOG   64U
-#define MAX_REG 1023U
 
-#define MAX_VCMDRV_CURRENT      100U
-#define MAX_VCMDRV_REG          1023U
 
 
 
@@ -101,28 +98,10 @@ extern const IsiRegDescription_t OV8858_g_1632x1224_onelane[];
 extern const IsiRegDescription_t OV8858_g_1632x1224_twolane[];
 //extern const IsiRegDescription_t OV8858_g_1632x1224P20_twolane[];
 //extern const IsiRegDescription_t OV8858_g_1632x1224P10_twolane[];
-extern const IsiRegDescription_t OV8858_g_1632x1224P30_twolane_fpschg[];
-extern const IsiRegDescription_t OV8858_g_1632x1224P25_twolane_fpschg[];
-extern const IsiRegDescription_t OV8858_g_1632x1224P20_twolane_fpschg[];
-extern const IsiRegDescription_t OV8858_g_1632x1224P15_twolane_fpschg[];
-extern const IsiRegDescription_t OV8858_g_1632x1224P10_twolane_fpschg[];
 extern const IsiRegDescription_t OV8858_g_1632x1224_fourlane[];
-extern const IsiRegDescription_t OV8858_g_1632x1224P30_fourlane_fpschg[];
-extern const IsiRegDescription_t OV8858_g_1632x1224P25_fourlane_fpschg[];
-extern const IsiRegDescription_t OV8858_g_1632x1224P20_fourlane_fpschg[];
-extern const IsiRegDescription_t OV8858_g_1632x1224P15_fourlane_fpschg[];
-extern const IsiRegDescription_t OV8858_g_1632x1224P10_fourlane_fpschg[];
 extern const IsiRegDescription_t OV8858_g_3264x2448_onelane[];
 extern const IsiRegDescription_t OV8858_g_3264x2448_twolane[];
-extern const IsiRegDescription_t OV8858_g_3264x2448P15_twolane_fpschg[];
-extern const IsiRegDescription_t OV8858_g_3264x2448P7_twolane_fpschg[];
 extern const IsiRegDescription_t OV8858_g_3264x2448_fourlane[];
-extern const IsiRegDescription_t OV8858_g_3264x2448P30_fourlane_fpschg[];
-extern const IsiRegDescription_t OV8858_g_3264x2448P25_fourlane_fpschg[];
-extern const IsiRegDescription_t OV8858_g_3264x2448P20_fourlane_fpschg[];
-extern const IsiRegDescription_t OV8858_g_3264x2448P15_fourlane_fpschg[];
-extern const IsiRegDescription_t OV8858_g_3264x2448P10_fourlane_fpschg[];
-extern const IsiRegDescription_t OV8858_g_3264x2448P7_fourlane_fpschg[];
 
 //R2A
 extern const IsiRegDescription_t OV8858_g_aRegDescription_twolane_R2A[];
@@ -132,6 +111,39 @@ extern const IsiRegDescription_t OV8858_g_aRegDescription_fourlane_R2A[];
 extern const IsiRegDescription_t OV8858_g_3264x2448_fourlane_R2A[];
 extern const IsiRegDescription_t OV8858_g_1632x1224_fourlane_R2A[];
 
+/* per lane count, modes of one size together; the fpschg tables of a size only differ in vts */
+static const OV8858_Mode_t OV8858_g_aModes_onelane[] =
+{
+    { ISI_RES_1632_1224P15, OV8858_g_1632x1224_onelane,  NULL,                               0x0f10, 0x04dc },
+    { ISI_RES_3264_2448P7,  OV8858_g_3264x2448_onelane,  NULL,                               0x0f28, 0x09aa },
+};
+
+static const OV8858_Mode_t OV8858_g_aModes_twolane[] =
+{
+    { ISI_RES_1632_1224P30, OV8858_g_1632x1224_twolane,  OV8858_g_1632x1224_twolane_R2A,     0x0788, 0x04dc },
+    { ISI_RES_1632_1224P25, OV8858_g_1632x1224_twolane,  OV8858_g_1632x1224_twolane_R2A,     0x0788, 0x05d4 },
+    { ISI_RES_1632_1224P20, OV8858_g_1632x1224_twolane,  OV8858_g_1632x1224_twolane_R2A,     0x0788, 0x074a },
+    { ISI_RES_1632_1224P15, OV8858_g_1632x1224_twolane,  OV8858_g_1632x1224_twolane_R2A,     0x0788, 0x09b8 },
+    { ISI_RES_1632_1224P10, OV8858_g_1632x1224_twolane,  OV8858_g_1632x1224_twolane_R2A,     0x0788, 0x0e94 },
+    { ISI_RES_3264_2448P15, OV8858_g_3264x2448_twolane,  OV8858_g_3264x2448_twolane_R2A,     0x0794, 0x09aa },
+    { ISI_RES_3264_2448P7,  OV8858_g_3264x2448_twolane,  OV8858_g_3264x2448_twolane_R2A,     0x0794, 0x1354 },
+};
+
+static const OV8858_Mode_t OV8858_g_aModes_fourlane[] =
+{
+    { ISI_RES_1632_1224P30, OV8858_g_1632x1224_fourlane, OV8858_g_1632x1224_fourlane_R2A,    0x0788, 0x04dc },
+    { ISI_RES_1632_1224P25, OV8858_g_1632x1224_fourlane, OV8858_g_1632x1224_fourlane_R2A,    0x0788, 0x05d4 },
+    { ISI_RES_1632_1224P20, OV8858_g_1632x1224_fourlane, OV8858_g_1632x1224_fourlane_R2A,    0x0788, 0x074a },
+    { ISI_RES_1632_1224P15, OV8858_g_1632x1224_fourlane, OV8858_g_1632x1224_fourlane_R2A,    0x0788, 0x09b8 },
+    { ISI_RES_1632_1224P10, OV8858_g_1632x1224_fourlane, OV8858_g_1632x1224_fourlane_R2A,    0x0788, 0x0e94 },
+    { ISI_RES_3264_2448P30, OV8858_g_3264x2448_fourlane, OV8858_g_3264x2448_fourlane_R2A,    0x0794, 0x09aa },
+    { ISI_RES_3264_2448P25, OV8858_g_3264x2448_fourlane, OV8858_g_3264x2448_fourlane_R2A,    0x0794, 0x0b98 },
+    { ISI_RES_3264_2448P20, OV8858_g_3264x2448_fourlane, OV8858_g_3264x2448_fourlane_R2A,    0x0794, 0x0e7f },
+    { ISI_RES_3264_2448P15, OV8858_g_3264x2448_fourlane, OV8858_g_3264x2448_fourlane_R2A,    0x0794, 0x1354 },
+    { ISI_RES_3264_2448P10, OV8858_g_3264x2448_fourlane, OV8858_g_3264x2448_fourlane_R2A,    0x0794, 0x1cfe },
+    { ISI_RES_3264_2448P7,  OV8858_g_3264x2448_fourlane, OV8858_g_3264x2448_fourlane_R2A,    0x0794, 0x26a8 },
+};
+
 
 
 
@@ -819,6 +831,110 @@ static RESULT OV8858_IsiEnableOTP
 /* OTP END*/
 
 
+/*****************************************************************************/
+/**
+ *          OV8858_ModeTimingInit
+ *
+ * @brief   Builds the timing table of the configured lane count. The clock
+ *          dependent values are filled in by OV8858_ModeTimingSetClk once the
+ *          pll of a size was programmed and read back.
+ *
+ * @param   pOV8858Ctx      OV8858 context
+ *
+ *****************************************************************************/
+static void OV8858_ModeTimingInit
+(
+    OV8858_Context_t        *pOV8858Ctx
+)
+{
+    const OV8858_Mode_t *pModes;
+    uint32_t NumModes, i, j;
+
+    switch ( pOV8858Ctx->IsiSensorMipiInfo.ucMipiLanes )
+    {
+        case SUPPORT_MIPI_ONE_LANE:
+            pModes = OV8858_g_aModes_onelane;
+            NumModes = sizeof(OV8858_g_aModes_onelane) / sizeof(OV8858_g_aModes_onelane[0]);
+            break;
+        case SUPPORT_MIPI_FOUR_LANE:
+            pModes = OV8858_g_aModes_fourlane;
+            NumModes = sizeof(OV8858_g_aModes_fourlane) / sizeof(OV8858_g_aModes_fourlane[0]);
+            break;
+        case SUPPORT_MIPI_TWO_LANE:
+        default:
+            pModes = OV8858_g_aModes_twolane;
+            NumModes = sizeof(OV8858_g_aModes_twolane) / sizeof(OV8858_g_aModes_twolane[0]);
+            break;
+    }
+    DCT_ASSERT( NumModes <= OV8858_MAX_MODES );
+
+    for ( i = 0; i < NumModes; i++ )
+    {
+        OV8858_ModeTiming_t *pTiming = &pOV8858Ctx->ModeTiming[i];
+
+        pTiming->pMode = &pModes[i];
+        for ( j = 0; j < i; j++ )
+        {
+            if ( pModes[j].pSizeRegs == pModes[i].pSizeRegs )
+            {
+                break;
+            }
+        }
+        pTiming->Size         = j;
+        pTiming->VtPixClkFreq = 0.0f;
+        pTiming->LineTime     = 0.0f;
+        pTiming->MaxIntTime   = 0.0f;
+    }
+    pOV8858Ctx->NumModes = NumModes;
+}
+
+static OV8858_ModeTiming_t *OV8858_ModeTimingGet
+(
+    OV8858_Context_t        *pOV8858Ctx,
+    uint32_t                Resolution
+)
+{
+    uint32_t i;
+
+    for ( i = 0; i < pOV8858Ctx->NumModes; i++ )
+    {
+        if ( pOV8858Ctx->ModeTiming[i].pMode->Resolution == Resolution )
+        {
+            return ( &pOV8858Ctx->ModeTiming[i] );
+        }
+    }
+
+    return ( NULL );
+}
+
+/* all modes of a size run on the same pll */
+static void OV8858_ModeTimingSetClk
+(
+    OV8858_Context_t        *pOV8858Ctx,
+    uint32_t                Size,
+    float                   VtPixClkFreq
+)
+{
+    uint32_t i;
+
+    for ( i = 0; i < pOV8858Ctx->NumModes; i++ )
+    {
+        OV8858_ModeTiming_t *pTiming = &pOV8858Ctx->ModeTiming[i];
+
+        if ( pTiming->Size != Size )
+        {
+            continue;
+        }
+        pTiming->VtPixClkFreq = VtPixClkFreq;
+        if ( VtPixClkFreq != 0.0f )
+        {
+            pTiming->LineTime   = ((float)pTiming->pMode->Hts) / VtPixClkFreq;
+            pTiming->MaxIntTime = ((float)(pTiming->pMode->Vts - 4)) * pTiming->LineTime;
+        }
+    }
+}
+
+
 /*****************************************************************************/
 /**
  *          OV8858_IsiCreateSensorIss
@@ -839,7 +955,6 @@ static RESULT OV8858_IsiCreateSensorIss
 )
 {
     RESULT result = RET_SUCCESS;
-	int32_t current_distance;
     OV8858_Context_t *pOV8858Ctx;
 
     TRACE( OV8858_INFO, "%s (enter)\n", __FUNCTION__);
@@ -880,13 +995,14 @@ static RESULT OV8858_IsiCreateSensorIss
     pOV8858Ctx->Streaming              = BOOL_FALSE;
     pOV8858Ctx->TestPattern            = BOOL_FALSE;
     pOV8858Ctx->isAfpsRun              = BOOL_FALSE;
-    /* ddl@rock-chips.com: v0.3.0 */
-    current_distance = pConfig->VcmRatedCurrent - pConfig->VcmStartCurrent;
-    current_distance = current_distance*MAX_VCMDRV_REG/MAX_VCMDRV_CURRENT;    
-    pOV8858Ctx->VcmInfo.Step = (current_distance+(MAX_LOG-1))/MAX_LOG;
-    pOV8858Ctx->VcmInfo.StartCurrent   = pConfig->VcmStartCurrent*MAX_VCMDRV_REG/MAX_VCMDRV_CURRENT;    
-    pOV8858Ctx->VcmInfo.RatedCurrent   = pOV8858Ctx->VcmInfo.StartCurrent + MAX_LOG*pOV8858Ctx->VcmInfo.Step;
-    pOV8858Ctx->VcmInfo.StepMode       = pConfig->VcmStepMode;    
+    result = IsiVcmInit( &pOV8858Ctx->Vcm, &pOV8858Ctx->IsiCtx, ISI_VCM_CHIP_DW9714, pConfig, MAX_LOG, 0U );
+    if ( result != RET_SUCCESS )
+    {
+        TRACE( OV8858_ERROR,  "%s: vcm init failed (%d)\n",  __FUNCTION__, result );
+        (void)HalDelRef( pConfig->HalHandle );
+        free ( pOV8858Ctx );
+        return ( result );
+    }
 	
 	pOV8858Ctx->IsiSensorMipiInfo.sensorHalDevID = pOV8858Ctx->IsiCtx.HalDevID;
 	if(pConfig->mipiLaneNum & g_suppoted_mipi_lanenum_type)
@@ -895,6 +1011,7 @@ static RESULT OV8858_IsiCreateSensorIss
         TRACE( OV8858_ERROR, "%s don't support lane numbers :%d,set to default %d\n", __FUNCTION__,pConfig->mipiLaneNum,DEFAULT_NUM_LANES);
         pOV8858Ctx->IsiSensorMipiInfo.ucMipiLanes = DEFAULT_NUM_LANES;
     }
+    OV8858_ModeTimingInit( pOV8858Ctx );
 	
     pConfig->hSensor = ( IsiSensorHandle_t )pOV8858Ctx;
 
@@ -1543,275 +1660,60 @@ static RESULT OV8858_SetupOutputWindowInternal
 )
 {
     RESULT result     = RET_SUCCESS;
-    uint16_t usFrameLengthLines = 0;
-    uint16_t usLineLengthPck    = 0;
-	uint16_t usTimeHts;
-	uint16_t usTimeVts;
-    float    rVtPixClkFreq      = 0.0f;
+    OV8858_ModeTiming_t *pTiming;
+    const OV8858_Mode_t *pMode;
     int xclk = 2400;
     
 	TRACE( OV8858_INFO, "%s (enter)\n", __FUNCTION__);
-	
-	if(pOV8858Ctx->IsiSensorMipiInfo.ucMipiLanes == SUPPORT_MIPI_ONE_LANE){
-	
-		pOV8858Ctx->IsiSensorMipiInfo.ulMipiFreq = 720;
-		switch ( pConfig->Resolution )
-		{
-			case ISI_RES_1632_1224P15:
-			{				
-				if (set2Sensor == BOOL_TRUE) {
-				    TRACE( OV8858_NOTICE1, "%s(%d): Resolution 1632x1224\n", __FUNCTION__,__LINE__ );
-    				result = IsiRegDefaultsApply( pOV8858Ctx, OV8858_g_1632x1224_onelane);
-    				if ( result != RET_SUCCESS )
-    				{
-    					return ( result );
-    				}
-    		    }
-				usTimeHts = 0x0f10; //hkw
-				usTimeVts = 0x04dc;
-				/* sleep a while, that sensor can take over new default values */
-				osSleep( 10 );
-				break;
-				
-			}
-			
-			case ISI_RES_3264_2448P7:
-			{				
-				if (set2Sensor == BOOL_TRUE) {
-				    TRACE( OV8858_NOTICE1, "%s(%d): Resolution 3264x2448\n", __FUNCTION__,__LINE__ );
-    				result = IsiRegDefaultsApply( pOV8858Ctx, OV8858_g_3264x2448_onelane);
-    				if ( result != RET_SUCCESS )
-    				{
-    					return ( result );
-    				}
-                }
-				usTimeHts = 0x0f28;
-				usTimeVts = 0x09aa;
-				/* sleep a while, that sensor can take over new default values */
-				osSleep( 10 );
-				break;
-				
-			}
-	
-			default:
-			{
-				TRACE( OV8858_ERROR, "%s: Resolution not supported\n", __FUNCTION__ );
-				return ( RET_NOTSUPP );
-			}
-		}
-	} else if(pOV8858Ctx->IsiSensorMipiInfo.ucMipiLanes == SUPPORT_MIPI_TWO_LANE){
-
-        pOV8858Ctx->IsiSensorMipiInfo.ulMipiFreq = 720;
-    	switch ( pConfig->Resolution )
-        {
-            case ISI_RES_1632_1224P30:
-            case ISI_RES_1632_1224P25:
-            case ISI_RES_1632_1224P20:
-            case ISI_RES_1632_1224P15:
-            case ISI_RES_1632_1224P10:            
-            {
-                if (set2Sensor == BOOL_TRUE) {                    
-                    if (res_no_chg == BOOL_FALSE) {
-						if(g_sensor_version == OV8858_R2A)
-                        	result = IsiRegDefaultsApply( pOV8858Ctx, OV8858_g_1632x1224_twolane_R2A);
-						else
-							result = IsiRegDefaultsApply( pOV8858Ctx, OV8858_g_1632x1224_twolane);
-                    }
-     
-                    if (pConfig->Resolution == ISI_RES_1632_1224P30) {                        
-                        result = IsiRegDefaultsApply( pOV8858Ctx, OV8858_g_1632x1224P30_twolane_fpschg);
-                    } else if (pConfig->Resolution == ISI_RES_1632_1224P25) {
-                        result = IsiRegDefaultsApply( pOV8858Ctx, OV8858_g_1632x1224P25_twolane_fpschg);
-                    } else if (pConfig->Resolution == ISI_RES_1632_1224P20) {
-                        result = IsiRegDefaultsApply( pOV8858Ctx, OV8858_g_1632x1224P20_twolane_fpschg);
-                    } else if (pConfig->Resolution == ISI_RES_1632_1224P15) {
-                        result = IsiRegDefaultsApply( pOV8858Ctx, OV8858_g_1632x1224P15_twolane_fpschg);
-                    } else if (pConfig->Resolution == ISI_RES_1632_1224P10) {
-                        result = IsiRegDefaultsApply( pOV8858Ctx, OV8858_g_1632x1224P10_twolane_fpschg);
-                    }
-        		}
-
-    			if(g_sensor_version == OV8858_R2A)
-    			    usTimeHts = 0x0788; 
-    			else
-                    usTimeHts = 0x0788; 
-                    
-                if (pConfig->Resolution == ISI_RES_1632_1224P30) {
-                    usTimeVts = 0x04dc;
-                } else if (pConfig->Resolution == ISI_RES_1632_1224P25) {
-                    usTimeVts = 0x5d4;
-                } else if (pConfig->Resolution == ISI_RES_1632_1224P20) {
-                    usTimeVts = 0x074a;
-                } else if (pConfig->Resolution == ISI_RES_1632_1224P15) {
-                    usTimeVts = 0x9b8;
-                } else if (pConfig->Resolution == ISI_RES_1632_1224P10) {
-                    usTimeVts = 0x0e94;
-                }
-                
-    		    /* sleep a while, that sensor can take over new default values */
-    		    osSleep( 10 );
-    			break;
-                
-            }
 
-            case ISI_RES_3264_2448P7:
-            case ISI_RES_3264_2448P15:
-            {
-                if (set2Sensor == BOOL_TRUE) {
-                    if (res_no_chg == BOOL_FALSE) {
-						if(g_sensor_version == OV8858_R2A)
-        			    	result = IsiRegDefaultsApply( pOV8858Ctx, OV8858_g_3264x2448_twolane_R2A);
-						else
-							result = IsiRegDefaultsApply( pOV8858Ctx, OV8858_g_3264x2448_twolane);
-        		    }
-
-                    if (pConfig->Resolution == ISI_RES_3264_2448P15) {                        
-                        result = IsiRegDefaultsApply( pOV8858Ctx, OV8858_g_3264x2448P15_twolane_fpschg);
-                    } else if (pConfig->Resolution == ISI_RES_3264_2448P7) {
-                        result = IsiRegDefaultsApply( pOV8858Ctx, OV8858_g_3264x2448P7_twolane_fpschg);
-                    }
-        		    
-        		}
-        		
-    			usTimeHts = 0x0794;                
-                if (pConfig->Resolution == ISI_RES_3264_2448P15) {                        
-                    usTimeVts = 0x09aa;
-                } else if (pConfig->Resolution == ISI_RES_3264_2448P7) {
-                    usTimeVts = 0x1354;
-                }
-    		    /* sleep a while, that sensor can take over new default values */
-    		    osSleep( 10 );
-    			break;
-                
-            }
+    pOV8858Ctx->IsiSensorMipiInfo.ulMipiFreq = 720;
 
-            default:
-            {
-                TRACE( OV8858_ERROR, "%s: Resolution(0x%x) not supported\n", __FUNCTION__, pConfig->Resolution);
-                return ( RET_NOTSUPP );
-            }
-    	}
-    } else if(pOV8858Ctx->IsiSensorMipiInfo.ucMipiLanes == SUPPORT_MIPI_FOUR_LANE) {
-    	pOV8858Ctx->IsiSensorMipiInfo.ulMipiFreq = 720;
+    pTiming = OV8858_ModeTimingGet( pOV8858Ctx, pConfig->Resolution );
+    if ( pTiming == NULL )
+    {
+        TRACE( OV8858_ERROR, "%s: Resolution(0x%x) not supported\n", __FUNCTION__, pConfig->Resolution);
+        return ( RET_NOTSUPP );
+    }
+    pMode = pTiming->pMode;
 
-        switch ( pConfig->Resolution )
-        {
-            case ISI_RES_1632_1224P30:
-            case ISI_RES_1632_1224P25:
-            case ISI_RES_1632_1224P20:
-            case ISI_RES_1632_1224P15:
-            case ISI_RES_1632_1224P10:            
+    if (set2Sensor == BOOL_TRUE) {
+        if (res_no_chg == BOOL_FALSE) {
+            TRACE( OV8858_NOTICE1, "%s(%d): Resolution %dx%d\n", __FUNCTION__,__LINE__,
+                ISI_RES_W_GET(pConfig->Resolution), ISI_RES_H_GET(pConfig->Resolution) );
+            if ((g_sensor_version == OV8858_R2A) && (pMode->pSizeRegsR2A != NULL))
+                result = IsiRegDefaultsApply( pOV8858Ctx, pMode->pSizeRegsR2A);
+            else
+                result = IsiRegDefaultsApply( pOV8858Ctx, pMode->pSizeRegs);
+            if ( result != RET_SUCCESS )
             {
-                if (set2Sensor == BOOL_TRUE) {                    
-                    if (res_no_chg == BOOL_FALSE) {
-						if(g_sensor_version == OV8858_R2A)
-	                        result = IsiRegDefaultsApply( pOV8858Ctx, OV8858_g_1632x1224_fourlane_R2A);
-						else
-							result = IsiRegDefaultsApply( pOV8858Ctx, OV8858_g_1632x1224_fourlane);
-                    }
-     
-                    if (pConfig->Resolution == ISI_RES_1632_1224P30) {                        
-                        result = IsiRegDefaultsApply( pOV8858Ctx, OV8858_g_1632x1224P30_fourlane_fpschg);
-                    } else if (pConfig->Resolution == ISI_RES_1632_1224P25) {
-                        result = IsiRegDefaultsApply( pOV8858Ctx, OV8858_g_1632x1224P25_fourlane_fpschg);
-                    } else if (pConfig->Resolution == ISI_RES_1632_1224P20) {
-                        result = IsiRegDefaultsApply( pOV8858Ctx, OV8858_g_1632x1224P20_fourlane_fpschg);
-                    } else if (pConfig->Resolution == ISI_RES_1632_1224P15) {
-                        result = IsiRegDefaultsApply( pOV8858Ctx, OV8858_g_1632x1224P15_fourlane_fpschg);
-                    } else if (pConfig->Resolution == ISI_RES_1632_1224P10) {
-                        result = IsiRegDefaultsApply( pOV8858Ctx, OV8858_g_1632x1224P10_fourlane_fpschg);
-                    }
-        		}
-    			usTimeHts = 0x0788; 
-                if (pConfig->Resolution == ISI_RES_1632_1224P30) {
-                    usTimeVts = 0x04dc;
-                } else if (pConfig->Resolution == ISI_RES_1632_1224P25) {
-                    usTimeVts = 0x5d4;
-                } else if (pConfig->Resolution == ISI_RES_1632_1224P20) {
-                    usTimeVts = 0x074a;
-                } else if (pConfig->Resolution == ISI_RES_1632_1224P15) {
-                    usTimeVts = 0x9b8;
-                } else if (pConfig->Resolution == ISI_RES_1632_1224P10) {
-                    usTimeVts = 0x0e94;
-                }
-                
-    		    /* sleep a while, that sensor can take over new default values */
-    		    osSleep( 10 );
-    			break;
-                
+                return ( result );
             }
+            /* sleep a while, that sensor can take over new default values */
+            osSleep( 10 );
+        }
 
-            case ISI_RES_3264_2448P7:
-            case ISI_RES_3264_2448P10:
-            case ISI_RES_3264_2448P15:
-            case ISI_RES_3264_2448P20:
-            case ISI_RES_3264_2448P25:
-            case ISI_RES_3264_2448P30:
-            {
-                if (set2Sensor == BOOL_TRUE) {
-                    if (res_no_chg == BOOL_FALSE) {
-						if(g_sensor_version == OV8858_R2A)
-        			    	result = IsiRegDefaultsApply( pOV8858Ctx, OV8858_g_3264x2448_fourlane_R2A);
-						else
-							result = IsiRegDefaultsApply( pOV8858Ctx, OV8858_g_3264x2448_fourlane);
-        		    }
-
-                    if (pConfig->Resolution == ISI_RES_3264_2448P30) {                        
-                        result = IsiRegDefaultsApply( pOV8858Ctx, OV8858_g_3264x2448P30_fourlane_fpschg);
-                    } else if (pConfig->Resolution == ISI_RES_3264_2448P25) {                        
-                        result = IsiRegDefaultsApply( pOV8858Ctx, OV8858_g_3264x2448P25_fourlane_fpschg);
-                    } else if (pConfig->Resolution == ISI_RES_3264_2448P20) {                        
-                        result = IsiRegDefaultsApply( pOV8858Ctx, OV8858_g_3264x2448P20_fourlane_fpschg);
-                    } else if (pConfig->Resolution == ISI_RES_3264_2448P15) {                        
-                        result = IsiRegDefaultsApply( pOV8858Ctx, OV8858_g_3264x2448P15_fourlane_fpschg);
-                    } else if (pConfig->Resolution == ISI_RES_3264_2448P10) {                        
-                        result = IsiRegDefaultsApply( pOV8858Ctx, OV8858_g_3264x2448P10_fourlane_fpschg);
-                    } else if (pConfig->Resolution == ISI_RES_3264_2448P7) {
-                        result = IsiRegDefaultsApply( pOV8858Ctx, OV8858_g_3264x2448P7_fourlane_fpschg);
-                    }
-        		    
-        		}
-        		
-    			usTimeHts = 0x0794;                
-                if (pConfig->Resolution == ISI_RES_3264_2448P30) {                        
-                    usTimeVts = 0x09aa;
-                } else if (pConfig->Resolution == ISI_RES_3264_2448P25) {                        
-                    usTimeVts = 0x0b98;
-                } else if (pConfig->Resolution == ISI_RES_3264_2448P20) {                        
-                    usTimeVts = 0x0e7f;
-                } else if (pConfig->Resolution == ISI_RES_3264_2448P15) {                        
-                    usTimeVts = 0x1354;
-                } else if (pConfig->Resolution == ISI_RES_3264_2448P10) {                        
-                    usTimeVts = 0x1cfe;
-                } else if (pConfig->Resolution == ISI_RES_3264_2448P7) {
-                    usTimeVts = 0x26a8;
-                }
-    		    /* sleep a while, that sensor can take over new default values */
-    		    osSleep( 10 );
-    			break;
-                
-            }
-        }        
+        /* fps step within the size */
+        result = OV8858_IsiRegWriteIss( pOV8858Ctx, OV8858_TIMING_VTS_H, (pMode->Vts >> 8U) & 0xffU );
+        RETURN_RESULT_IF_DIFFERENT( RET_SUCCESS, result );
+        result = OV8858_IsiRegWriteIss( pOV8858Ctx, OV8858_TIMING_VTS_L, pMode->Vts & 0xffU );
+        RETURN_RESULT_IF_DIFFERENT( RET_SUCCESS, result );
 
+        /* the pll only changes with the size table */
+        if ((res_no_chg == BOOL_FALSE) || (pTiming->VtPixClkFreq == 0.0f)) {
+            OV8858_ModeTimingSetClk( pOV8858Ctx, pTiming->Size, OV8858_get_PCLK(pOV8858Ctx, xclk) );
+        }
     }
-    
-	
-/* 2.) write default values derived from datasheet and evaluation kit (static setup altered by dynamic setup further below) */
-    
-	usLineLengthPck = usTimeHts;
-    usFrameLengthLines = usTimeVts;
-	rVtPixClkFreq = OV8858_get_PCLK(pOV8858Ctx, xclk);
-    
+
     // store frame timing for later use in AEC module
-    pOV8858Ctx->VtPixClkFreq     = rVtPixClkFreq;
-    pOV8858Ctx->LineLengthPck    = usLineLengthPck;
-    pOV8858Ctx->FrameLengthLines = usFrameLengthLines;
+    pOV8858Ctx->VtPixClkFreq     = pTiming->VtPixClkFreq;
+    pOV8858Ctx->LineLengthPck    = pMode->Hts;
+    pOV8858Ctx->FrameLengthLines = pMode->Vts;
 
     TRACE( OV8858_INFO, "%s  (exit): Resolution %dx%d@%dfps  MIPI %dlanes  res_no_chg: %d   rVtPixClkFreq: %f\n", __FUNCTION__,
                         ISI_RES_W_GET(pConfig->Resolution),ISI_RES_H_GET(pConfig->Resolution),
                         ISI_FPS_GET(pConfig->Resolution),
                         pOV8858Ctx->IsiSensorMipiInfo.ucMipiLanes,
-                        res_no_chg,rVtPixClkFreq);
+                        res_no_chg,pTiming->VtPixClkFreq);
     
     return ( result );
 }
@@ -2474,6 +2376,7 @@ static RESULT OV8858_IsiSensorSetPowerIss
 
     pOV8858Ctx->Configured = BOOL_FALSE;
     pOV8858Ctx->Streaming  = BOOL_FALSE;
+    IsiVcmInvalidate( &pOV8858Ctx->Vcm );
 
     TRACE( OV8858_DEBUG, "%s power off \n", __FUNCTION__);
     result = HalSetPower( pOV8858Ctx->IsiCtx.HalHandle, pOV8858Ctx->IsiCtx.HalDevID, false );
@@ -3455,7 +3358,8 @@ static RESULT OV8858_IsiGetAfpsInfoHelperIss(
     uint32_t            AfpsStageIdx
 )
 {
-    RESULT result = RET_SUCCESS;
+    const OV8858_ModeTiming_t *pTiming;
+    float MaxIntTime;
 
     TRACE( OV8858_INFO, "%s: (enter)\n", __FUNCTION__);
 
@@ -3463,36 +3367,39 @@ static RESULT OV8858_IsiGetAfpsInfoHelperIss(
     DCT_ASSERT(pAfpsInfo != NULL);
     DCT_ASSERT(AfpsStageIdx <= ISI_NUM_AFPS_STAGES);
 
-    // update resolution in copy of config in context
-    pOV8858Ctx->Config.Resolution = Resolution;
-
-    // tell sensor about that
-    result = OV8858_SetupOutputWindowInternal( pOV8858Ctx, &pOV8858Ctx->Config,BOOL_FALSE,BOOL_FALSE );
-    if ( result != RET_SUCCESS )
+    pTiming = OV8858_ModeTimingGet( pOV8858Ctx, Resolution );
+    if ( pTiming == NULL )
     {
-        TRACE( OV8858_ERROR, "%s: SetupOutputWindow failed for resolution ID %08x.\n", __FUNCTION__, Resolution);
-        return ( result );
+        TRACE( OV8858_ERROR, "%s: no timing for resolution ID %08x.\n", __FUNCTION__, Resolution);
+        return ( RET_NOTSUPP );
     }
 
-    // update limits & stuff (reset current & old settings)
-    result = OV8858_AecSetModeParameters( pOV8858Ctx, &pOV8858Ctx->Config );
-    if ( result != RET_SUCCESS )
+    if ( pTiming->VtPixClkFreq != 0.0f )
     {
-        TRACE( OV8858_ERROR, "%s: AecSetModeParameters failed for resolution ID %08x.\n", __FUNCTION__, Resolution);
-        return ( result );
+        MaxIntTime = pTiming->MaxIntTime;
+    }
+    else if ( pOV8858Ctx->VtPixClkFreq != 0.0f )
+    {
+        // size not programmed yet, assume the pll of the current mode
+        MaxIntTime = ( ((float)(pTiming->pMode->Vts - 4)) * ((float)pTiming->pMode->Hts) ) / pOV8858Ctx->VtPixClkFreq;
+    }
+    else
+    {
+        TRACE( OV8858_ERROR, "%s: Division by zero!\n", __FUNCTION__ );
+        return ( RET_OUTOFRANGE );
     }
 
     // take over params
     pAfpsInfo->Stage[AfpsStageIdx].Resolution = Resolution;
-    pAfpsInfo->Stage[AfpsStageIdx].MaxIntTime = pOV8858Ctx->AecMaxIntegrationTime;
+    pAfpsInfo->Stage[AfpsStageIdx].MaxIntTime = MaxIntTime;
     pAfpsInfo->AecMinGain           = pOV8858Ctx->AecMinGain;
     pAfpsInfo->AecMaxGain           = pOV8858Ctx->AecMaxGain;
     pAfpsInfo->AecMinIntTime        = pOV8858Ctx->AecMinIntegrationTime;
-    pAfpsInfo->AecMaxIntTime        = pOV8858Ctx->AecMaxIntegrationTime;
+    pAfpsInfo->AecMaxIntTime        = MaxIntTime;
     pAfpsInfo->AecSlowestResolution = Resolution;
     TRACE( OV8858_INFO, "%s: (exit)\n", __FUNCTION__);
 
-    return ( result );
+    return ( RET_SUCCESS );
 }
 
 /*****************************************************************************/
@@ -3552,21 +3459,9 @@ RESULT OV8858_IsiGetAfpsInfoIss(
     pAfpsInfo->CurrMinIntTime = pOV8858Ctx->AecMinIntegrationTime;
     pAfpsInfo->CurrMaxIntTime = pOV8858Ctx->AecMaxIntegrationTime;
 
-    // allocate dummy context used for Afps parameter calculation as a copy of current context
-    OV8858_Context_t *pDummyCtx = (OV8858_Context_t*) malloc( sizeof(OV8858_Context_t) );
-    if ( pDummyCtx == NULL )
-    {
-        TRACE( OV8858_ERROR,  "%s: Can't allocate dummy OV8858 context\n",  __FUNCTION__ );
-        return ( RET_OUTOFMEM );
-    }
-    *pDummyCtx = *pOV8858Ctx;
-
-    // set AFPS mode in dummy context
-    pDummyCtx->isAfpsRun = BOOL_TRUE;
-
 #define AFPSCHECKANDADD(_res_) \
     { \
-        RESULT lres = OV8858_IsiGetAfpsInfoHelperIss( pDummyCtx, _res_, pAfpsInfo, idx); \
+        RESULT lres = OV8858_IsiGetAfpsInfoHelperIss( pOV8858Ctx, _res_, pAfpsInfo, idx); \
         if ( lres == RET_SUCCESS ) \
         { \
             ++idx; \
@@ -3700,9 +3595,6 @@ RESULT OV8858_IsiGetAfpsInfoIss(
 
     }
 
-    // release dummy context again
-    free(pDummyCtx);
-
     TRACE( OV8858_INFO, "%s: (exit)\n", __FUNCTION__);
 
     return ( result );
@@ -4334,35 +4226,15 @@ static RESULT OV8858_IsiMdiSetupMotoDrive
 )
 {
     OV8858_Context_t *pOV8858Ctx = (OV8858_Context_t *)handle;
-	uint32_t vcm_movefull_t;
-    RESULT result = RET_SUCCESS;
 
-    //TRACE( OV8858_ERROR, "%s: (enter)\n", __FUNCTION__);
+    TRACE( OV8858_INFO, "%s: (enter)\n", __FUNCTION__);
 
     if ( pOV8858Ctx == NULL )
     {
         return ( RET_WRONG_HANDLE );
     }
 
-    if ( pMaxStep == NULL )
-    {
-        return ( RET_NULL_POINTER );
-    }
- if ((pOV8858Ctx->VcmInfo.StepMode & 0x0c) != 0) {
- 	vcm_movefull_t = 64* (1<<(pOV8858Ctx->VcmInfo.StepMode & 0x03)) *1024/((1 << (((pOV8858Ctx->VcmInfo.StepMode & 0x0c)>>2)-1))*1000);
- }else{
- 	vcm_movefull_t =64*1023/1000;
-   TRACE( OV8858_ERROR, "%s: (---NO SRC---)\n", __FUNCTION__);
- }
- 
-	  *pMaxStep = (MAX_LOG|(vcm_movefull_t<<16));
-   // *pMaxStep = MAX_LOG;
-
-    result = OV8858_IsiMdiFocusSet( handle, MAX_LOG );
-
-    //TRACE( OV8858_ERROR, "%s: (exit)\n", __FUNCTION__);
-
-    return ( result );
+    return ( IsiVcmSetup( &pOV8858Ctx->Vcm, pMaxStep ) );
 }
 
 
@@ -4390,51 +4262,12 @@ static RESULT OV8858_IsiMdiFocusSet
 {
     OV8858_Context_t *pOV8858Ctx = (OV8858_Context_t *)handle;
 
-    RESULT result = RET_SUCCESS;
-
-    uint32_t nPosition;
-    uint8_t  data[2] = { 0, 0 };
-
-    //TRACE( OV8858_ERROR, "%s: (enter)\n", __FUNCTION__);
-
     if ( pOV8858Ctx == NULL )
     {
         return ( RET_WRONG_HANDLE );
     }
 
-    /* map 64 to 0 -> infinity */
-    //nPosition = ( Position >= MAX_LOG ) ? 0 : ( MAX_REG - (Position * 16U) );
-	if( Position > MAX_LOG ){
-		TRACE( OV8858_ERROR, "%s: pOV8858Ctx Position (%d) max_position(%d)\n", __FUNCTION__,Position, MAX_LOG);
-		//Position = MAX_LOG;
-	}	
-    /* ddl@rock-chips.com: v0.3.0 */
-    if ( Position >= MAX_LOG )
-        nPosition = pOV8858Ctx->VcmInfo.StartCurrent;
-    else 
-        nPosition = pOV8858Ctx->VcmInfo.StartCurrent + (pOV8858Ctx->VcmInfo.Step*(MAX_LOG-Position));
-    /* ddl@rock-chips.com: v0.6.0 */
-    if (nPosition > MAX_VCMDRV_REG)  
-        nPosition = MAX_VCMDRV_REG;
-
-    TRACE( OV8858_INFO, "%s: focus set position_reg_value(%d) position(%d) \n", __FUNCTION__, nPosition, Position);
-    data[0] = (uint8_t)(0x00U | (( nPosition & 0x3F0U ) >> 4U));                 // PD,  1, D9..D4, see AD5820 datasheet
-    //data[1] = (uint8_t)( ((nPosition & 0x0FU) << 4U) | MDI_SLEW_RATE_CTRL );    // D3..D0, S3..S0
-	data[1] = (uint8_t)( ((nPosition & 0x0FU) << 4U) | pOV8858Ctx->VcmInfo.StepMode );
-	
-    //TRACE( OV8858_ERROR, "%s: value = %d, 0x%02x 0x%02x\n", __FUNCTION__, nPosition, data[0], data[1] );
-
-    result = HalWriteI2CMem( pOV8858Ctx->IsiCtx.HalHandle,
-                             pOV8858Ctx->IsiCtx.I2cAfBusNum,
-                             pOV8858Ctx->IsiCtx.SlaveAfAddress,
-                             0,
-                             pOV8858Ctx->IsiCtx.NrOfAfAddressBytes,
-                             data,
-                             2U );
-    RETURN_RESULT_IF_DIFFERENT( RET_SUCCESS, result );
-
-    //TRACE( OV8858_ERROR, "%s: (exit)\n", __FUNCTION__);
-    return ( result );
+    return ( IsiVcmSet( &pOV8858Ctx->Vcm, Position ) );
 }
 
 
@@ -4463,60 +4296,12 @@ static RESULT OV8858_IsiMdiFocusGet
 {
     OV8858_Context_t *pOV8858Ctx = (OV8858_Context_t *)handle;
 
-    RESULT result = RET_SUCCESS;
-    uint8_t  data[2] = { 0, 0 };
-
-    //TRACE( OV8858_ERROR, "%s: (enter)\n", __FUNCTION__);
-
     if ( pOV8858Ctx == NULL )
     {
         return ( RET_WRONG_HANDLE );
     }
 
-    if ( pAbsStep == NULL )
-    {
-        return ( RET_NULL_POINTER );
-    }
-
-    result = HalReadI2CMem( pOV8858Ctx->IsiCtx.HalHandle,
-                            pOV8858Ctx->IsiCtx.I2cAfBusNum,
-                            pOV8858Ctx->IsiCtx.SlaveAfAddress,
-                            0,
-                            pOV8858Ctx->IsiCtx.NrOfAfAddressBytes,
-                            data,
-                            2U );
-    RETURN_RESULT_IF_DIFFERENT( RET_SUCCESS, result );
-
-    //TRACE( OV8858_ERROR, "%s: value = 0x%02x 0x%02x\n", __FUNCTION__, data[0], data[1] );
-
-    /* Data[0] = PD,  1, D9..D4, see VM149C datasheet */
-    /* Data[1] = D3..D0, S3..S0 */
-    *pAbsStep = ( ((uint32_t)(data[0] & 0x3FU)) << 4U ) | ( ((uint32_t)data[1]) >> 4U );
-
-    /*  //map 0 to 64 -> infinity 
-    if( *pAbsStep == 0 )
-    {
-        *pAbsStep = MAX_LOG;
-    }
-    else
-    {
-        *pAbsStep = ( MAX_REG - *pAbsStep ) / 16U;
-    }*/
-	if( *pAbsStep <= pOV8858Ctx->VcmInfo.StartCurrent)
-    {
-        *pAbsStep = MAX_LOG;
-    }
-    else if((*pAbsStep>pOV8858Ctx->VcmInfo.StartCurrent) && (*pAbsStep<=pOV8858Ctx->VcmInfo.RatedCurrent))
-    {
-        *pAbsStep = (pOV8858Ctx->VcmInfo.RatedCurrent - *pAbsStep ) / pOV8858Ctx->VcmInfo.Step;
-    }
-	else
-	{
-		*pAbsStep = 0;
-	}
-   // TRACE( OV8858_ERROR, "%s: (exit)\n", __FUNCTION__);
-
-    return ( result );
+    return ( IsiVcmGet( &pOV8858Ctx->Vcm, pAbsStep ) );
 }
 
 
@@ -756,47 +756,6 @@ const IsiRegDescription_t OV8858_g_1632x1224_twolane[] =
 	{0x0000 ,0x00,"eTableEnd",eTableEnd}
 
 };
-const IsiRegDescription_t OV8858_g_1632x1224P30_twolane_fpschg[] =
-{    
-	{0x380e, 0x04,"0x0100",eReadWrite}, // VTS H							 
-	{0x380f, 0xdc,"0x0100",eReadWrite}, // VTS L
-	{0x0000 ,0x00,"eTableEnd",eTableEnd}
-
-};
-
-const IsiRegDescription_t OV8858_g_1632x1224P25_twolane_fpschg[] =
-{  	
-	{0x380e, 0x05,"0x0100",eReadWrite}, // VTS H							 
-	{0x380f, 0xd4,"0x0100",eReadWrite}, // VTS L
-	{0x0000 ,0x00,"eTableEnd",eTableEnd}
-};
-
-
-const IsiRegDescription_t OV8858_g_1632x1224P20_twolane_fpschg[] =
-{
-    {0x380e, 0x07,"0x0100",eReadWrite}, // VTS H							 
-	{0x380f, 0x4a,"0x0100",eReadWrite}, // VTS L
-	{0x0000 ,0x00,"eTableEnd",eTableEnd}
-
-};
-
-const IsiRegDescription_t OV8858_g_1632x1224P15_twolane_fpschg[] =
-{
-		
-	{0x380e, 0x09,"0x0100",eReadWrite}, // VTS H							 
-	{0x380f, 0xb8,"0x0100",eReadWrite}, // VTS L
-	{0x0000 ,0x00,"eTableEnd",eTableEnd}
-
-};
-
-const IsiRegDescription_t OV8858_g_1632x1224P10_twolane_fpschg[] =
-{ 
-	{0x380e, 0x0e,"0x0100",eReadWrite}, // VTS H							 
-	{0x380f, 0x94,"0x0100",eReadWrite}, // VTS L	
-	{0x0000 ,0x00,"eTableEnd",eTableEnd}
-
-};
-
 const IsiRegDescription_t OV8858_g_3264x2448_twolane[] =
 {
 	{0x030e, 0x02,"0x0100",eReadWrite}, // pll2_rdiv					
@@ -840,22 +799,6 @@ const IsiRegDescription_t OV8858_g_3264x2448_twolane[] =
 	{0x0000 ,0x00,"eTableEnd",eTableEnd}
 
 };
-const IsiRegDescription_t OV8858_g_3264x2448P7_twolane_fpschg[] =
-{
-    {0x380e, 0x13,"0x0100",eReadWrite}, // VTS H						
-	{0x380f, 0x54,"0x0100",eReadWrite}, // VTS L						
-    {0x0000 ,0x00,"eTableEnd",eTableEnd}
-};
-
-const IsiRegDescription_t OV8858_g_3264x2448P15_twolane_fpschg[] =
-{
-    {0x380e, 0x09,"0x0100",eReadWrite}, // VTS H						
-	{0x380f, 0xaa,"0x0100",eReadWrite}, // VTS L						
-    {0x0000 ,0x00,"eTableEnd",eTableEnd}
-};
-
-
-
 const IsiRegDescription_t OV8858_g_aRegDescription_fourlane[] =
 {
 	// MIPI=720Mbps, SysClk=72Mhz,Dac Clock=360Mhz.
@@ -1231,46 +1174,6 @@ const IsiRegDescription_t OV8858_g_1632x1224_fourlane[] =
 {0x382d , 0x7f , "0x0100",eReadWrite},
 {0x0000 ,0x00,"eTableEnd",eTableEnd}
 
-};
-const IsiRegDescription_t OV8858_g_1632x1224P30_fourlane_fpschg[] =
-{    
-	{0x380e, 0x04,"0x0100",eReadWrite}, // VTS H							 
-	{0x380f, 0xdc,"0x0100",eReadWrite}, // VTS L
-	{0x0000 ,0x00,"eTableEnd",eTableEnd}
-
-};
-
-const IsiRegDescription_t OV8858_g_1632x1224P25_fourlane_fpschg[] =
-{  	
-	{0x380e, 0x05,"0x0100",eReadWrite}, // VTS H							 
-	{0x380f, 0xd4,"0x0100",eReadWrite}, // VTS L
-	{0x0000 ,0x00,"eTableEnd",eTableEnd}
-};
-
-
-const IsiRegDescription_t OV8858_g_1632x1224P20_fourlane_fpschg[] =
-{
-    {0x380e, 0x07,"0x0100",eReadWrite}, // VTS H							 
-	{0x380f, 0x4a,"0x0100",eReadWrite}, // VTS L
-	{0x0000 ,0x00,"eTableEnd",eTableEnd}
-
-};
-
-const IsiRegDescription_t OV8858_g_1632x1224P15_fourlane_fpschg[] =
-{
-		
-	{0x380e, 0x09,"0x0100",eReadWrite}, // VTS H							 
-	{0x380f, 0xb8,"0x0100",eReadWrite}, // VTS L
-	{0x0000 ,0x00,"eTableEnd",eTableEnd}
-
-};
-
-const IsiRegDescription_t OV8858_g_1632x1224P10_fourlane_fpschg[] =
-{ 
-	{0x380e, 0x0e,"0x0100",eReadWrite}, // VTS H							 
-	{0x380f, 0x94,"0x0100",eReadWrite}, // VTS L	
-	{0x0000 ,0x00,"eTableEnd",eTableEnd}
-
 };
 const IsiRegDescription_t OV8858_g_3264x2448_fourlane[] =
 {
@@ -1373,45 +1276,6 @@ const IsiRegDescription_t OV8858_g_3264x2448_fourlane[] =
 
 };
 
-const IsiRegDescription_t OV8858_g_3264x2448P7_fourlane_fpschg[] =
-{
-    {0x380e, 0x26,"0x0100",eReadWrite}, // VTS H						
-	{0x380f, 0xa8,"0x0100",eReadWrite}, // VTS L						
-    {0x0000 ,0x00,"eTableEnd",eTableEnd}
-};
-const IsiRegDescription_t OV8858_g_3264x2448P10_fourlane_fpschg[] =
-{
-    {0x380e, 0x1c,"0x0100",eReadWrite}, // VTS H						
-	{0x380f, 0xfe,"0x0100",eReadWrite}, // VTS L						
-    {0x0000 ,0x00,"eTableEnd",eTableEnd}
-};
-const IsiRegDescription_t OV8858_g_3264x2448P15_fourlane_fpschg[] =
-{
-    {0x380e, 0x13,"0x0100",eReadWrite}, // VTS H						
-	{0x380f, 0x54,"0x0100",eReadWrite}, // VTS L						
-    {0x0000 ,0x00,"eTableEnd",eTableEnd}
-};
-const IsiRegDescription_t OV8858_g_3264x2448P20_fourlane_fpschg[] =
-{
-    {0x380e, 0x0e,"0x0100",eReadWrite}, // VTS H						
-	{0x380f, 0x7f,"0x0100",eReadWrite}, // VTS L						
-    {0x0000 ,0x00,"eTableEnd",eTableEnd}
-};
-const IsiRegDescription_t OV8858_g_3264x2448P25_fourlane_fpschg[] =
-{
-    {0x380e, 0x0b,"0x0100",eReadWrite}, // VTS H						
-	{0x380f, 0x98,"0x0100",eReadWrite}, // VTS L						
-    {0x0000 ,0x00,"eTableEnd",eTableEnd}
-};
-
-const IsiRegDescription_t OV8858_g_3264x2448P30_fourlane_fpschg[] =
-{
-    {0x380e, 0x09,"0x0100",eReadWrite}, // VTS H						
-	{0x380f, 0xaa,"0x0100",eReadWrite}, // VTS L						
-    {0x0000 ,0x00,"eTableEnd",eTableEnd}
-};
-
-
 //--1
 const IsiRegDescription_t OV8858_g_aRegDescription_fourlane_R2A[] =
 {
@@ -0,0 +1,107 @@
+/**
+ * @file isi_vcm.h
+ *
+ * @brief   Voice coil motor (lens actuator) layer shared by the ISI drivers.
+ *
+ * The driver keeps an IsiVcmContext_t in its context, fills it with
+ * IsiVcmInit() from the instance config and forwards its IsiMdi calls to
+ * IsiVcmSetup(), IsiVcmSet() and IsiVcmGet(). The chip back-end only
+ * encodes the register writes; the position mapping, the cached position
+ * and the full travel time are common.
+ *
+ * Full travel time: what a move over the whole code range takes with the
+ * chip's slew setting (linear ramp, SAC (smart actuator control) or direct
+ * write). The drivers report it in the upper 16 bits of the max step for
+ * the AF search.
+ *
+ *****************************************************************************/
+#ifndef __ISI_VCM_H__
+#define __ISI_VCM_H__
+
+#include <ebase/types.h>
+#include <common/return_codes.h>
+#include <hal/hal_api.h>
+
+#include "isi.h"
+#include "isi_priv.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define ISI_VCM_DRV_CURRENT_MAX     100U        /* mA at full code */
+#define ISI_VCM_DRV_CODE_MAX        1023U       /* 10 bit current dac */
+
+typedef enum IsiVcmChip_e
+{
+    ISI_VCM_CHIP_AD5820     = 0,    /* 2 bytes: PD,FLAG,D9..D4 | D3..D0,S3..S0 with a fixed slew nibble */
+    ISI_VCM_CHIP_DW9714     = 1,    /* AD5820 layout, the nibble is the step mode: [3:2] codes/step, [1:0] step period */
+    ISI_VCM_CHIP_DW9718     = 2,    /* register mapped, SAC mode programmed at setup, position at 0x02 */
+    ISI_VCM_CHIP_MAX
+} IsiVcmChip_t;
+
+typedef enum IsiVcmSlew_e
+{
+    ISI_VCM_SLEW_DIRECT     = 0,    /* code written at once, the lens rings down */
+    ISI_VCM_SLEW_LINEAR     = 1,    /* chip ramps the code, time grows with the distance */
+    ISI_VCM_SLEW_SAC        = 2     /* chip shapes every move to one transition time */
+} IsiVcmSlew_t;
+
+typedef struct IsiVcmContext_s
+{
+    IsiSensorContext_t  *pIsiCtx;           /**< i2c of the af module */
+    IsiVcmChip_t        Chip;
+    IsiVcmSlew_t        Slew;
+    uint32_t            MaxLog;             /**< focus steps, MaxLog is infinity */
+    uint32_t            StartCurrent;       /**< dac codes */
+    uint32_t            RatedCurrent;
+    uint32_t            Step;               /**< dac codes per focus step */
+    uint32_t            StepMode;           /**< VcmStepMode of the board config */
+    uint8_t             SlewCtrl;           /**< AD5820 S3..S0 */
+
+    uint32_t            MoveFullTime;       /**< us for a move over the whole code range */
+    bool_t              CodeValid;          /**< Code is what the chip holds */
+    uint32_t            Code;
+} IsiVcmContext_t;
+
+RESULT IsiVcmInit
+(
+    IsiVcmContext_t                 *pVcm,
+    IsiSensorContext_t              *pIsiCtx,
+    IsiVcmChip_t                    Chip,
+    const IsiSensorInstanceConfig_t *pConfig,
+    uint32_t                        MaxLog,
+    uint8_t                         SlewCtrl
+);
+
+/* powers the chip up, moves to infinity; *pMaxStep = MaxLog | (move full time in ms << 16) */
+RESULT IsiVcmSetup
+(
+    IsiVcmContext_t                 *pVcm,
+    uint32_t                        *pMaxStep
+);
+
+RESULT IsiVcmSet
+(
+    IsiVcmContext_t                 *pVcm,
+    uint32_t                        Position
+);
+
+RESULT IsiVcmGet
+(
+    IsiVcmContext_t                 *pVcm,
+    uint32_t                        *pPosition
+);
+
+/* the chip lost its code (sensor power change), the next move is always written */
+void IsiVcmInvalidate
+(
+    IsiVcmContext_t                 *pVcm
+);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __ISI_VCM_H__ */
@@ -34,3 +34,25 @@ LOCAL_MODULE_TAGS:= optional
 #include $(BUILD_SHARED_LIBRARY)
 include $(BUILD_STATIC_LIBRARY)
 
+#vcm actuator layer, linked statically into the isi drivers that use it
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:=\
+	isi_vcm.c\
+	
+
+LOCAL_C_INCLUDES += \
+	$(LOCAL_PATH)/../include\
+	$(LOCAL_PATH)/../include_priv\
+	$(LOCAL_PATH)/../../include\
+
+
+LOCAL_CFLAGS := -Wall -Wextra -std=c99   -Wformat-nonliteral -g -O0 -DDEBUG -pedantic
+LOCAL_CFLAGS += -DLINUX  -DMIPI_USE_CAMERIC -DHAL_MOCKUP -DCAM_ENGINE_DRAW_DOM_ONLY -D_FILE_OFFSET_BITS=64 -DHAS_STDINT_H
+
+LOCAL_SHARED_LIBRARIES:=libisp_silicomimageisp_api
+
+LOCAL_MODULE:= libisp_isi_vcm
+
+LOCAL_MODULE_TAGS:= optional
+include $(BUILD_STATIC_LIBRARY)
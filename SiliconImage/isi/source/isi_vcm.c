@@ -0,0 +1,383 @@
+/**
+ * @file isi_vcm.c
+ *
+ * @brief   Voice coil motor layer shared by the ISI drivers, see isi_vcm.h.
+ *
+ *****************************************************************************/
+#include <unistd.h>
+
+#include <ebase/types.h>
+#include <ebase/trace.h>
+#include <ebase/builtins.h>
+
+#include <common/return_codes.h>
+
+#include "isi.h"
+#include "isi_iss.h"
+#include "isi_priv.h"
+#include "isi_vcm.h"
+
+
+
+/******************************************************************************
+ * local macro definitions
+ *****************************************************************************/
+CREATE_TRACER( ISI_VCM_INFO , "ISI_VCM: ", INFO,    0U );
+CREATE_TRACER( ISI_VCM_ERROR, "ISI_VCM: ", ERROR,   1U );
+
+#define DW9718_REG_CONTROL      0x00U
+#define DW9718_REG_MODE         0x01U
+#define DW9718_REG_DAC          0x02U       /* 0x02: D9..D8, 0x03: D7..D0 */
+#define DW9718_REG_SACT         0x05U
+#define DW9718_MODE_SAC         0x39U
+#define DW9718_SACT             0x65U
+#define DW9718_SAC_TIME         50000U      /* us, with DW9718_SACT */
+
+
+
+/******************************************************************************
+ * chip back-ends
+ *****************************************************************************/
+typedef struct IsiVcmDrv_s
+{
+    const char  *pName;
+    RESULT      (*pSetup)( IsiVcmContext_t *pVcm );
+    RESULT      (*pWrite)( IsiVcmContext_t *pVcm, uint32_t Code );
+    RESULT      (*pRead)( IsiVcmContext_t *pVcm, uint32_t *pCode );
+    uint32_t    (*pMoveFull)( IsiVcmContext_t *pVcm );      /* us, also sets Slew */
+} IsiVcmDrv_t;
+
+static RESULT IsiVcmWriteMem
+(
+    IsiVcmContext_t *pVcm,
+    uint32_t        Reg,
+    uint8_t         *pData,
+    uint32_t        Size
+)
+{
+    return ( HalWriteI2CMem( pVcm->pIsiCtx->HalHandle,
+                             pVcm->pIsiCtx->I2cAfBusNum,
+                             pVcm->pIsiCtx->SlaveAfAddress,
+                             Reg,
+                             pVcm->pIsiCtx->NrOfAfAddressBytes,
+                             pData,
+                             Size ) );
+}
+
+static RESULT IsiVcmReadMem
+(
+    IsiVcmContext_t *pVcm,
+    uint32_t        Reg,
+    uint8_t         *pData,
+    uint32_t        Size
+)
+{
+    return ( HalReadI2CMem( pVcm->pIsiCtx->HalHandle,
+                            pVcm->pIsiCtx->I2cAfBusNum,
+                            pVcm->pIsiCtx->SlaveAfAddress,
+                            Reg,
+                            pVcm->pIsiCtx->NrOfAfAddressBytes,
+                            pData,
+                            Size ) );
+}
+
+static RESULT AD5820_Setup( IsiVcmContext_t *pVcm )
+{
+    (void)pVcm;
+    return ( RET_SUCCESS );
+}
+
+static RESULT AD5820_Write( IsiVcmContext_t *pVcm, uint32_t Code )
+{
+    uint8_t data[2];
+    uint8_t slew = ( pVcm->Chip == ISI_VCM_CHIP_DW9714 ) ? (uint8_t)pVcm->StepMode : pVcm->SlewCtrl;
+
+    data[0] = (uint8_t)(0x00U | (( Code & 0x3F0U ) >> 4U));         // PD,  1, D9..D4
+    data[1] = (uint8_t)( ((Code & 0x0FU) << 4U) | (slew & 0x0FU) ); // D3..D0, S3..S0
+
+    return ( IsiVcmWriteMem( pVcm, 0U, data, 2U ) );
+}
+
+static RESULT AD5820_Read( IsiVcmContext_t *pVcm, uint32_t *pCode )
+{
+    uint8_t data[2] = { 0, 0 };
+    RESULT result;
+
+    result = IsiVcmReadMem( pVcm, 0U, data, 2U );
+    RETURN_RESULT_IF_DIFFERENT( RET_SUCCESS, result );
+
+    *pCode = ( ((uint32_t)(data[0] & 0x3FU)) << 4U ) | ( ((uint32_t)data[1]) >> 4U );
+    return ( RET_SUCCESS );
+}
+
+/* StepMode 1..7: linear steps of 2^(StepMode-1) x 52ms full travel, 9..15: 2^(StepMode-9) x 2ms */
+static uint32_t AD5820_MoveFull( IsiVcmContext_t *pVcm )
+{
+    uint32_t mode = pVcm->StepMode;
+
+    pVcm->Slew = ISI_VCM_SLEW_LINEAR;
+    if ( (mode >= 1U) && (mode <= 7U) )
+    {
+        return ( 52000U * (1U << (mode - 1U)) );
+    }
+    if ( (mode >= 9U) && (mode <= 15U) )
+    {
+        return ( 2000U * (1U << (mode - 9U)) );
+    }
+
+    TRACE( ISI_VCM_ERROR, "%s: StepMode %d is invalidate!\n", __FUNCTION__, mode );
+    pVcm->Slew = ISI_VCM_SLEW_DIRECT;
+    return ( 64U * ISI_VCM_DRV_CODE_MAX );
+}
+
+/* [3:2]: 0 direct, else 2^(n-1) codes per step; [1:0]: 64us x 2^n per step */
+static uint32_t DW9714_MoveFull( IsiVcmContext_t *pVcm )
+{
+    uint32_t mode = pVcm->StepMode;
+
+    if ( (mode & 0x0CU) != 0U )
+    {
+        pVcm->Slew = ISI_VCM_SLEW_LINEAR;
+        return ( 64U * (1U << (mode & 0x03U)) * 1024U / (1U << (((mode & 0x0CU) >> 2U) - 1U)) );
+    }
+
+    pVcm->Slew = ISI_VCM_SLEW_DIRECT;
+    return ( 64U * ISI_VCM_DRV_CODE_MAX );
+}
+
+static RESULT DW9718_Setup( IsiVcmContext_t *pVcm )
+{
+    uint8_t data;
+    RESULT result;
+
+    data = 0x00U;
+    result = IsiVcmWriteMem( pVcm, DW9718_REG_CONTROL, &data, 1U );
+    RETURN_RESULT_IF_DIFFERENT( RET_SUCCESS, result );
+    usleep(100);
+
+    data = DW9718_MODE_SAC;
+    result = IsiVcmWriteMem( pVcm, DW9718_REG_MODE, &data, 1U );
+    RETURN_RESULT_IF_DIFFERENT( RET_SUCCESS, result );
+
+    data = DW9718_SACT;
+    result = IsiVcmWriteMem( pVcm, DW9718_REG_SACT, &data, 1U );
+    RETURN_RESULT_IF_DIFFERENT( RET_SUCCESS, result );
+    usleep(500);
+
+    return ( RET_SUCCESS );
+}
+
+static RESULT DW9718_Write( IsiVcmContext_t *pVcm, uint32_t Code )
+{
+    uint8_t data[2];
+
+    data[0] = (uint8_t)(( Code & 0xF00U ) >> 8U);
+    data[1] = (uint8_t)( Code & 0xFFU );
+
+    return ( IsiVcmWriteMem( pVcm, DW9718_REG_DAC, data, 2U ) );
+}
+
+static RESULT DW9718_Read( IsiVcmContext_t *pVcm, uint32_t *pCode )
+{
+    uint8_t data[2] = { 0, 0 };
+    RESULT result;
+
+    result = IsiVcmReadMem( pVcm, DW9718_REG_DAC, &data[0], 1U );
+    RETURN_RESULT_IF_DIFFERENT( RET_SUCCESS, result );
+    result = IsiVcmReadMem( pVcm, DW9718_REG_DAC + 1U, &data[1], 1U );
+    RETURN_RESULT_IF_DIFFERENT( RET_SUCCESS, result );
+
+    *pCode = ( ((uint32_t)(data[0] & 0x0FU)) << 8U ) | ((uint32_t)data[1]);
+    return ( RET_SUCCESS );
+}
+
+static uint32_t DW9718_MoveFull( IsiVcmContext_t *pVcm )
+{
+    pVcm->Slew = ISI_VCM_SLEW_SAC;
+    return ( DW9718_SAC_TIME );
+}
+
+static const IsiVcmDrv_t IsiVcmDrvs[ISI_VCM_CHIP_MAX] =
+{
+    { "AD5820", AD5820_Setup, AD5820_Write, AD5820_Read, AD5820_MoveFull },
+    { "DW9714", AD5820_Setup, AD5820_Write, AD5820_Read, DW9714_MoveFull },
+    { "DW9718", DW9718_Setup, DW9718_Write, DW9718_Read, DW9718_MoveFull },
+};
+
+
+
+/******************************************************************************
+ * position mapping
+ *****************************************************************************/
+static uint32_t IsiVcmPosToCode( const IsiVcmContext_t *pVcm, uint32_t Position )
+{
+    uint32_t code;
+
+    /* MaxLog -> infinity -> start current */
+    if ( Position >= pVcm->MaxLog )
+        code = pVcm->StartCurrent;
+    else
+        code = pVcm->StartCurrent + (pVcm->Step * (pVcm->MaxLog - Position));
+
+    return ( (code > ISI_VCM_DRV_CODE_MAX) ? ISI_VCM_DRV_CODE_MAX : code );
+}
+
+static uint32_t IsiVcmCodeToPos( const IsiVcmContext_t *pVcm, uint32_t Code )
+{
+    if ( Code <= pVcm->StartCurrent )
+        return ( pVcm->MaxLog );
+    if ( Code <= pVcm->RatedCurrent )
+        return ( (pVcm->RatedCurrent - Code) / pVcm->Step );
+    return ( 0U );
+}
+
+/******************************************************************************
+ * API
+ *****************************************************************************/
+RESULT IsiVcmInit
+(
+    IsiVcmContext_t                 *pVcm,
+    IsiSensorContext_t              *pIsiCtx,
+    IsiVcmChip_t                    Chip,
+    const IsiSensorInstanceConfig_t *pConfig,
+    uint32_t                        MaxLog,
+    uint8_t                         SlewCtrl
+)
+{
+    uint32_t current_distance;
+
+    if ( (pVcm == NULL) || (pIsiCtx == NULL) || (pConfig == NULL) )
+    {
+        return ( RET_NULL_POINTER );
+    }
+    if ( (Chip >= ISI_VCM_CHIP_MAX) || (MaxLog == 0U) )
+    {
+        return ( RET_INVALID_PARM );
+    }
+
+    MEMSET( pVcm, 0, sizeof( IsiVcmContext_t ) );
+    pVcm->pIsiCtx   = pIsiCtx;
+    pVcm->Chip      = Chip;
+    pVcm->MaxLog    = MaxLog;
+    pVcm->SlewCtrl  = SlewCtrl;
+    pVcm->StepMode  = pConfig->VcmStepMode;
+
+    /* ddl@rock-chips.com: v0.3.0 */
+    current_distance = pConfig->VcmRatedCurrent - pConfig->VcmStartCurrent;
+    current_distance = current_distance * ISI_VCM_DRV_CODE_MAX / ISI_VCM_DRV_CURRENT_MAX;
+    pVcm->Step          = (current_distance + (MaxLog - 1U)) / MaxLog;
+    if ( pVcm->Step == 0U )
+    {
+        pVcm->Step = 1U;
+    }
+    pVcm->StartCurrent  = pConfig->VcmStartCurrent * ISI_VCM_DRV_CODE_MAX / ISI_VCM_DRV_CURRENT_MAX;
+    pVcm->RatedCurrent  = pVcm->StartCurrent + MaxLog * pVcm->Step;
+    pVcm->MoveFullTime  = IsiVcmDrvs[Chip].pMoveFull( pVcm );
+
+    TRACE( ISI_VCM_INFO, "%s: %s codes %d..%d step %d, full move %d us, slew %d\n", __FUNCTION__,
+        IsiVcmDrvs[Chip].pName, pVcm->StartCurrent, pVcm->RatedCurrent, pVcm->Step,
+        pVcm->MoveFullTime, pVcm->Slew );
+
+    return ( RET_SUCCESS );
+}
+
+RESULT IsiVcmSetup
+(
+    IsiVcmContext_t                 *pVcm,
+    uint32_t                        *pMaxStep
+)
+{
+    RESULT result;
+
+    if ( (pVcm == NULL) || (pVcm->pIsiCtx == NULL) || (pMaxStep == NULL) )
+    {
+        return ( RET_NULL_POINTER );
+    }
+
+    /* the chip may have been powered down since the last move */
+    pVcm->CodeValid = BOOL_FALSE;
+    result = IsiVcmDrvs[pVcm->Chip].pSetup( pVcm );
+    RETURN_RESULT_IF_DIFFERENT( RET_SUCCESS, result );
+
+    *pMaxStep = ( pVcm->MaxLog | ((pVcm->MoveFullTime / 1000U) << 16U) );
+
+    return ( IsiVcmSet( pVcm, pVcm->MaxLog ) );
+}
+
+RESULT IsiVcmSet
+(
+    IsiVcmContext_t                 *pVcm,
+    uint32_t                        Position
+)
+{
+    uint32_t code;
+    RESULT result;
+
+    if ( (pVcm == NULL) || (pVcm->pIsiCtx == NULL) )
+    {
+        return ( RET_NULL_POINTER );
+    }
+
+    if ( Position > pVcm->MaxLog )
+    {
+        TRACE( ISI_VCM_ERROR, "%s: Position (%d) max_position(%d)\n", __FUNCTION__, Position, pVcm->MaxLog );
+    }
+    code = IsiVcmPosToCode( pVcm, Position );
+
+    if ( (pVcm->CodeValid == BOOL_TRUE) && (pVcm->Code == code) )
+    {
+        return ( RET_SUCCESS );
+    }
+
+    result = IsiVcmDrvs[pVcm->Chip].pWrite( pVcm, code );
+    if ( result != RET_SUCCESS )
+    {
+        pVcm->CodeValid = BOOL_FALSE;
+        TRACE( ISI_VCM_ERROR, "%s: write code %d failed (%d)\n", __FUNCTION__, code, result );
+        return ( result );
+    }
+
+    TRACE( ISI_VCM_INFO, "%s: position %d code %d -> %d\n", __FUNCTION__,
+        Position, pVcm->Code, code );
+    pVcm->Code = code;
+    pVcm->CodeValid = BOOL_TRUE;
+
+    return ( RET_SUCCESS );
+}
+
+RESULT IsiVcmGet
+(
+    IsiVcmContext_t                 *pVcm,
+    uint32_t                        *pPosition
+)
+{
+    uint32_t code;
+    RESULT result;
+
+    if ( (pVcm == NULL) || (pVcm->pIsiCtx == NULL) || (pPosition == NULL) )
+    {
+        return ( RET_NULL_POINTER );
+    }
+
+    if ( pVcm->CodeValid != BOOL_TRUE )
+    {
+        result = IsiVcmDrvs[pVcm->Chip].pRead( pVcm, &code );
+        RETURN_RESULT_IF_DIFFERENT( RET_SUCCESS, result );
+        pVcm->Code = code;
+        pVcm->CodeValid = BOOL_TRUE;
+    }
+    *pPosition = IsiVcmCodeToPos( pVcm, pVcm->Code );
+
+    return ( RET_SUCCESS );
+}
+
+void IsiVcmInvalidate
+(
+    IsiVcmContext_t                 *pVcm
+)
+{
+    if ( pVcm != NULL )
+    {
+        pVcm->CodeValid = BOOL_FALSE;
+    }
+}